@@ -0,0 +1,775 @@
+// hostlink.cpp - Linux host tool for the co-processor links, over a serial tty or a pty (e.g. rxsim)
+// Usage: hostlink [-b baud] [-c chunk] [-w window] [-T timeout_ms] <cmd> <tty> [args]
+//   putbin <tty> <local> <remote> [resume]
+//                                   shrxbin upload to main_mcu's putbin: windowed, each frame ACKed or
+//                                   NAKed and resent (-c frame size, default SHRXBIN_MAX_FRAME; -w caps
+//                                   the receiver's window). resume continues an interrupted upload of
+//                                   <remote> from the offset the receiver reports, if the CRC32 it
+//                                   reports for that prefix matches <local>. Receivers without
+//                                   ACK/NAK get frames back to back, -w bytes queued ahead of the wire.
+//   hello|info|status <tty>         CoProc RPC
+//   stats <tty> [reset]             link counters of both ends
+//   load|sload <tty> <file>         blob / script upload as windowed *_WDATA bursts; -c/-w are what
+//                                   we ask for in *_BEGIN, the co-processor answers with its limits
+//   exec|sexec <tty> [args..]       run the loaded blob / script
+//   func <tty> <name> [args..]      named function call
+//   bench <tty> [n]                 n "ping" calls, round trip times
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "CoProcProto.h"
+#include "CoProcLink.h"
+#include "shrxbin.h"
+
+#ifndef HOSTLINK_REPLY_MS
+#define HOSTLINK_REPLY_MS 3000  // wait for a reply frame
+#endif
+#ifndef HOSTLINK_WIN_RETRIES
+#define HOSTLINK_WIN_RETRIES 8  // rounds without progress before a windowed upload gives up
+#endif
+#ifndef MAX_EXEC_ARGS
+#define MAX_EXEC_ARGS 64  // as CoProcExec.h
+#endif
+
+struct Options {
+  uint32_t baud = 115200;
+  uint32_t chunk = 0;   // 0: per-command default
+  uint32_t window = 0;  // 0: per-command default
+  uint32_t timeoutMs = 5000;
+};
+static Options g_opt;
+static CoProc::PtyLink g_link;
+static CoProc::LinkStats g_stats;  // same counters as the co-processor keeps (CMD_STATS)
+static uint32_t g_seq = 1;
+
+static double secondsSince(uint32_t t0Us) {
+  return (double)(uint32_t)(micros() - t0Us) / 1e6;
+}
+static void printRate(const char* what, uint64_t bytes, uint32_t t0Us) {
+  double dt = secondsSince(t0Us);
+  printf("%s: %llu bytes in %.3f s, %.1f KiB/s\n", what, (unsigned long long)bytes, dt,
+         dt > 0 ? bytes / 1024.0 / dt : 0.0);
+}
+
+// ------- Link byte helpers -------
+static bool waitFd(short events, uint32_t ms) {
+  struct pollfd p = { g_link.fd(), events, 0 };
+  return ::poll(&p, 1, (int)ms) > 0;
+}
+static bool readByte(uint8_t& b, uint32_t timeoutMs) {
+  uint32_t start = millis();
+  for (;;) {
+    int v = g_link.read();
+    if (v >= 0) {
+      b = (uint8_t)v;
+      ++g_stats.bytes_rx;
+      return true;
+    }
+    uint32_t waited = millis() - start;
+    if (waited > timeoutMs) return false;
+    waitFd(POLLIN, timeoutMs - waited + 1);
+  }
+}
+static bool readExact(uint8_t* dst, size_t n, uint32_t timeoutMs) {
+  for (size_t i = 0; i < n; ++i) {
+    if (!readByte(dst[i], timeoutMs)) return false;
+  }
+  return true;
+}
+static bool writeAll(const void* src, size_t n) {
+  const uint8_t* p = (const uint8_t*)src;
+  uint32_t start = millis();
+  while (n) {
+    size_t w = g_link.write(p, n);
+    if (w) {
+      p += w;
+      n -= w;
+      g_stats.bytes_tx += (uint32_t)w;
+      start = millis();
+      continue;
+    }
+    if (errno != EAGAIN && errno != EINTR) return false;
+    if ((uint32_t)(millis() - start) > g_opt.timeoutMs) return false;
+    waitFd(POLLOUT, 50);
+  }
+  return true;
+}
+// Bytes written but not yet on the wire (0 where the driver cannot tell)
+static uint32_t outQueued() {
+  int q = 0;
+  return (::ioctl(g_link.fd(), TIOCOUTQ, &q) == 0 && q > 0) ? (uint32_t)q : 0;
+}
+// One text line (CR/LF stripped); false on timeout
+static bool readLine(std::string& line, uint32_t timeoutMs) {
+  line.clear();
+  uint32_t start = millis();
+  for (;;) {
+    uint32_t waited = millis() - start;
+    uint8_t b;
+    if (waited > timeoutMs || !readByte(b, timeoutMs - waited)) return false;
+    if (b == '\n') return true;
+    if (b != '\r') line += (char)b;
+  }
+}
+
+static bool openLink(const char* tty) {
+  if (!g_link.open(tty)) {
+    fprintf(stderr, "hostlink: cannot open %s: %s\n", tty, strerror(errno));
+    return false;
+  }
+  if (!g_link.begin(g_opt.baud)) {
+    fprintf(stderr, "hostlink: cannot set %u baud on %s\n", (unsigned)g_opt.baud, tty);
+    return false;
+  }
+  return true;
+}
+
+// ========== shrxbin (putbin) ==========
+static bool writeRxFrame(uint32_t off, const uint8_t* data, uint32_t len) {
+  uint8_t hdr[16] = { 0xA5, 0x5A, 0x4B, 0x52 };
+  uint32_t crc = len ? Crc32::compute(data, len) : 0;
+  memcpy(hdr + 4, &off, 4);
+  memcpy(hdr + 8, &len, 4);
+  memcpy(hdr + 12, &crc, 4);
+  return writeAll(hdr, sizeof(hdr)) && (!len || writeAll(data, len));
+}
+
+// A line the receiver printed mid-upload can only be an ERR (shrxbin is silent until the commit)
+static bool rxErrorPending(std::string& pend) {
+  uint8_t b;
+  while (g_link.available() > 0 && readByte(b, 0)) {
+    if (b == '\n') {
+      if (pend.rfind("ERR", 0) == 0) return true;
+      pend.clear();
+    } else if (b != '\r') {
+      pend += (char)b;
+    }
+  }
+  return false;
+}
+
+// Plain session (receiver answered a bare READY): frames go out back to back; the only wait is for
+// the tty queue to drain below 'window', which keeps the progress honest and lets a receiver ERR
+// stop us within a window.
+static bool putbinStream(const std::vector<uint8_t>& img, uint32_t chunk, uint32_t window, uint32_t t0) {
+  uint32_t lastReport = 0;
+  std::string pend;
+  for (uint32_t off = 0; off < img.size();) {
+    uint32_t n = (uint32_t)img.size() - off < chunk ? (uint32_t)img.size() - off : chunk;
+    bool err = false;
+    while (!(err = rxErrorPending(pend)) && outQueued() > window) waitFd(POLLIN, 1);
+    if (err) {
+      printf("< %s\n", pend.c_str());
+      fprintf(stderr, "putbin: receiver stopped at %u\n", (unsigned)off);
+      return false;
+    }
+    if (!writeRxFrame(off, img.data() + off, n)) {
+      fprintf(stderr, "putbin: write failed at %u\n", (unsigned)off);
+      return false;
+    }
+    ++g_stats.frames_tx;
+    off += n;
+    if (off - lastReport >= 512u * 1024u || off == img.size()) {
+      lastReport = off;
+      double dt = secondsSince(t0);
+      printf("  %.2f MiB queued  (%.2f MiB/s)\n", off / 1048576.0, dt > 0 ? off / 1048576.0 / dt : 0.0);
+    }
+  }
+  if (!writeRxFrame(0xFFFFFFFFu, nullptr, 0)) {
+    fprintf(stderr, "putbin: commit write failed\n");
+    return false;
+  }
+  g_link.flush();
+  for (;;) {  // 'pend' may already hold the start of the line
+    uint8_t b;
+    if (!readByte(b, 20000)) {
+      fprintf(stderr, "putbin: timeout waiting for completion\n");
+      return false;
+    }
+    if (b == '\r') continue;
+    if (b != '\n') {
+      pend += (char)b;
+      continue;
+    }
+    printf("< %s\n", pend.c_str());
+    if (pend.rfind("OK", 0) == 0) return true;
+    if (pend.rfind("ERR", 0) == 0) return false;
+    pend.clear();
+  }
+}
+
+// Windowed session (READY <window> <maxFrame> <offset>): at most 'window' unACKed bytes in flight,
+// go back to the receiver's offset on a NAK, or to the last ACK after HOSTLINK_REPLY_MS of silence
+// (a lost ACK only costs resending frames the receiver re-ACKs without writing).
+static bool putbinWindowed(const std::vector<uint8_t>& img, uint32_t from, uint32_t chunk, uint32_t window,
+                           uint32_t t0, uint32_t& resent, uint32_t& naks) {
+  const uint32_t total = (uint32_t)img.size();
+  uint32_t acked = from, next = from, high = from, stall = 0, lastReport = from;
+  bool committed = false;
+  std::string line;
+  resent = naks = 0;
+  for (;;) {
+    while (next < total) {
+      uint32_t n = total - next < chunk ? total - next : chunk;
+      if (next > acked && next - acked + n > window) break;
+      if (!writeRxFrame(next, img.data() + next, n)) {
+        fprintf(stderr, "putbin: write failed at %u\n", (unsigned)next);
+        return false;
+      }
+      ++g_stats.frames_tx;
+      if (next < high) ++resent;
+      next += n;
+      if (next > high) high = next;
+    }
+    if (acked == total && !committed) {
+      if (!writeRxFrame(0xFFFFFFFFu, nullptr, 0)) {
+        fprintf(stderr, "putbin: commit write failed\n");
+        return false;
+      }
+      committed = true;
+    }
+    if (!readLine(line, committed ? 20000 : HOSTLINK_REPLY_MS)) {
+      ++g_stats.timeouts;
+      if (++stall > HOSTLINK_WIN_RETRIES) {
+        fprintf(stderr, "putbin: stalled at %u (no ACK)\n", (unsigned)acked);
+        return false;
+      }
+      next = acked;
+      committed = false;
+      continue;
+    }
+    unsigned a = 0, b = 0;
+    char why[32] = "";
+    if (sscanf(line.c_str(), "ACK %u %u", &a, &b) == 2) {
+      if (a <= acked && a + b > acked) {
+        acked = a + b;
+        stall = 0;
+      }
+      if (acked - lastReport >= 512u * 1024u || (acked == total && lastReport != total)) {
+        lastReport = acked;
+        double dt = secondsSince(t0);
+        double mb = (acked - from) / 1048576.0;
+        printf("  %.2f MiB acked  (%.2f MiB/s)\n", acked / 1048576.0, dt > 0 ? mb / dt : 0.0);
+      }
+      continue;
+    }
+    printf("< %s\n", line.c_str());
+    if (sscanf(line.c_str(), "NAK %u %31s", &a, why) >= 1) {
+      ++naks;
+      if (a < acked || a > total) {
+        fprintf(stderr, "putbin: bad NAK offset %u\n", a);
+        return false;
+      }
+      stall = (a > acked) ? 0 : stall + 1;
+      if (stall > HOSTLINK_WIN_RETRIES) {
+        fprintf(stderr, "putbin: stalled at %u (%s)\n", (unsigned)a, why);
+        return false;
+      }
+      acked = next = a;
+      committed = false;
+      continue;
+    }
+    if (line.rfind("OK", 0) == 0) return true;
+    if (line.rfind("ERR", 0) == 0) return false;
+  }
+}
+
+// Sends a putbin command line and waits for the receiver's READY
+static bool putbinRequest(const char* cmd, std::string& line) {
+  if (!writeAll(cmd, strlen(cmd))) {
+    fprintf(stderr, "putbin: write failed\n");
+    return false;
+  }
+  do {  // the console echoes the command first
+    if (!readLine(line, 15000)) {
+      fprintf(stderr, "putbin: timeout waiting for READY\n");
+      return false;
+    }
+    printf("< %s\n", line.c_str());
+    if (line.rfind("putbin:", 0) == 0 || line.rfind("usage:", 0) == 0) return false;
+    // An interrupted session was still open and took the command as frame bytes; it has given up now
+    if (line.rfind("ERR idle", 0) == 0 && !writeAll(cmd, strlen(cmd))) {
+      fprintf(stderr, "putbin: write failed\n");
+      return false;
+    }
+  } while (line.rfind("READY", 0) != 0);
+  return true;
+}
+
+static int cmdPutbin(const char* tty, const char* local, const char* remote, bool resume) {
+  FILE* f = fopen(local, "rb");
+  if (!f) {
+    fprintf(stderr, "putbin: cannot open %s\n", local);
+    return 1;
+  }
+  std::vector<uint8_t> img;
+  uint8_t buf[4096];
+  for (size_t n; (n = fread(buf, 1, sizeof(buf), f)) > 0;) img.insert(img.end(), buf, buf + n);
+  fclose(f);
+  if (img.empty()) {
+    fprintf(stderr, "putbin: %s is empty\n", local);
+    return 1;
+  }
+  uint32_t chunk = g_opt.chunk ? g_opt.chunk : SHRXBIN_MAX_FRAME;
+  if (chunk > SHRXBIN_MAX_FRAME) chunk = SHRXBIN_MAX_FRAME;  // the receiver's frame buffer
+  if (!openLink(tty)) return 1;
+  ::tcflush(g_link.fd(), TCIOFLUSH);
+
+  char cmd[128];
+  snprintf(cmd, sizeof(cmd), "putbin %s %u %s\r\n", remote, (unsigned)img.size(), resume ? "resume" : "win");
+  std::string line;
+  if (!putbinRequest(cmd, line)) return 1;
+
+  unsigned rxWindow = 0, rxFrame = 0, from = 0, rxCrc = 0;
+  int fields = sscanf(line.c_str(), "READY %u %u %u %x", &rxWindow, &rxFrame, &from, &rxCrc);
+  // Skip only a prefix the receiver holds byte for byte; otherwise abort the session and start over
+  if (fields >= 3 && from > 0 && from <= img.size() && (fields < 4 || rxCrc != Crc32::compute(img.data(), from))) {
+    fprintf(stderr, "putbin: receiver's first %u bytes differ from %s, sending from 0\n", from, local);
+    if (!writeRxFrame(0xFFFFFFFEu, nullptr, 0)) {
+      fprintf(stderr, "putbin: write failed\n");
+      return 1;
+    }
+    do {
+      if (!readLine(line, HOSTLINK_REPLY_MS)) break;
+      printf("< %s\n", line.c_str());
+    } while (line.rfind("ERR", 0) != 0);
+    snprintf(cmd, sizeof(cmd), "putbin %s %u win\r\n", remote, (unsigned)img.size());
+    if (!putbinRequest(cmd, line)) return 1;
+    from = 0;
+    fields = sscanf(line.c_str(), "READY %u %u %u", &rxWindow, &rxFrame, &from);
+    if (from) {
+      fprintf(stderr, "putbin: receiver resumed a fresh upload at %u\n", from);
+      return 1;
+    }
+  }
+
+  uint32_t t0 = micros();
+  if (fields < 3) {
+    // Receiver without ACK/NAK: it ignores the mode word and cannot resume
+    if (resume) fprintf(stderr, "putbin: receiver cannot resume, sending from 0\n");
+    if (!putbinStream(img, chunk, g_opt.window ? g_opt.window : 2 * chunk, t0)) return 1;
+    printRate("putbin", img.size(), t0);
+    return 0;
+  }
+  if (!rxWindow || !rxFrame || from > img.size()) {
+    fprintf(stderr, "putbin: bad READY\n");
+    return 1;
+  }
+  if (chunk > rxFrame) chunk = rxFrame;
+  uint32_t window = (g_opt.window && g_opt.window < rxWindow) ? g_opt.window : rxWindow;
+  if (from) printf("resuming at %u of %u\n", from, (unsigned)img.size());
+  uint32_t resent = 0, naks = 0;
+  if (!putbinWindowed(img, from, chunk, window, t0, resent, naks)) return 1;
+  printf("window %u x %u B, %u resent, %u NAKs\n", (unsigned)window, (unsigned)chunk, (unsigned)resent, (unsigned)naks);
+  printRate("putbin", img.size() - from, t0);
+  return 0;
+}
+
+// ========== CoProc RPC ==========
+static bool sendFrame(uint16_t cmd, const void* payload, uint32_t len, uint32_t& seq) {
+  CoProc::Frame h;
+  h.magic = CoProc::MAGIC;
+  h.version = CoProc::VERSION;
+  h.cmd = cmd;
+  h.seq = seq = g_seq++;
+  h.len = len;
+  h.crc32 = len ? CoProc::crc32_ieee(payload, len) : 0;
+  ++g_stats.frames_tx;
+  return writeAll(&h, sizeof(h)) && (!len || writeAll(payload, len));
+}
+
+static void printEvent(const uint8_t* p, uint32_t len) {
+  uint32_t w[4] = { 0, 0, 0, 0 };
+  memcpy(w, p, len < sizeof(w) ? len : sizeof(w));
+  printf("event type=%u %u %d %d\n", (unsigned)w[0], (unsigned)w[1], (int)w[2], (int)w[3]);
+}
+
+// Next intact frame; events are printed and skipped. False on timeout.
+static bool readFrame(CoProc::Frame& h, uint8_t* buf, uint32_t cap, uint32_t& len, uint32_t timeoutMs) {
+  static const uint8_t magic[4] = { 'C', 'P', 'R', '0' };
+  uint32_t start = millis();
+  uint8_t w[4] = { 0, 0, 0, 0 };
+  uint32_t scanned = 0;
+  for (;;) {
+    uint32_t waited = millis() - start;
+    uint8_t b;
+    if (waited > timeoutMs || !readByte(b, timeoutMs - waited)) {
+      ++g_stats.timeouts;
+      return false;
+    }
+    memmove(w, w + 1, 3);
+    w[3] = b;
+    ++scanned;
+    if (memcmp(w, magic, 4) != 0) continue;
+    if (scanned > 4) {
+      ++g_stats.resyncs;
+      g_stats.skipped += scanned - 4;
+    }
+    scanned = 0;
+    memcpy(&h, w, 4);
+    if (!readExact((uint8_t*)&h + 4, sizeof(h) - 4, 200) || h.version != CoProc::VERSION || h.len > cap) {
+      ++g_stats.bad_headers;
+      continue;
+    }
+    if (h.len && !readExact(buf, h.len, 2000)) {
+      ++g_stats.timeouts;
+      return false;
+    }
+    if (h.len && CoProc::crc32_ieee(buf, h.len) != h.crc32) {
+      ++g_stats.crc_errors;
+      continue;
+    }
+    ++g_stats.frames_rx;
+    len = h.len;
+    if (h.cmd == (CoProc::CMD_EVENT | 0x80)) {
+      printEvent(buf, len);
+      continue;
+    }
+    return true;
+  }
+}
+
+// Reply to (cmd, seq); stale replies are skipped
+static bool readReply(uint16_t cmd, uint32_t seq, uint8_t* buf, uint32_t cap, uint32_t& len, uint32_t timeoutMs) {
+  uint32_t start = millis();
+  CoProc::Frame h;
+  for (;;) {
+    uint32_t waited = millis() - start;
+    if (waited > timeoutMs || !readFrame(h, buf, cap, len, timeoutMs - waited)) return false;
+    if (h.cmd == (uint16_t)(cmd | 0x80) && h.seq == seq) return true;
+  }
+}
+
+static bool request(uint16_t cmd, const void* req, uint32_t reqLen, uint8_t* resp, uint32_t cap, uint32_t& rl,
+                    int32_t* st = nullptr, uint32_t timeoutMs = HOSTLINK_REPLY_MS) {
+  uint32_t seq = 0;
+  if (!sendFrame(cmd, req, reqLen, seq)) {
+    fprintf(stderr, "coproc: write failed\n");
+    return false;
+  }
+  if (!readReply(cmd, seq, resp, cap, rl, timeoutMs)) {
+    fprintf(stderr, "coproc: no reply to cmd 0x%02X\n", (unsigned)cmd);
+    return false;
+  }
+  if (st) {
+    *st = CoProc::ST_PARAM;
+    if (rl >= 4) memcpy(st, resp, 4);
+  }
+  return true;
+}
+
+static uint32_t rd32(const uint8_t* p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+static int cmdHello() {
+  uint8_t r[64];
+  uint32_t rl = 0;
+  int32_t st = 0;
+  if (!request(CoProc::CMD_HELLO, nullptr, 0, r, sizeof(r), rl, &st)) return 1;
+  if (rl < 12) return 1;
+  printf("HELLO st=%d version=0x%04X features=0x%08X\n", (int)st, (unsigned)rd32(r + 4), (unsigned)rd32(r + 8));
+  return st == CoProc::ST_OK ? 0 : 1;
+}
+
+static int cmdInfo() {
+  uint8_t r[64];
+  uint32_t rl = 0;
+  int32_t st = 0;
+  if (!request(CoProc::CMD_INFO, nullptr, 0, r, sizeof(r), rl, &st)) return 1;
+  if (rl < 4 + sizeof(CoProc::Info)) return 1;
+  CoProc::Info info;
+  memcpy(&info, r + 4, sizeof(info));
+  printf("INFO st=%d flags=0x%08X blob_len=%u mailbox_max=%u\n", (int)st, (unsigned)info.impl_flags,
+         (unsigned)info.blob_len, (unsigned)info.mailbox_max);
+  return 0;
+}
+
+static int cmdStatus() {
+  uint8_t r[64];
+  uint32_t rl = 0;
+  int32_t st = 0;
+  if (!request(CoProc::CMD_STATUS, nullptr, 0, r, sizeof(r), rl, &st)) return 1;
+  printf("STATUS st=%d exec_state=%u", (int)st, rl >= 8 ? (unsigned)rd32(r + 4) : 0u);
+  if (rl >= 20) printf(" job=%u job_status=%d job_result=%d", (unsigned)rd32(r + 8), (int)rd32(r + 12), (int)rd32(r + 16));
+  printf("\n");
+  return 0;
+}
+
+static int cmdStats(bool reset) {
+  uint32_t flags = reset ? (uint32_t)CoProc::STATS_RESET : 0u;
+  uint8_t r[16 + 4 * 32];
+  uint32_t rl = 0;
+  int32_t st = 0;
+  if (!request(CoProc::CMD_STATS, &flags, sizeof(flags), r, sizeof(r), rl, &st) || st != CoProc::ST_OK || rl < 8) return 1;
+  uint32_t n = rd32(r + 4);
+  const uint32_t* local = (const uint32_t*)&g_stats;
+  printf("%-12s %10s %10s\n", "", "host", "coproc");
+  for (uint32_t i = 0; i < CoProc::STATS_FIELDS; ++i) {
+    uint32_t remote = (i < n && 8 + 4 * (i + 1) <= rl) ? rd32(r + 8 + 4 * i) : 0;
+    printf("%-12s %10u %10u\n", CoProc::statsFieldName(i), (unsigned)local[i], (unsigned)remote);
+  }
+  return 0;
+}
+
+// Stream 'img' as *_WDATA bursts of up to 'window' frames; only the last frame of a burst asks for
+// an ACK. NAKed chunks and anything past the co-processor's 'high' mark are resent, a lost ACK is
+// recovered with an empty poll frame (same scheme as ExecHost::coprocSendWindowed).
+static bool sendWindowed(uint16_t cmd, const std::vector<uint8_t>& img, uint32_t chunk, uint32_t window,
+                         uint32_t& bursts, uint32_t& resent) {
+  const uint32_t total = (uint32_t)img.size();
+  const uint32_t nChunks = (total + chunk - 1) / chunk;
+  std::vector<uint8_t> frame(CoProc::WIN_HDR_BYTES + chunk);
+  uint32_t base = 0, next = 0, nak = 0, stall = 0;
+  bool poll = false;
+  bursts = resent = 0;
+  while (base < nChunks) {
+    uint32_t list[CoProc::WIN_MAX];
+    uint32_t n = 0;
+    for (uint32_t i = 0; !poll && i < CoProc::WIN_MAX && n < window; ++i) {
+      if (nak & (1u << i)) list[n++] = base + i;
+    }
+    resent += n;
+    while (!poll && n < window && next < nChunks && next < base + window) list[n++] = next++;
+    nak = 0;
+    poll = false;
+    uint32_t ackSeq = 0;
+    if (n == 0) {
+      uint32_t hdr[2] = { 0, CoProc::WIN_ACK_REQ };
+      if (!sendFrame(cmd, hdr, sizeof(hdr), ackSeq)) return false;
+    }
+    for (uint32_t k = 0; k < n; ++k) {
+      uint32_t idx = list[k];
+      uint32_t off = idx * chunk;
+      uint32_t len = (total - off < chunk) ? total - off : chunk;
+      uint32_t flags = (k == n - 1) ? CoProc::WIN_ACK_REQ : 0u;
+      memcpy(frame.data(), &idx, 4);
+      memcpy(frame.data() + 4, &flags, 4);
+      memcpy(frame.data() + CoProc::WIN_HDR_BYTES, img.data() + off, len);
+      if (!sendFrame(cmd, frame.data(), CoProc::WIN_HDR_BYTES + len, ackSeq)) return false;
+    }
+    ++bursts;
+    uint8_t r[64];
+    uint32_t rl = 0;
+    if (!readReply(cmd, ackSeq, r, sizeof(r), rl, HOSTLINK_REPLY_MS) || rl < 16) {
+      if (++stall > HOSTLINK_WIN_RETRIES) {
+        fprintf(stderr, "coproc: windowed upload stalled (no ACK)\n");
+        return false;
+      }
+      poll = true;
+      continue;
+    }
+    uint32_t ack[4];
+    memcpy(ack, r, sizeof(ack));
+    if ((int32_t)ack[0] != CoProc::ST_OK) {
+      fprintf(stderr, "coproc: WDATA st=%d at chunk %u\n", (int)(int32_t)ack[0], (unsigned)ack[1]);
+      return false;
+    }
+    if (ack[1] > nChunks || ack[1] < base) {
+      fprintf(stderr, "coproc: bad window ACK\n");
+      return false;
+    }
+    stall = (ack[1] > base) ? 0 : stall + 1;
+    if (stall > HOSTLINK_WIN_RETRIES) {
+      fprintf(stderr, "coproc: windowed upload stalled (no progress)\n");
+      return false;
+    }
+    base = ack[1];
+    nak = ack[2];
+    if (ack[3] < next) next = (ack[3] > base) ? ack[3] : base;  // tail of the burst never arrived
+  }
+  return true;
+}
+
+static int cmdLoad(bool script, const char* path) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "load: cannot open %s\n", path);
+    return 1;
+  }
+  std::vector<uint8_t> img;
+  uint8_t buf[4096];
+  for (size_t n; (n = fread(buf, 1, sizeof(buf), f)) > 0;) img.insert(img.end(), buf, buf + n);
+  fclose(f);
+  if (img.empty()) {
+    fprintf(stderr, "load: %s is empty\n", path);
+    return 1;
+  }
+  const uint16_t beginCmd = script ? CoProc::CMD_SCRIPT_BEGIN : CoProc::CMD_LOAD_BEGIN;
+  const uint16_t dataCmd = script ? CoProc::CMD_SCRIPT_WDATA : CoProc::CMD_LOAD_WDATA;
+  const uint16_t endCmd = script ? CoProc::CMD_SCRIPT_END : CoProc::CMD_LOAD_END;
+  const uint32_t total = (uint32_t)img.size();
+  // Ask big; the reply carries what the co-processor's request buffer and window can take
+  uint32_t req[3] = { total, g_opt.chunk ? g_opt.chunk : 0xFFFFFFFFu, g_opt.window ? g_opt.window : CoProc::WIN_MAX };
+  uint8_t r[64];
+  uint32_t rl = 0;
+  int32_t st = 0;
+  uint32_t t0 = micros();
+  if (!request(beginCmd, req, sizeof(req), r, sizeof(r), rl, &st)) return 1;
+  if (st != CoProc::ST_OK || rl < 12) {
+    fprintf(stderr, "load: BEGIN st=%d%s\n", (int)st, rl < 12 ? " (no windowed upload offered)" : "");
+    return 1;
+  }
+  uint32_t chunk = rd32(r + 4), window = rd32(r + 8);
+  if (!chunk || !window || window > CoProc::WIN_MAX) {
+    fprintf(stderr, "load: bad window %u x %u\n", (unsigned)window, (unsigned)chunk);
+    return 1;
+  }
+  uint32_t bursts = 0, resent = 0;
+  if (!sendWindowed(dataCmd, img, chunk, window, bursts, resent)) return 1;
+  uint32_t crc = CoProc::crc32_ieee(img.data(), img.size());
+  if (!request(endCmd, &crc, sizeof(crc), r, sizeof(r), rl, &st)) return 1;
+  if (st != CoProc::ST_OK) {
+    fprintf(stderr, "load: END st=%d\n", (int)st);
+    return 1;
+  }
+  printf("window %u x %u B, %u bursts, %u resent, crc 0x%08X\n", (unsigned)window, (unsigned)chunk,
+         (unsigned)bursts, (unsigned)resent, (unsigned)crc);
+  printRate(script ? "sload" : "load", total, t0);
+  return 0;
+}
+
+static bool parseArgs(int argc, char** argv, std::vector<int32_t>& out) {
+  for (int i = 0; i < argc; ++i) {
+    char* end = nullptr;
+    long v = strtol(argv[i], &end, 0);
+    if (!end || *end) {
+      fprintf(stderr, "bad argument '%s'\n", argv[i]);
+      return false;
+    }
+    out.push_back((int32_t)v);
+  }
+  return out.size() <= MAX_EXEC_ARGS;
+}
+
+static int cmdExec(bool script, int argc, char** argv) {
+  std::vector<int32_t> a;
+  if (!parseArgs(argc, argv, a)) return 1;
+  std::vector<uint8_t> req;
+  uint32_t n = (uint32_t)a.size();
+  req.insert(req.end(), (uint8_t*)&n, (uint8_t*)&n + 4);
+  req.insert(req.end(), (uint8_t*)a.data(), (uint8_t*)a.data() + 4 * n);
+  req.insert(req.end(), (uint8_t*)&g_opt.timeoutMs, (uint8_t*)&g_opt.timeoutMs + 4);
+  uint8_t r[64];
+  uint32_t rl = 0;
+  int32_t st = 0;
+  uint16_t cmd = script ? CoProc::CMD_SCRIPT_EXEC : CoProc::CMD_EXEC;
+  if (!request(cmd, req.data(), (uint32_t)req.size(), r, sizeof(r), rl, &st, g_opt.timeoutMs + HOSTLINK_REPLY_MS)) return 1;
+  printf("%s st=%d result=%d\n", script ? "SCRIPT_EXEC" : "EXEC", (int)st, rl >= 8 ? (int)rd32(r + 4) : 0);
+  return st == CoProc::ST_OK ? 0 : 1;
+}
+
+static bool funcRequest(const char* name, const std::vector<int32_t>& a, std::vector<uint8_t>& req) {
+  uint32_t nl = (uint32_t)strlen(name), n = (uint32_t)a.size();
+  if (nl == 0 || nl > CoProc::FUNC_NAME_MAX) return false;
+  req.clear();
+  req.insert(req.end(), (uint8_t*)&nl, (uint8_t*)&nl + 4);
+  req.insert(req.end(), (const uint8_t*)name, (const uint8_t*)name + nl);
+  req.insert(req.end(), (uint8_t*)&n, (uint8_t*)&n + 4);
+  req.insert(req.end(), (const uint8_t*)a.data(), (const uint8_t*)a.data() + 4 * n);
+  return true;
+}
+
+static int cmdFunc(const char* name, int argc, char** argv) {
+  std::vector<int32_t> a;
+  std::vector<uint8_t> req;
+  if (!parseArgs(argc, argv, a) || !funcRequest(name, a, req)) return 1;
+  uint8_t r[64];
+  uint32_t rl = 0;
+  int32_t st = 0;
+  if (!request(CoProc::CMD_FUNC, req.data(), (uint32_t)req.size(), r, sizeof(r), rl, &st, g_opt.timeoutMs)) return 1;
+  printf("FUNC %s st=%d result=%d\n", name, (int)st, rl >= 8 ? (int)rd32(r + 4) : 0);
+  return st == CoProc::ST_OK ? 0 : 1;
+}
+
+static int cmdBench(uint32_t rounds) {
+  std::vector<uint8_t> req;
+  funcRequest("ping", std::vector<int32_t>(), req);
+  uint32_t minUs = 0xFFFFFFFFu, maxUs = 0, fails = 0;
+  uint64_t sumUs = 0;
+  uint32_t t0 = micros();
+  for (uint32_t i = 0; i < rounds; ++i) {
+    uint8_t r[64];
+    uint32_t rl = 0;
+    int32_t st = 0;
+    uint32_t s = micros();
+    if (!request(CoProc::CMD_FUNC, req.data(), (uint32_t)req.size(), r, sizeof(r), rl, &st) || st != CoProc::ST_OK) {
+      ++fails;
+      continue;
+    }
+    uint32_t us = micros() - s;
+    sumUs += us;
+    if (us < minUs) minUs = us;
+    if (us > maxUs) maxUs = us;
+  }
+  uint32_t ok = rounds - fails;
+  double dt = secondsSince(t0);
+  printf("bench: %u/%u ok, rtt min %u avg %u max %u us, %.1f calls/s\n", (unsigned)ok, (unsigned)rounds,
+         ok ? (unsigned)minUs : 0u, ok ? (unsigned)(sumUs / ok) : 0u, (unsigned)maxUs, dt > 0 ? ok / dt : 0.0);
+  return fails ? 1 : 0;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: hostlink [-b baud] [-c chunk] [-w window] [-T timeout_ms] <cmd> <tty> [args]\n"
+          "  putbin <tty> <local> <remote> [resume]\n"
+          "  hello|info|status <tty>\n"
+          "  stats <tty> [reset]\n"
+          "  load|sload <tty> <file>\n"
+          "  exec|sexec <tty> [args..]\n"
+          "  func <tty> <name> [args..]\n"
+          "  bench <tty> [n]\n");
+}
+
+int main(int argc, char** argv) {
+  int i = 1;
+  for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+    uint32_t v = (uint32_t)strtoul(argv[i + 1], nullptr, 0);
+    if (!strcmp(argv[i], "-b")) g_opt.baud = v;
+    else if (!strcmp(argv[i], "-c")) g_opt.chunk = v;
+    else if (!strcmp(argv[i], "-w")) g_opt.window = v;
+    else if (!strcmp(argv[i], "-T")) g_opt.timeoutMs = v;
+    else break;
+  }
+  if (argc - i < 2) {
+    usage();
+    return 2;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  const char* cmd = argv[i];
+  const char* tty = argv[i + 1];
+  int nargs = argc - i - 2;
+  char** args = argv + i + 2;
+
+  if (!strcmp(cmd, "putbin")) {
+    if (nargs < 2 || nargs > 3 || (nargs == 3 && strcmp(args[2], "resume"))) {
+      usage();
+      return 2;
+    }
+    return cmdPutbin(tty, args[0], args[1], nargs == 3);
+  }
+  if (!openLink(tty)) return 1;
+  ::tcflush(g_link.fd(), TCIOFLUSH);
+  if (!strcmp(cmd, "hello")) return cmdHello();
+  if (!strcmp(cmd, "info")) return cmdInfo();
+  if (!strcmp(cmd, "status")) return cmdStatus();
+  if (!strcmp(cmd, "stats")) return cmdStats(nargs > 0 && !strcmp(args[0], "reset"));
+  if ((!strcmp(cmd, "load") || !strcmp(cmd, "sload")) && nargs == 1) return cmdLoad(cmd[0] == 's', args[0]);
+  if (!strcmp(cmd, "exec") || !strcmp(cmd, "sexec")) return cmdExec(cmd[0] == 's', nargs, args);
+  if (!strcmp(cmd, "func") && nargs >= 1) return cmdFunc(args[0], nargs - 1, args + 1);
+  if (!strcmp(cmd, "bench")) return cmdBench(nargs ? (uint32_t)strtoul(args[0], nullptr, 0) : 100);
+  usage();
+  return 2;
+}
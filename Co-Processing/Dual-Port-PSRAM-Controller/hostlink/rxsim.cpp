@@ -0,0 +1,426 @@
+// rxsim.cpp - host build of the device-side receivers, served on a pty so hostlink (or ExecHost test
+// rigs) can run end to end without hardware. Prints the slave path to connect to.
+//   CPR0 frames                 -> CoProcExec, dispatched like main_coproc_minimal's processRequest
+//   "putbin <name> <size> [win|resume]" line -> shrxbin receiver writing <outdir>/<name> (as
+//                               main_mcu's putbin; resume continues from the size of <name>.part)
+// Blobs are accepted and cached but not run (no Thumb core here); scripts and named functions run.
+// Usage: rxsim [-o outdir] [-t tty] [-s shared.bin] [-e n]
+//   -t  serve an existing tty/pty instead of a new pty
+//   -s  back CMD_LOAD_REF with a file (CoProc::SimSharedMem)
+//   -e  flip a bit in every n-th byte putbin reads (exercises NAK/resend)
+#include <Arduino.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+#include <string>
+#include <thread>
+
+#define BLOB_MAILBOX_MAX 512u  // as blob_mailbox_config.h
+extern "C" {
+__attribute__((aligned(4))) uint8_t BLOB_MAILBOX[BLOB_MAILBOX_MAX];
+}
+volatile uint8_t g_cancel_flag = 0;
+
+#include "CoProcProto.h"
+#include "CoProcLink.h"
+#include "CoProcLang.h"
+#include "CoProcExec.h"
+#include "shrxbin.h"
+
+static const uint32_t REQ_MAX = 8192;  // as main_coproc_minimal
+static const uint32_t RESP_MAX = 8192;
+static const uint32_t SIM_MAX_BAUD = 921600;
+
+static CoProc::PtyLink g_link;
+static CoProc::LinkResponder g_linkResp(g_link, SIM_MAX_BAUD);
+static CoProcExec g_exec;
+static CoProc::LinkStats& g_linkStats = g_exec.linkStats();
+static CoProc::SimSharedMem g_shared;
+static CoProc::Frame g_reqHdr, g_respHdr;
+static uint8_t g_reqBuf[REQ_MAX];
+static uint8_t g_respBuf[RESP_MAX];
+static std::string g_outDir = ".";
+
+// ------- Link byte helpers -------
+static void waitReadable(uint32_t ms) {
+  struct pollfd p = { g_link.fd(), POLLIN, 0 };
+  ::poll(&p, 1, (int)ms);
+}
+static bool readByte(uint8_t& b, uint32_t timeoutMs) {
+  uint32_t start = millis();
+  for (;;) {
+    int v = g_link.read();
+    if (v >= 0) {
+      b = (uint8_t)v;
+      ++g_linkStats.bytes_rx;
+      return true;
+    }
+    uint32_t waited = millis() - start;
+    if (waited > timeoutMs) return false;
+    waitReadable(timeoutMs - waited + 1);
+  }
+}
+static bool readExact(uint8_t* dst, size_t n, uint32_t timeoutPerByteMs) {
+  for (size_t i = 0; i < n; ++i) {
+    if (!readByte(dst[i], timeoutPerByteMs)) return false;
+  }
+  return true;
+}
+static bool writeAll(const uint8_t* src, size_t n, uint32_t timeoutMs) {
+  uint32_t start = millis();
+  size_t off = 0;
+  while (off < n) {
+    size_t wrote = g_link.write(src + off, n - off);
+    if (wrote > 0) {
+      off += wrote;
+      g_linkStats.bytes_tx += (uint32_t)wrote;
+      continue;
+    }
+    if ((millis() - start) > timeoutMs) return false;
+    struct pollfd p = { g_link.fd(), POLLOUT, 0 };
+    ::poll(&p, 1, 10);
+  }
+  return true;
+}
+static bool writeHeader(const CoProc::Frame& h) {
+  ++g_linkStats.frames_tx;
+  return writeAll(reinterpret_cast<const uint8_t*>(&h), sizeof(CoProc::Frame), 2000);
+}
+static void writeReply(const CoProc::Frame& req, int32_t st) {
+  size_t off = 0;
+  CoProc::writePOD(g_respBuf, RESP_MAX, off, st);
+  CoProc::makeResponseHeader(g_respHdr, req.cmd, req.seq, (uint32_t)off, CoProc::crc32_ieee(g_respBuf, off));
+  writeHeader(g_respHdr);
+  writeAll(g_respBuf, off, 5000);
+}
+
+// shrxbin talks text (READY/ACK/NAK/OK/ERR) on the same link
+static uint32_t g_faultEvery = 0, g_faultCount = 0;
+class LinkStream : public Stream {
+public:
+  int available() override {
+    return g_link.available();
+  }
+  int read() override {
+    int v = g_link.read();
+    if (v >= 0) ++g_linkStats.bytes_rx;
+    if (v >= 0 && g_faultEvery && ++g_faultCount % g_faultEvery == 0) v ^= 0x01;
+    return v;
+  }
+  size_t write(uint8_t c) override {
+    return write(&c, 1);
+  }
+  size_t write(const uint8_t* p, size_t n) override {
+    return writeAll(p, n, 2000) ? n : 0;
+  }
+  void flush() override {}
+};
+static LinkStream g_linkStream;
+
+// ------- putbin (shrxbin) -------
+static shrxbin::State g_rxbin;
+static int g_rxFd = -1;
+static std::string g_rxPath;
+
+static bool rxWriteAbs(void*, uint32_t absAddr, const uint8_t* data, uint32_t len) {
+  return ::pwrite(g_rxFd, data, len, (off_t)absAddr) == (ssize_t)len;
+}
+static bool rxReadAbs(void*, uint32_t absAddr, uint8_t* data, uint32_t len) {
+  return ::pread(g_rxFd, data, len, (off_t)absAddr) == (ssize_t)len;
+}
+// Frames land in order, so <name>.part never holds more than the contiguous prefix; a checkpoint
+// only has to make it durable
+static bool rxCheckpoint(void*, const char*, uint32_t size, uint32_t, uint32_t) {
+  printf("putbin: %s.part checkpoint at %u\n", g_rxPath.c_str(), (unsigned)size);
+  return ::fdatasync(g_rxFd) == 0;
+}
+static bool rxFinalize(void*, const char*, uint32_t size, uint32_t, uint32_t) {
+  bool ok = ::ftruncate(g_rxFd, (off_t)size) == 0;
+  ::close(g_rxFd);
+  g_rxFd = -1;
+  ok = ok && ::rename((g_rxPath + ".part").c_str(), g_rxPath.c_str()) == 0;
+  printf("putbin: %s %s (%u bytes)\n", g_rxPath.c_str(), ok ? "written" : "FAILED", (unsigned)size);
+  return ok;
+}
+
+static void startPutbin(char* line) {
+  char* name = strtok(line + 6, " \t");
+  char* size = name ? strtok(nullptr, " \t") : nullptr;
+  char* mode = size ? strtok(nullptr, " \t") : nullptr;
+  uint32_t total = size ? (uint32_t)strtoul(size, nullptr, 0) : 0;
+  bool windowed = mode && (!strcmp(mode, "win") || !strcmp(mode, "resume"));
+  bool resume = mode && !strcmp(mode, "resume");
+  if (!name || !total || strchr(name, '/') || (mode && !windowed)) {
+    g_linkStream.println("usage: putbin <file> <size> [win|resume]");
+    return;
+  }
+  if (g_rxFd >= 0) ::close(g_rxFd);
+  g_rxPath = g_outDir + "/" + name;
+  g_rxFd = ::open((g_rxPath + ".part").c_str(), O_RDWR | O_CREAT | (resume ? 0 : O_TRUNC), 0644);
+  if (g_rxFd < 0) {
+    g_linkStream.println("putbin: createFileSlot failed");
+    return;
+  }
+  uint32_t resumeOff = 0;
+  if (resume) {
+    // Back to a 4 KiB "erase unit" like the flash targets, dropping what lies past it
+    off_t have = ::lseek(g_rxFd, 0, SEEK_END);
+    if (have > 0 && have <= (off_t)total) resumeOff = (uint32_t)have & ~4095u;
+    if (resumeOff != have && ::ftruncate(g_rxFd, resumeOff) != 0) {
+      g_linkStream.println("putbin: createFileSlot failed");
+      return;
+    }
+  }
+  shrxbin::Writer wr;
+  wr.writeAbs = rxWriteAbs;
+  wr.finalizeSize = rxFinalize;
+  wr.readAbs = rxReadAbs;
+  if (windowed) wr.checkpoint = rxCheckpoint;
+  wr.cap = 0;
+  if (windowed) shrxbin::beginWindowed(g_rxbin, g_linkStream, name, total, wr, resumeOff);
+  else shrxbin::begin(g_rxbin, g_linkStream, name, total, wr);
+  printf("putbin: receiving %s (%u bytes", name, (unsigned)total);
+  if (windowed) printf(", windowed from %u", (unsigned)resumeOff);
+  printf(")\n");
+}
+
+// Bytes outside frames form console lines; only putbin is understood
+static char g_line[160];
+static size_t g_lineLen = 0;
+static bool consoleByte(uint8_t b) {
+  if (b == '\r' || b == '\n') {
+    g_line[g_lineLen] = 0;
+    bool isPut = !strncmp(g_line, "putbin ", 7);
+    if (isPut) {
+      // Like shline: the LF of a CR LF pair is eaten before the receiver starts reading frames
+      uint8_t lf;
+      if (b == '\r') (void)readByte(lf, 20);
+      startPutbin(g_line);
+    }
+    g_lineLen = 0;
+    return isPut;
+  }
+  if (b >= 0x20 && b < 0x7F && g_lineLen + 1 < sizeof(g_line)) g_line[g_lineLen++] = (char)b;
+  else g_lineLen = 0;  // binary noise
+  return false;
+}
+
+// ------- Requests -------
+static bool processRequest(const CoProc::Frame& hdr, const uint8_t* payload, CoProc::Frame& respH, uint8_t* respBuf, uint32_t& respLen) {
+  size_t off = 0;
+  int32_t st = CoProc::ST_BAD_CMD;
+  respLen = 0;
+  switch (hdr.cmd) {
+    case CoProc::CMD_HELLO: st = g_exec.cmdHELLO(false, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_INFO: st = g_exec.cmdINFO(false, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_LINK_BAUD:
+    case CoProc::CMD_LINK_ECHO:
+    case CoProc::CMD_LINK_COMMIT: st = g_linkResp.handle(hdr.cmd, payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_SUBSCRIBE: st = g_exec.cmdSUBSCRIBE(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_STATS: st = g_exec.cmdSTATS(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_LOAD_BEGIN: st = g_exec.cmdLOAD_BEGIN(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_LOAD_DATA: st = g_exec.cmdLOAD_DATA(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_LOAD_END: st = g_exec.cmdLOAD_END(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_LOAD_WDATA: st = g_exec.cmdLOAD_WDATA(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_QUERY: st = g_exec.cmdQUERY(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_LOAD_REF: st = g_exec.cmdLOAD_REF(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_EXEC: st = g_exec.cmdEXEC(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_EXEC_CACHED: st = g_exec.cmdEXEC_CACHED(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_EXEC_ASYNC: st = g_exec.cmdEXEC_ASYNC(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_JOB_SUBMIT: st = g_exec.cmdJOB_SUBMIT(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_RESULTS: st = g_exec.cmdRESULTS(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_STATUS: st = g_exec.cmdSTATUS(respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_MAILBOX_RD: st = g_exec.cmdMAILBOX_RD(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_CANCEL: st = g_exec.cmdCANCEL(respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_SCRIPT_BEGIN: st = g_exec.cmdSCRIPT_BEGIN(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_SCRIPT_DATA: st = g_exec.cmdSCRIPT_DATA(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_SCRIPT_END: st = g_exec.cmdSCRIPT_END(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_SCRIPT_EXEC: st = g_exec.cmdSCRIPT_EXEC(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_SCRIPT_WDATA: st = g_exec.cmdSCRIPT_WDATA(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_FUNC: st = g_exec.cmdFUNC(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_FUNC_LIST: st = g_exec.cmdFUNC_LIST(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_FUNC_BATCH: st = g_exec.cmdFUNC_BATCH(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    default:  // RESET and ISP_* need the board
+      st = CoProc::ST_BAD_CMD;
+      CoProc::writePOD(respBuf, RESP_MAX, off, st);
+      break;
+  }
+  (void)st;
+  respLen = (uint32_t)off;
+  if (CoProc::isWindowedData(hdr.cmd) && respLen == 0) return false;
+  CoProc::makeResponseHeader(respH, hdr.cmd, hdr.seq, respLen, respLen ? CoProc::crc32_ieee(respBuf, respLen) : 0);
+  return true;
+}
+
+static uint8_t g_evtBuf[32];
+static uint32_t g_evtSeq = 0;
+static void pumpEvents() {
+  size_t off = 0;
+  if (!g_exec.pollEvent(g_evtBuf, sizeof(g_evtBuf), off)) return;
+  CoProc::Frame h;
+  CoProc::makeResponseHeader(h, CoProc::CMD_EVENT, g_evtSeq++, (uint32_t)off, CoProc::crc32_ieee(g_evtBuf, off));
+  if (!writeHeader(h)) return;
+  (void)writeAll(g_evtBuf, off, 2000);
+}
+
+// Same framing rules as the sketch; returns false on errors, on idle and when a putbin line took over
+static bool readFramedRequest(CoProc::Frame& hdr, uint8_t* payloadBuf) {
+  static const uint8_t magicBytes[4] = { 'C', 'P', 'R', '0' };
+  uint8_t w[4] = { 0, 0, 0, 0 };
+  uint32_t scanned = 0;
+  for (;;) {
+    uint8_t b;
+    if (!readByte(b, 50)) {
+      g_linkResp.poll();
+      if (!g_linkResp.inTrial()) pumpEvents();
+      return false;
+    }
+    w[0] = w[1];
+    w[1] = w[2];
+    w[2] = w[3];
+    w[3] = b;
+    ++scanned;
+    if (memcmp(w, magicBytes, 4) != 0) {
+      if (consoleByte(b)) return false;
+      continue;
+    }
+    g_lineLen = 0;
+    if (scanned > 4) {
+      ++g_linkStats.resyncs;
+      g_linkStats.skipped += scanned - 4;
+    }
+    union {
+      CoProc::Frame f;
+      uint8_t bytes[sizeof(CoProc::Frame)];
+    } u;
+    memcpy(u.bytes, w, 4);
+    if (!readExact(u.bytes + 4, sizeof(CoProc::Frame) - 4, 200)) {
+      ++g_linkStats.timeouts;
+      g_exec.noteDropped(CoProc::ST_TIMEOUT, 0, 0xFFFFFFFFu);
+      return false;
+    }
+    hdr = u.f;
+    if (hdr.magic != CoProc::MAGIC || hdr.version != CoProc::VERSION) {
+      ++g_linkStats.bad_headers;
+      g_exec.noteDropped(CoProc::ST_BAD_VERSION, hdr.cmd, hdr.seq);
+      return false;
+    }
+    if (hdr.len > REQ_MAX) {
+      ++g_linkStats.bad_headers;
+      for (uint32_t left = hdr.len; left; --left) {
+        uint8_t sink;
+        if (!readByte(sink, 200)) {
+          ++g_linkStats.timeouts;
+          g_exec.noteDropped(CoProc::ST_TIMEOUT, hdr.cmd, hdr.seq);
+          return false;
+        }
+      }
+      writeReply(hdr, CoProc::ST_SIZE);
+      return false;
+    }
+    if (hdr.len) {
+      if (!readExact(payloadBuf, hdr.len, 2000)) {
+        ++g_linkStats.timeouts;
+        g_exec.noteDropped(CoProc::ST_TIMEOUT, hdr.cmd, hdr.seq);
+        return false;
+      }
+      if (CoProc::crc32_ieee(payloadBuf, hdr.len) != hdr.crc32) {
+        ++g_linkStats.crc_errors;
+        if (!CoProc::isWindowedData(hdr.cmd)) writeReply(hdr, CoProc::ST_CRC);
+        return false;
+      }
+    }
+    ++g_linkStats.frames_rx;
+    return true;
+  }
+}
+
+static int32_t fn_ping(const int32_t*, uint32_t) {
+  return 1234;
+}
+static int32_t fn_add(const int32_t* a, uint32_t n) {
+  int64_t sum = 0;
+  for (uint32_t i = 0; i < n; ++i) sum += a[i];
+  return (int32_t)sum;
+}
+
+static void usage() {
+  fprintf(stderr, "usage: rxsim [-o outdir] [-t tty] [-s shared.bin] [-e n]\n");
+}
+
+int main(int argc, char** argv) {
+  const char* tty = nullptr;
+  const char* sharedPath = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    if (i + 1 < argc && !strcmp(argv[i], "-o")) g_outDir = argv[++i];
+    else if (i + 1 < argc && !strcmp(argv[i], "-t")) tty = argv[++i];
+    else if (i + 1 < argc && !strcmp(argv[i], "-s")) sharedPath = argv[++i];
+    else if (i + 1 < argc && !strcmp(argv[i], "-e")) g_faultEvery = (uint32_t)strtoul(argv[++i], nullptr, 0);
+    else {
+      usage();
+      return 2;
+    }
+  }
+  signal(SIGPIPE, SIG_IGN);
+  char slave[128] = { 0 };
+  int slaveFd = -1;
+  if (tty) {
+    if (!g_link.open(tty)) {
+      fprintf(stderr, "rxsim: cannot open %s: %s\n", tty, strerror(errno));
+      return 1;
+    }
+  } else {
+    if (!g_link.openPty(slave, sizeof(slave))) {
+      fprintf(stderr, "rxsim: posix_openpt failed: %s\n", strerror(errno));
+      return 1;
+    }
+    // Hold the slave open (raw) so a client closing it does not hang up the master
+    slaveFd = ::open(slave, O_RDWR | O_NOCTTY);
+    struct termios t;
+    if (slaveFd >= 0 && ::tcgetattr(slaveFd, &t) == 0) {
+      ::cfmakeraw(&t);
+      ::tcsetattr(slaveFd, TCSANOW, &t);
+    }
+  }
+  g_link.begin(115200);
+  g_exec.begin();
+  g_exec.setMaxRequest(REQ_MAX);
+  g_exec.registerFunc("ping", 0, fn_ping);
+  g_exec.registerFunc("add", -1, fn_add);
+  if (sharedPath) {
+    if (!g_shared.open(sharedPath)) {
+      fprintf(stderr, "rxsim: cannot open shared file %s\n", sharedPath);
+      return 1;
+    }
+    g_exec.attachShared(&g_shared);
+  }
+  // core1
+  std::thread worker([] {
+    for (;;) {
+      g_exec.workerPoll();
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+  });
+  worker.detach();
+
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+  printf("rxsim: %s (out=%s)\n", tty ? tty : slave, g_outDir.c_str());
+  for (;;) {
+    if (shrxbin::active(g_rxbin)) {
+      shrxbin::pump(g_rxbin);
+      if (shrxbin::active(g_rxbin)) waitReadable(50);
+      continue;
+    }
+    if (!readFramedRequest(g_reqHdr, g_reqBuf)) continue;
+    uint32_t respLen = 0;
+    if (!processRequest(g_reqHdr, g_reqBuf, g_respHdr, g_respBuf, respLen)) continue;
+    if (!writeHeader(g_respHdr)) continue;
+    if (respLen && !writeAll(g_respBuf, respLen, 10000)) continue;
+    g_linkResp.afterReply();
+  }
+  (void)slaveFd;
+  return 0;
+}
@@ -0,0 +1,122 @@
+#pragma once
+// Arduino.h - just enough of the core API to build the co-processor headers (CoProcExec.h, CoProcLang.h,
+// shrxbin.h) into Linux host programs. ARDUINO stays undefined, so the CoProc headers pick their host paths.
+// Pins do nothing (analog/digital reads return 0); time comes from steady_clock.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <chrono>
+#include <thread>
+
+#define HEX 16
+#define DEC 10
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define INPUT_PULLDOWN 3
+#define HIGH 1
+#define LOW 0
+
+#ifndef tight_loop_contents
+#define tight_loop_contents() std::this_thread::yield()
+#endif
+
+inline uint32_t micros() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+inline uint32_t millis() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+inline void delay(uint32_t ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+inline void delayMicroseconds(uint32_t us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+inline void yield() {
+  std::this_thread::yield();
+}
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) {
+  return 0;
+}
+inline void analogWrite(uint8_t, int) {}
+inline int analogRead(uint8_t) {
+  return 0;
+}
+
+// Byte sink; the default writes to stdout
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) {
+    return fputc(c, stdout) == EOF ? 0 : 1;
+  }
+  virtual size_t write(const uint8_t* p, size_t n) {
+    size_t w = 0;
+    while (w < n && write(p[w])) ++w;
+    return w;
+  }
+  size_t print(const char* s) {
+    return write((const uint8_t*)s, strlen(s));
+  }
+  size_t print(char c) {
+    return write((uint8_t)c);
+  }
+  size_t print(unsigned long v, int base = DEC) {
+    char b[24];
+    snprintf(b, sizeof(b), base == HEX ? "%lX" : "%lu", v);
+    return print(b);
+  }
+  size_t print(long v, int base = DEC) {
+    if (base == HEX) return print((unsigned long)v, base);
+    char b[24];
+    snprintf(b, sizeof(b), "%ld", v);
+    return print(b);
+  }
+  size_t print(unsigned v, int base = DEC) {
+    return print((unsigned long)v, base);
+  }
+  size_t print(int v, int base = DEC) {
+    return print((long)v, base);
+  }
+  size_t println() {
+    return print("\r\n");
+  }
+  template<typename T>
+  size_t println(T v) {
+    size_t n = print(v);
+    return n + println();
+  }
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+    char b[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(b, sizeof(b), fmt, ap);
+    va_end(ap);
+    if (n < 0) return 0;
+    return write((const uint8_t*)b, (size_t)n < sizeof(b) ? (size_t)n : sizeof(b) - 1);
+  }
+  virtual void flush() {
+    fflush(stdout);
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() {
+    return 0;
+  }
+  virtual int read() {
+    return -1;
+  }
+  virtual int peek() {
+    return -1;
+  }
+};
@@ -10,6 +10,31 @@
           extern "C" __attribute__((aligned(4)))
           uint8_t BLOB_MAILBOX[BLOB_MAILBOX_MAX];
       - A definition of volatile uint8_t g_cancel_flag;
+  - BLOB_MAILBOX holds a streaming SPSC ring (MailboxRing.h). Blobs and scripts append to it while they run;
+    CMD_MAILBOX_RD consumes what has been written so far. No console is attached on this side, so a full
+    ring drops (and counts) bytes instead of stalling the producer.
+  - Verified images are keyed by length + CRC32. Replacing the current blob or script moves it into a
+    small LRU cache (COPROC_CACHE_SLOTS / COPROC_CACHE_BYTES) instead of freeing it, so CMD_QUERY and
+    CMD_EXEC_CACHED can bring it back without an upload. The cache gives memory back first when a new
+    upload cannot be allocated.
+  - CMD_EXEC_ASYNC hands the blob or script to core1 and replies at once. pollEvent() is called by the
+    sketch between requests: it enforces the job timeout, records the result for CMD_STATUS and
+    produces the CMD_EVENT payloads the host subscribed to. Replacing the image a job is running
+    moves it into the cache (or parks it until the job ends); cache eviction skips it.
+  - CMD_JOB_SUBMIT queues jobs (image key, args, timeout, priority) and returns their ids at once.
+    pollEvent() starts the next one as soon as core1 is free, highest priority first, so core1 does
+    not wait for the host between jobs. A queued job names its image by length + CRC and finds it as
+    the current image or in the cache when it starts (ST_NOT_FOUND if it was evicted meanwhile).
+    Every finished async job lands in a result ring (COPROC_RESULT_RING) that CMD_RESULTS drains;
+    when the ring is full the oldest result is dropped and counted.
+  - attachShared() enables CMD_LOAD_REF: the image is copied out of the shared PSRAM window under an
+    arbiter lease and only becomes current once its CRC matches. A request for an image this side
+    already holds is served from the cache without touching the bus.
+  - Registered functions are also addressable by their registry slot. CMD_FUNC_LIST hands out the
+    id table together with its CRC; CMD_FUNC_BATCH runs several calls by id in one frame and refuses
+    (ST_STATE) when the host's table CRC is stale.
+  - linkStats() is the counter set the sketch's framing code bumps (CoProc::LinkStats); CMD_STATS
+    reports it and can reset it.
       - Optional DBG(...) macro for debug logging; if not defined, a no-op is used.
 */
 #pragma once
@@ -19,6 +44,9 @@
 #include <limits.h>
 #include "CoProcProto.h"
 #include "CoProcLang.h"
+#include "MailboxRing.h"
+#include "Lz4Block.h"
+#include "CoProcShared.h"
 
 #ifndef DBG
 #define DBG(...) \
@@ -36,6 +64,19 @@
 #define MAX_EXEC_ARGS 64
 #endif
 
+#ifndef COPROC_CACHE_SLOTS
+#define COPROC_CACHE_SLOTS 4  // replaced images kept for CMD_QUERY / CMD_EXEC_CACHED (0 disables)
+#endif
+#ifndef COPROC_CACHE_BYTES
+#define COPROC_CACHE_BYTES (48u * 1024u)  // heap the cache may hold on top of the current blob and script
+#endif
+#ifndef COPROC_JOB_QUEUE
+#define COPROC_JOB_QUEUE 8  // jobs waiting for core1 (CMD_JOB_SUBMIT)
+#endif
+#ifndef COPROC_RESULT_RING
+#define COPROC_RESULT_RING 16  // finished async jobs kept until CMD_RESULTS drains them
+#endif
+
 // These must be provided by the including sketch (definitions), we only declare them here.
 extern "C" uint8_t BLOB_MAILBOX[BLOB_MAILBOX_MAX];
 extern volatile uint8_t g_cancel_flag;
@@ -74,6 +115,7 @@ public:
   void begin() {
     memset(&g_job, 0, sizeof(g_job));
     memset(BLOB_MAILBOX, 0, BLOB_MAILBOX_MAX);
+    Mbx::init(BLOB_MAILBOX, BLOB_MAILBOX_MAX, false);
     g_cancel_flag = 0;
     g_exec_state = CoProc::EXEC_IDLE;
   }
@@ -85,12 +127,21 @@ public:
       return;
     }
     int32_t status = 0, result = 0;
-    if ((g_job.code == 0) || (g_job.size & 1u)) {
+    if (g_job.script) {
+      int32_t rv = 0;
+      bool ok = s_vm && s_vm->run((uint8_t*)g_job.code, g_job.size, g_job.args, g_job.argc, g_job.timeout_ms, rv);
+      status = ok ? (int32_t)CoProc::ST_OK : (int32_t)CoProc::ST_EXEC;
+      result = rv;
+    } else if ((g_job.code == 0) || (g_job.size & 1u)) {
       status = CoProc::ST_PARAM;
     } else {
-      BLOB_MAILBOX[0] = 0;
+      if (!Mbx::valid(BLOB_MAILBOX, BLOB_MAILBOX_MAX)) Mbx::init(BLOB_MAILBOX, BLOB_MAILBOX_MAX, false);
+#if defined(ARDUINO)
       void* entryThumb = (void*)(g_job.code | 1u);
       result = call_with_args_thumb(entryThumb, g_job.argc, g_job.args);
+#else
+      status = CoProc::ST_EXEC;  // host builds (hostlink/rxsim) cannot run Thumb code
+#endif
     }
     g_job.result = result;
     g_job.status = status;
@@ -105,8 +156,17 @@ public:
     uint32_t flags = 0;
     if (g_blob_len) flags |= 1u;
     if (g_job.active) flags |= 2u;
-    if (BLOB_MAILBOX[0]) flags |= 4u;
+    if (mailboxHasData()) flags |= 4u;
     if (ispActive) flags |= (1u << 8);
+    flags |= CoProc::FEAT_LZ4;
+    flags |= CoProc::FEAT_LINK_BAUD;
+    if (COPROC_CACHE_SLOTS) flags |= CoProc::FEAT_CACHE;
+    flags |= CoProc::FEAT_ASYNC;
+    flags |= CoProc::FEAT_FUNC_BATCH;
+    if (COPROC_JOB_QUEUE) flags |= CoProc::FEAT_JOB_QUEUE;
+    if (m_shared) flags |= CoProc::FEAT_LOAD_REF;
+    flags |= CoProc::FEAT_STATS;
+    m_evtMask = 0;  // a (re)attached host subscribes again
     int32_t features = (int32_t)flags;
     DBG("[DBG] HELLO -> ver=%d features=0x%08X\n", version, (unsigned)features);
     CoProc::writePOD(out, cap, off, status);
@@ -120,7 +180,7 @@ public:
     info.impl_flags = 0;
     if (g_blob_len) info.impl_flags |= 1u;
     if (g_job.active) info.impl_flags |= 2u;
-    if (BLOB_MAILBOX[0]) info.impl_flags |= 4u;
+    if (mailboxHasData()) info.impl_flags |= 4u;
     if (ispActive) info.impl_flags |= (1u << 8);
     info.blob_len = g_blob_len;
     info.mailbox_max = BLOB_MAILBOX_MAX;
@@ -137,14 +197,15 @@ public:
     uint32_t total = 0;
     if (!CoProc::readPOD(in, len, p, total)) return writeStatus(out, cap, off, CoProc::ST_PARAM);
     if (total == 0 || (total & 1u)) return writeStatus(out, cap, off, CoProc::ST_SIZE);
-    freeBlob();
-    g_blob = (uint8_t*)malloc(total);
+    retireBlob();
+    g_blob = allocImage(total);
     if (!g_blob) return writeStatus(out, cap, off, CoProc::ST_NOMEM);
     g_blob_len = 0;
     g_blob_cap = total;
     g_blob_crc = 0;
     g_exec_state = CoProc::EXEC_LOADED;
     DBG("[DBG] LOAD_BEGIN total=%u\n", (unsigned)total);
+    if (negotiateWindow(in, len, p, m_blobWin, m_blobDec, g_blob, total, out, cap, off)) return CoProc::ST_OK;
     return writeStatus(out, cap, off, CoProc::ST_OK);
   }
 
@@ -165,11 +226,27 @@ public:
     return status;
   }
 
+  // Windowed chunk (CMD_LOAD_WDATA); replies only when the sender asks for an ACK
+  int32_t cmdLOAD_WDATA(const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t& off) {
+    int32_t st = windowData(m_blobWin, m_blobDec, in, len, out, cap, off);
+    if (!m_blobWin.done() || (m_blobDec.active() && !m_blobDec.done())) {
+      g_blob_len = m_blobDec.active() ? m_blobDec.produced() : m_blobWin.stored();
+    } else if (g_blob_len != g_blob_cap) {
+      g_blob_len = g_blob_cap;
+      g_blob_crc = CoProc::crc32_ieee(g_blob, g_blob_len);  // windowed END carries a one-shot CRC
+    }
+    return st;
+  }
+
   int32_t cmdLOAD_END(const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t& off) {
     size_t p = 0;
     uint32_t expected = 0;
     if (!CoProc::readPOD(in, len, p, expected)) return writeStatus(out, cap, off, CoProc::ST_PARAM);
     int32_t status = (expected == g_blob_crc) ? CoProc::ST_OK : CoProc::ST_CRC;
+    if (m_blobWin.chunk && !m_blobWin.done()) status = CoProc::ST_SIZE;
+    if (m_blobDec.active() && !m_blobDec.done()) status = CoProc::ST_SIZE;
+    m_blobKeyed = (status == CoProc::ST_OK);
+    if (m_blobKeyed) m_blobKey = CoProc::crc32_ieee(g_blob, g_blob_len);  // legacy END carries a rolling CRC
     CoProc::writePOD(out, cap, off, status);
     CoProc::writePOD(out, cap, off, g_blob_len);
     DBG("[DBG] LOAD_END crc_exp=0x%08X crc_have=0x%08X st=%d\n",
@@ -179,20 +256,13 @@ public:
 
   int32_t cmdEXEC(const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t& off) {
     if (!g_blob || (g_blob_len & 1u)) return writeStatus2(out, cap, off, CoProc::ST_STATE, 0);
-    if (g_job.active) return writeStatus2(out, cap, off, CoProc::ST_STATE, 0);
-    size_t p = 0;
+    if (g_job.active || m_async.running) return writeStatus2(out, cap, off, CoProc::ST_STATE, 0);
     uint32_t argc = 0, timeout_ms = 0;
-    if (!CoProc::readPOD(in, len, p, argc)) return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
-    if (argc > MAX_EXEC_ARGS) argc = MAX_EXEC_ARGS;
-    for (uint32_t i = 0; i < argc; ++i) {
-      int32_t v = 0;
-      if (!CoProc::readPOD(in, len, p, v)) return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
-      g_job.args[i] = v;
-    }
-    (void)CoProc::readPOD(in, len, p, timeout_ms);
+    if (!parseExecArgs(in, len, g_job.args, argc, timeout_ms)) return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
     g_job.code = (uintptr_t)g_blob;
     g_job.size = g_blob_len;
     g_job.argc = argc;
+    g_job.script = 0;
     g_job.result = 0;
     g_job.status = 0;
     g_job.active = 1;
@@ -223,6 +293,9 @@ public:
     uint32_t es = g_exec_state;
     CoProc::writePOD(out, cap, off, status);
     CoProc::writePOD(out, cap, off, es);
+    CoProc::writePOD(out, cap, off, m_lastJob.id);
+    CoProc::writePOD(out, cap, off, m_lastJob.status);
+    CoProc::writePOD(out, cap, off, m_lastJob.result);
     DBG("[DBG] STATUS es=%u\n", (unsigned)es);
     return status;
   }
@@ -232,13 +305,26 @@ public:
     uint32_t maxb = 0;
     if (!CoProc::readPOD(in, len, p, maxb)) return writeStatus(out, cap, off, CoProc::ST_PARAM);
     if (maxb > BLOB_MAILBOX_MAX) maxb = BLOB_MAILBOX_MAX;
-    uint32_t n = 0;
-    for (; n < maxb; ++n)
-      if (BLOB_MAILBOX[n] == 0) break;
+    // Leave room for status, n and the trailing dropped count
+    if (cap < off + 12) return writeStatus(out, cap, off, CoProc::ST_PARAM);
+    if (maxb > cap - off - 12) maxb = (uint32_t)(cap - off - 12);
+    uint32_t n = 0, dropped = 0;
     CoProc::writePOD(out, cap, off, (int32_t)CoProc::ST_OK);
+    size_t nOff = off;
     CoProc::writePOD(out, cap, off, n);
-    CoProc::writeBytes(out, cap, off, BLOB_MAILBOX, n);
-    DBG("[DBG] MAILBOX_RD n=%u\n", (unsigned)n);
+    if (Mbx::valid(BLOB_MAILBOX, BLOB_MAILBOX_MAX)) {
+      n = Mbx::read(BLOB_MAILBOX, out + off, maxb);
+      dropped = Mbx::at(BLOB_MAILBOX)->dropped;  // running total, producer-owned
+    } else {
+      // A raw blob wrote a plain string over the ring header: hand it over once, then start a fresh ring
+      n = Mbx::legacyText(BLOB_MAILBOX, BLOB_MAILBOX_MAX, (char*)out + off, maxb + 1);
+      if (!g_job.active) Mbx::init(BLOB_MAILBOX, BLOB_MAILBOX_MAX, false);
+    }
+    off += n;
+    memcpy(out + nOff, &n, sizeof(n));
+    CoProc::writePOD(out, cap, off, dropped);
+    m_mbxSignalled = false;  // next EVT_MAILBOX once more data arrives
+    DBG("[DBG] MAILBOX_RD n=%u dropped=%u\n", (unsigned)n, (unsigned)dropped);
     return CoProc::ST_OK;
   }
 
@@ -256,14 +342,15 @@ public:
     uint32_t total = 0;
     if (!CoProc::readPOD(in, len, p, total)) return writeStatus(out, cap, off, CoProc::ST_PARAM);
     if (total == 0 || total == 0xFFFFFFFFu) return writeStatus(out, cap, off, CoProc::ST_SIZE);  // guard overflow on malloc(total+1)
-    freeScript();
-    g_script = (uint8_t*)malloc((size_t)total + 1u);
+    retireScript();
+    g_script = allocImage((size_t)total + 1u);
     if (!g_script) return writeStatus(out, cap, off, CoProc::ST_NOMEM);
     g_script_len = 0;
     g_script_cap = total;
     g_script_expected_len = total;
     g_script_crc = 0;
     DBG("[DBG] SCRIPT_BEGIN total=%u\n", (unsigned)total);
+    if (negotiateWindow(in, len, p, m_scriptWin, m_scriptDec, g_script, total, out, cap, off)) return CoProc::ST_OK;
     return writeStatus(out, cap, off, CoProc::ST_OK);
   }
 
@@ -284,6 +371,13 @@ public:
     return status;
   }
 
+  int32_t cmdSCRIPT_WDATA(const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t& off) {
+    int32_t st = windowData(m_scriptWin, m_scriptDec, in, len, out, cap, off);
+    // SCRIPT_END checks length and CRC over the stored bytes
+    g_script_len = m_scriptDec.active() ? m_scriptDec.produced() : m_scriptWin.stored();
+    return st;
+  }
+
   int32_t cmdSCRIPT_END(const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t& off) {
     size_t p = 0;
     uint32_t expected = 0;
@@ -310,6 +404,8 @@ public:
     if (expected != 0xFFFFFFFFu) {
       status = (expected == have) ? CoProc::ST_OK : CoProc::ST_CRC;
     }
+    m_scriptKeyed = (status == CoProc::ST_OK);
+    m_scriptKey = have;
     // Respond with: status, length, and have-CRC for robustness
     CoProc::writePOD(out, cap, off, status);
     CoProc::writePOD(out, cap, off, g_script_len);
@@ -321,55 +417,12 @@ public:
 
   int32_t cmdSCRIPT_EXEC(const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t& off) {
     if (!g_script || g_script_len == 0) return writeStatus2(out, cap, off, CoProc::ST_STATE, 0);
-    size_t p = 0;
+    // Anything on core1 (blob or script) also produces mailbox events; the ring has one producer
+    if (isJobActive() || m_async.running) return writeStatus2(out, cap, off, CoProc::ST_STATE, 0);
     uint32_t argc = 0, timeout_ms = 0;
-    if (!CoProc::readPOD(in, len, p, argc)) return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
-    if (argc > MAX_EXEC_ARGS) argc = MAX_EXEC_ARGS;
     int32_t argv[MAX_EXEC_ARGS] = { 0 };
-    if (argc == 0) {
-      if (!CoProc::readPOD(in, len, p, timeout_ms)) return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
-    } else {
-      if (p + sizeof(uint32_t) <= len) {
-        uint32_t marker = 0;
-        memcpy(&marker, in + p, sizeof(marker));
-        if (marker == 0xFFFFFFFFu) {
-          p += sizeof(uint32_t);
-          DBG("[DBG] SCRIPT_EXEC: alternate ASCII-args mode detected argc=%u\n", (unsigned)argc);
-          for (uint32_t i = 0; i < argc; ++i) {
-            uint32_t slen = 0;
-            if (!CoProc::readPOD(in, len, p, slen)) return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
-            if (slen == 0 || p + slen > len) return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
-            if (slen > 1024) return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
-            uint8_t tmp[1025];
-            memcpy(tmp, in + p, slen);
-            p += slen;
-            int32_t parsed = 0;
-            if (!parseAsciiInt(tmp, slen, parsed)) return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
-            argv[i] = parsed;
-            DBG("[DBG] SCRIPT_EXEC arg[%u] ascii='%.*s' -> %d (0x%08X)\n",
-                (unsigned)i, (int)slen, (const char*)tmp, (int)parsed, (unsigned)parsed);
-          }
-          if (!CoProc::readPOD(in, len, p, timeout_ms)) return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
-        } else {
-          DBG("[DBG] SCRIPT_EXEC: classic int32-args mode argc=%u\n", (unsigned)argc);
-          for (uint32_t i = 0; i < argc; ++i) {
-            int32_t v = 0;
-            if (!CoProc::readPOD(in, len, p, v)) return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
-            argv[i] = v;
-          }
-          if (!CoProc::readPOD(in, len, p, timeout_ms)) return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
-        }
-      } else {
-        return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
-      }
-    }
-    if (!s_vm) {
-      s_vm = new CoProcLang::VM();
-      if (!s_vm) return writeStatus2(out, cap, off, CoProc::ST_NOMEM, 0);
-    }
-    s_vm->env.mailbox = BLOB_MAILBOX;
-    s_vm->env.mailbox_max = BLOB_MAILBOX_MAX;
-    s_vm->env.cancel_flag = &g_cancel_flag;
+    if (!parseScriptArgs(in, len, argv, argc, timeout_ms)) return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
+    if (!prepareVm()) return writeStatus2(out, cap, off, CoProc::ST_NOMEM, 0);
     g_exec_state = CoProc::EXEC_RUNNING;
     int32_t retVal = 0;
     bool ok = s_vm->run(g_script, g_script_len, argv, argc, timeout_ms, retVal);
@@ -381,6 +434,240 @@ public:
     return st;
   }
 
+  // Content cache: is (kind, len, crc) held? QUERY_SELECT also makes it the current image.
+  int32_t cmdQUERY(const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t& off) {
+    size_t p = 0;
+    uint32_t kind = 0, ilen = 0, crc = 0, flags = 0;
+    if (!CoProc::readPOD(in, len, p, kind) || !CoProc::readPOD(in, len, p, ilen) || !CoProc::readPOD(in, len, p, crc))
+      return writeStatus(out, cap, off, CoProc::ST_PARAM);
+    (void)CoProc::readPOD(in, len, p, flags);
+    int32_t st = CoProc::ST_NOT_FOUND;
+    if (kind > CoProc::CACHE_SCRIPT) {
+      st = CoProc::ST_PARAM;
+    } else if (flags & CoProc::QUERY_SELECT) {
+      st = cacheSelect(kind, ilen, crc);
+    } else if (isCurrent(kind, ilen, crc) || cacheFind(kind, ilen, crc) >= 0) {
+      st = CoProc::ST_OK;
+    }
+    uint32_t images = 0;
+    for (uint32_t i = 0; i < COPROC_CACHE_SLOTS; ++i)
+      if (m_cache[i].data) ++images;
+    CoProc::writePOD(out, cap, off, st);
+    CoProc::writePOD(out, cap, off, images);
+    CoProc::writePOD(out, cap, off, m_cacheBytes);
+    DBG("[DBG] QUERY kind=%u len=%u crc=0x%08X flags=%u st=%d\n", (unsigned)kind, (unsigned)ilen, (unsigned)crc,
+        (unsigned)flags, (int)st);
+    return st;
+  }
+
+  // CMD_LOAD_REF: take a blob or script from the shared PSRAM window
+  int32_t cmdLOAD_REF(const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t& off) {
+    size_t p = 0;
+    uint32_t kind = 0, addr = 0, ilen = 0, crc = 0;
+    if (!CoProc::readPOD(in, len, p, kind) || !CoProc::readPOD(in, len, p, addr) || !CoProc::readPOD(in, len, p, ilen)
+        || !CoProc::readPOD(in, len, p, crc) || kind > CoProc::CACHE_SCRIPT || !CoProc::sharedRefValid(addr, ilen))
+      return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
+    if (kind == CoProc::CACHE_BLOB && (ilen & 1u)) return writeStatus2(out, cap, off, CoProc::ST_SIZE, 0);
+    if (!m_shared) return writeStatus2(out, cap, off, CoProc::ST_STATE, 0);
+    int32_t st = cacheSelect(kind, ilen, crc);
+    if (st == CoProc::ST_OK) return writeStatus2(out, cap, off, st, (int32_t)ilen);
+    uint8_t* img = allocImage((size_t)ilen + (kind == CoProc::CACHE_SCRIPT ? 1u : 0u));
+    if (!img) return writeStatus2(out, cap, off, CoProc::ST_NOMEM, 0);
+    {
+      CoProc::SharedMem::Lease lease(*m_shared);
+      st = !lease.ok ? CoProc::ST_TIMEOUT : m_shared->read(addr, img, ilen) ? CoProc::ST_OK : CoProc::ST_EXEC;
+    }
+    if (st == CoProc::ST_OK && CoProc::crc32_ieee(img, ilen) != crc) st = CoProc::ST_CRC;
+    DBG("[DBG] LOAD_REF kind=%u addr=0x%06X len=%u st=%d\n", (unsigned)kind, (unsigned)addr, (unsigned)ilen, (int)st);
+    if (st != CoProc::ST_OK) {
+      free(img);
+      return writeStatus2(out, cap, off, st, 0);
+    }
+    if (kind == CoProc::CACHE_SCRIPT) {
+      retireScript();
+      img[ilen] = 0;
+      g_script = img;
+      g_script_len = g_script_cap = g_script_expected_len = ilen;
+      g_script_crc = crc;
+      m_scriptKeyed = true;
+      m_scriptKey = crc;
+    } else {
+      retireBlob();
+      g_blob = img;
+      g_blob_len = g_blob_cap = ilen;
+      g_blob_crc = crc;
+      m_blobKeyed = true;
+      m_blobKey = crc;
+      g_exec_state = CoProc::EXEC_LOADED;
+    }
+    return writeStatus2(out, cap, off, CoProc::ST_OK, (int32_t)ilen);
+  }
+
+  // CMD_EXEC_CACHED: select a held image, then run it exactly like CMD_EXEC / CMD_SCRIPT_EXEC
+  int32_t cmdEXEC_CACHED(const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t& off) {
+    size_t p = 0;
+    uint32_t kind = 0, ilen = 0, crc = 0;
+    if (!CoProc::readPOD(in, len, p, kind) || !CoProc::readPOD(in, len, p, ilen) || !CoProc::readPOD(in, len, p, crc))
+      return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
+    if (kind > CoProc::CACHE_SCRIPT) return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
+    int32_t st = cacheSelect(kind, ilen, crc);
+    if (st != CoProc::ST_OK) return writeStatus2(out, cap, off, st, 0);
+    if (kind == CoProc::CACHE_SCRIPT) return cmdSCRIPT_EXEC(in + p, len - p, out, cap, off);
+    return cmdEXEC(in + p, len - p, out, cap, off);
+  }
+
+  // CMD_SUBSCRIBE: choose which unsolicited events pollEvent() produces
+  int32_t cmdSUBSCRIBE(const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t& off) {
+    size_t p = 0;
+    uint32_t mask = 0;
+    if (!CoProc::readPOD(in, len, p, mask)) return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
+    m_evtMask = mask & (CoProc::EVT_JOB_DONE | CoProc::EVT_MAILBOX | CoProc::EVT_ERROR);
+    m_mbxSignalled = false;
+    m_errPending = false;
+    DBG("[DBG] SUBSCRIBE mask=0x%X\n", (unsigned)m_evtMask);
+    return writeStatus2(out, cap, off, CoProc::ST_OK, (int32_t)m_evtMask);
+  }
+
+  // CMD_STATS: link counters, optionally zeroed once they are in the reply
+  int32_t cmdSTATS(const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t& off) {
+    size_t p = 0;
+    uint32_t flags = 0;
+    if (len && !CoProc::readPOD(in, len, p, flags)) return writeStatus(out, cap, off, CoProc::ST_PARAM);
+    CoProc::writePOD(out, cap, off, (int32_t)CoProc::ST_OK);
+    CoProc::writePOD(out, cap, off, CoProc::STATS_FIELDS);
+    CoProc::writePOD(out, cap, off, m_linkStats);
+    if (flags & CoProc::STATS_RESET) m_linkStats = CoProc::LinkStats{};
+    return CoProc::ST_OK;
+  }
+
+  // CMD_EXEC_ASYNC: start the current blob or script on core1 and reply with its job id
+  int32_t cmdEXEC_ASYNC(const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t& off) {
+    size_t p = 0;
+    uint32_t kind = 0;
+    if (!CoProc::readPOD(in, len, p, kind) || kind > CoProc::CACHE_SCRIPT) return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
+    if (g_job.active || m_async.running || m_queued) return writeStatus2(out, cap, off, CoProc::ST_STATE, 0);
+    uint32_t argc = 0, timeout_ms = 0;
+    int32_t argv[MAX_EXEC_ARGS];
+    uint8_t* img = (kind == CoProc::CACHE_SCRIPT) ? g_script : g_blob;
+    uint32_t ilen = (kind == CoProc::CACHE_SCRIPT) ? g_script_len : g_blob_len;
+    int32_t st = parseJob(kind, in + p, len - p, img, ilen, argv, argc, timeout_ms);
+    if (st != CoProc::ST_OK) return writeStatus2(out, cap, off, st, 0);
+    uint32_t id = nextJobId();
+    startJob(kind, img, ilen, argv, argc, timeout_ms, id);
+    DBG("[DBG] EXEC_ASYNC job=%u kind=%u argc=%u timeout=%u\n", (unsigned)id, (unsigned)kind, (unsigned)argc,
+        (unsigned)timeout_ms);
+    return writeStatus2(out, cap, off, CoProc::ST_OK, (int32_t)id);
+  }
+
+  // CMD_JOB_SUBMIT: queue a run of the current blob or script; starts when core1 is free
+  int32_t cmdJOB_SUBMIT(const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t& off) {
+    size_t p = 0;
+    uint32_t kind = 0, prio = 0;
+    if (!CoProc::readPOD(in, len, p, kind) || !CoProc::readPOD(in, len, p, prio) || kind > CoProc::CACHE_SCRIPT)
+      return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
+    int slot = -1;
+    for (uint32_t i = 0; i < COPROC_JOB_QUEUE && slot < 0; ++i)
+      if (!m_queue[i].id) slot = (int)i;
+    if (slot < 0) return writeStatus2(out, cap, off, CoProc::ST_NOMEM, 0);
+    bool script = (kind == CoProc::CACHE_SCRIPT);
+    if (!(script ? m_scriptKeyed : m_blobKeyed)) return writeStatus2(out, cap, off, CoProc::ST_STATE, 0);  // unverified image
+    QueuedJob& q = m_queue[slot];
+    int32_t st = parseJob(kind, in + p, len - p, script ? g_script : g_blob, script ? g_script_len : g_blob_len, q.args, q.argc,
+                          q.timeout_ms);
+    if (st != CoProc::ST_OK) return writeStatus2(out, cap, off, st, 0);
+    q.kind = kind;
+    q.len = script ? g_script_len : g_blob_len;
+    q.crc = script ? m_scriptKey : m_blobKey;
+    q.priority = prio;
+    q.order = ++m_queueTick;
+    q.id = nextJobId();
+    ++m_queued;
+    DBG("[DBG] JOB_SUBMIT job=%u kind=%u prio=%u queued=%u\n", (unsigned)q.id, (unsigned)kind, (unsigned)prio,
+        (unsigned)m_queued);
+    return writeStatus2(out, cap, off, CoProc::ST_OK, (int32_t)q.id);
+  }
+
+  // CMD_RESULTS: drain finished async jobs, oldest first
+  int32_t cmdRESULTS(const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t& off) {
+    size_t p = 0;
+    uint32_t maxN = 0;
+    if (!CoProc::readPOD(in, len, p, maxN)) return writeStatus(out, cap, off, CoProc::ST_PARAM);
+    CoProc::writePOD(out, cap, off, (int32_t)CoProc::ST_OK);
+    size_t nOff = off;
+    uint32_t n = 0;
+    CoProc::writePOD(out, cap, off, n);
+    CoProc::writePOD(out, cap, off, m_resDropped);
+    CoProc::writePOD(out, cap, off, m_queued + (m_async.running ? 1u : 0u));
+    while (n < maxN && m_resTail != m_resHead && off + sizeof(JobResult) <= cap) {
+      CoProc::writePOD(out, cap, off, m_results[m_resTail % COPROC_RESULT_RING]);
+      ++m_resTail;
+      ++n;
+    }
+    memcpy(out + nOff, &n, sizeof(n));
+    DBG("[DBG] RESULTS n=%u left=%u dropped=%u\n", (unsigned)n, (unsigned)(m_resHead - m_resTail), (unsigned)m_resDropped);
+    return CoProc::ST_OK;
+  }
+
+  // Async bookkeeping; call from the protocol loop while no request is being handled. Returns true
+  // with one CMD_EVENT payload in 'out' when a subscribed event is due.
+  bool pollEvent(uint8_t* out, size_t cap, size_t& off) {
+    if (m_async.running) {
+      if (g_job.active) {
+        if (m_async.timeout_ms && !m_async.timedOut && (millis() - m_async.t0) > m_async.timeout_ms) {
+          mailboxSetCancel(1);
+          m_async.timedOut = true;
+          DBG("[DBG] async job %u timeout\n", (unsigned)m_async.id);
+        }
+      } else {
+        m_async.running = false;
+        mailboxSetCancel(0);
+        g_exec_state = CoProc::EXEC_DONE;
+        pushResult(m_async.id, m_async.timedOut ? (int32_t)CoProc::ST_TIMEOUT : (int32_t)g_job.status, g_job.result);
+      }
+    }
+    if (m_parked && !g_job.active) {
+      free(m_parked);
+      m_parked = nullptr;
+    }
+    dispatchNext();
+    if (!(m_evtMask & CoProc::EVT_JOB_DONE)) m_resEvt = m_resHead;  // subscribing later does not replay old results
+    if (m_resHead - m_resEvt > COPROC_RESULT_RING) m_resEvt = m_resHead - COPROC_RESULT_RING;
+    if (m_resEvt != m_resHead) {
+      const JobResult& r = m_results[m_resEvt++ % COPROC_RESULT_RING];
+      CoProc::writePOD(out, cap, off, (uint32_t)CoProc::EVT_JOB_DONE);
+      CoProc::writePOD(out, cap, off, r.id);
+      CoProc::writePOD(out, cap, off, r.status);
+      CoProc::writePOD(out, cap, off, r.result);
+      return true;
+    }
+    if (m_errPending) {
+      m_errPending = false;
+      CoProc::writePOD(out, cap, off, (uint32_t)CoProc::EVT_ERROR);
+      CoProc::writePOD(out, cap, off, m_err.status);
+      CoProc::writePOD(out, cap, off, m_err.cmd);
+      CoProc::writePOD(out, cap, off, m_err.seq);
+      return true;
+    }
+    if ((m_evtMask & CoProc::EVT_MAILBOX) && !m_mbxSignalled && mailboxHasData()) {
+      m_mbxSignalled = true;
+      uint32_t n = Mbx::valid(BLOB_MAILBOX, BLOB_MAILBOX_MAX) ? Mbx::used(BLOB_MAILBOX)
+                                                               : (uint32_t)strnlen((const char*)BLOB_MAILBOX, BLOB_MAILBOX_MAX);
+      CoProc::writePOD(out, cap, off, (uint32_t)CoProc::EVT_MAILBOX);
+      CoProc::writePOD(out, cap, off, n);
+      return true;
+    }
+    return false;
+  }
+
+  // The sketch dropped a request without replying (timeout, bad header); reported as EVT_ERROR
+  void noteDropped(int32_t status, uint16_t cmd, uint32_t seq) {
+    if (!(m_evtMask & CoProc::EVT_ERROR)) return;
+    m_err.status = status;
+    m_err.cmd = cmd;
+    m_err.seq = seq;
+    m_errPending = true;
+  }
+
   // Named function registry and dispatcher (CMD_FUNC)
   // Register a function by name with fixed argc.
   // expected_argc: >=0 for exact match; -1 to allow any argc.
@@ -391,17 +678,86 @@ public:
       if (strcmp(m_funcs[i].name, name) == 0) {
         m_funcs[i].expected_argc = expected_argc;
         m_funcs[i].fn = fn;
+        m_funcCrcValid = false;
         return true;
       }
     }
     if (m_funcCount >= MAX_FUNCS) return false;
+    if (strlen(name) > CoProc::FUNC_NAME_MAX) return false;
     m_funcs[m_funcCount].name = name;  // assume lifetime >= registry
     m_funcs[m_funcCount].expected_argc = expected_argc;
     m_funcs[m_funcCount].fn = fn;
     ++m_funcCount;
+    m_funcCrcValid = false;
     return true;
   }
 
+  // CMD_FUNC_LIST: registry slots from first_id on, as many as fit in max_bytes of reply
+  int32_t cmdFUNC_LIST(const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t& off) {
+    size_t p = 0;
+    uint32_t first = 0, maxBytes = 0;
+    if (!CoProc::readPOD(in, len, p, first) || !CoProc::readPOD(in, len, p, maxBytes))
+      return writeStatus(out, cap, off, CoProc::ST_PARAM);
+    if (maxBytes < 16) return writeStatus(out, cap, off, CoProc::ST_PARAM);
+    size_t lim = off + maxBytes;
+    if (lim > cap) lim = cap;
+    CoProc::writePOD(out, lim, off, (int32_t)CoProc::ST_OK);
+    CoProc::writePOD(out, lim, off, funcTableCrc());
+    CoProc::writePOD(out, lim, off, m_funcCount);
+    size_t nOff = off;
+    uint32_t n = 0;
+    CoProc::writePOD(out, lim, off, n);
+    for (uint32_t id = first; id < m_funcCount; ++id) {
+      uint8_t nl = (uint8_t)strlen(m_funcs[id].name);
+      if (off + 4 + nl > lim) break;
+      CoProc::writePOD(out, lim, off, (uint16_t)id);
+      CoProc::writePOD(out, lim, off, (int8_t)m_funcs[id].expected_argc);
+      CoProc::writePOD(out, lim, off, nl);
+      CoProc::writeBytes(out, lim, off, m_funcs[id].name, nl);
+      ++n;
+    }
+    memcpy(out + nOff, &n, sizeof(n));
+    DBG("[DBG] FUNC_LIST first=%u n=%u of %u\n", (unsigned)first, (unsigned)n, (unsigned)m_funcCount);
+    return CoProc::ST_OK;
+  }
+
+  // CMD_FUNC_BATCH: run count calls by id; stops at the first failing call
+  int32_t cmdFUNC_BATCH(const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t& off) {
+    size_t p = 0;
+    uint32_t crc = 0, count = 0;
+    if (!CoProc::readPOD(in, len, p, crc) || !CoProc::readPOD(in, len, p, count)) return writeStatus2(out, cap, off, CoProc::ST_PARAM, 0);
+    if (crc != funcTableCrc()) return writeStatus2(out, cap, off, CoProc::ST_STATE, 0);
+    size_t stOff = off;
+    CoProc::writePOD(out, cap, off, (int32_t)CoProc::ST_OK);
+    size_t nOff = off;
+    uint32_t done = 0;
+    CoProc::writePOD(out, cap, off, done);
+    int32_t st = CoProc::ST_OK;
+    int32_t argv[MAX_EXEC_ARGS];
+    for (; done < count; ++done) {
+      uint16_t id = 0, argc = 0;
+      if (!CoProc::readPOD(in, len, p, id) || !CoProc::readPOD(in, len, p, argc) || argc > MAX_EXEC_ARGS
+          || !CoProc::readBytes(in, len, p, argv, argc * sizeof(int32_t))) {
+        st = CoProc::ST_PARAM;
+        break;
+      }
+      if (id >= m_funcCount || (m_funcs[id].expected_argc >= 0 && (uint32_t)m_funcs[id].expected_argc != argc)) {
+        DBG("[DBG] FUNC_BATCH call %u: bad id %u / argc %u\n", (unsigned)done, (unsigned)id, (unsigned)argc);
+        st = CoProc::ST_PARAM;
+        break;
+      }
+      if (off + sizeof(int32_t) > cap) {
+        st = CoProc::ST_SIZE;
+        break;
+      }
+      CoProc::writePOD(out, cap, off, m_funcs[id].fn(argv, argc));
+    }
+    memcpy(out + stOff, &st, sizeof(st));
+    memcpy(out + nOff, &done, sizeof(done));
+    DBG("[DBG] FUNC_BATCH count=%u done=%u st=%d\n", (unsigned)count, (unsigned)done, (int)st);
+    return st;
+  }
+
   int32_t cmdFUNC(const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t& off) {
     size_t p = 0;
     uint32_t nameLen = 0;
@@ -480,6 +836,23 @@ public:
   bool isJobActive() const {
     return g_job.active != 0;
   }
+  // A job running on core1, or async jobs still queued for it
+  bool jobsPending() const {
+    return g_job.active || m_async.running || m_queued;
+  }
+  // Largest request payload the transport accepts (REQ_MAX); caps the negotiated window chunk
+  void setMaxRequest(uint32_t n) {
+    m_reqMax = n;
+  }
+
+  // Shared PSRAM for CMD_LOAD_REF (nullptr disables it)
+  void attachShared(CoProc::SharedMem* m) {
+    m_shared = m;
+  }
+
+  CoProc::LinkStats& linkStats() {
+    return m_linkStats;
+  }
 
 private:
   struct ExecJob {
@@ -487,12 +860,58 @@ private:
     uint32_t size;
     uint32_t argc;
     int32_t args[MAX_EXEC_ARGS];
+    uint8_t script;  // 1: CoProcLang source at 'code' (async scripts run on core1 too)
+    uint32_t timeout_ms;
     volatile uint8_t active;
     volatile int32_t result;
     volatile int32_t status;
   };
   ExecJob g_job;
 
+  // Async job on core1, queued jobs, finished results, and event state
+  struct AsyncJob {
+    bool running;
+    bool timedOut;
+    uint32_t id;
+    uint32_t t0;
+    uint32_t timeout_ms;
+  };
+  struct JobResult {
+    uint32_t id;
+    int32_t status;
+    int32_t result;
+  };
+  struct DroppedReq {
+    int32_t status;
+    uint32_t cmd;
+    uint32_t seq;
+  };
+  struct QueuedJob {
+    uint32_t id;  // 0 = free slot
+    uint32_t kind, len, crc;  // image key
+    uint32_t priority;  // higher starts first
+    uint32_t order;  // submit order within a priority
+    uint32_t argc;
+    uint32_t timeout_ms;
+    int32_t args[MAX_EXEC_ARGS];
+  };
+  AsyncJob m_async = {};
+  JobResult m_lastJob = {};
+  uint32_t m_jobSeq = 0;
+  QueuedJob m_queue[COPROC_JOB_QUEUE ? COPROC_JOB_QUEUE : 1] = {};
+  uint32_t m_queued = 0;
+  uint32_t m_queueTick = 0;
+  JobResult m_results[COPROC_RESULT_RING];
+  uint32_t m_resHead = 0;  // results pushed (running count; index = count % COPROC_RESULT_RING)
+  uint32_t m_resTail = 0;  // results drained by CMD_RESULTS
+  uint32_t m_resEvt = 0;  // results sent as EVT_JOB_DONE
+  uint32_t m_resDropped = 0;
+  uint8_t* m_parked = nullptr;  // replaced image core1 is still running
+  uint32_t m_evtMask = 0;
+  bool m_mbxSignalled = false;
+  bool m_errPending = false;
+  DroppedReq m_err = {};
+
   // Blob (binary) state
   uint8_t* g_blob;
   uint32_t g_blob_len;
@@ -506,6 +925,34 @@ private:
   uint32_t g_script_expected_len;  // total length advertised at BEGIN; used for size check at END
   uint32_t g_script_crc;
 
+  // Content keys of the current images (valid once *_END verified them)
+  bool m_blobKeyed = false;
+  uint32_t m_blobKey = 0;
+  bool m_scriptKeyed = false;
+  uint32_t m_scriptKey = 0;
+
+  CoProc::SharedMem* m_shared = nullptr;
+  CoProc::LinkStats m_linkStats = {};
+
+  // Replaced images (LRU by 'used')
+  struct CacheEntry {
+    uint8_t* data;  // nullptr = free slot
+    uint32_t len;
+    uint32_t crc;
+    uint32_t kind;
+    uint32_t used;
+  };
+  CacheEntry m_cache[COPROC_CACHE_SLOTS ? COPROC_CACHE_SLOTS : 1] = {};
+  uint32_t m_cacheBytes = 0;
+  uint32_t m_cacheTick = 0;
+
+  // Windowed uploads (CMD_*_WDATA)
+  CoProc::WindowRx m_blobWin;
+  CoProc::WindowRx m_scriptWin;
+  Lz4::Decoder m_blobDec;  // active while a compressed upload is in progress
+  Lz4::Decoder m_scriptDec;
+  uint32_t m_reqMax = 512;
+
   volatile uint32_t g_exec_state;
   inline static CoProcLang::VM* s_vm = nullptr;
 
@@ -518,9 +965,26 @@ private:
   static constexpr uint32_t MAX_FUNCS = 32;
   FuncEntry m_funcs[MAX_FUNCS];
   uint32_t m_funcCount = 0;
+  uint32_t m_funcCrc = 0;
+  bool m_funcCrcValid = false;
+
+  // Identity of the id -> (name, argc) mapping handed out by CMD_FUNC_LIST
+  uint32_t funcTableCrc() {
+    if (m_funcCrcValid) return m_funcCrc;
+    uint32_t c = 0xFFFFFFFFu;
+    for (uint32_t i = 0; i < m_funcCount; ++i) {
+      int8_t argc = (int8_t)m_funcs[i].expected_argc;
+      c = Crc32::update(c, m_funcs[i].name, strlen(m_funcs[i].name) + 1);  // NUL separates the names
+      c = Crc32::update(c, &argc, 1);
+    }
+    m_funcCrc = c ^ 0xFFFFFFFFu;
+    m_funcCrcValid = true;
+    return m_funcCrc;
+  }
 
   void clearFuncRegistry() {
     m_funcCount = 0;
+    m_funcCrcValid = false;
     for (uint32_t i = 0; i < MAX_FUNCS; ++i) {
       m_funcs[i].name = nullptr;
       m_funcs[i].expected_argc = -1;
@@ -539,6 +1003,167 @@ private:
 
   static inline void mailboxSetCancel(uint8_t v) {
     g_cancel_flag = v;
+    if (Mbx::valid(BLOB_MAILBOX, BLOB_MAILBOX_MAX)) Mbx::setCancel(BLOB_MAILBOX, v);
+  }
+  static inline bool mailboxHasData() {
+    if (Mbx::valid(BLOB_MAILBOX, BLOB_MAILBOX_MAX)) return Mbx::used(BLOB_MAILBOX) != 0;
+    return BLOB_MAILBOX[0] != 0;
+  }
+
+  uint32_t nextJobId() {
+    if (++m_jobSeq == 0) m_jobSeq = 1;
+    return m_jobSeq;
+  }
+
+  // Validate an async run of 'img' and parse its CMD_EXEC / CMD_SCRIPT_EXEC style arguments
+  int32_t parseJob(uint32_t kind, const uint8_t* in, size_t len, const uint8_t* img, uint32_t ilen, int32_t* argv,
+                   uint32_t& argc, uint32_t& timeout_ms) {
+    if (kind == CoProc::CACHE_SCRIPT) {
+      if (!img || ilen == 0) return CoProc::ST_STATE;
+      if (!parseScriptArgs(in, len, argv, argc, timeout_ms)) return CoProc::ST_PARAM;
+      if (!prepareVm()) return CoProc::ST_NOMEM;
+    } else {
+      if (!img || (ilen & 1u)) return CoProc::ST_STATE;
+      if (!parseExecArgs(in, len, argv, argc, timeout_ms)) return CoProc::ST_PARAM;
+    }
+    return CoProc::ST_OK;
+  }
+
+  // Hand a job to core1 (workerPoll); pollEvent() watches its timeout and collects the result
+  void startJob(uint32_t kind, const uint8_t* img, uint32_t ilen, const int32_t* argv, uint32_t argc, uint32_t timeout_ms,
+                uint32_t id) {
+    m_async.running = true;
+    m_async.timedOut = false;
+    m_async.id = id;
+    m_async.t0 = millis();
+    m_async.timeout_ms = timeout_ms;
+    g_job.code = (uintptr_t)img;
+    g_job.size = ilen;
+    memcpy(g_job.args, argv, argc * sizeof(int32_t));
+    g_job.argc = argc;
+    g_job.script = (kind == CoProc::CACHE_SCRIPT) ? 1 : 0;
+    g_job.timeout_ms = timeout_ms;
+    g_job.result = 0;
+    g_job.status = 0;
+    g_exec_state = CoProc::EXEC_RUNNING;
+    g_job.active = 1;
+  }
+
+  // Start queued jobs while core1 is free: highest priority first, then submit order
+  void dispatchNext() {
+    while (m_queued && !g_job.active && !m_async.running) {
+      int best = -1;
+      for (uint32_t i = 0; i < COPROC_JOB_QUEUE; ++i) {
+        const QueuedJob& q = m_queue[i];
+        if (!q.id) continue;
+        if (best < 0 || q.priority > m_queue[best].priority
+            || (q.priority == m_queue[best].priority && q.order < m_queue[best].order))
+          best = (int)i;
+      }
+      QueuedJob& q = m_queue[best];
+      uint32_t id = q.id;
+      q.id = 0;
+      --m_queued;
+      const uint8_t* img = findImage(q.kind, q.len, q.crc);
+      if (!img) {
+        DBG("[DBG] job %u: image len=%u crc=0x%08X gone\n", (unsigned)id, (unsigned)q.len, (unsigned)q.crc);
+        pushResult(id, CoProc::ST_NOT_FOUND, 0);
+      } else if (q.kind == CoProc::CACHE_SCRIPT && !prepareVm()) {
+        pushResult(id, CoProc::ST_NOMEM, 0);
+      } else {
+        startJob(q.kind, img, q.len, q.args, q.argc, q.timeout_ms, id);
+        DBG("[DBG] job %u started (prio=%u, %u queued)\n", (unsigned)id, (unsigned)q.priority, (unsigned)m_queued);
+      }
+    }
+  }
+
+  void pushResult(uint32_t id, int32_t status, int32_t result) {
+    m_lastJob = JobResult{ id, status, result };
+    if (m_resHead - m_resTail >= COPROC_RESULT_RING) {
+      ++m_resTail;
+      ++m_resDropped;
+    }
+    m_results[m_resHead++ % COPROC_RESULT_RING] = m_lastJob;
+    DBG("[DBG] async job %u done status=%d result=%d\n", (unsigned)id, (int)status, (int)result);
+  }
+
+  // There is one VM; an async script on core1 owns it
+  bool isRunning(const uint8_t* img) const {
+    return img && g_job.active && g_job.code == (uintptr_t)img;
+  }
+
+  // CMD_EXEC arguments: uint32 argc, int32 argv[argc] [, uint32 timeout_ms]
+  static bool parseExecArgs(const uint8_t* in, size_t len, int32_t* argv, uint32_t& argc, uint32_t& timeout_ms) {
+    size_t p = 0;
+    argc = 0;
+    timeout_ms = 0;
+    if (!CoProc::readPOD(in, len, p, argc)) return false;
+    if (argc > MAX_EXEC_ARGS) argc = MAX_EXEC_ARGS;
+    for (uint32_t i = 0; i < argc; ++i) {
+      int32_t v = 0;
+      if (!CoProc::readPOD(in, len, p, v)) return false;
+      argv[i] = v;
+    }
+    (void)CoProc::readPOD(in, len, p, timeout_ms);
+    return true;
+  }
+
+  // CMD_SCRIPT_EXEC arguments: classic int32 argv, or marker 0xFFFFFFFF + ASCII args; then timeout_ms
+  static bool parseScriptArgs(const uint8_t* in, size_t len, int32_t* argv, uint32_t& argc, uint32_t& timeout_ms) {
+    size_t p = 0;
+    argc = 0;
+    timeout_ms = 0;
+    if (!CoProc::readPOD(in, len, p, argc)) return false;
+    if (argc > MAX_EXEC_ARGS) argc = MAX_EXEC_ARGS;
+    if (argc == 0) {
+      if (!CoProc::readPOD(in, len, p, timeout_ms)) return false;
+    } else {
+      if (p + sizeof(uint32_t) <= len) {
+        uint32_t marker = 0;
+        memcpy(&marker, in + p, sizeof(marker));
+        if (marker == 0xFFFFFFFFu) {
+          p += sizeof(uint32_t);
+          DBG("[DBG] SCRIPT_EXEC: alternate ASCII-args mode detected argc=%u\n", (unsigned)argc);
+          for (uint32_t i = 0; i < argc; ++i) {
+            uint32_t slen = 0;
+            if (!CoProc::readPOD(in, len, p, slen)) return false;
+            if (slen == 0 || p + slen > len) return false;
+            if (slen > 1024) return false;
+            uint8_t tmp[1025];
+            memcpy(tmp, in + p, slen);
+            p += slen;
+            int32_t parsed = 0;
+            if (!parseAsciiInt(tmp, slen, parsed)) return false;
+            argv[i] = parsed;
+            DBG("[DBG] SCRIPT_EXEC arg[%u] ascii='%.*s' -> %d (0x%08X)\n",
+                (unsigned)i, (int)slen, (const char*)tmp, (int)parsed, (unsigned)parsed);
+          }
+          if (!CoProc::readPOD(in, len, p, timeout_ms)) return false;
+        } else {
+          DBG("[DBG] SCRIPT_EXEC: classic int32-args mode argc=%u\n", (unsigned)argc);
+          for (uint32_t i = 0; i < argc; ++i) {
+            int32_t v = 0;
+            if (!CoProc::readPOD(in, len, p, v)) return false;
+            argv[i] = v;
+          }
+          if (!CoProc::readPOD(in, len, p, timeout_ms)) return false;
+        }
+      } else {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool prepareVm() {
+    if (!s_vm) {
+      s_vm = new CoProcLang::VM();
+      if (!s_vm) return false;
+    }
+    s_vm->env.mailbox = BLOB_MAILBOX;
+    s_vm->env.mailbox_max = BLOB_MAILBOX_MAX;
+    s_vm->env.cancel_flag = &g_cancel_flag;
+    return true;
   }
 
   static bool parseAsciiInt(const uint8_t* s, size_t n, int32_t& out) {
@@ -593,6 +1218,9 @@ private:
     g_blob_len = 0;
     g_blob_cap = 0;
     g_blob_crc = 0;
+    m_blobKeyed = false;
+    m_blobWin.reset();
+    m_blobDec.reset();
     g_exec_state = CoProc::EXEC_IDLE;
     DBG("[COPROC] blob freed\n");
   }
@@ -604,9 +1232,185 @@ private:
     g_script_cap = 0;
     g_script_crc = 0;
     g_script_expected_len = 0;
+    m_scriptKeyed = false;
+    m_scriptWin.reset();
+    m_scriptDec.reset();
     DBG("[COPROC] script freed\n");
   }
 
+  // ----- Content cache -----
+  // Replace the current image: a verified one moves into the cache, anything else is freed unless
+  // core1 is running it (then it is parked and freed once the job ends)
+  void retireBlob() {
+    if (g_blob && m_blobKeyed && cachePut(CoProc::CACHE_BLOB, g_blob, g_blob_len, m_blobKey)) g_blob = nullptr;
+    if (isRunning(g_blob)) park(g_blob);
+    freeBlob();
+  }
+  void retireScript() {
+    if (g_script && m_scriptKeyed && cachePut(CoProc::CACHE_SCRIPT, g_script, g_script_len, m_scriptKey)) g_script = nullptr;
+    if (isRunning(g_script)) park(g_script);
+    freeScript();
+  }
+  void park(uint8_t*& img) {
+    if (m_parked) free(m_parked);  // only one job runs, so an older parked image is idle by now
+    m_parked = img;
+    img = nullptr;
+  }
+
+  // Current or cached image with this key
+  uint8_t* findImage(uint32_t kind, uint32_t len, uint32_t crc) const {
+    if (isCurrent(kind, len, crc)) return (kind == CoProc::CACHE_SCRIPT) ? g_script : g_blob;
+    int i = cacheFind(kind, len, crc);
+    return (i >= 0) ? m_cache[i].data : nullptr;
+  }
+
+  // malloc that may evict cached images to make room
+  uint8_t* allocImage(size_t n) {
+    uint8_t* p = (uint8_t*)malloc(n);
+    while (!p && cacheEvictOldest()) p = (uint8_t*)malloc(n);
+    return p;
+  }
+
+  bool isCurrent(uint32_t kind, uint32_t len, uint32_t crc) const {
+    if (kind == CoProc::CACHE_SCRIPT) return g_script && m_scriptKeyed && g_script_len == len && m_scriptKey == crc;
+    return g_blob && m_blobKeyed && g_blob_len == len && m_blobKey == crc;
+  }
+
+  int cacheFind(uint32_t kind, uint32_t len, uint32_t crc) const {
+    for (uint32_t i = 0; i < COPROC_CACHE_SLOTS; ++i) {
+      const CacheEntry& e = m_cache[i];
+      if (e.data && e.kind == kind && e.len == len && e.crc == crc) return (int)i;
+    }
+    return -1;
+  }
+
+  // Takes ownership of 'data' on success
+  bool cachePut(uint32_t kind, uint8_t* data, uint32_t len, uint32_t crc) {
+    if (!COPROC_CACHE_SLOTS || len > COPROC_CACHE_BYTES) return false;
+    int dup = cacheFind(kind, len, crc);
+    if (dup >= 0) {
+      m_cache[dup].used = ++m_cacheTick;
+      return false;
+    }
+    for (;;) {
+      int freeSlot = -1;
+      for (uint32_t i = 0; i < COPROC_CACHE_SLOTS && freeSlot < 0; ++i)
+        if (!m_cache[i].data) freeSlot = (int)i;
+      if (freeSlot >= 0 && m_cacheBytes + len <= COPROC_CACHE_BYTES) {
+        m_cache[freeSlot] = CacheEntry{ data, len, crc, kind, ++m_cacheTick };
+        m_cacheBytes += len;
+        DBG("[COPROC] cached kind=%u len=%u crc=0x%08X\n", (unsigned)kind, (unsigned)len, (unsigned)crc);
+        return true;
+      }
+      if (!cacheEvictOldest()) return false;
+    }
+  }
+
+  bool cacheEvictOldest() {
+    int victim = -1;
+    for (uint32_t i = 0; i < COPROC_CACHE_SLOTS; ++i) {
+      if (m_cache[i].data && !isRunning(m_cache[i].data) && (victim < 0 || m_cache[i].used < m_cache[victim].used))
+        victim = (int)i;
+    }
+    if (victim < 0) return false;
+    CacheEntry& e = m_cache[victim];
+    free(e.data);
+    m_cacheBytes -= e.len;
+    e = CacheEntry{};
+    return true;
+  }
+
+  // Make a held image current; the image it replaces goes into the cache in turn
+  int32_t cacheSelect(uint32_t kind, uint32_t len, uint32_t crc) {
+    if (isCurrent(kind, len, crc)) return CoProc::ST_OK;
+    int i = cacheFind(kind, len, crc);
+    if (i < 0) return CoProc::ST_NOT_FOUND;
+    CacheEntry e = m_cache[i];
+    m_cache[i] = CacheEntry{};
+    m_cacheBytes -= e.len;
+    if (kind == CoProc::CACHE_SCRIPT) {
+      retireScript();
+      g_script = e.data;  // allocated with room for the terminating NUL
+      g_script_len = g_script_cap = g_script_expected_len = e.len;
+      g_script_crc = e.crc;
+      m_scriptKeyed = true;
+      m_scriptKey = e.crc;
+    } else {
+      retireBlob();
+      g_blob = e.data;
+      g_blob_len = g_blob_cap = e.len;
+      g_blob_crc = e.crc;
+      m_blobKeyed = true;
+      m_blobKey = e.crc;
+      g_exec_state = CoProc::EXEC_LOADED;
+    }
+    DBG("[COPROC] cache hit kind=%u len=%u\n", (unsigned)kind, (unsigned)len);
+    return CoProc::ST_OK;
+  }
+
+  // *_BEGIN: optional want_chunk/want_window after total_len. On success the reply carries the
+  // agreed chunk and window and *_WDATA frames are accepted; old senders get the plain reply.
+  // A following codec/packed_len selects a compressed stream, decoded into 'dst' as it arrives.
+  bool negotiateWindow(const uint8_t* in, size_t len, size_t p, CoProc::WindowRx& w, Lz4::Decoder& dec, uint8_t* dst,
+                       uint32_t total, uint8_t* out, size_t cap, size_t& off) {
+    w.reset();
+    dec.reset();
+    uint32_t wantChunk = 0, wantWin = 0, codec = CoProc::CODEC_NONE, packedLen = 0;
+    if (!CoProc::readPOD(in, len, p, wantChunk) || !CoProc::readPOD(in, len, p, wantWin)) return false;
+    uint32_t maxChunk = (m_reqMax > CoProc::WIN_HDR_BYTES) ? m_reqMax - CoProc::WIN_HDR_BYTES : 0;
+    uint32_t chunk = ((wantChunk < maxChunk) ? wantChunk : maxChunk) & ~3u;
+    uint32_t win = (wantWin < CoProc::WIN_MAX) ? wantWin : CoProc::WIN_MAX;
+    if (!chunk || !win) return false;
+    if (CoProc::readPOD(in, len, p, codec) && CoProc::readPOD(in, len, p, packedLen)
+        && codec == CoProc::CODEC_LZ4 && packedLen) {
+      dec.start(dst, total);
+      w.start(nullptr, packedLen, chunk);  // in-order: chunks go to the decoder, not into 'dst'
+    } else {
+      codec = CoProc::CODEC_NONE;
+      w.start(dst, total, chunk);
+    }
+    CoProc::writePOD(out, cap, off, (int32_t)CoProc::ST_OK);
+    CoProc::writePOD(out, cap, off, chunk);
+    CoProc::writePOD(out, cap, off, win);
+    if (codec != CoProc::CODEC_NONE) CoProc::writePOD(out, cap, off, codec);
+    DBG("[DBG] window chunk=%u window=%u codec=%u\n", (unsigned)chunk, (unsigned)win, (unsigned)codec);
+    return true;
+  }
+
+  // *_WDATA: store (or decode) the chunk, reply (ACK + NAK mask) only when asked; 'off' stays 0 otherwise
+  static int32_t windowData(CoProc::WindowRx& w, Lz4::Decoder& dec, const uint8_t* in, size_t len, uint8_t* out,
+                            size_t cap, size_t& off) {
+    size_t p = 0;
+    uint32_t idx = 0, flags = 0;
+    if (!CoProc::readPOD(in, len, p, idx) || !CoProc::readPOD(in, len, p, flags)) return CoProc::ST_PARAM;
+    int32_t st = CoProc::ST_OK;
+    uint32_t n = (uint32_t)(len - p);
+    if (!w.chunk) {
+      st = CoProc::ST_STATE;
+    } else if (len > p && dec.active()) {
+      // Only the next chunk can be decoded; later ones are dropped and resent after the ACK
+      if (w.isNext(idx, n)) {
+        if (dec.feed(in + p, n)) {
+          w.advance();
+        } else {
+          st = CoProc::ST_PARAM;
+        }
+      } else if (dec.failed()) {
+        st = CoProc::ST_PARAM;
+      }
+    } else if (len > p && !w.accept(idx, in + p, n)) {
+      st = CoProc::ST_PARAM;
+    }
+    if (flags & CoProc::WIN_ACK_REQ) {
+      CoProc::writePOD(out, cap, off, st);
+      CoProc::writePOD(out, cap, off, w.base);
+      CoProc::writePOD(out, cap, off, w.holes());
+      CoProc::writePOD(out, cap, off, w.high);
+      DBG("[DBG] WDATA ack=%u nak=0x%08X high=%u\n", (unsigned)w.base, (unsigned)w.holes(), (unsigned)w.high);
+    }
+    return st;
+  }
+
   static int32_t writeStatus(uint8_t* out, size_t cap, size_t& off, int32_t st) {
     CoProc::writePOD(out, cap, off, st);
     return st;
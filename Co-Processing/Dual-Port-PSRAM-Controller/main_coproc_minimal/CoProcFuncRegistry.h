@@ -1,9 +1,12 @@
 // CoprocFuncRegistry.h (on the co-processor firmware)
+// GPIO builtins; setup() registers g_table into CoProcExec so they get CMD_FUNC_LIST ids.
+#pragma once
 #include <Arduino.h>
 
 typedef int32_t (*RpcHandler)(const int32_t* argv, uint32_t argc);
 struct RpcEntry {
   const char* name;
+  int argc;  // -1 = any
   RpcHandler fn;
 };
 
@@ -36,12 +39,12 @@ static int32_t r_delay(const int32_t* a, uint32_t n) {
 // static int32_t r_reboot(const int32_t*, uint32_t) { NVIC_SystemReset(); return 0; }
 
 static const RpcEntry g_table[] = {
-  { "digitalRead", r_digitalRead },
-  { "digitalWrite", r_digitalWrite },
-  { "pinMode", r_pinMode },
-  { "analogRead", r_analogRead },
-  { "delay", r_delay },
-  // { "reboot",       r_reboot       },
+  { "digitalRead", 1, r_digitalRead },
+  { "digitalWrite", 2, r_digitalWrite },
+  { "pinMode", 2, r_pinMode },
+  { "analogRead", 1, r_analogRead },
+  { "delay", 1, r_delay },
+  // { "reboot",       0, r_reboot       },
 };
 
 static bool dispatchFuncByName(const char* name, const int32_t* argv, uint32_t argc, int32_t& out) {
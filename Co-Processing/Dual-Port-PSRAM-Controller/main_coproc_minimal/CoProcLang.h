@@ -12,6 +12,7 @@
 #include <stddef.h>
 #include <string.h>
 #include <math.h>
+#include "MailboxRing.h"
 #if COPROCLANG_COPY_INPUT
 #include <stdlib.h>
 #endif
@@ -79,7 +80,7 @@ static inline bool strieq_full(const char* a, const char* b) {
 
 // ---------- Execution env ----------
 struct Env {
-  volatile uint8_t* mailbox;            // optional mailbox (null-terminated), may be nullptr
+  volatile uint8_t* mailbox;            // optional mailbox area (streaming ring, MailboxRing.h), may be nullptr
   uint32_t mailbox_max;                 // bytes
   volatile const uint8_t* cancel_flag;  // optional cancel flag pointer (1 => cancel)
   Env()
@@ -104,14 +105,13 @@ struct VM {
   uint32_t label_count;
   // Mailbox and control
   Env env;
-  uint32_t mb_w;
 
 #if COPROCLANG_MAX_LINES < 8 || COPROCLANG_MAX_LABELS < 8
 #error "COPROCLANG_MAX_* too small"
 #endif
 
   VM()
-    : base(nullptr), len(0), line_count(0), label_count(0), mb_w(0) {
+    : base(nullptr), len(0), line_count(0), label_count(0) {
     for (int i = 0; i < 16; ++i) R[i] = 0;
     for (uint32_t i = 0; i < COPROCLANG_MAX_LINES; ++i) lines[i] = nullptr;
     for (uint32_t i = 0; i < COPROCLANG_MAX_LABELS; ++i) {
@@ -121,19 +121,11 @@ struct VM {
   }
 
   // ----- Mailbox -----
-  void mbClear() {
-    if (!env.mailbox || env.mailbox_max == 0) return;
-    mb_w = 0;
-    env.mailbox[0] = 0;
-  }
+  // Output streams to the reader as it is written, so MBCLR has nothing left to clear.
+  void mbClear() {}
   void mbAppend(const char* s, size_t n) {
     if (!env.mailbox || env.mailbox_max == 0 || !s || n == 0) return;
-    uint32_t cap = env.mailbox_max;
-    while (n && (mb_w + 1) < cap) {
-      env.mailbox[mb_w++] = (uint8_t)(*s++);
-      --n;
-    }
-    env.mailbox[mb_w] = 0;
+    Mbx::write(env.mailbox, s, (uint32_t)n);
   }
 
   // ----- Lex helpers -----
@@ -695,9 +687,9 @@ private:
     }
     line_count = 0;
     label_count = 0;
-    mb_w = 0;
     for (uint32_t i = 0; i < argc && i < 16; ++i) R[i] = args[i];
-    if (env.mailbox && env.mailbox_max) env.mailbox[0] = 0;
+    if (env.mailbox && env.mailbox_max && !Mbx::valid(env.mailbox, env.mailbox_max))
+      Mbx::init(env.mailbox, env.mailbox_max, false);
 
     // Build tables
     if (!buildTablesInPlace()) return false;
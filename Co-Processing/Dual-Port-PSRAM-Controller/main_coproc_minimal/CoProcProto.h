@@ -5,14 +5,33 @@
   - Frame: 20B header + payload (CRC32 of payload is carried inside the header; CRC=0 if len==0).
   - Requests: HELLO, INFO, LOAD_BEGIN, LOAD_DATA, LOAD_END, EXEC, STATUS, MAILBOX_RD, CANCEL, RESET.
   - Script Requests: SCRIPT_BEGIN, SCRIPT_DATA, SCRIPT_END, SCRIPT_EXEC (same framing as LOAD_EXEC).
+  - Windowed uploads: *_BEGIN may negotiate a chunk size and window; the sender then streams *_WDATA
+    frames without waiting and only asks for an ACK (cumulative + selective NAK) at the end of a burst.
+  - Compressed uploads: when HELLO advertises FEAT_LZ4, a windowed *_BEGIN may also name a codec; the
+    *_WDATA frames then carry an LZ4 block stream that the co-processor decodes in place (Lz4Block.h).
+  - Link speed: when HELLO advertises FEAT_LINK_BAUD, LINK_BAUD / LINK_ECHO / LINK_COMMIT step the
+    serial rate up after attach (negotiation in CoProcLink.h).
+  - Content cache: when HELLO advertises FEAT_CACHE, QUERY / EXEC_CACHED name an image by kind, length
+    and CRC32 so a blob or script the co-processor still holds is not uploaded again.
+  - Async: when HELLO advertises FEAT_ASYNC, EXEC_ASYNC starts a job and replies at once; after
+    SUBSCRIBE the co-processor sends unsolicited EVENT frames (job done, mailbox data, dropped request).
+  - Job queue: when HELLO advertises FEAT_JOB_QUEUE, JOB_SUBMIT queues runs by priority and RESULTS
+    drains the ring of finished jobs, so several jobs can be in flight while new images are loaded.
+  - Shared PSRAM: when HELLO advertises FEAT_LOAD_REF, LOAD_REF names a blob or script the main MCU
+    staged in the shared PSRAM window (CoProcShared.h) instead of streaming it over the link.
   - FUNC Request: call a named function registered on the co-processor (see payload below).
+  - FUNC by ID: when HELLO advertises FEAT_FUNC_BATCH, FUNC_LIST maps the registry to numeric ids once
+    and FUNC_BATCH runs a vector of id + args calls in one frame.
   - ISP Requests: ISP_ENTER, ISP_EXIT.
+  - Link statistics: when HELLO advertises FEAT_STATS, STATS returns the co-processor's framing
+    counters (frames, bytes, CRC errors, resyncs, timeouts); the host keeps the same set locally.
   - Responses: cmd | 0x80, status-first payloads.
 */
 #include <stdint.h>
 #include <stddef.h>
 #include <string.h>
 #include <type_traits>
+#include "Crc32.h"
 
 namespace CoProc {
 
@@ -25,25 +44,52 @@ enum : uint16_t {
   CMD_HELLO = 0x01,
   CMD_INFO = 0x02,
 
+  // Link speed negotiation (see "Link speed" below)
+  CMD_LINK_BAUD = 0x03,    // req: uint32 baud, uint32 trial_ms; resp: int32 status, uint32 committed_baud, uint32 max_baud
+  CMD_LINK_ECHO = 0x04,    // req: bytes; resp: int32 status, uint32 crc32(bytes), bytes
+  CMD_LINK_COMMIT = 0x05,  // req: -; resp: int32 status, uint32 baud
+
+  // Async jobs and events (see "Async" below)
+  CMD_SUBSCRIBE = 0x06,  // req: uint32 event_mask (EVT_*); resp: int32 status, uint32 event_mask
+
+  // Link counters (see "Link statistics" below)
+  CMD_STATS = 0x07,  // req: [uint32 flags (STATS_*)]; resp: int32 status, uint32 n, uint32 counters[n] (LinkStats order)
+
   // Binary blob pipeline
-  CMD_LOAD_BEGIN = 0x10,  // req: uint32 total_len
+  CMD_LOAD_BEGIN = 0x10,  // req: uint32 total_len [, uint32 want_chunk, uint32 want_window [, uint32 codec, uint32 packed_len]]
+                          // resp: int32 status [, uint32 chunk, uint32 window [, uint32 codec]] (windowed when both are sent)
   CMD_LOAD_DATA = 0x11,   // req: raw bytes
-  CMD_LOAD_END = 0x12,    // req: uint32 expected_crc32
+  CMD_LOAD_END = 0x12,    // req: uint32 expected_crc32 (windowed: plain CRC32 of the whole decoded image)
+  CMD_LOAD_WDATA = 0x13,  // req: uint32 chunk_index, uint32 flags (WIN_*), bytes; see WindowRx
+  CMD_QUERY = 0x14,       // req: uint32 kind (CACHE_*), uint32 len, uint32 crc32 [, uint32 flags (QUERY_*)]
+                          // resp: int32 status (ST_OK held, ST_NOT_FOUND), uint32 cached_images, uint32 cached_bytes
+  CMD_LOAD_REF = 0x15,    // req: uint32 kind (CACHE_*), uint32 addr, uint32 len, uint32 crc32 (see "Shared PSRAM")
+                          // resp: int32 status, uint32 len
 
   CMD_EXEC = 0x20,  // req: uint32 argc, int32 argv[argc], uint32 timeout_ms
 
   // Status/mailbox/cancel/reset
-  CMD_STATUS = 0x21,      // req: -
-  CMD_MAILBOX_RD = 0x22,  // req: uint32 max_bytes
+  CMD_STATUS = 0x21,      // req: -; resp: int32 status, uint32 exec_state [, uint32 job_id, int32 job_status, int32 job_result]
+  CMD_MAILBOX_RD = 0x22,  // req: uint32 max_bytes; resp: int32 status, uint32 n, bytes[n] (consumed), uint32 dropped_total
   CMD_CANCEL = 0x23,      // req: -
   CMD_RESET = 0x24,       // req: -
 
+  CMD_EXEC_CACHED = 0x25,  // req: uint32 kind, uint32 len, uint32 crc32, then a CMD_EXEC / CMD_SCRIPT_EXEC request
+                           // resp: as CMD_EXEC / CMD_SCRIPT_EXEC; int32 ST_NOT_FOUND, int32 0 when not held
+  CMD_EXEC_ASYNC = 0x26,   // req: uint32 kind (CACHE_*), then a CMD_EXEC / CMD_SCRIPT_EXEC request
+                           // resp: int32 status, uint32 job_id; the result follows as EVT_JOB_DONE
+  CMD_JOB_SUBMIT = 0x27,   // req: uint32 kind (CACHE_*), uint32 priority, then a CMD_EXEC / CMD_SCRIPT_EXEC request
+                           // resp: int32 status (ST_NOMEM queue full), uint32 job_id (see "Job queue")
+  CMD_RESULTS = 0x28,      // req: uint32 max_results; resp: int32 status, uint32 n, uint32 dropped_total,
+                           //       uint32 pending, n x (uint32 job_id, int32 status, int32 result), oldest first
+
   // Script pipeline
-  CMD_SCRIPT_BEGIN = 0x30,  // req: uint32 total_len
+  CMD_SCRIPT_BEGIN = 0x30,  // req/resp: as CMD_LOAD_BEGIN
   CMD_SCRIPT_DATA = 0x31,   // req: raw bytes (UTF-8 text)
   CMD_SCRIPT_END = 0x32,    // req: uint32 expected_crc32
   CMD_SCRIPT_EXEC = 0x33,   // req: uint32 argc, int32 argv[argc], uint32 timeout_ms
                             //       (alternate mode supported by impl: marker 0xFFFFFFFF + ASCII args)
+  CMD_SCRIPT_WDATA = 0x34,  // req: as CMD_LOAD_WDATA
 
   // Named function dispatch
   CMD_FUNC = 0x40,  // req: uint32 name_len, bytes[name_len], uint32 argc,
@@ -51,10 +97,17 @@ enum : uint16_t {
                     //        either classic: int32 argv[argc]
                     //        or alternate: uint32 marker=0xFFFFFFFF, then for each arg: uint32 slen, bytes[slen] (ASCII numeric)
                     // resp: int32 status, int32 result
+  CMD_FUNC_LIST = 0x41,   // req: uint32 first_id, uint32 max_bytes
+                          // resp: int32 status, uint32 table_crc, uint32 total, uint32 n, n x FuncListEntry
+  CMD_FUNC_BATCH = 0x42,  // req: uint32 table_crc, uint32 count, count x (uint16 id, uint16 argc, int32 argv[argc])
+                          // resp: int32 status, uint32 n_done, int32 results[n_done]
 
   // ISP control
   CMD_ISP_ENTER = 0x60,  // req: -
-  CMD_ISP_EXIT = 0x61    // req: -
+  CMD_ISP_EXIT = 0x61,   // req: -
+
+  // Co-processor -> host only: header cmd = CMD_EVENT | 0x80, seq = event counter, never a reply
+  CMD_EVENT = 0x7F  // payload: uint32 type (EVT_*), then the fields listed for that type
 };
 
 // Status
@@ -69,7 +122,8 @@ enum : int32_t {
   ST_SIZE = -7,
   ST_CRC = -8,
   ST_TIMEOUT = -9,
-  ST_EXEC = -10
+  ST_EXEC = -10,
+  ST_NOT_FOUND = -11
 };
 
 // ========== Frame header ==========
@@ -96,14 +150,9 @@ inline void makeResponseHeader(Frame& h, uint16_t reqCmd, uint32_t seq, uint32_t
 }
 
 // ========== CRC32 (IEEE 802.3) ==========
+// 'crc' is the raw register (0xFFFFFFFF to start); the result is finalized. See Crc32.h.
 inline uint32_t crc32_ieee(const void* data, size_t len, uint32_t crc = 0xFFFFFFFFu) {
-  const uint8_t* p = (const uint8_t*)data;
-  while (len--) {
-    uint32_t c = (crc ^ *p++) & 0xFFu;
-    for (int i = 0; i < 8; ++i) c = (c >> 1) ^ (0xEDB88320u & (-(int)(c & 1u)));
-    crc = (crc >> 8) ^ c;
-  }
-  return crc ^ 0xFFFFFFFFu;
+  return Crc32::update(crc, data, len) ^ 0xFFFFFFFFu;
 }
 
 // ========== Small PODs ==========
@@ -112,7 +161,7 @@ struct Info {
   // impl_flags bits:
   //   bit0: blob_loaded
   //   bit1: exec_running
-  //   bit2: mailbox_nonempty
+  //   bit2: mailbox_nonempty (unread ring bytes)
   //   bit8: isp_active (if supported and currently in ISP mode)
   uint32_t impl_flags;
   uint32_t blob_len;     // bytes loaded
@@ -155,6 +204,214 @@ inline bool readBytes(const uint8_t* src, size_t len, size_t& off, void* p, size
   return true;
 }
 
+// ========== Windowed DATA transfer ==========
+// The image is split into fixed 'chunk' byte pieces (the last may be shorter); frame i carries
+// chunk i, so retransmissions and reordering are harmless. A *_WDATA frame gets a reply only when
+// it has WIN_ACK_REQ set (a frame with no bytes is a pure ACK poll); corrupt frames are dropped
+// silently and show up as NAK bits.
+// ACK reply: int32 status, uint32 ack, uint32 nak_mask, uint32 high
+//   ack       chunks [0, ack) are stored
+//   nak_mask  bit i: chunk ack+i is missing although a later chunk arrived
+//   high      one past the highest chunk received; the sender resends [high, next) as well
+enum : uint32_t {
+  WIN_ACK_REQ = 1u << 0,
+};
+static constexpr uint32_t WIN_MAX = 32;        // frames in flight (width of nak_mask)
+static constexpr uint32_t WIN_HDR_BYTES = 8;   // chunk_index + flags in front of the data
+
+inline bool isWindowedData(uint16_t cmd) {
+  return cmd == CMD_LOAD_WDATA || cmd == CMD_SCRIPT_WDATA;
+}
+
+// ========== Compressed uploads ==========
+// HELLO 'features' bit 16: *_BEGIN accepts codec + packed_len after the window words. total_len stays
+// the decoded size; chunks then index the packed stream and are decoded strictly in order, so an
+// out-of-order chunk is dropped (it is resent after the ACK, like a lost one). The reply echoes the
+// codec when it was accepted; without the echo the sender falls back to raw *_WDATA.
+enum : uint32_t {
+  FEAT_LZ4 = 1u << 16,
+};
+enum : uint32_t {
+  CODEC_NONE = 0,
+  CODEC_LZ4 = 1,  // LZ4 block format
+};
+
+// Receiver bookkeeping: the destination buffer holds the whole image, so chunks land in place.
+struct WindowRx {
+  uint8_t* dst = nullptr;
+  uint32_t total = 0;
+  uint32_t chunk = 0;  // 0 = no windowed transfer in progress
+  uint32_t nChunks = 0;
+  uint32_t base = 0;  // chunks [0, base) stored
+  uint32_t mask = 0;  // bit i: chunk base+i stored
+  uint32_t high = 0;
+
+  void start(uint8_t* d, uint32_t t, uint32_t c) {
+    dst = d;
+    total = t;
+    chunk = c;
+    nChunks = c ? (t + c - 1) / c : 0;
+    base = mask = high = 0;
+  }
+  void reset() {
+    start(nullptr, 0, 0);
+  }
+  uint32_t chunkLen(uint32_t idx) const {
+    return (idx == nChunks - 1) ? total - idx * chunk : chunk;
+  }
+  bool accept(uint32_t idx, const uint8_t* data, uint32_t n) {
+    if (!chunk || !dst || idx >= nChunks) return false;
+    if (n != chunkLen(idx)) return false;
+    if (idx < base) return true;  // duplicate of a stored chunk
+    if (idx - base >= WIN_MAX) return false;
+    uint32_t bit = 1u << (idx - base);
+    if (!(mask & bit)) {
+      memcpy(dst + idx * chunk, data, n);
+      mask |= bit;
+    }
+    if (idx + 1 > high) high = idx + 1;
+    while (mask & 1u) {
+      mask >>= 1;
+      ++base;
+    }
+    return true;
+  }
+  // In-order mode (compressed streams, dst == nullptr): the caller consumes chunk 'base' itself
+  bool isNext(uint32_t idx, uint32_t n) const {
+    return chunk && idx == base && idx < nChunks && n == chunkLen(idx);
+  }
+  void advance() {
+    if (++base > high) high = base;
+  }
+  bool done() const {
+    return chunk && base == nChunks;
+  }
+  uint32_t stored() const {
+    uint32_t b = base * chunk;
+    return b < total ? b : total;
+  }
+  uint32_t holes() const {
+    uint32_t span = (high > base) ? high - base : 0;
+    uint32_t m = (span >= 32) ? 0xFFFFFFFFu : ((1u << span) - 1u);
+    return m & ~mask;
+  }
+};
+
+// ========== Link speed ==========
+// HELLO 'features' bit 17: the co-processor takes LINK_* requests. LINK_BAUD is answered at the
+// current rate, then the co-processor switches and starts a trial of trial_ms; it falls back to the
+// last committed rate unless LINK_COMMIT arrives at the new rate before the trial ends. LINK_ECHO
+// works at any time and is what the host uses to prove a rate before committing it.
+enum : uint32_t {
+  FEAT_LINK_BAUD = 1u << 17,
+};
+
+// ========== Content cache ==========
+// HELLO 'features' bit 18. Images are keyed by (kind, length, CRC32 of the whole decoded image); the
+// co-processor keeps the current blob and script plus a few recently replaced ones. QUERY with
+// QUERY_SELECT makes a held image current, exactly as if it had just been uploaded.
+enum : uint32_t {
+  FEAT_CACHE = 1u << 18,
+};
+enum : uint32_t {
+  CACHE_BLOB = 0,
+  CACHE_SCRIPT = 1,
+};
+enum : uint32_t {
+  QUERY_SELECT = 1u << 0,
+};
+
+// ========== Async ==========
+// HELLO 'features' bit 19. EXEC_ASYNC queues the current blob or script on core1 and replies with a
+// job id; the protocol loop keeps serving requests meanwhile (STATUS reports the last job as well).
+// Events are opt-in per type with SUBSCRIBE (HELLO clears the mask) and only go out between replies
+// while the link is idle, so they never split a reply.
+//   EVT_JOB_DONE  uint32 job_id, int32 status, int32 result
+//   EVT_MAILBOX   uint32 bytes_ready; sent once when the ring gains data, re-armed by MAILBOX_RD
+//   EVT_ERROR     int32 status, uint32 cmd, uint32 seq of a request that was dropped without a reply
+//                 (seq 0xFFFFFFFF when the header itself was lost)
+enum : uint32_t {
+  FEAT_ASYNC = 1u << 19,
+};
+enum : uint32_t {
+  EVT_JOB_DONE = 1u << 0,
+  EVT_MAILBOX = 1u << 1,
+  EVT_ERROR = 1u << 2,
+};
+
+// ========== FUNC by ID ==========
+// HELLO 'features' bit 20. Ids are registry slots, fixed for as long as the firmware runs; table_crc
+// covers every id, name and argc, so a FUNC_BATCH built against another table (the co-processor was
+// reflashed or registered more functions) fails with ST_STATE before anything runs. A batch stops
+// at the first call that fails; status is that call's error and n_done counts the calls that ran.
+// FuncListEntry: uint16 id, int8 expected_argc (-1 = any), uint8 name_len, name bytes (no NUL)
+enum : uint32_t {
+  FEAT_FUNC_BATCH = 1u << 20,
+};
+static constexpr uint32_t FUNC_NAME_MAX = 128;
+
+// ========== Job queue ==========
+// HELLO 'features' bit 22. JOB_SUBMIT snapshots the current blob or script by (kind, len, CRC32) and
+// queues the run; core1 takes the highest priority first, submit order within one priority. The
+// image may be replaced right after the reply: the old one moves to the content cache, and one that
+// is already running stays alive until it returns. A job whose image was evicted before it started
+// finishes with ST_NOT_FOUND. Every async job (EXEC_ASYNC too) ends in a fixed ring of results that
+// RESULTS drains; when nobody drains it the oldest are overwritten and counted in dropped_total.
+// EVT_JOB_DONE is still sent per job to subscribers. 'pending' counts queued plus running jobs.
+enum : uint32_t {
+  FEAT_JOB_QUEUE = 1u << 22,
+};
+
+// ========== Shared PSRAM ==========
+// HELLO 'features' bit 21. Both MCUs reach one PSRAM through the SPI bus arbiter. The main MCU writes
+// an image into [SHARED_REF_BASE, SHARED_REF_BASE + SHARED_REF_SIZE) under an arbiter lease, releases
+// the bus and sends LOAD_REF; the co-processor takes its own lease, copies the bytes into RAM and
+// checks the CRC before the image becomes current (the PSRAM is an SPI device, not mapped memory, so
+// nothing runs from it in place). The window is fixed at build time on both sides; the main MCU keeps
+// its own PSRAM data (e.g. a SimpleFS) below it and does not touch it until the LOAD_REF reply.
+#ifndef COPROC_SHARED_BASE
+#define COPROC_SHARED_BASE 0x700000u  // last 1 MiB of an 8 MiB APS6404
+#endif
+#ifndef COPROC_SHARED_SIZE
+#define COPROC_SHARED_SIZE 0x100000u
+#endif
+enum : uint32_t {
+  FEAT_LOAD_REF = 1u << 21,
+};
+static constexpr uint32_t SHARED_REF_BASE = COPROC_SHARED_BASE;
+static constexpr uint32_t SHARED_REF_SIZE = COPROC_SHARED_SIZE;
+static inline bool sharedRefValid(uint32_t addr, uint32_t len) {
+  return len && addr >= SHARED_REF_BASE && len <= SHARED_REF_SIZE && addr - SHARED_REF_BASE <= SHARED_REF_SIZE - len;
+}
+
+// ========== Link statistics ==========
+// HELLO 'features' bit 23. Each end counts what its framing layer saw since boot or the last
+// STATS_RESET. STATS sends the counters as n x uint32 in field order, so fields can be appended
+// without breaking an older host (it reads the first n it knows).
+struct LinkStats {
+  uint32_t frames_rx;
+  uint32_t frames_tx;  // events included
+  uint32_t bytes_rx;
+  uint32_t bytes_tx;
+  uint32_t crc_errors;  // payload CRC did not match the header
+  uint32_t resyncs;  // a header was found only after skipping bytes on the magic scan
+  uint32_t skipped;  // bytes skipped by those scans
+  uint32_t timeouts;  // frame cut off mid-way, or no reply in time
+  uint32_t bad_headers;  // magic found, but version or length rejected
+};
+static constexpr uint32_t STATS_FIELDS = sizeof(LinkStats) / sizeof(uint32_t);
+enum : uint32_t {
+  FEAT_STATS = 1u << 23,
+};
+enum : uint32_t {
+  STATS_RESET = 1u << 0,  // zero the counters after this reply
+};
+static inline const char* statsFieldName(uint32_t i) {
+  static const char* const names[STATS_FIELDS] = { "frames_rx", "frames_tx", "bytes_rx", "bytes_tx", "crc_errors",
+                                                   "resyncs", "skipped", "timeouts", "bad_headers" };
+  return i < STATS_FIELDS ? names[i] : "?";
+}
+
 // ========== Exec state flags ==========
 enum : uint32_t {
   EXEC_IDLE = 0,
@@ -0,0 +1,168 @@
+#pragma once
+/*
+  CoProcShared.h
+  Shared-PSRAM window behind CMD_LOAD_REF (see "Shared PSRAM" in CoProcProto.h).
+  - SharedMem: byte access to the PSRAM both MCUs can reach, plus the bus lease that makes it safe.
+    acquire/release nest like ExternalArbiter; Lease is the scoped form.
+      MemDeviceShared  a UnifiedSpiMem::MemDevice (the shared PSRAM) under UnifiedSpiMem::ExternalArbiter
+      SimSharedMem     file-backed stand-in for host-side tests (not on Arduino builds). flock() on the
+                       file plays the arbiter, so two processes, or two objects opened on the same file
+                       in one process, contend for the bus the way the two MCUs do.
+  - sharedStage(): main MCU side. Copies an image into the window under one lease and returns its CRC32.
+*/
+#include <stdint.h>
+#include <stddef.h>
+#include "CoProcProto.h"
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#include "UnifiedSPIMem.h"
+#elif defined(__linux__)
+#include <chrono>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#endif
+
+#ifndef COPROC_SHARED_LEASE_MS
+#define COPROC_SHARED_LEASE_MS 1000  // wait for the bus grant before giving up
+#endif
+
+namespace CoProc {
+
+class SharedMem {
+public:
+  virtual ~SharedMem() {}
+  virtual bool acquire(uint32_t timeoutMs) = 0;
+  virtual void release() = 0;
+  virtual bool read(uint32_t addr, uint8_t* dst, size_t n) = 0;
+  virtual bool write(uint32_t addr, const uint8_t* src, size_t n) = 0;
+  virtual const char* name() const = 0;
+
+  struct Lease {
+    SharedMem& m;
+    bool ok;
+    Lease(SharedMem& mem, uint32_t timeoutMs = COPROC_SHARED_LEASE_MS)
+      : m(mem), ok(mem.acquire(timeoutMs)) {}
+    ~Lease() {
+      if (ok) m.release();
+    }
+  };
+};
+
+#if defined(ARDUINO)
+class MemDeviceShared : public SharedMem {
+public:
+  explicit MemDeviceShared(UnifiedSpiMem::MemDevice* dev = nullptr)
+    : _dev(dev) {}
+  void setDevice(UnifiedSpiMem::MemDevice* dev) {
+    _dev = dev;
+  }
+  UnifiedSpiMem::MemDevice* device() const {
+    return _dev;
+  }
+  bool acquire(uint32_t timeoutMs) override {
+    return _dev && UnifiedSpiMem::ExternalArbiter::acquire(timeoutMs);
+  }
+  void release() override {
+    UnifiedSpiMem::ExternalArbiter::release();
+  }
+  bool read(uint32_t addr, uint8_t* dst, size_t n) override {
+    return _dev && (uint64_t)addr + n <= _dev->capacity() && _dev->read(addr, dst, n) == n;
+  }
+  bool write(uint32_t addr, const uint8_t* src, size_t n) override {
+    return _dev && (uint64_t)addr + n <= _dev->capacity() && _dev->write(addr, src, n);
+  }
+  const char* name() const override {
+    return "psram";
+  }
+
+private:
+  UnifiedSpiMem::MemDevice* _dev;
+};
+#endif
+
+#if !defined(ARDUINO) && defined(__linux__)
+class SimSharedMem : public SharedMem {
+public:
+  ~SimSharedMem() {
+    close();
+  }
+  // The file is grown (sparse) to cover the window
+  bool open(const char* path) {
+    close();
+    _fd = ::open(path, O_RDWR | O_CREAT, 0644);
+    if (_fd < 0) return false;
+    struct stat s;
+    const off_t need = (off_t)SHARED_REF_BASE + SHARED_REF_SIZE;
+    if (::fstat(_fd, &s) != 0 || (s.st_size < need && ::ftruncate(_fd, need) != 0)) {
+      close();
+      return false;
+    }
+    return true;
+  }
+  void close() {
+    if (_fd >= 0) ::close(_fd);
+    _fd = -1;
+    _depth = 0;
+  }
+  bool acquire(uint32_t timeoutMs) override {
+    if (_fd < 0) return false;
+    if (_depth) {
+      ++_depth;
+      return true;
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    while (::flock(_fd, LOCK_EX | LOCK_NB) != 0) {
+      if (timeoutMs && std::chrono::steady_clock::now() - t0 > std::chrono::milliseconds(timeoutMs)) return false;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    _depth = 1;
+    return true;
+  }
+  void release() override {
+    if (_depth == 0) return;
+    if (--_depth == 0) ::flock(_fd, LOCK_UN);
+  }
+  bool held() const {
+    return _depth != 0;
+  }
+  bool read(uint32_t addr, uint8_t* dst, size_t n) override {
+    return _fd >= 0 && ::pread(_fd, dst, n, (off_t)addr) == (ssize_t)n;
+  }
+  bool write(uint32_t addr, const uint8_t* src, size_t n) override {
+    return _fd >= 0 && ::pwrite(_fd, src, n, (off_t)addr) == (ssize_t)n;
+  }
+  const char* name() const override {
+    return "sim";
+  }
+
+private:
+  int _fd = -1;
+  uint32_t _depth = 0;
+};
+#endif
+
+// Main MCU: write 'len' bytes from fetch() to SHARED_REF_BASE and return their CRC32.
+// The lease is held for the whole copy and dropped before returning, so the co-processor can take it.
+typedef bool (*SharedFetch)(void* ctx, uint32_t off, uint8_t* dst, uint32_t n);
+static inline bool sharedStage(SharedMem& m, uint32_t len, SharedFetch fetch, void* ctx, uint32_t& crcOut,
+                               uint32_t timeoutMs = COPROC_SHARED_LEASE_MS) {
+  if (!sharedRefValid(SHARED_REF_BASE, len)) return false;
+  SharedMem::Lease lease(m, timeoutMs);
+  if (!lease.ok) return false;
+  uint8_t buf[256];
+  uint32_t c = 0xFFFFFFFFu;
+  for (uint32_t off = 0; off < len;) {
+    uint32_t n = (len - off > sizeof(buf)) ? (uint32_t)sizeof(buf) : len - off;
+    if (!fetch(ctx, off, buf, n) || !m.write(SHARED_REF_BASE + off, buf, n)) return false;
+    c = Crc32::update(c, buf, n);
+    off += n;
+  }
+  crcOut = c ^ 0xFFFFFFFFu;
+  return true;
+}
+
+}  // namespace CoProc
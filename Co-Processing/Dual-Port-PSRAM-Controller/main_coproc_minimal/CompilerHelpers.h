@@ -1,4 +1,4 @@
-// ========== Compile Tiny-C source file -> raw Thumb binary on FS ==========
+// ========== Compile Tiny-C source file -> raw Thumb/Xtensa binary on FS ==========
 static void printCompileErrorContext(const char* src, size_t srcLen, size_t pos) {
   const size_t CONTEXT = 40;
   if (!src || srcLen == 0) return;
@@ -16,8 +16,33 @@ static void printCompileErrorContext(const char* src, size_t srcLen, size_t pos)
   Console.println("^");
   Console.println("-------------------");
 }
-static bool compileTinyCFileToFile(const char* srcName, const char* dstName) {
+static void printCompileStats(const MCCompiler::Result& base, const MCCompiler::Result& opt, MCCompiler::Target target) {
+  if (!base.ok) return;
+  Console.print("compile: -O0 ");
+  Console.print((uint32_t)base.stats.codeBytes);
+  Console.print("+");
+  Console.print((uint32_t)base.stats.poolBytes);
+  Console.print(" bytes ~");
+  Console.print((uint32_t)base.stats.cycles);
+  Console.print(" cyc -> -O ");
+  Console.print((uint32_t)opt.stats.codeBytes);
+  Console.print("+");
+  Console.print((uint32_t)opt.stats.poolBytes);
+  Console.print(" bytes ~");
+  Console.print((uint32_t)opt.stats.cycles);
+  Console.print(" cyc (code+pool, static ");
+  Console.print(MCCompiler::targetName(target));
+  Console.println(" estimate)");
+}
+// targetArg: "thumb1" / "thumb2" / "xtensa", nullptr = the core this sketch runs on
+static bool compileTinyCFileToFile(const char* srcName, const char* dstName, const char* targetArg) {
   if (!checkNameLen(srcName) || !checkNameLen(dstName)) return false;
+  MCCompiler::Target target;
+  if (targetArg && !MCCompiler::parseTarget(targetArg, target)) {
+    Console.print("compile: unknown target: ");
+    Console.println(targetArg);
+    return false;
+  }
   if (!activeFs.exists(srcName)) {
     Console.print("compile: source not found: ");
     Console.println(srcName);
@@ -50,9 +75,23 @@ static bool compileTinyCFileToFile(const char* srcName, const char* dstName) {
     free(srcBuf);
     return false;
   }
-  MCCompiler comp;
+  // ~35 KB of AST/codegen tables: keep the compiler off the stack
+  MCCompiler* comp = new (std::nothrow) MCCompiler();
+  if (!comp) {
+    Console.println("compile: out of memory for compiler");
+    free(outBuf);
+    free(srcBuf);
+    return false;
+  }
+  if (targetArg) comp->setTarget(target);
+  target = comp->target();
   size_t outSize = 0;
-  MCCompiler::Result r = comp.compile(srcBuf, srcSize, outBuf, outCap, &outSize);
+  // Unoptimized pass only feeds the before/after report
+  comp->setOptions(MCCompiler::Options::none());
+  MCCompiler::Result base = comp->compile(srcBuf, srcSize, outBuf, outCap, &outSize);
+  comp->setOptions(MCCompiler::Options());
+  MCCompiler::Result r = comp->compile(srcBuf, srcSize, outBuf, outCap, &outSize);
+  delete comp;
   if (!r.ok) {
     Console.print("compile: error at pos ");
     Console.print((uint32_t)r.errorPos);
@@ -70,8 +109,11 @@ static bool compileTinyCFileToFile(const char* srcName, const char* dstName) {
     Console.print(dstName);
     Console.print(" (");
     Console.print((uint32_t)outSize);
-    Console.println(" bytes)");
-    if (outSize & 1u) {
+    Console.print(" bytes, ");
+    Console.print(MCCompiler::targetName(target));
+    Console.println(")");
+    printCompileStats(base, r, target);
+    if ((outSize & 1u) && target != MCCompiler::TARGET_XTENSA) {
       Console.println("note: odd-sized output; for Thumb execution, even size is recommended.");
     }
   } else {
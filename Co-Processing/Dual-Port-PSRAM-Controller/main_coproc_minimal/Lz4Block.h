@@ -0,0 +1,210 @@
+#pragma once
+/*
+  Lz4Block.h
+  LZ4 block format (no frame header, no checksum) for compressed blob/script uploads.
+  - compress(): greedy single-pass encoder with a 4096-entry hash table supplied by the caller
+    (16 KB). Output follows the LZ4 block rules (last 5 bytes literal, last match starts at least
+    12 bytes before the end), so standard LZ4 decoders accept it.
+  - Decoder: streaming, fed arbitrary slices of the compressed stream in order, writing straight
+    into the final buffer. Matches copy from already decoded output, so the only "window" is the
+    destination itself and the decoder state is a few words.
+  Plain C++, no Arduino dependency.
+*/
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace Lz4 {
+
+static constexpr uint32_t MIN_MATCH = 4;
+static constexpr uint32_t LAST_LITERALS = 5;
+static constexpr uint32_t MF_LIMIT = 12;
+static constexpr uint32_t MAX_OFFSET = 65535;
+static constexpr uint32_t HASH_LOG = 12;
+static constexpr uint32_t HASH_ENTRIES = 1u << HASH_LOG;
+
+// Worst case output size for 'n' input bytes (incompressible data)
+static inline uint32_t bound(uint32_t n) {
+  return n + n / 255u + 16u;
+}
+
+static inline uint32_t read32(const uint8_t* p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+static inline uint32_t hash4(uint32_t v) {
+  return (v * 2654435761u) >> (32 - HASH_LOG);
+}
+
+// Returns the compressed size, or 0 if it does not fit in 'cap'. 'table' holds HASH_ENTRIES words.
+static inline uint32_t compress(const uint8_t* src, uint32_t n, uint8_t* dst, uint32_t cap, uint32_t* table) {
+  uint32_t o = 0;
+  auto put = [&](uint8_t b) -> bool {
+    if (o >= cap) return false;
+    dst[o++] = b;
+    return true;
+  };
+  auto putLen = [&](uint32_t v) -> bool {  // length continuation bytes after a nibble of 15
+    for (; v >= 255u; v -= 255u)
+      if (!put(255)) return false;
+    return put((uint8_t)v);
+  };
+  auto putLiterals = [&](uint32_t from, uint32_t len) -> bool {
+    if (o + len > cap) return false;
+    memcpy(dst + o, src + from, len);
+    o += len;
+    return true;
+  };
+
+  uint32_t anchor = 0;
+  if (n >= MF_LIMIT + 1) {
+    for (uint32_t i = 0; i < HASH_ENTRIES; ++i) table[i] = 0xFFFFFFFFu;
+    const uint32_t limit = n - MF_LIMIT;
+    const uint32_t matchEnd = n - LAST_LITERALS;
+    uint32_t ip = 0;
+    while (ip < limit) {
+      uint32_t seq = read32(src + ip);
+      uint32_t h = hash4(seq);
+      uint32_t ref = table[h];
+      table[h] = ip;
+      if (ref == 0xFFFFFFFFu || ip - ref > MAX_OFFSET || read32(src + ref) != seq) {
+        ip += 1u + ((ip - anchor) >> 6);  // skip faster through incompressible runs
+        continue;
+      }
+      uint32_t mlen = MIN_MATCH;
+      while (ip + mlen < matchEnd && src[ref + mlen] == src[ip + mlen]) ++mlen;
+
+      uint32_t lit = ip - anchor;
+      uint32_t ml = mlen - MIN_MATCH;
+      if (!put((uint8_t)(((lit < 15u ? lit : 15u) << 4) | (ml < 15u ? ml : 15u)))) return 0;
+      if (lit >= 15u && !putLen(lit - 15u)) return 0;
+      if (!putLiterals(anchor, lit)) return 0;
+      uint32_t dist = ip - ref;
+      if (!put((uint8_t)dist) || !put((uint8_t)(dist >> 8))) return 0;
+      if (ml >= 15u && !putLen(ml - 15u)) return 0;
+
+      ip += mlen;
+      anchor = ip;
+      if (ip - 2u < limit) table[hash4(read32(src + ip - 2u))] = ip - 2u;
+    }
+  }
+  uint32_t lit = n - anchor;
+  if (!put((uint8_t)((lit < 15u ? lit : 15u) << 4))) return 0;
+  if (lit >= 15u && !putLen(lit - 15u)) return 0;
+  if (!putLiterals(anchor, lit)) return 0;
+  return o;
+}
+
+// Streaming decoder: start() with the destination and the exact decoded size, then feed() the
+// compressed stream in order. done() once the output is complete; any malformed input is sticky.
+struct Decoder {
+  enum : uint8_t { TOKEN, LIT_LEN, LITERALS, OFF_LO, OFF_HI, MATCH_LEN, DONE, FAILED };
+  uint8_t* dst = nullptr;  // nullptr = not in use
+  uint32_t cap = 0;
+  uint32_t pos = 0;
+  uint32_t lit = 0;
+  uint32_t mlen = 0;
+  uint32_t offset = 0;
+  uint8_t state = TOKEN;
+
+  void start(uint8_t* d, uint32_t decodedLen) {
+    dst = d;
+    cap = decodedLen;
+    pos = lit = mlen = offset = 0;
+    state = TOKEN;
+  }
+  void reset() {
+    start(nullptr, 0);
+  }
+  bool active() const {
+    return dst != nullptr;
+  }
+  bool done() const {
+    return state == DONE;
+  }
+  bool failed() const {
+    return state == FAILED;
+  }
+  uint32_t produced() const {
+    return pos;
+  }
+
+  bool feed(const uint8_t* p, uint32_t n) {
+    if (!dst) return false;
+    while (n && state != FAILED) {
+      switch (state) {
+        case TOKEN:
+          lit = *p >> 4;
+          mlen = (*p & 15u) + MIN_MATCH;
+          ++p, --n;
+          state = (lit == 15u) ? LIT_LEN : LITERALS;
+          if (lit == 0) endLiterals();
+          break;
+        case LIT_LEN:
+          lit += *p;
+          if (*p != 255) state = LITERALS;
+          ++p, --n;
+          break;
+        case LITERALS:
+          {
+            uint32_t take = (lit < n) ? lit : n;
+            if (take > cap - pos) {
+              state = FAILED;
+              break;
+            }
+            memcpy(dst + pos, p, take);
+            pos += take, p += take, n -= take, lit -= take;
+            if (lit == 0) endLiterals();
+            break;
+          }
+        case OFF_LO:
+          offset = *p++, --n;
+          state = OFF_HI;
+          break;
+        case OFF_HI:
+          offset |= (uint32_t)*p++ << 8, --n;
+          if (offset == 0 || offset > pos) {
+            state = FAILED;
+          } else if (mlen == 15u + MIN_MATCH) {
+            state = MATCH_LEN;
+          } else {
+            copyMatch();
+          }
+          break;
+        case MATCH_LEN:
+          mlen += *p;
+          if (*p++ != 255) copyMatch();
+          --n;
+          break;
+        default:  // DONE: trailing bytes
+          state = FAILED;
+          break;
+      }
+    }
+    return state != FAILED;
+  }
+
+private:
+  // Literal run finished: the stream ends here when the output is complete, else an offset follows
+  void endLiterals() {
+    state = (pos == cap) ? DONE : OFF_LO;
+  }
+  void copyMatch() {
+    if (mlen > cap - pos) {
+      state = FAILED;
+      return;
+    }
+    uint8_t* d = dst + pos;
+    const uint8_t* s = d - offset;
+    if (offset >= mlen) {
+      memcpy(d, s, mlen);
+    } else {
+      for (uint32_t i = 0; i < mlen; ++i) d[i] = s[i];  // overlapping run
+    }
+    pos += mlen;
+    state = (pos == cap) ? DONE : TOKEN;
+  }
+};
+
+}  // namespace Lz4
@@ -1,4 +1,6 @@
 // ==================== Minimal ZMODEM receiver (rz-lite, HEX+BIN32) ====================
+#include "Crc32.h"
+
 namespace ZModem {
 // ZMODEM constants
 static constexpr uint8_t ZPAD = 0x2A;  // '*'
@@ -29,16 +31,6 @@ static constexpr uint32_t CANFC32 = 0x0001;
 static constexpr uint32_t ESCCTL = 0x0002;
 static constexpr uint32_t ESC8 = 0x0008;
 
-// CRC-32 (IEEE)
-static inline uint32_t crc32_update(uint32_t c, uint8_t b) {
-  c ^= b;
-  for (int i = 0; i < 8; ++i) c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
-  return c;
-}
-static inline uint32_t crc32(const uint8_t* p, size_t n, uint32_t c = 0xFFFFFFFFu) {
-  for (size_t i = 0; i < n; ++i) c = crc32_update(c, p[i]);
-  return ~c;
-}
 // CRC-16/CCITT (ZMODEM header CRC when HEX/BIN16)
 static inline uint16_t crc16_ccitt_update(uint16_t c, uint8_t b) {
   c ^= (uint16_t)b << 8;
@@ -130,7 +122,7 @@ static void sendHeaderBin32(uint8_t type, uint32_t p0) {
     (uint8_t)((p0 >> 16) & 0xFF),
     (uint8_t)((p0 >> 24) & 0xFF)
   };
-  uint32_t c = crc32(hdr, 5);
+  uint32_t c = Crc32::compute(hdr, 5);
   auto we = [](uint8_t b) {
     if (b == ZDLE || b < 0x20 || b == 0x7F) {
       Serial.write(ZDLE);
@@ -17,7 +17,9 @@
 #include "rp_selfupdate.h"
 #include <SoftwareSerial.h>
 #include "CoProcProto.h"
+#include "CoProcLink.h"
 #include "CoProcLang.h"
+#include "CoProcFuncRegistry.h"
 // MCP4921 DAC
 #include "MCP_DAC.h"
 //MCP4921 MCP(19, 18);  //  SW SPI
@@ -46,7 +48,23 @@ static const uint8_t PWM_AUDIO_PIN = 3;  // GP3 default; adjust if needed
 //#define SOFT_BAUD 115200
 #define SOFT_BAUD 57600
 #endif
-static SoftwareSerial coproclink(PIN_RX, PIN_TX, false);  // RX, TX, non-inverted
+#ifndef COPROC_LINK_MAX_BAUD
+#define COPROC_LINK_MAX_BAUD 921600  // highest rate LINK_BAUD accepts
+#endif
+// Transport: 0 = SoftwareSerial, 1 = hardware UART0 (Serial1), 2 = PIO UART; must match the main side
+#ifndef COPROC_LINK
+#define COPROC_LINK 0
+#endif
+#if COPROC_LINK == 1
+// UART0 only has TX on GP0 and RX on GP1: both boards swap roles, the crossed wires stay as they are
+static CoProc::UartLink coproclink(Serial1, PIN_RX /*TX*/, PIN_TX /*RX*/);
+#elif COPROC_LINK == 2
+static CoProc::PioUartLink coproclink(PIN_TX, PIN_RX, 512);
+#else
+static SoftwareSerial coprocSerial(PIN_RX, PIN_TX, false);  // RX, TX, non-inverted
+static CoProc::SoftSerialLink coproclink(coprocSerial);
+#endif
+static CoProc::LinkResponder g_linkResp(coproclink, COPROC_LINK_MAX_BAUD);
 static SoftwareSerial auxlink(8, 9, false);               // RX, TX, non-inverted
 struct WavInfo {
   uint32_t dataOffset = 0;
@@ -387,6 +405,7 @@ static inline uint32_t getEraseAlignFor(StorageBackend b) {
 #include "Base64Utils.h"
 #include "InputHelper.h"
 #include "CrossFSUtils.h"
+#include "rp_selfupdate_fs.h"
 #include "CompilerHelpers.h"
 void performance_test() {
   Console.println();
@@ -729,6 +748,8 @@ static inline void serviceISPIfActive() {
 // ------- Executor and script handling (moved to header-only class) -------
 #include "CoProcExec.h"
 static CoProcExec g_exec;
+static CoProc::LinkStats& g_linkStats = g_exec.linkStats();  // bumped by the framing helpers below
+static CoProc::MemDeviceShared g_shared;  // PSRAM shared with the main MCU (CMD_LOAD_REF)
 // ------- Transport / protocol buffers -------
 static CoProc::Frame g_reqHdr, g_respHdr;
 static uint8_t* g_reqBuf = nullptr;
@@ -1137,6 +1158,67 @@ static bool touchPath(const char* cwd, const char* arg) {
   if (activeFs.exists(path)) return true;
   return activeFs.writeFile(path, /*data*/ nullptr, /*size*/ 0, /*mode*/ 0);
 }
+// Read a digest (sha256sum line or CRC32) from a small manifest file on 'fs'
+static bool readUpdateManifest(const FSIface& fs, const char* name, rpupd_manifest& m) {
+  char text[128];
+  uint32_t n = fs.readFile ? fs.readFile(name, (uint8_t*)text, sizeof(text) - 1) : 0;
+  if (!n) return false;
+  text[n] = 0;
+  return rpupd_manifest_parse(text, m);
+}
+// update [vol:]<file> [digest|manifest] [check]: flash internal firmware from a SimpleFS file after
+// verifying it. Without a digest, <file>.sha256 or <file>.crc32 on the same volume is the manifest.
+static void cmdSelfUpdate(const char* spec, const char* digestArg, bool checkOnly) {
+  StorageBackend b = g_storage;
+  const char* path = spec;
+  if (!parseBackendSpec(spec, b, path)) path = spec;
+  char name[ActiveFS::MAX_NAME + 1];
+  if (!normalizeFsPathCopy(name, sizeof(name), path, false)) {
+    Console.println("update: bad file name");
+    return;
+  }
+  FSIface fs;
+  fillFsIface(b, fs);
+  UnifiedSpiMem::MemDevice* dev = deviceForBackend(b);
+  uint32_t addr = 0, size = 0, cap = 0;
+  if (!dev || !fs.getFileInfo || !fs.getFileInfo(name, addr, size, cap)) {
+    Console.printf("update: %s not found\n", spec);
+    return;
+  }
+  rpupd_manifest m;
+  m.size = size;
+  bool haveDigest = false;
+  if (digestArg) {
+    haveDigest = rpupd_manifest_parse(digestArg, m) || readUpdateManifest(fs, digestArg, m);
+  } else {
+    char mf[ActiveFS::MAX_NAME + 8];
+    snprintf(mf, sizeof(mf), "%s.sha256", name);
+    haveDigest = readUpdateManifest(fs, mf, m);
+    snprintf(mf, sizeof(mf), "%s.crc32", name);
+    haveDigest = readUpdateManifest(fs, mf, m) || haveDigest;
+  }
+  if (!haveDigest) {
+    Console.println("update: no digest (give one, or put <file>.sha256 / <file>.crc32 next to it)");
+    return;
+  }
+  if (g_exec.jobsPending()) {
+    Console.printf("update: st=%d, a job is running or queued on core1\n", (int)CoProc::ST_STATE);
+    return;
+  }
+  Console.printf("update: %s, %u bytes at 0x%08X (%s%s)\n", name, (unsigned)size, (unsigned)addr,
+                 m.has_sha256 ? "sha256" : "", m.has_crc32 ? (m.has_sha256 ? "+crc32" : "crc32") : "");
+  uint32_t t0 = millis();
+  if (checkOnly) {
+    bool ok = rpupd_stream_pass(dev, addr, size, m, false);
+    Console.printf("update: image %s (%u ms)\n", ok ? "OK" : rpupd_last_error, (unsigned)(millis() - t0));
+    return;
+  }
+  Console.println("update: verifying and staging, then flashing; the board restarts when done");
+  rp2040.idleOtherCore();  // core1 runs from flash too
+  rpupd_program_from_device(dev, addr, size, m);  // returns only on failure
+  rp2040.resumeOtherCore();
+  Console.printf("update failed: %s; firmware unchanged (%u ms)\n", rpupd_last_error, (unsigned)(millis() - t0));
+}
 static void printHelp() {
   Console.println("Co-Processor Console Commands (filename max 32 chars):");
   Console.println("  help                         - this help");
@@ -1169,7 +1251,8 @@ static void printHelp() {
   Console.println("  putb64s <file> [expected]    - paste base64; end ESC[201~ / Ctrl-D / '.'");
   Console.println("  hash <file> [sha256]         - print SHA-256 of file");
   Console.println("  sha256 <file>                - alias for 'hash <file>'");
-  Console.println("  cc <src> <dst>               - compile Tiny-C to binary");
+  Console.println("  update [vol:]<file> [digest|manifest] [check] - verify, then flash this MCU from a file");
+  Console.println("  cc <src> <dst> [target]      - compile Tiny-C to binary");
   Console.println("  wav play <file>              - play unsigned 8-bit mono WAV via MCP4921 DAC");
   Console.println("  wav playpwm <file> [pin]     - play unsigned 8-bit mono WAV via PWM (piezo)");
   Console.println("  wav playpwmdac <file>        - play WAV via DAC");
@@ -1857,15 +1940,32 @@ static void handleCommand(char* line) {
     printHexLower(dig, sizeof(dig));
     Serial.write(' ');
     Serial.println(fn);
+  } else if (!strcmp(t0, "update")) {
+    char* spec;
+    char* arg = nullptr;
+    char* opt = nullptr;
+    if (!nextToken(p, spec)) {
+      Console.println("usage: update [flash:|psram:|nand:]<file> [sha256|crc32|manifest file] [check]");
+      return;
+    }
+    (void)nextToken(p, arg);
+    (void)nextToken(p, opt);
+    if (arg && !strcmp(arg, "check")) {
+      opt = arg;
+      arg = nullptr;
+    }
+    cmdSelfUpdate(spec, arg, opt && !strcmp(opt, "check"));
   } else if (!strcmp(t0, "cc")) {
     char* src;
     char* dst;
+    char* target;
     if (!nextToken(p, src) || !nextToken(p, dst)) {
-      Console.println("usage: cc <src> <dst>");
+      Console.println("usage: cc <src> <dst> [thumb1|thumb2|xtensa]");
       Console.println("example: cc myprog.c myprog.bin");
       return;
     }
-    if (!compileTinyCFileToFile(src, dst)) {
+    nextToken(p, target);  // optional; nullptr when absent
+    if (!compileTinyCFileToFile(src, dst, target)) {
       Console.println("cc: failed");
     }
   } else if (!strcmp(t0, "wav")) {
@@ -2025,6 +2125,7 @@ static bool readByte(uint8_t& b, uint32_t timeoutMs) {
       int v = coproclink.read();
       if (v >= 0) {
         b = (uint8_t)v;
+        ++g_linkStats.bytes_rx;
         return true;
       }
     }
@@ -2053,6 +2154,7 @@ static bool writeAll(const uint8_t* src, size_t n, uint32_t timeoutMs) {
     size_t wrote = coproclink.write(src + off, n - off);
     if (wrote > 0) {
       off += wrote;
+      g_linkStats.bytes_tx += (uint32_t)wrote;
       continue;
     }
     if ((millis() - start) > timeoutMs) return false;
@@ -2061,6 +2163,10 @@ static bool writeAll(const uint8_t* src, size_t n, uint32_t timeoutMs) {
   coproclink.flush();
   return true;
 }
+static bool writeHeader(const CoProc::Frame& h) {
+  ++g_linkStats.frames_tx;
+  return writeAll(reinterpret_cast<const uint8_t*>(&h), sizeof(CoProc::Frame), 2000);
+}
 // ------- ISP handlers -------
 static int32_t handleISP_ENTER(const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t& off) {
   (void)in;
@@ -2107,26 +2213,42 @@ static const char* cmdName(uint16_t c) {
   switch (c) {
     case CoProc::CMD_HELLO: return "HELLO";
     case CoProc::CMD_INFO: return "INFO";
+    case CoProc::CMD_LINK_BAUD: return "LINK_BAUD";
+    case CoProc::CMD_LINK_ECHO: return "LINK_ECHO";
+    case CoProc::CMD_LINK_COMMIT: return "LINK_COMMIT";
+    case CoProc::CMD_SUBSCRIBE: return "SUBSCRIBE";
+    case CoProc::CMD_STATS: return "STATS";
     case CoProc::CMD_LOAD_BEGIN: return "LOAD_BEGIN";
     case CoProc::CMD_LOAD_DATA: return "LOAD_DATA";
     case CoProc::CMD_LOAD_END: return "LOAD_END";
+    case CoProc::CMD_LOAD_WDATA: return "LOAD_WDATA";
+    case CoProc::CMD_QUERY: return "QUERY";
+    case CoProc::CMD_LOAD_REF: return "LOAD_REF";
     case CoProc::CMD_EXEC: return "EXEC";
     case CoProc::CMD_STATUS: return "STATUS";
     case CoProc::CMD_MAILBOX_RD: return "MAILBOX_RD";
     case CoProc::CMD_CANCEL: return "CANCEL";
     case CoProc::CMD_RESET: return "RESET";
+    case CoProc::CMD_EXEC_CACHED: return "EXEC_CACHED";
+    case CoProc::CMD_EXEC_ASYNC: return "EXEC_ASYNC";
+    case CoProc::CMD_JOB_SUBMIT: return "JOB_SUBMIT";
+    case CoProc::CMD_RESULTS: return "RESULTS";
     case CoProc::CMD_SCRIPT_BEGIN: return "SCRIPT_BEGIN";
     case CoProc::CMD_SCRIPT_DATA: return "SCRIPT_DATA";
     case CoProc::CMD_SCRIPT_END: return "SCRIPT_END";
     case CoProc::CMD_SCRIPT_EXEC: return "SCRIPT_EXEC";
+    case CoProc::CMD_SCRIPT_WDATA: return "SCRIPT_WDATA";
     case CoProc::CMD_FUNC: return "FUNC";
+    case CoProc::CMD_FUNC_LIST: return "FUNC_LIST";
+    case CoProc::CMD_FUNC_BATCH: return "FUNC_BATCH";
     case CoProc::CMD_ISP_ENTER: return "ISP_ENTER";
     case CoProc::CMD_ISP_EXIT: return "ISP_EXIT";
   }
   return "UNKNOWN";
 }
-// Build response from request (delegates exec/script commands to CoProcExec)
-static void processRequest(const CoProc::Frame& hdr, const uint8_t* payload, CoProc::Frame& respH, uint8_t* respBuf, uint32_t& respLen) {
+// Build response from request (delegates exec/script commands to CoProcExec).
+// Returns false when no reply is due (windowed DATA frames that did not ask for an ACK).
+static bool processRequest(const CoProc::Frame& hdr, const uint8_t* payload, CoProc::Frame& respH, uint8_t* respBuf, uint32_t& respLen) {
   size_t off = 0;
   int32_t st = CoProc::ST_BAD_CMD;
   respLen = 0;
@@ -2137,10 +2259,22 @@ static void processRequest(const CoProc::Frame& hdr, const uint8_t* payload, CoP
   switch (hdr.cmd) {
     case CoProc::CMD_HELLO: st = g_exec.cmdHELLO(g_isp_active, respBuf, RESP_MAX, off); break;
     case CoProc::CMD_INFO: st = g_exec.cmdINFO(g_isp_active, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_LINK_BAUD:
+    case CoProc::CMD_LINK_ECHO:
+    case CoProc::CMD_LINK_COMMIT: st = g_linkResp.handle(hdr.cmd, payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_SUBSCRIBE: st = g_exec.cmdSUBSCRIBE(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_STATS: st = g_exec.cmdSTATS(payload, hdr.len, respBuf, RESP_MAX, off); break;
     case CoProc::CMD_LOAD_BEGIN: st = g_exec.cmdLOAD_BEGIN(payload, hdr.len, respBuf, RESP_MAX, off); break;
     case CoProc::CMD_LOAD_DATA: st = g_exec.cmdLOAD_DATA(payload, hdr.len, respBuf, RESP_MAX, off); break;
     case CoProc::CMD_LOAD_END: st = g_exec.cmdLOAD_END(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_LOAD_WDATA: st = g_exec.cmdLOAD_WDATA(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_QUERY: st = g_exec.cmdQUERY(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_LOAD_REF: st = g_exec.cmdLOAD_REF(payload, hdr.len, respBuf, RESP_MAX, off); break;
     case CoProc::CMD_EXEC: st = g_exec.cmdEXEC(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_EXEC_CACHED: st = g_exec.cmdEXEC_CACHED(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_EXEC_ASYNC: st = g_exec.cmdEXEC_ASYNC(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_JOB_SUBMIT: st = g_exec.cmdJOB_SUBMIT(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_RESULTS: st = g_exec.cmdRESULTS(payload, hdr.len, respBuf, RESP_MAX, off); break;
     case CoProc::CMD_STATUS: st = g_exec.cmdSTATUS(respBuf, RESP_MAX, off); break;
     case CoProc::CMD_MAILBOX_RD: st = g_exec.cmdMAILBOX_RD(payload, hdr.len, respBuf, RESP_MAX, off); break;
     case CoProc::CMD_CANCEL: st = g_exec.cmdCANCEL(respBuf, RESP_MAX, off); break;
@@ -2156,7 +2290,10 @@ static void processRequest(const CoProc::Frame& hdr, const uint8_t* payload, CoP
     case CoProc::CMD_SCRIPT_DATA: st = g_exec.cmdSCRIPT_DATA(payload, hdr.len, respBuf, RESP_MAX, off); break;
     case CoProc::CMD_SCRIPT_END: st = g_exec.cmdSCRIPT_END(payload, hdr.len, respBuf, RESP_MAX, off); break;
     case CoProc::CMD_SCRIPT_EXEC: st = g_exec.cmdSCRIPT_EXEC(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_SCRIPT_WDATA: st = g_exec.cmdSCRIPT_WDATA(payload, hdr.len, respBuf, RESP_MAX, off); break;
     case CoProc::CMD_FUNC: st = g_exec.cmdFUNC(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_FUNC_LIST: st = g_exec.cmdFUNC_LIST(payload, hdr.len, respBuf, RESP_MAX, off); break;
+    case CoProc::CMD_FUNC_BATCH: st = g_exec.cmdFUNC_BATCH(payload, hdr.len, respBuf, RESP_MAX, off); break;
     case CoProc::CMD_ISP_ENTER: st = handleISP_ENTER(payload, hdr.len, respBuf, RESP_MAX, off); break;
     case CoProc::CMD_ISP_EXIT: st = handleISP_EXIT(respBuf, RESP_MAX, off); break;
     default:
@@ -2165,16 +2302,32 @@ static void processRequest(const CoProc::Frame& hdr, const uint8_t* payload, CoP
       break;
   }
   respLen = (uint32_t)off;
+  if (CoProc::isWindowedData(hdr.cmd) && respLen == 0) return false;
   uint32_t crc = (respLen ? CoProc::crc32_ieee(respBuf, respLen) : 0);
   CoProc::makeResponseHeader(respH, hdr.cmd, hdr.seq, respLen, crc);
 #if COPROC_DEBUG
   DBG("[DBG] RESP len=%u crc=0x%08X\n", (unsigned)respLen, (unsigned)crc);
 #endif
+  return true;
+}
+// ------- Unsolicited events -------
+// Async job completion, mailbox data and dropped requests go out as CMD_EVENT frames, only while
+// the link has been idle (soft serial cannot send and receive at once).
+static uint8_t g_evtBuf[32];
+static uint32_t g_evtSeq = 0;
+static void pumpEvents() {
+  size_t off = 0;
+  if (!g_exec.pollEvent(g_evtBuf, sizeof(g_evtBuf), off)) return;
+  CoProc::Frame h;
+  CoProc::makeResponseHeader(h, CoProc::CMD_EVENT, g_evtSeq++, (uint32_t)off, CoProc::crc32_ieee(g_evtBuf, off));
+  if (!writeHeader(h)) return;
+  (void)writeAll(g_evtBuf, off, 2000);
 }
 // ------- Serial protocol helpers -------
 static bool readFramedRequest(CoProc::Frame& hdr, uint8_t* payloadBuf) {
   const uint8_t magicBytes[4] = { (uint8_t)('C'), (uint8_t)('P'), (uint8_t)('R'), (uint8_t)('0') };
   uint8_t w[4] = { 0, 0, 0, 0 };
+  uint32_t scanned = 0;  // bytes seen by the magic scan
   uint32_t lastActivity = millis();
   for (;;) {
     uint8_t b;
@@ -2183,8 +2336,13 @@ static bool readFramedRequest(CoProc::Frame& hdr, uint8_t* payloadBuf) {
       w[1] = w[2];
       w[2] = w[3];
       w[3] = b;
+      ++scanned;
       lastActivity = millis();
       if (w[0] == magicBytes[0] && w[1] == magicBytes[1] && w[2] == magicBytes[2] && w[3] == magicBytes[3]) {
+        if (scanned > 4) {
+          ++g_linkStats.resyncs;
+          g_linkStats.skipped += scanned - 4;
+        }
         union {
           CoProc::Frame f;
           uint8_t bytes[sizeof(CoProc::Frame)];
@@ -2192,21 +2350,28 @@ static bool readFramedRequest(CoProc::Frame& hdr, uint8_t* payloadBuf) {
         memcpy(u.bytes, w, 4);
         if (!readExact(u.bytes + 4, sizeof(CoProc::Frame) - 4, 200)) {
           DBG("[COPROC] header tail timeout\n");
+          ++g_linkStats.timeouts;
+          g_exec.noteDropped(CoProc::ST_TIMEOUT, 0, 0xFFFFFFFFu);
           return false;
         }
         hdr = u.f;
         if ((hdr.magic != CoProc::MAGIC) || (hdr.version != CoProc::VERSION)) {
           DBG("[COPROC] bad header magic=0x%08X ver=0x%04X\n", (unsigned)hdr.magic, (unsigned)hdr.version);
+          ++g_linkStats.bad_headers;
+          g_exec.noteDropped(CoProc::ST_BAD_VERSION, hdr.cmd, hdr.seq);
           return false;
         }
         if (hdr.len > REQ_MAX) {
           DBG("[COPROC] req too large (%u > %u), draining\n", (unsigned)hdr.len, (unsigned)REQ_MAX);
+          ++g_linkStats.bad_headers;
           uint8_t sink[64];
           uint32_t left = hdr.len;
           while (left) {
             uint32_t chunk = (left > sizeof(sink)) ? sizeof(sink) : left;
             if (!readExact(sink, chunk, 200)) {
               DBG("[COPROC] drain timeout\n");
+              ++g_linkStats.timeouts;
+              g_exec.noteDropped(CoProc::ST_TIMEOUT, hdr.cmd, hdr.seq);
               return false;
             }
             left -= chunk;
@@ -2216,34 +2381,42 @@ static bool readFramedRequest(CoProc::Frame& hdr, uint8_t* payloadBuf) {
           CoProc::writePOD(g_respBuf, RESP_MAX, off, st);
           uint32_t crc = CoProc::crc32_ieee(g_respBuf, off);
           CoProc::makeResponseHeader(g_respHdr, hdr.cmd, hdr.seq, (uint32_t)off, crc);
-          writeAll(reinterpret_cast<const uint8_t*>(&g_respHdr), sizeof(CoProc::Frame), 2000);
+          writeHeader(g_respHdr);
           if (off) writeAll(g_respBuf, off, 5000);
           return false;
         }
         if (hdr.len) {
           if (!readExact(payloadBuf, hdr.len, 2000)) {
             DBG("[COPROC] payload read timeout\n");
+            ++g_linkStats.timeouts;
+            g_exec.noteDropped(CoProc::ST_TIMEOUT, hdr.cmd, hdr.seq);
             return false;
           }
           uint32_t crc = CoProc::crc32_ieee(payloadBuf, hdr.len);
           if (crc != hdr.crc32) {
             DBG("[COPROC] CRC mismatch exp=0x%08X got=0x%08X\n", (unsigned)hdr.crc32, (unsigned)crc);
+            ++g_linkStats.crc_errors;
+            // Windowed DATA: stay silent mid-burst; the missing chunk is NAKed at the next ACK
+            if (CoProc::isWindowedData(hdr.cmd)) return false;
             size_t off = 0;
             int32_t st = CoProc::ST_CRC;
             CoProc::writePOD(g_respBuf, RESP_MAX, off, st);
             uint32_t rcrc = CoProc::crc32_ieee(g_respBuf, off);
             CoProc::makeResponseHeader(g_respHdr, hdr.cmd, hdr.seq, (uint32_t)off, rcrc);
-            writeAll(reinterpret_cast<const uint8_t*>(&g_respHdr), sizeof(CoProc::Frame), 2000);
+            writeHeader(g_respHdr);
             if (off) writeAll(g_respBuf, off, 5000);
             return false;
           }
         }
+        ++g_linkStats.frames_rx;
         return true;
       }
     } else {
       if ((millis() - lastActivity) > 1000) {
         lastActivity = millis();
       }
+      g_linkResp.poll();  // revert a rate trial that never got its LINK_COMMIT
+      if (!g_linkResp.inTrial()) pumpEvents();
       keypadPollSPI();  // keep keypad alive while we idle
       pumpConsole();
       serviceISPIfActive();
@@ -2269,13 +2442,13 @@ static void ispServiceLoop() {
             (void)handleISP_EXIT(g_respBuf, RESP_MAX, off);
             uint32_t crc = CoProc::crc32_ieee(g_respBuf, off);
             CoProc::makeResponseHeader(g_respHdr, g_reqHdr.cmd, g_reqHdr.seq, (uint32_t)off, crc);
-            writeAll(reinterpret_cast<const uint8_t*>(&g_respHdr), sizeof(CoProc::Frame), 2000);
+            writeHeader(g_respHdr);
             if (off) writeAll(g_respBuf, off, 5000);
             // Left ISP; return to normal loop
             return;
           } else {
             processRequest(g_reqHdr, g_reqBuf, g_respHdr, g_respBuf, respLen);
-            (void)writeAll(reinterpret_cast<const uint8_t*>(&g_respHdr), sizeof(CoProc::Frame), 2000);
+            (void)writeHeader(g_respHdr);
             if (respLen) (void)writeAll(g_respBuf, respLen, 10000);
           }
         } else {
@@ -2285,7 +2458,7 @@ static void ispServiceLoop() {
           CoProc::writePOD(g_respBuf, RESP_MAX, off, st);
           uint32_t crc = CoProc::crc32_ieee(g_respBuf, off);
           CoProc::makeResponseHeader(g_respHdr, g_reqHdr.cmd, g_reqHdr.seq, (uint32_t)off, crc);
-          (void)writeAll(reinterpret_cast<const uint8_t*>(&g_respHdr), sizeof(CoProc::Frame), 2000);
+          (void)writeHeader(g_respHdr);
           if (off) (void)writeAll(g_respBuf, off, 10000);
         }
       }
@@ -2310,8 +2483,8 @@ static void protocolLoop() {
       continue;
     }
     uint32_t respLen = 0;
-    processRequest(g_reqHdr, g_reqBuf, g_respHdr, g_respBuf, respLen);
-    if (!writeAll(reinterpret_cast<const uint8_t*>(&g_respHdr), sizeof(CoProc::Frame), 2000)) {
+    if (!processRequest(g_reqHdr, g_reqBuf, g_respHdr, g_respBuf, respLen)) continue;
+    if (!writeHeader(g_respHdr)) {
       DBG("[COPROC] write header failed\n");
       continue;
     }
@@ -2321,6 +2494,7 @@ static void protocolLoop() {
         continue;
       }
     }
+    g_linkResp.afterReply();  // LINK_BAUD: switch rate now that the reply is out
     // Optional second poll
     keypadPollSPI();
     pumpConsole();
@@ -2379,14 +2553,16 @@ void setup() {
   // Protocol buffers
   g_reqBuf = (uint8_t*)malloc(REQ_MAX);
   g_respBuf = (uint8_t*)malloc(RESP_MAX);
-  // Software serial link
+  // Serial link (boot rate; the main side may step it up with LINK_BAUD)
   coproclink.begin(SOFT_BAUD);
-  coproclink.listen();
   // Executor
   g_exec.begin();
+  g_exec.setMaxRequest(REQ_MAX);
   g_exec.registerFunc("ping", 0, fn_ping);
   g_exec.registerFunc("add", -1, fn_add);
   g_exec.registerFunc("tone", 3, fn_tone);
+  for (size_t i = 0; i < sizeof(g_table) / sizeof(g_table[0]); ++i)
+    g_exec.registerFunc(g_table[i].name, g_table[i].argc, g_table[i].fn);
   // Unified SPI bus and scan (SPI1)
   uniMem.begin();
   uniMem.setPreservePsramContents(true);
@@ -2405,6 +2581,10 @@ void setup() {
   if (!nandOk) Console.println("NAND FS: no suitable device found or open failed");
   if (!flashOk) Console.println("Flash FS: no suitable device found or open failed");
   if (!psramOk) Console.println("PSRAM FS: no suitable device found or open failed");
+  if (psramOk) {
+    g_shared.setDevice(fsPSRAM.raw().device());
+    g_exec.attachShared(&g_shared);
+  }
   // Bind and mount preferred backend
   bindActiveFs(g_storage);
   bool mounted = activeFs.mount(g_storage == StorageBackend::Flash /*autoFormatIfEmpty*/);
@@ -2431,7 +2611,7 @@ void setup() {
   } else {
     Console.println("MCP23S17 init failed.");
   }
-  Serial.printf("CoProc ready (soft-serial %u bps). RX=GP%u TX=GP%u\n", (unsigned)SOFT_BAUD, (unsigned)PIN_RX, (unsigned)PIN_TX);
+  Serial.printf("CoProc ready (%s %u bps). GP%u/GP%u\n", coproclink.name(), (unsigned)SOFT_BAUD, (unsigned)PIN_RX, (unsigned)PIN_TX);
   //auxlink.begin(4800);
   Console.println("USB console ready. Type 'help' for commands.");
   consolePromptOnce();
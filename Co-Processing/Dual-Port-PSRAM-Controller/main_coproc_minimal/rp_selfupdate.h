@@ -5,8 +5,12 @@
       RPUPD_BACKEND_W25Q    (Winbond W25Q SPI NOR flash)
       RPUPD_BACKEND_PSRAM   (Basic/assumed SPI PSRAM using 0x02 write, 0x03 read)
   - SPI defaults: SPI1 on GP10..13 (Pico-friendly). Override with macros below.
-  - No headers/CRC: you provide exact payload length.
+  - No headers/CRC: you provide exact payload length. For a verified update from a file on a
+    mounted SimpleFS volume see rp_selfupdate_fs.h.
   - Programs internal flash in 4KB sectors, 256B pages.
+  - Differential: each staged sector is compared with the XIP-mapped current contents first.
+    Identical sectors are skipped, sectors that only clear bits (1->0) are programmed without
+    an erase, and only the 256B pages that differ are programmed. rpupd_last_stats has the counts.
   - Program function runs critical flash ops from RAM with interrupts disabled.
 
   Tested with Arduino-Pico (Earle Philhower) core. Requires RP2040 or RP2350.
@@ -35,6 +39,7 @@
 extern "C" {
 #include <hardware/flash.h>
 #include <hardware/sync.h>
+#include <hardware/regs/addressmap.h>
 #include <hardware/watchdog.h>
 #include <pico/bootrom.h>
 }
@@ -74,9 +79,21 @@ extern "C" {
 // Flash geometry
 static constexpr size_t RPUPD_FLASH_SECTOR_SIZE = 4096;
 static constexpr size_t RPUPD_FLASH_PAGE_SIZE = 256;
+static constexpr size_t RPUPD_PAGES_PER_SECTOR = RPUPD_FLASH_SECTOR_SIZE / RPUPD_FLASH_PAGE_SIZE;
 
 // One 4KB RAM buffer for staging
-static uint8_t rpupd_sector_buf[RPUPD_FLASH_SECTOR_SIZE];
+static uint8_t rpupd_sector_buf[RPUPD_FLASH_SECTOR_SIZE] __attribute__((aligned(4)));
+
+// Outcome of the last rpupd_program_from_external()
+struct rpupd_stats {
+  uint32_t sectors;     // sectors covered by the image
+  uint32_t skipped;     // already identical, left alone
+  uint32_t programmed;  // only 1->0 changes: programmed without an erase
+  uint32_t erased;      // erased and programmed
+  uint32_t pages;       // 256B pages programmed
+  uint32_t irq_off_us;  // total time spent with interrupts disabled
+};
+static rpupd_stats rpupd_last_stats;
 
 // Select SPI instance
 #if RPUPD_SPI_INSTANCE == 0
@@ -292,26 +309,94 @@ static inline void rpupd_ext_wipe(uint32_t bytes) {
 
 // ---------- Internal flash programming (RAM-resident critical section) ----------
 
-// Erase and program one 4KB sector at dst_offset using rpupd_sector_buf content.
-// Must be called with interrupts disabled, runs from RAM.
-static bool __not_in_flash_func(rpupd_erase_program_sector_ram)(uint32_t dst_offset) {
-  // Erase full sector
-  flash_range_erase(dst_offset, RPUPD_FLASH_SECTOR_SIZE);
+// Compare a staged 4KB sector (RAM, word aligned) with the one currently at dst_offset (read through XIP).
+// Returns 0 when identical, 1 when programming alone gets there (no bit goes 0->1), 2 when the
+// sector needs an erase. For 1, 'page_mask' has one bit per 256B page that differs.
+static inline int rpupd_sector_diff(uint32_t dst_offset, const uint8_t* src, uint32_t& page_mask) {
+  const uint32_t* cur = (const uint32_t*)(XIP_BASE + dst_offset);
+  const uint32_t* nxt = (const uint32_t*)src;
+  const size_t words_per_page = RPUPD_FLASH_PAGE_SIZE / 4;
+  int need = 0;
+  page_mask = 0;
+  for (size_t pg = 0; pg < RPUPD_PAGES_PER_SECTOR; ++pg) {
+    for (size_t w = pg * words_per_page; w < (pg + 1) * words_per_page; ++w) {
+      uint32_t c = cur[w], n = nxt[w];
+      if (c == n) continue;
+      if (n & ~c) return 2;  // a bit has to go 0->1
+      page_mask |= 1u << pg;
+      need = 1;
+    }
+  }
+  return need;
+}
+
+// Program the pages in page_mask of one 4KB sector at dst_offset from 'src' (RAM), erasing the sector
+// first when 'erase' (then every page is programmed). Must be called with interrupts disabled, runs from RAM.
+static bool __not_in_flash_func(rpupd_erase_program_sector_ram)(uint32_t dst_offset, const uint8_t* src, bool erase,
+                                                                 uint32_t page_mask) {
+  if (erase) {
+    flash_range_erase(dst_offset, RPUPD_FLASH_SECTOR_SIZE);
+    page_mask = (1u << RPUPD_PAGES_PER_SECTOR) - 1;
+  }
   // Program 256B pages
-  for (size_t off = 0; off < RPUPD_FLASH_SECTOR_SIZE; off += RPUPD_FLASH_PAGE_SIZE) {
-    flash_range_program(dst_offset + off, rpupd_sector_buf + off, RPUPD_FLASH_PAGE_SIZE);
+  for (size_t pg = 0; pg < RPUPD_PAGES_PER_SECTOR; ++pg) {
+    if (!(page_mask & (1u << pg))) continue;
+    size_t off = pg * RPUPD_FLASH_PAGE_SIZE;
+    flash_range_program(dst_offset + off, src + off, RPUPD_FLASH_PAGE_SIZE);
+  }
+  return true;
+}
+
+// Bring the internal-flash sector at dst_offset in line with 'src' (4KB, RAM): skip, program, or
+// erase+program, counted into 'st'. Interrupts are off only while the flash changes.
+static inline bool rpupd_commit_sector(uint32_t dst_offset, const uint8_t* src, rpupd_stats& st) {
+  ++st.sectors;
+  uint32_t page_mask = 0;
+  int need = rpupd_sector_diff(dst_offset, src, page_mask);
+  if (need == 0) {
+    ++st.skipped;
+    return true;
+  }
+  // Critical section: (erase+)program the sector
+  uint32_t t0 = micros();
+  uint32_t irq = save_and_disable_interrupts();
+  bool ok = rpupd_erase_program_sector_ram(dst_offset, src, need == 2, page_mask);
+  restore_interrupts(irq);
+  st.irq_off_us += micros() - t0;
+  if (!ok) return false;
+  if (need == 2) {
+    ++st.erased;
+    st.pages += RPUPD_PAGES_PER_SECTOR;
+  } else {
+    ++st.programmed;
+    st.pages += (uint32_t)__builtin_popcount(page_mask);
   }
   return true;
 }
 
+// Print rpupd_last_stats to Serial and restart through the watchdog; does not return
+static inline void rpupd_reboot() {
+  const rpupd_stats& st = rpupd_last_stats;
+  Serial.printf("rpupd: %u sectors, %u skipped, %u programmed, %u erased; %u pages, %u us with IRQs off\n",
+                (unsigned)st.sectors, (unsigned)st.skipped, (unsigned)st.programmed, (unsigned)st.erased,
+                (unsigned)st.pages, (unsigned)st.irq_off_us);
+  Serial.flush();
+  delay(20);
+  watchdog_reboot(0, 0, 0);
+  while (true) { /* wait for reboot */
+  }
+}
+
 // Public: copy [ext_offset .. ext_offset+length) to internal flash starting at RPUPD_FLASH_TARGET_OFFSET.
-// Reads up to 4KB from external storage, then erases/programs sector-by-sector.
-// If reboot_after = true, watchdog_reboot() is called and this will not return.
+// Reads up to 4KB from external storage, then erases/programs sector-by-sector, skipping what already matches.
+// If reboot_after = true, a summary goes to Serial, watchdog_reboot() is called and this will not return.
 static inline bool rpupd_program_from_external(uint32_t ext_offset, uint32_t length, bool reboot_after = true) {
   if (length == 0) return false;
   if (length > RPUPD_ONBOARD_FLASH_SIZE) return false;
 
   rpupd_connect_internal_flash_if_needed();
+  memset(&rpupd_last_stats, 0, sizeof(rpupd_last_stats));
+  rpupd_stats& st = rpupd_last_stats;
 
   uint32_t bytes_remaining = length;
   uint32_t src = ext_offset;
@@ -323,11 +408,8 @@ static inline bool rpupd_program_from_external(uint32_t ext_offset, uint32_t len
     memset(rpupd_sector_buf, 0xFF, RPUPD_FLASH_SECTOR_SIZE);  // pad tail with 0xFF
     rpupd_ext_read(src, rpupd_sector_buf, this_len);
 
-    // Critical section: erase+program one sector
-    uint32_t irq = save_and_disable_interrupts();
-    bool ok = rpupd_erase_program_sector_ram(dst);
-    restore_interrupts(irq);
-    if (!ok) return false;
+    // Compare with what is there now, then program only what changed
+    if (!rpupd_commit_sector(dst, rpupd_sector_buf, st)) return false;
 
     // Advance
     src += this_len;
@@ -335,11 +417,6 @@ static inline bool rpupd_program_from_external(uint32_t ext_offset, uint32_t len
     bytes_remaining -= this_len;
   }
 
-  if (reboot_after) {
-    delay(20);
-    watchdog_reboot(0, 0, 0);
-    while (true) { /* wait for reboot */
-    }
-  }
+  if (reboot_after) rpupd_reboot();
   return true;
 }
\ No newline at end of file
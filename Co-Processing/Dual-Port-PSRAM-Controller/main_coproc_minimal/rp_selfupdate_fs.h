@@ -0,0 +1,255 @@
+#pragma once
+/*
+  rp_selfupdate_fs.h - Self-update from a file on a mounted SimpleFS volume, verified before flashing.
+  - The image is read through UnifiedSpiMem::MemDevice, the device the volume sits on (SimpleFS files
+    are contiguous: getFileInfo() gives the address). Reads are synchronous, each one filling a single
+    buffer of RPUPD_STREAM_SECTORS sectors, so one SPI transaction feeds several sectors.
+  - A manifest gives the expected size and a CRC32 and/or SHA-256 of the image:
+      pass 1  stream the file and check it
+      pass 2  stream it again into a staging area of internal flash, past the running binary
+      pass 3  hash the staged copy through XIP
+      apply   copy staging -> RPUPD_FLASH_TARGET_OFFSET and reboot
+    Passes 1-3 leave the running firmware alone, so any failure returns into intact code. The target
+    usually overlaps the running firmware, so the apply step is one RAM-resident loop with interrupts
+    off: no flash-resident code runs once it starts, and it never returns (watchdog reboot at the end).
+    Sectors that already match are skipped, as in rp_selfupdate.h.
+  - Staging sits between the end of the binary (and of the target range) and RPUPD_STAGE_LIMIT, which
+    defaults to the start of Arduino-Pico's filesystem/EEPROM area.
+  - rpupd_manifest_parse() reads a digest as text: 64 hex digits (sha256sum / 'hash' output) or a CRC32
+    (8 hex digits, optional 0x). On failure rpupd_last_error says why.
+
+  Include after SHA256hashcmd.h (SHA256_CTX, sha256_init/update/final).
+*/
+#include "rp_selfupdate.h"
+#include "UnifiedSPIMem.h"
+#include "Crc32.h"
+
+extern "C" {
+#include <hardware/structs/psm.h>
+#include <hardware/structs/watchdog.h>
+extern char __flash_binary_end;
+extern uint8_t _FS_start;
+}
+
+#ifndef RPUPD_STREAM_SECTORS
+#define RPUPD_STREAM_SECTORS 2  // sectors per MemDevice read
+#endif
+#ifndef RPUPD_BINARY_END
+#define RPUPD_BINARY_END ((uint32_t)((uintptr_t)&__flash_binary_end - XIP_BASE))  // end of the running image
+#endif
+#ifndef RPUPD_STAGE_LIMIT
+#define RPUPD_STAGE_LIMIT ((uint32_t)((uintptr_t)&_FS_start - XIP_BASE))  // staging must end below this offset
+#endif
+
+struct rpupd_manifest {
+  uint32_t size = 0;  // expected image bytes (0 = the file size)
+  bool has_crc32 = false;
+  uint32_t crc32 = 0;
+  bool has_sha256 = false;
+  uint8_t sha256[32] = {};
+};
+
+static uint8_t rpupd_stream_buf[RPUPD_STREAM_SECTORS][RPUPD_FLASH_SECTOR_SIZE] __attribute__((aligned(4)));
+static const char* rpupd_last_error = "";
+
+// Add the digest in 'text' (leading blanks skipped, stops at the first non-hex character) to 'm'
+static inline bool rpupd_manifest_parse(const char* text, rpupd_manifest& m) {
+  if (!text) return false;
+  while (*text == ' ' || *text == '\t' || *text == '\r' || *text == '\n') ++text;
+  if (text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) text += 2;
+  uint8_t raw[32];
+  size_t n = 0;
+  for (;; ++n) {
+    char c = text[n];
+    int v = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+    if (v < 0) break;
+    if (n >= 64) return false;
+    if (n & 1) raw[n / 2] |= (uint8_t)v;
+    else raw[n / 2] = (uint8_t)(v << 4);
+  }
+  if (n == 64) {
+    memcpy(m.sha256, raw, 32);
+    m.has_sha256 = true;
+    return true;
+  }
+  if (n == 8) {
+    m.crc32 = ((uint32_t)raw[0] << 24) | ((uint32_t)raw[1] << 16) | ((uint32_t)raw[2] << 8) | raw[3];
+    m.has_crc32 = true;
+    return true;
+  }
+  return false;
+}
+
+// Running digests over one pass
+struct rpupd_digest {
+  uint32_t crc;
+  SHA256_CTX sha;
+};
+static inline void rpupd_digest_begin(rpupd_digest& d, const rpupd_manifest& m) {
+  d.crc = 0xFFFFFFFFu;
+  if (m.has_sha256) sha256_init(&d.sha);
+}
+static inline void rpupd_digest_update(rpupd_digest& d, const rpupd_manifest& m, const uint8_t* p, size_t n) {
+  if (m.has_crc32) d.crc = Crc32::update(d.crc, p, n);
+  if (m.has_sha256) sha256_update(&d.sha, p, n);
+}
+static inline bool rpupd_digest_match(rpupd_digest& d, const rpupd_manifest& m) {
+  if (m.has_crc32 && (d.crc ^ 0xFFFFFFFFu) != m.crc32) return false;
+  if (m.has_sha256) {
+    uint8_t h[32];
+    sha256_final(&d.sha, h);
+    if (memcmp(h, m.sha256, 32) != 0) return false;
+  }
+  return true;
+}
+
+// Stream [base, base+len) of 'dev' through rpupd_stream_buf. Pass 1 (commit=false) only digests it;
+// pass 2 also commits each sector to internal flash at 'stage'. Sector tails past 'len' are padded with 0xFF.
+static inline bool rpupd_stream_pass(UnifiedSpiMem::MemDevice* dev, uint64_t base, uint32_t len,
+                                     const rpupd_manifest& m, bool commit, uint32_t stage = 0) {
+  uint8_t* buf = &rpupd_stream_buf[0][0];
+  const uint32_t cap = sizeof(rpupd_stream_buf);
+  rpupd_digest d;
+  rpupd_digest_begin(d, m);
+  for (uint32_t off = 0; off < len; off += cap) {
+    uint32_t n = (len - off > cap) ? cap : (len - off);
+    if (dev->read(base + off, buf, n) != n) {
+      rpupd_last_error = "read error";
+      return false;
+    }
+    rpupd_digest_update(d, m, buf, n);
+    if (commit) {
+      uint32_t padded = (n + RPUPD_FLASH_SECTOR_SIZE - 1) & ~(uint32_t)(RPUPD_FLASH_SECTOR_SIZE - 1);
+      memset(buf + n, 0xFF, padded - n);
+      for (uint32_t s = 0; s < padded; s += RPUPD_FLASH_SECTOR_SIZE) {
+        if (!rpupd_commit_sector(stage + off + s, buf + s, rpupd_last_stats)) {
+          rpupd_last_error = "flash program failed";
+          return false;
+        }
+      }
+    }
+    yield();
+  }
+  if (!rpupd_digest_match(d, m)) {
+    rpupd_last_error = commit ? "image changed while flashing" : "digest mismatch";
+    return false;
+  }
+  return true;
+}
+
+// Pass 3: digest the staged copy in internal flash
+static inline bool rpupd_verify_internal(uint32_t stage, uint32_t len, const rpupd_manifest& m) {
+  rpupd_digest d;
+  rpupd_digest_begin(d, m);
+  const uint8_t* p = (const uint8_t*)(XIP_BASE + stage);
+  for (uint32_t off = 0; off < len; off += RPUPD_FLASH_SECTOR_SIZE) {
+    uint32_t n = (len - off > RPUPD_FLASH_SECTOR_SIZE) ? RPUPD_FLASH_SECTOR_SIZE : (len - off);
+    rpupd_digest_update(d, m, p + off, n);
+    yield();
+  }
+  return rpupd_digest_match(d, m);
+}
+
+// First sector-aligned offset past both the running binary and the target range
+static inline uint32_t rpupd_stage_offset(uint32_t len) {
+  uint32_t bin = RPUPD_BINARY_END;
+  uint32_t dst = RPUPD_FLASH_TARGET_OFFSET + len;
+  uint32_t lo = bin > dst ? bin : dst;
+  return (lo + RPUPD_FLASH_SECTOR_SIZE - 1) & ~(uint32_t)(RPUPD_FLASH_SECTOR_SIZE - 1);
+}
+
+// Apply: copy 'len' staged bytes to 'dst' sector by sector (skip / program / erase+program, as
+// rpupd_commit_sector), then reboot. Runs from RAM with interrupts off and calls only the RAM-resident
+// flash_range_* functions, because 'dst' may hold the code that was running. Does not return.
+static void __not_in_flash_func(rpupd_apply_staged)(uint32_t dst, uint32_t stage, uint32_t len) {
+  (void)save_and_disable_interrupts();
+  uint32_t* buf = (uint32_t*)rpupd_sector_buf;
+  const uint32_t words_per_page = RPUPD_FLASH_PAGE_SIZE / 4;
+  for (uint32_t off = 0; off < len; off += RPUPD_FLASH_SECTOR_SIZE) {
+    const volatile uint32_t* src = (const volatile uint32_t*)(XIP_BASE + stage + off);
+    const volatile uint32_t* cur = (const volatile uint32_t*)(XIP_BASE + dst + off);
+    uint32_t page_mask = 0;
+    bool erase = false;
+    for (uint32_t w = 0; w < RPUPD_FLASH_SECTOR_SIZE / 4; ++w) {
+      uint32_t n = src[w], c = cur[w];
+      buf[w] = n;
+      if (n == c) continue;
+      if (n & ~c) erase = true;
+      page_mask |= 1u << (w / words_per_page);
+    }
+    if (!page_mask) continue;
+    if (erase) {
+      flash_range_erase(dst + off, RPUPD_FLASH_SECTOR_SIZE);
+      page_mask = (1u << RPUPD_PAGES_PER_SECTOR) - 1;
+    }
+    for (uint32_t pg = 0; pg < RPUPD_PAGES_PER_SECTOR; ++pg) {
+      if (page_mask & (1u << pg))
+        flash_range_program(dst + off + pg * RPUPD_FLASH_PAGE_SIZE, (const uint8_t*)buf + pg * RPUPD_FLASH_PAGE_SIZE,
+                            RPUPD_FLASH_PAGE_SIZE);
+    }
+  }
+  // watchdog_reboot(0, 0, 0) without its flash-resident code
+  watchdog_hw->scratch[4] = 0;
+  hw_set_bits(&psm_hw->wdsel, PSM_WDSEL_BITS & ~(PSM_WDSEL_ROSC_BITS | PSM_WDSEL_XOSC_BITS));
+  hw_set_bits(&watchdog_hw->ctrl, WATCHDOG_CTRL_TRIGGER_BITS);
+  while (true) {
+  }
+}
+
+// Public: flash the 'len' bytes at 'base' on 'dev' after checking them against 'm', then reboot into
+// them. Only returns on failure, and then the running firmware is unchanged (rpupd_last_error says why).
+static inline bool rpupd_program_from_device(UnifiedSpiMem::MemDevice* dev, uint64_t base, uint32_t len,
+                                             const rpupd_manifest& m) {
+  memset(&rpupd_last_stats, 0, sizeof(rpupd_last_stats));
+  rpupd_last_error = "";
+  if (!dev || len == 0) {
+    rpupd_last_error = "no image";
+    return false;
+  }
+  if (!m.has_crc32 && !m.has_sha256) {
+    rpupd_last_error = "no digest in manifest";
+    return false;
+  }
+  if (m.size && m.size != len) {
+    rpupd_last_error = "size does not match manifest";
+    return false;
+  }
+  const uint32_t padded = (len + RPUPD_FLASH_SECTOR_SIZE - 1) & ~(uint32_t)(RPUPD_FLASH_SECTOR_SIZE - 1);
+  const uint32_t stage = rpupd_stage_offset(padded);
+  const uint32_t limit = RPUPD_STAGE_LIMIT < RPUPD_ONBOARD_FLASH_SIZE ? RPUPD_STAGE_LIMIT : RPUPD_ONBOARD_FLASH_SIZE;
+  if ((uint64_t)stage + padded > limit) {
+    rpupd_last_error = "no room to stage the image in internal flash";
+    return false;
+  }
+  if (!rpupd_stream_pass(dev, base, len, m, false)) return false;
+  rpupd_connect_internal_flash_if_needed();
+  if (!rpupd_stream_pass(dev, base, len, m, true, stage)) return false;
+  if (!rpupd_verify_internal(stage, len, m)) {
+    rpupd_last_error = "staged copy does not match";
+    return false;
+  }
+  // Past this point nothing returns: report what the apply step will do while the firmware is intact
+  rpupd_stats& st = rpupd_last_stats;
+  memset(&st, 0, sizeof(st));
+  for (uint32_t off = 0; off < padded; off += RPUPD_FLASH_SECTOR_SIZE) {
+    uint32_t page_mask = 0;
+    int need = rpupd_sector_diff(RPUPD_FLASH_TARGET_OFFSET + off, (const uint8_t*)(XIP_BASE + stage + off), page_mask);
+    ++st.sectors;
+    if (need == 0) {
+      ++st.skipped;
+    } else if (need == 1) {
+      ++st.programmed;
+      st.pages += (uint32_t)__builtin_popcount(page_mask);
+    } else {
+      ++st.erased;
+      st.pages += RPUPD_PAGES_PER_SECTOR;
+    }
+  }
+  Serial.printf("rpupd: staged at 0x%08X; applying %u sectors, %u skipped, %u programmed, %u erased (%u pages), then reboot\n",
+                (unsigned)stage, (unsigned)st.sectors, (unsigned)st.skipped, (unsigned)st.programmed,
+                (unsigned)st.erased, (unsigned)st.pages);
+  Serial.flush();
+  delay(20);
+  rpupd_apply_staged(RPUPD_FLASH_TARGET_OFFSET, stage, padded);
+  return true;  // not reached
+}
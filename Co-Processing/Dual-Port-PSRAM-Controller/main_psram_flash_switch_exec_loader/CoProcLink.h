@@ -0,0 +1,531 @@
+#pragma once
+/*
+  CoProcLink.h
+  Byte transport under the CoProcProto framing, plus link speed negotiation (CMD_LINK_*).
+  - Link: begin(baud) (re)opens at a rate, then available/read/write/flush like a Stream.
+      SoftSerialLink  SoftwareSerial, the original transport
+      UartLink        RP2040 hardware UART (SerialUART); pins must match the instance
+                      (UART0: TX GP0/12/16/28, RX GP1/13/17/29; UART1: TX GP4/8/20/24, RX GP5/9/21/25)
+      PioUartLink     RP2040 PIO UART (SerialPIO) on any pins, with its own RX FIFO depth
+      LoopbackLink    in-memory pair for host-side tests (not on Arduino builds)
+      PtyLink         Linux tty/pty file descriptor in raw mode (not on Arduino builds)
+  - LinkResponder: co-processor side of LINK_BAUD / LINK_ECHO / LINK_COMMIT. A new rate is applied
+    after the LINK_BAUD reply went out and reverts by itself unless LINK_COMMIT arrives in time.
+  - negotiateLinkBaud(): host side. Steps up through a rate table; each rate has to carry a few
+    CRC-checked echo bursts before it is committed, and the first rate that fails ends the climb on
+    the last good one.
+*/
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include "CoProcProto.h"
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#include <SoftwareSerial.h>
+#else
+#include <atomic>
+#include <chrono>
+#include <thread>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#endif
+#endif
+
+namespace CoProc {
+
+#if defined(ARDUINO)
+static inline uint32_t linkMillis() {
+  return millis();
+}
+static inline void linkDelayMs(uint32_t ms) {
+  delay(ms);
+}
+#else
+static inline uint32_t linkMillis() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+static inline void linkDelayMs(uint32_t ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+#endif
+
+// ========== Transport ==========
+class Link {
+public:
+  virtual ~Link() {}
+  // (Re)open at 'baud'; bytes already received at the old rate are dropped. False if unsupported.
+  virtual bool begin(uint32_t baud) = 0;
+  virtual int available() = 0;
+  virtual int read() = 0;  // -1 when empty
+  virtual size_t write(const uint8_t* p, size_t n) = 0;
+  virtual void flush() {}  // wait until written bytes are on the wire
+  virtual const char* name() const = 0;
+  uint32_t baud() const {
+    return _baud;
+  }
+
+protected:
+  uint32_t _baud = 0;
+};
+
+#if defined(ARDUINO)
+class SoftSerialLink : public Link {
+public:
+  explicit SoftSerialLink(SoftwareSerial& s)
+    : _s(s) {}
+  bool begin(uint32_t baud) override {
+    if (_baud) _s.end();
+    _s.begin(baud);
+    _s.listen();
+    _baud = baud;
+    return true;
+  }
+  int available() override {
+    return _s.available();
+  }
+  int read() override {
+    return _s.read();
+  }
+  size_t write(const uint8_t* p, size_t n) override {
+    return _s.write(p, n);
+  }
+  void flush() override {
+    _s.flush();
+  }
+  const char* name() const override {
+    return "soft";
+  }
+
+private:
+  SoftwareSerial& _s;
+};
+#endif
+
+#if defined(ARDUINO_ARCH_RP2040)
+class UartLink : public Link {
+public:
+  UartLink(SerialUART& u, pin_size_t tx, pin_size_t rx, size_t fifo = 256)
+    : _u(u), _tx(tx), _rx(rx), _fifo(fifo) {}
+  bool begin(uint32_t baud) override {
+    if (_baud) _u.end();
+    if (!_u.setTX(_tx) || !_u.setRX(_rx)) return false;
+    if (_fifo) _u.setFIFOSize(_fifo);
+    _u.begin(baud);
+    _baud = baud;
+    return true;
+  }
+  int available() override {
+    return _u.available();
+  }
+  int read() override {
+    return _u.read();
+  }
+  size_t write(const uint8_t* p, size_t n) override {
+    return _u.write(p, n);
+  }
+  void flush() override {
+    _u.flush();
+  }
+  const char* name() const override {
+    return "uart";
+  }
+
+private:
+  SerialUART& _u;
+  pin_size_t _tx, _rx;
+  size_t _fifo;
+};
+
+class PioUartLink : public Link {
+public:
+  PioUartLink(pin_size_t tx, pin_size_t rx, size_t fifo = 256)
+    : _p(tx, rx, fifo) {}
+  bool begin(uint32_t baud) override {
+    if (_baud) _p.end();
+    _p.begin(baud);
+    _baud = baud;
+    return true;
+  }
+  int available() override {
+    return _p.available();
+  }
+  int read() override {
+    return _p.read();
+  }
+  size_t write(const uint8_t* p, size_t n) override {
+    return _p.write(p, n);
+  }
+  void flush() override {
+    _p.flush();
+  }
+  const char* name() const override {
+    return "pio";
+  }
+
+private:
+  SerialPIO _p;
+};
+#endif
+
+#if !defined(ARDUINO)
+// In-memory pair; each end may run on its own thread (one reader and one writer per direction).
+// Bytes only cross intact when both ends run the same rate, like a real UART. Above setCleanMax()
+// every 64th byte gets a bit flipped, to model a wire that cannot carry the faster rates.
+class LoopbackLink : public Link {
+public:
+  static constexpr uint32_t CAP = 8192;
+  static void connect(LoopbackLink& a, LoopbackLink& b) {
+    a._peer = &b;
+    b._peer = &a;
+  }
+  void setCleanMax(uint32_t baud) {
+    _cleanMax = baud;
+  }
+  bool begin(uint32_t baud) override {
+    _tail.store(_head.load());
+    _baud = baud;
+    _wire.store(baud);
+    return true;
+  }
+  int available() override {
+    return (int)(_head.load() - _tail.load());
+  }
+  int read() override {
+    uint32_t t = _tail.load();
+    if (t == _head.load()) return -1;
+    uint8_t b = _rx[t % CAP];
+    _tail.store(t + 1);
+    return b;
+  }
+  size_t write(const uint8_t* p, size_t n) override {
+    if (!_peer) return 0;
+    uint32_t rate = _wire.load();
+    bool match = (_peer->_wire.load() == rate);
+    uint32_t h = _peer->_head.load();
+    size_t i = 0;
+    for (; i < n && h - _peer->_tail.load() < CAP; ++i, ++h) {
+      uint8_t b = p[i];
+      if (!match) b = (uint8_t)(((b << 3) | (b >> 5)) ^ 0x5A);
+      if (_cleanMax && rate > _cleanMax && (++_sent & 63u) == 0) b ^= 0x10;
+      _peer->_rx[h % CAP] = b;
+    }
+    _peer->_head.store(h);
+    return i;
+  }
+  const char* name() const override {
+    return "loopback";
+  }
+
+private:
+  LoopbackLink* _peer = nullptr;
+  uint8_t _rx[CAP];
+  std::atomic<uint32_t> _head{ 0 };
+  std::atomic<uint32_t> _tail{ 0 };
+  std::atomic<uint32_t> _wire{ 0 };
+  uint32_t _cleanMax = 0;
+  uint32_t _sent = 0;
+};
+#endif
+
+#if !defined(ARDUINO) && defined(__linux__)
+// A serial device or pty (open), or a fresh pty master whose slave path is returned (openPty).
+class PtyLink : public Link {
+public:
+  ~PtyLink() {
+    close();
+  }
+  bool open(const char* path) {
+    close();
+    _fd = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    return _fd >= 0;
+  }
+  bool openPty(char* slavePath, size_t cap) {
+    close();
+    _fd = ::posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (_fd < 0) return false;
+    if (::grantpt(_fd) != 0 || ::unlockpt(_fd) != 0 || ::ptsname_r(_fd, slavePath, cap) != 0) {
+      close();
+      return false;
+    }
+    return true;
+  }
+  void close() {
+    if (_fd >= 0) ::close(_fd);
+    _fd = -1;
+    _baud = 0;
+  }
+  bool begin(uint32_t baud) override {
+    speed_t sp = speedFor(baud);
+    struct termios t;
+    if (_fd < 0 || !sp || ::tcgetattr(_fd, &t) != 0) return false;
+    ::cfmakeraw(&t);
+    t.c_cc[VMIN] = 0;
+    t.c_cc[VTIME] = 0;
+    ::cfsetispeed(&t, sp);
+    ::cfsetospeed(&t, sp);
+    if (::tcsetattr(_fd, TCSANOW, &t) != 0) return false;
+    ::tcflush(_fd, TCIFLUSH);
+    _baud = baud;
+    return true;
+  }
+  int available() override {
+    int n = 0;
+    if (_fd < 0 || ::ioctl(_fd, FIONREAD, &n) != 0) return 0;
+    return n;
+  }
+  int read() override {
+    uint8_t b;
+    return (_fd >= 0 && ::read(_fd, &b, 1) == 1) ? b : -1;
+  }
+  size_t write(const uint8_t* p, size_t n) override {
+    ssize_t w = (_fd >= 0) ? ::write(_fd, p, n) : -1;
+    return w > 0 ? (size_t)w : 0;
+  }
+  void flush() override {
+    if (_fd >= 0) ::tcdrain(_fd);
+  }
+  const char* name() const override {
+    return "pty";
+  }
+  int fd() const {
+    return _fd;
+  }
+
+private:
+  static speed_t speedFor(uint32_t baud) {
+    switch (baud) {
+      case 9600: return B9600;
+      case 19200: return B19200;
+      case 38400: return B38400;
+      case 57600: return B57600;
+      case 115200: return B115200;
+      case 230400: return B230400;
+#ifdef B460800
+      case 460800: return B460800;
+#endif
+#ifdef B921600
+      case 921600: return B921600;
+#endif
+#ifdef B1000000
+      case 1000000: return B1000000;
+#endif
+    }
+    return 0;
+  }
+  int _fd = -1;
+};
+#endif
+
+// ========== Negotiation ==========
+static constexpr uint32_t LINK_ECHO_MAX = 256;  // largest LINK_ECHO payload either side sends
+static const uint32_t kLinkRates[] = { 115200, 230400, 460800, 921600 };
+
+// Co-processor side. handle() builds the reply for a LINK_* request; call afterReply() once that
+// reply is flushed, and poll() whenever the request loop is idle.
+class LinkResponder {
+public:
+  LinkResponder(Link& link, uint32_t maxBaud)
+    : _link(link), _max(maxBaud) {}
+
+  int32_t handle(uint16_t cmd, const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t& off) {
+    int32_t st = ST_OK;
+    size_t roff = 0;
+    switch (cmd) {
+      case CMD_LINK_BAUD:
+        {
+          uint32_t baud = 0, trialMs = 0;
+          if (!readPOD(in, len, roff, baud) || !readPOD(in, len, roff, trialMs)) {
+            st = ST_PARAM;
+          } else if (!baud || baud > _max || trialMs < 50 || trialMs > 10000) {
+            st = ST_PARAM;
+          } else {
+            _pending = baud;
+            _trialMs = trialMs;
+          }
+          uint32_t committed = committedBaud();
+          writePOD(out, cap, off, st);
+          writePOD(out, cap, off, committed);
+          writePOD(out, cap, off, _max);
+          return st;
+        }
+      case CMD_LINK_ECHO:
+        {
+          if (len > LINK_ECHO_MAX || 8 + len > cap) st = ST_SIZE;
+          writePOD(out, cap, off, st);
+          if (st != ST_OK) return st;
+          uint32_t crc = crc32_ieee(in, len);
+          writePOD(out, cap, off, crc);
+          writeBytes(out, cap, off, in, len);
+          return st;
+        }
+      case CMD_LINK_COMMIT:
+        {
+          // Idempotent: a repeated COMMIT (lost reply) confirms the rate already in use
+          _trial = false;
+          _safe = _link.baud();
+          writePOD(out, cap, off, st);
+          writePOD(out, cap, off, _safe);
+          return st;
+        }
+    }
+    st = ST_BAD_CMD;
+    writePOD(out, cap, off, st);
+    return st;
+  }
+
+  void afterReply() {
+    if (!_pending) return;
+    uint32_t baud = _pending;
+    _pending = 0;
+    if (!_trial) _safe = _link.baud();
+    linkDelayMs(2);  // last stop bits of the reply
+    if (!_link.begin(baud)) {
+      _link.begin(_safe);
+      return;
+    }
+    _trial = true;
+    _deadline = linkMillis() + _trialMs;
+  }
+
+  void poll() {
+    if (_trial && (int32_t)(linkMillis() - _deadline) >= 0) {
+      _trial = false;
+      _link.begin(_safe);
+    }
+  }
+
+  bool inTrial() const {
+    return _trial;
+  }
+  uint32_t committedBaud() const {
+    return _trial ? _safe : _link.baud();
+  }
+
+private:
+  Link& _link;
+  uint32_t _max;
+  uint32_t _safe = 0;  // rate to fall back to while a trial runs
+  uint32_t _pending = 0;
+  uint32_t _trialMs = 0;
+  uint32_t _deadline = 0;
+  bool _trial = false;
+};
+
+// Host side outcome
+struct LinkNegotiation {
+  uint32_t from = 0;
+  uint32_t to = 0;          // rate in use afterwards (0: co-processor lost)
+  uint32_t remoteMax = 0;   // co-processor limit from the first LINK_BAUD reply
+  uint32_t failedAt = 0;    // rate that failed verification (0: none)
+  uint32_t bytesEchoed = 0;
+};
+
+// Echo burst contents: pseudo-random, led by the bytes that most often break a marginal link
+static inline void linkEchoPattern(uint8_t* p, uint32_t n, uint32_t seed) {
+  static const uint8_t lead[] = { 0x00, 0xFF, 0x55, 0xAA, 'C', 'P', 'R', '0' };
+  uint32_t x = seed ? seed : 0x9E3779B9u;
+  for (uint32_t i = 0; i < n; ++i) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    p[i] = (i < sizeof(lead)) ? lead[i] : (uint8_t)x;
+  }
+}
+
+// 'req' performs one exchange and returns false on transport failure:
+//   bool req(uint16_t cmd, const uint8_t* p, uint32_t n, uint8_t* resp, uint32_t cap, uint32_t& respLen, uint32_t timeoutMs)
+// Tries every rate in 'rates' (ascending) above the current one, up to 'maxBaud'. A 'maxBaud' below
+// the current rate is a step down to exactly that rate, verified the same way.
+template<typename Req>
+static LinkNegotiation negotiateLinkBaud(Link& link, Req&& req, const uint32_t* rates, size_t nRates,
+                                         uint32_t maxBaud, uint32_t trialMs = 1000,
+                                         uint32_t bursts = 3, uint32_t burstLen = LINK_ECHO_MAX) {
+  LinkNegotiation r;
+  r.from = r.to = link.baud();
+  const bool down = maxBaud < link.baud();
+  if (down) {
+    rates = &maxBaud;
+    nRates = 1;
+  }
+  if (burstLen > LINK_ECHO_MAX) burstLen = LINK_ECHO_MAX;
+  const uint32_t replyMs = 300;
+  uint8_t pat[LINK_ECHO_MAX];
+  uint8_t resp[8 + LINK_ECHO_MAX];
+  uint32_t rl = 0;
+
+  auto echoOk = [&](uint32_t seed) -> bool {
+    linkEchoPattern(pat, burstLen, seed);
+    if (!req(CMD_LINK_ECHO, pat, burstLen, resp, sizeof(resp), rl, replyMs)) return false;
+    int32_t st = -1;
+    uint32_t crc = 0;
+    if (rl != 8 + burstLen) return false;
+    memcpy(&st, resp, 4);
+    memcpy(&crc, resp + 4, 4);
+    if (st != ST_OK || crc != crc32_ieee(pat, burstLen) || memcmp(resp + 8, pat, burstLen) != 0) return false;
+    r.bytesEchoed += burstLen;
+    return true;
+  };
+
+  for (size_t i = 0; i < nRates; ++i) {
+    const uint32_t cur = link.baud();
+    const uint32_t next = rates[i];
+    if (down ? next != maxBaud : (next <= cur || next > maxBaud)) continue;
+    if (r.remoteMax && next > r.remoteMax) break;
+
+    uint8_t p[8];
+    memcpy(p, &next, 4);
+    memcpy(p + 4, &trialMs, 4);
+    int32_t st = -1;
+    if (req(CMD_LINK_BAUD, p, sizeof(p), resp, sizeof(resp), rl, replyMs) && rl >= 12) {
+      memcpy(&st, resp, 4);
+      memcpy(&r.remoteMax, resp + 8, 4);
+    } else {
+      // The reply may have been lost after the co-processor accepted: let its trial run out
+      linkDelayMs(trialMs + 100);
+      break;
+    }
+    if (st != ST_OK) break;
+
+    bool ok = link.begin(next);
+    if (ok) {
+      linkDelayMs(5);
+      for (uint32_t b = 0; ok && b < bursts; ++b) ok = echoOk(next * 31u + b);
+    }
+    if (ok) {
+      ok = req(CMD_LINK_COMMIT, nullptr, 0, resp, sizeof(resp), rl, replyMs) && rl >= 8;
+      if (ok) {
+        memcpy(&st, resp, 4);
+        ok = (st == ST_OK);
+      }
+    }
+    if (ok) {
+      r.to = next;
+      continue;
+    }
+
+    // Fall back: the co-processor returns to 'cur' when its trial ends without a COMMIT
+    r.failedAt = next;
+    link.begin(cur);
+    linkDelayMs(trialMs + 100);
+    if (echoOk(cur)) break;
+    // Only the COMMIT reply was lost: the co-processor kept the new rate
+    link.begin(next);
+    linkDelayMs(5);
+    if (echoOk(next)) {
+      r.to = next;
+      break;
+    }
+    link.begin(cur);
+    r.to = 0;
+    break;
+  }
+  return r;
+}
+
+}  // namespace CoProc
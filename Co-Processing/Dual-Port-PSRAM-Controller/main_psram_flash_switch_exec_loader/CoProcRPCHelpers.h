@@ -1,42 +1,5 @@
 // ===================== Co-Processor RPC helpers (for CMD_FUNC) =====================
-static uint32_t g_coproc_seq = 1;
-static bool coprocWriteAll(const uint8_t* src, size_t n, uint32_t timeoutMs) {
-  uint32_t start = millis();
-  size_t off = 0;
-  while (off < n) {
-    size_t w = coprocLink.write(src + off, n - off);
-    if (w > 0) {
-      off += w;
-      continue;
-    }
-    if ((millis() - start) > timeoutMs) return false;
-    yield();
-  }
-  coprocLink.flush();
-  return true;
-}
-static bool coprocReadByte(uint8_t& b, uint32_t timeoutMs) {
-  uint32_t start = millis();
-  while ((millis() - start) <= timeoutMs) {
-    int a = coprocLink.available();
-    if (a > 0) {
-      int v = coprocLink.read();
-      if (v >= 0) {
-        b = (uint8_t)v;
-        return true;
-      }
-    }
-    tight_loop_contents();
-    yield();
-  }
-  return false;
-}
-static bool coprocReadExact(uint8_t* dst, size_t n, uint32_t timeoutPerByteMs) {
-  for (size_t i = 0; i < n; ++i) {
-    if (!coprocReadByte(dst[i], timeoutPerByteMs)) return false;
-  }
-  return true;
-}
+// Goes through ExecHost so event frames and async replies that arrive meanwhile are dispatched, not misread
 static bool coprocCallFunc(const char* name, const int32_t* argv, uint32_t argc, int32_t& outResult) {
   if (!name) return false;
   uint32_t nameLen = (uint32_t)strlen(name);
@@ -45,7 +8,6 @@ static bool coprocCallFunc(const char* name, const int32_t* argv, uint32_t argc,
     return false;
   }
   if (argc > MAX_EXEC_ARGS) argc = MAX_EXEC_ARGS;
-  const uint32_t payloadLen = 4 + nameLen + 4 + 4 * argc;
   uint8_t payload[4 + 128 + 4 + 4 * MAX_EXEC_ARGS];
   size_t off = 0;
   CoProc::writePOD(payload, sizeof(payload), off, nameLen);
@@ -54,98 +16,26 @@ static bool coprocCallFunc(const char* name, const int32_t* argv, uint32_t argc,
   for (uint32_t i = 0; i < argc; ++i) {
     CoProc::writePOD(payload, sizeof(payload), off, argv[i]);
   }
-  CoProc::Frame req{};
-  req.magic = CoProc::MAGIC;
-  req.version = CoProc::VERSION;
-  req.cmd = CoProc::CMD_FUNC;
-  req.seq = g_coproc_seq++;
-  req.len = payloadLen;
-  req.crc32 = (payloadLen ? CoProc::crc32_ieee(payload, payloadLen) : 0);
-  if (!coprocWriteAll(reinterpret_cast<const uint8_t*>(&req), sizeof(req), 2000)) {
-    Console.println("coproc func: write header failed");
+  uint8_t buf[16];
+  uint32_t rl = 0;
+  if (!Exec.coprocCall(CoProc::CMD_FUNC, payload, (uint32_t)off, buf, sizeof(buf), rl, nullptr, 5000)) {
+    Console.println("coproc func: no valid response");
     return false;
   }
-  if (payloadLen) {
-    if (!coprocWriteAll(payload, payloadLen, 10000)) {
-      Console.println("coproc func: write payload failed");
-      return false;
-    }
+  size_t rp = 0;
+  int32_t st = CoProc::ST_BAD_CMD;
+  int32_t rv = 0;
+  if (rl >= sizeof(int32_t)) {
+    CoProc::readPOD(buf, rl, rp, st);
+  }
+  if (rl >= 2 * sizeof(int32_t)) {
+    CoProc::readPOD(buf, rl, rp, rv);
   }
-  const uint8_t magicBytes[4] = { (uint8_t)('C'), (uint8_t)('P'), (uint8_t)('R'), (uint8_t)('0') };
-  uint8_t w[4] = { 0, 0, 0, 0 };
-  for (;;) {
-    uint8_t b = 0;
-    if (!coprocReadByte(b, 5000)) {
-      Console.println("coproc func: response timeout");
-      return false;
-    }
-    w[0] = w[1];
-    w[1] = w[2];
-    w[2] = w[3];
-    w[3] = b;
-    if (w[0] == magicBytes[0] && w[1] == magicBytes[1] && w[2] == magicBytes[2] && w[3] == magicBytes[3]) {
-      union {
-        CoProc::Frame f;
-        uint8_t bytes[sizeof(CoProc::Frame)];
-      } u;
-      memcpy(u.bytes, w, 4);
-      if (!coprocReadExact(u.bytes + 4, sizeof(CoProc::Frame) - 4, 200)) {
-        Console.println("coproc func: resp header tail timeout");
-        return false;
-      }
-      CoProc::Frame resp = u.f;
-      if ((resp.magic != CoProc::MAGIC) || (resp.version != CoProc::VERSION)) {
-        Console.println("coproc func: resp bad magic/version");
-        return false;
-      }
-      if (resp.cmd != (uint16_t)(CoProc::CMD_FUNC | 0x80)) {
-        Console.print("coproc func: unexpected resp cmd=0x");
-        Console.println(resp.cmd, HEX);
-        return false;
-      }
-      uint8_t buf[16];
-      if (resp.len > sizeof(buf)) {
-        Console.println("coproc func: resp too large");
-        uint32_t left = resp.len;
-        uint8_t sink[32];
-        while (left) {
-          uint32_t chunk = (left > sizeof(sink)) ? sizeof(sink) : left;
-          if (!coprocReadExact(sink, chunk, 200)) break;
-          left -= chunk;
-        }
-        return false;
-      }
-      if (resp.len) {
-        if (!coprocReadExact(buf, resp.len, 200)) {
-          Console.println("coproc func: resp payload timeout");
-          return false;
-        }
-        uint32_t crc = CoProc::crc32_ieee(buf, resp.len);
-        if (crc != resp.crc32) {
-          Console.print("coproc func: resp CRC mismatch exp=0x");
-          Console.print(resp.crc32, HEX);
-          Console.print(" got=0x");
-          Console.println(crc, HEX);
-          return false;
-        }
-      }
-      size_t rp = 0;
-      int32_t st = CoProc::ST_BAD_CMD;
-      int32_t rv = 0;
-      if (resp.len >= sizeof(int32_t)) {
-        CoProc::readPOD(buf, resp.len, rp, st);
-      }
-      if (resp.len >= 2 * sizeof(int32_t)) {
-        CoProc::readPOD(buf, resp.len, rp, rv);
-      }
-      if (st == CoProc::ST_OK) {
-        outResult = rv;
-        return true;
-      } else {
-        Console.print("coproc func: remote error status=");
-        Console.println(st);
-        return false;
-      }
-    }
+  if (st == CoProc::ST_OK) {
+    outResult = rv;
+    return true;
   }
+  Console.print("coproc func: remote error status=");
+  Console.println(st);
+  return false;
 }
\ No newline at end of file
@@ -0,0 +1,224 @@
+// ========== run <src.c>: compile-and-run with a source-hash keyed image cache ==========
+// Lookup order: RAM LRU (no compile, no FS) -> FS image "rc_<hash16>.bin" -> compile into RAM.
+// The key is SHA-256 over a build stamp, the target and the source, so a reflash invalidates old images.
+#ifndef RUNCACHE_SLOTS
+#define RUNCACHE_SLOTS 4
+#endif
+#ifndef RUNCACHE_MAX_BYTES
+#define RUNCACHE_MAX_BYTES (32u * 1024u)  // total RAM held by cached images
+#endif
+#ifndef RUNCACHE_FS_IMAGES
+#define RUNCACHE_FS_IMAGES 1  // 0 = RAM cache only, never write rc_*.bin files
+#endif
+
+struct RunCacheEntry {
+  uint8_t key[32];
+  void* raw;     // malloc'd block (free this)
+  uint8_t* buf;  // 4-byte aligned image inside raw
+  uint32_t sz;   // image size (always even)
+  uint32_t lastUse;
+  uint32_t hits;
+};
+static RunCacheEntry g_runCache[RUNCACHE_SLOTS] = {};
+static uint32_t g_runCacheTick = 0;
+static uint32_t g_runCacheBytes = 0;
+
+static void runCacheKey(const char* src, uint32_t len, MCCompiler::Target target, uint8_t out[32]) {
+  static const char stamp[] = __DATE__ " " __TIME__;
+  SHA256_CTX ctx;
+  sha256_init(&ctx);
+  sha256_update(&ctx, (const uint8_t*)stamp, sizeof(stamp) - 1);
+  uint8_t t = (uint8_t)target;
+  sha256_update(&ctx, &t, 1);
+  sha256_update(&ctx, (const uint8_t*)src, len);
+  sha256_final(&ctx, out);
+}
+// FS image name from the first 8 key bytes; 23 chars, within ActiveFS::MAX_NAME
+static void runCacheFsName(const uint8_t key[32], char out[24]) {
+  static const char* hexd = "0123456789abcdef";
+  memcpy(out, "rc_", 3);
+  for (int i = 0; i < 8; ++i) {
+    out[3 + i * 2] = hexd[key[i] >> 4];
+    out[4 + i * 2] = hexd[key[i] & 0xF];
+  }
+  memcpy(out + 19, ".bin", 5);
+}
+static RunCacheEntry* runCacheFind(const uint8_t key[32]) {
+  for (int i = 0; i < RUNCACHE_SLOTS; ++i) {
+    RunCacheEntry& e = g_runCache[i];
+    if (e.raw && memcmp(e.key, key, 32) == 0) return &e;
+  }
+  return nullptr;
+}
+static void runCacheDrop(RunCacheEntry& e) {
+  if (!e.raw) return;
+  g_runCacheBytes -= e.sz;
+  free(e.raw);
+  e.raw = nullptr;
+  e.buf = nullptr;
+  e.sz = 0;
+  e.hits = 0;
+}
+static void runCacheClear() {
+  for (int i = 0; i < RUNCACHE_SLOTS; ++i) runCacheDrop(g_runCache[i]);
+}
+// Takes ownership of raw; evicts least-recently-used images until the new one fits.
+// Returns nullptr (raw stays with the caller) if the image alone exceeds RUNCACHE_MAX_BYTES.
+static RunCacheEntry* runCacheInsert(const uint8_t key[32], void* raw, uint8_t* buf, uint32_t sz) {
+  if (sz > RUNCACHE_MAX_BYTES) return nullptr;
+  for (;;) {
+    RunCacheEntry* lru = nullptr;
+    RunCacheEntry* freeSlot = nullptr;
+    for (int i = 0; i < RUNCACHE_SLOTS; ++i) {
+      RunCacheEntry& e = g_runCache[i];
+      if (!e.raw) {
+        if (!freeSlot) freeSlot = &e;
+      } else if (!lru || (int32_t)(e.lastUse - lru->lastUse) < 0) {
+        lru = &e;
+      }
+    }
+    if (freeSlot && g_runCacheBytes + sz <= RUNCACHE_MAX_BYTES) {
+      memcpy(freeSlot->key, key, 32);
+      freeSlot->raw = raw;
+      freeSlot->buf = buf;
+      freeSlot->sz = sz;
+      freeSlot->lastUse = g_runCacheTick;
+      freeSlot->hits = 0;
+      g_runCacheBytes += sz;
+      return freeSlot;
+    }
+    runCacheDrop(*lru);
+  }
+}
+// Compile straight into an aligned exec buffer; the buffer is trimmed to the image afterwards.
+static bool runCacheCompile(const char* src, uint32_t srcLen, MCCompiler::Target target,
+                            void*& rawOut, uint8_t*& bufOut, uint32_t& szOut) {
+  uint32_t outCap = (srcLen * 12u) + 256u;
+  if (outCap < 512u) outCap = 512u;
+  void* raw = malloc(outCap + 4);
+  if (!raw) {
+    Console.println("run: malloc out failed");
+    return false;
+  }
+  size_t pad = (size_t)(((((uintptr_t)raw) + 3) & ~((uintptr_t)3)) - (uintptr_t)raw);
+  MCCompiler* comp = new (std::nothrow) MCCompiler();
+  if (!comp) {
+    Console.println("run: out of memory for compiler");
+    free(raw);
+    return false;
+  }
+  comp->setTarget(target);
+  size_t outSize = 0;
+  MCCompiler::Result r = comp->compile(src, srcLen, (uint8_t*)raw + pad, outCap, &outSize);
+  delete comp;
+  if (!r.ok) {
+    Console.print("run: compile error at pos ");
+    Console.print((uint32_t)r.errorPos);
+    Console.print(": ");
+    Console.println(r.errorMsg ? r.errorMsg : "unknown");
+    printCompileErrorContext(src, srcLen, r.errorPos);
+    free(raw);
+    return false;
+  }
+  uint32_t sz = ((uint32_t)outSize + 1u) & ~1u;  // core1 rejects odd-sized images
+  if (sz != outSize) ((uint8_t*)raw)[pad + outSize] = 0;
+  // Shrinking normally stays in place; if the block moves, restore the alignment offset
+  void* shrunk = realloc(raw, pad + sz + 4);
+  if (shrunk) {
+    size_t npad = (size_t)(((((uintptr_t)shrunk) + 3) & ~((uintptr_t)3)) - (uintptr_t)shrunk);
+    if (npad != pad) memmove((uint8_t*)shrunk + npad, (uint8_t*)shrunk + pad, sz);
+    raw = shrunk;
+    pad = npad;
+  }
+  rawOut = raw;
+  bufOut = (uint8_t*)raw + pad;
+  szOut = sz;
+  return true;
+}
+static bool runCacheExec(const uint8_t* buf, uint32_t sz, int argc, const int32_t* argv) {
+  int rv = 0;
+  if (!Exec.runOnCore1((uintptr_t)buf, sz, (uint32_t)argc, argv, rv, Exec.timeout(100000))) {
+    Console.println("run: core1 run failed");
+    return false;
+  }
+  Console.print("Return=");
+  Console.println(rv);
+  Exec.mailboxPrintIfAny();
+  return true;
+}
+// Read source, resolve image via cache (or compile), run on core1; prints Return/mailbox like exec
+static bool runTinyCFile(const char* srcName, int argc, const int32_t* argv) {
+  if (!checkNameLen(srcName)) return false;
+  uint32_t srcSize = 0;
+  if (!activeFs.getFileSize(srcName, srcSize) || srcSize == 0) {
+    Console.print("run: source not found or empty: ");
+    Console.println(srcName);
+    return false;
+  }
+  char* srcBuf = (char*)malloc(srcSize + 1);
+  if (!srcBuf) {
+    Console.println("run: malloc src failed");
+    return false;
+  }
+  if (activeFs.readFile(srcName, (uint8_t*)srcBuf, srcSize) != srcSize) {
+    Console.println("run: readFile failed");
+    free(srcBuf);
+    return false;
+  }
+  srcBuf[srcSize] = 0;
+  MCCompiler::Target target = MCCompiler::nativeTarget();
+  uint8_t key[32];
+  runCacheKey(srcBuf, srcSize, target, key);
+  uint32_t t0 = micros();
+  const char* how = "RAM";
+  RunCacheEntry* e = runCacheFind(key);
+  if (!e) {
+    void* raw = nullptr;
+    uint8_t* buf = nullptr;
+    uint32_t sz = 0;
+    char fsName[24];
+    runCacheFsName(key, fsName);
+    bool haveImage = false;
+    if (RUNCACHE_FS_IMAGES && activeFs.exists(fsName)) {
+      haveImage = Exec.loadFileToExecBuf(fsName, raw, buf, sz);
+      how = "FS";
+    }
+    if (!haveImage) {
+      if (!runCacheCompile(srcBuf, srcSize, target, raw, buf, sz)) {
+        free(srcBuf);
+        return false;
+      }
+      how = "compiled";
+      if (RUNCACHE_FS_IMAGES && !writeBinaryToFS(fsName, buf, sz)) {
+        Console.println("run: note: could not store image on FS");
+      }
+    }
+    e = runCacheInsert(key, raw, buf, sz);
+    if (!e) {
+      // Too big to keep in RAM: run this copy once, then let it go
+      free(srcBuf);
+      Console.println("run: image exceeds RUNCACHE_MAX_BYTES; not cached in RAM");
+      bool ok = runCacheExec(buf, sz, argc, argv);
+      free(raw);
+      return ok;
+    }
+  } else {
+    ++e->hits;
+  }
+  free(srcBuf);
+  e->lastUse = ++g_runCacheTick;
+  Console.printf("run: %s image %u bytes at 0x%08x (%u us)\n", how, (unsigned)e->sz,
+                 (unsigned)(uintptr_t)e->buf, (unsigned)(micros() - t0));
+  return runCacheExec(e->buf, e->sz, argc, argv);
+}
+static void runCachePrint() {
+  Console.printf("run cache: %u/%u bytes, %d slots\n", (unsigned)g_runCacheBytes, (unsigned)RUNCACHE_MAX_BYTES, RUNCACHE_SLOTS);
+  for (int i = 0; i < RUNCACHE_SLOTS; ++i) {
+    const RunCacheEntry& e = g_runCache[i];
+    if (!e.raw) continue;
+    char fsName[24];
+    runCacheFsName(e.key, fsName);
+    Console.printf("  %s  %6u bytes  hits=%u  age=%u\n", fsName, (unsigned)e.sz, (unsigned)e.hits,
+                   (unsigned)(g_runCacheTick - e.lastUse));
+  }
+}
@@ -0,0 +1,163 @@
+#pragma once
+/*
+  Crc32.h
+  CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320) shared by the framing code: CoProcProto,
+  ZModem, shrxbin and the putbin host tool. Plain C++, no Arduino dependency.
+  - update(state, p, n) advances the raw register (start at 0xFFFFFFFF, finish with ^0xFFFFFFFF).
+    compute(p, n) is the one-shot CRC, extend(crc, p, n) continues a finished CRC (zlib crc32()).
+  - combine(crcA, crcB, lenB) is the CRC of A followed by B, for chunks checked independently.
+  - CRC32_IMPL picks the update() kernel:
+      8  slice-by-8, 8 KB table (default)
+      4  slice-by-4, first 4 KB of the same table
+      1  one 256-entry table (1 KB)
+      0  16-entry nibble table (64 B), for SRAM/flash-tight builds
+    Tables are built at compile time (C++14 constexpr) into .rodata. Every kernel stays callable by
+    name (updateBitwise/Nibble/Table/Slice4/Slice8) for benchmarks; unused tables are not emitted.
+*/
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef CRC32_IMPL
+#define CRC32_IMPL 8
+#endif
+
+namespace Crc32 {
+
+static constexpr uint32_t POLY = 0xEDB88320u;
+
+struct SliceTables {
+  uint32_t t[8][256];
+};
+struct NibbleTable {
+  uint32_t t[16];
+};
+
+static constexpr SliceTables makeSliceTables() {
+  SliceTables r{};
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; ++k) c = (c & 1u) ? (POLY ^ (c >> 1)) : (c >> 1);
+    r.t[0][i] = c;
+  }
+  for (uint32_t i = 0; i < 256; ++i) {
+    for (int k = 1; k < 8; ++k) r.t[k][i] = (r.t[k - 1][i] >> 8) ^ r.t[0][r.t[k - 1][i] & 0xFFu];
+  }
+  return r;
+}
+static constexpr NibbleTable makeNibbleTable() {
+  NibbleTable r{};
+  for (uint32_t i = 0; i < 16; ++i) {
+    uint32_t c = i;
+    for (int k = 0; k < 4; ++k) c = (c & 1u) ? (POLY ^ (c >> 1)) : (c >> 1);
+    r.t[i] = c;
+  }
+  return r;
+}
+static constexpr SliceTables kSlice = makeSliceTables();
+static constexpr NibbleTable kNibble = makeNibbleTable();
+
+// Little-endian word from any alignment (Cortex-M0+ faults on unaligned loads)
+static inline uint32_t load32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// ----- update kernels (raw register in, raw register out) -----
+static inline uint32_t updateBitwise(uint32_t c, const void* data, size_t n) {
+  const uint8_t* p = (const uint8_t*)data;
+  while (n--) {
+    c ^= *p++;
+    for (int k = 0; k < 8; ++k) c = (c >> 1) ^ (POLY & (0u - (c & 1u)));
+  }
+  return c;
+}
+static inline uint32_t updateNibble(uint32_t c, const void* data, size_t n) {
+  const uint8_t* p = (const uint8_t*)data;
+  while (n--) {
+    c ^= *p++;
+    c = kNibble.t[c & 0x0Fu] ^ (c >> 4);
+    c = kNibble.t[c & 0x0Fu] ^ (c >> 4);
+  }
+  return c;
+}
+static inline uint32_t updateTable(uint32_t c, const void* data, size_t n) {
+  const uint8_t* p = (const uint8_t*)data;
+  while (n--) c = kSlice.t[0][(c ^ *p++) & 0xFFu] ^ (c >> 8);
+  return c;
+}
+static inline uint32_t updateSlice4(uint32_t c, const void* data, size_t n) {
+  const uint8_t* p = (const uint8_t*)data;
+  const auto& T = kSlice.t;
+  for (; n >= 4; n -= 4, p += 4) {
+    c ^= load32(p);
+    c = T[3][c & 0xFFu] ^ T[2][(c >> 8) & 0xFFu] ^ T[1][(c >> 16) & 0xFFu] ^ T[0][c >> 24];
+  }
+  return updateTable(c, p, n);
+}
+static inline uint32_t updateSlice8(uint32_t c, const void* data, size_t n) {
+  const uint8_t* p = (const uint8_t*)data;
+  const auto& T = kSlice.t;
+  for (; n >= 8; n -= 8, p += 8) {
+    uint32_t a = c ^ load32(p);
+    uint32_t b = load32(p + 4);
+    c = T[7][a & 0xFFu] ^ T[6][(a >> 8) & 0xFFu] ^ T[5][(a >> 16) & 0xFFu] ^ T[4][a >> 24]
+        ^ T[3][b & 0xFFu] ^ T[2][(b >> 8) & 0xFFu] ^ T[1][(b >> 16) & 0xFFu] ^ T[0][b >> 24];
+  }
+  return updateTable(c, p, n);
+}
+
+static inline uint32_t update(uint32_t state, const void* data, size_t n) {
+#if CRC32_IMPL == 8
+  return updateSlice8(state, data, n);
+#elif CRC32_IMPL == 4
+  return updateSlice4(state, data, n);
+#elif CRC32_IMPL == 1
+  return updateTable(state, data, n);
+#else
+  return updateNibble(state, data, n);
+#endif
+}
+
+static inline uint32_t compute(const void* data, size_t n) {
+  return update(0xFFFFFFFFu, data, n) ^ 0xFFFFFFFFu;
+}
+static inline uint32_t extend(uint32_t crc, const void* data, size_t n) {
+  return update(crc ^ 0xFFFFFFFFu, data, n) ^ 0xFFFFFFFFu;
+}
+
+// ----- combine: crc(A||B) from crc(A), crc(B), len(B) -----
+// GF(2) polynomial arithmetic modulo POLY (bit-reflected, x^0 in bit 31)
+static inline uint32_t mulModP(uint32_t a, uint32_t b) {
+  uint32_t m = 1u << 31, p = 0;
+  for (;;) {
+    if (a & m) {
+      p ^= b;
+      if ((a & (m - 1u)) == 0) break;
+    }
+    m >>= 1;
+    b = (b & 1u) ? (b >> 1) ^ POLY : b >> 1;
+  }
+  return p;
+}
+// x^(n * 8) mod POLY, by squaring x^8
+static inline uint32_t xPow8nModP(uint64_t n) {
+  uint32_t p = 1u << 31;   // x^0
+  uint32_t sq = 1u << 23;  // x^8
+  while (n) {
+    if (n & 1u) p = mulModP(sq, p);
+    sq = mulModP(sq, sq);
+    n >>= 1;
+  }
+  return p;
+}
+static inline uint32_t combine(uint32_t crcA, uint32_t crcB, uint64_t lenB) {
+  return mulModP(xPow8nModP(lenB), crcA) ^ crcB;
+}
+
+// Known-answer check: CRC-32("123456789") = 0xCBF43926
+static inline bool selfTest() {
+  static const uint8_t v[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+  if (compute(v, sizeof(v)) != 0xCBF43926u) return false;
+  return combine(compute(v, 4), compute(v + 4, 5), 5) == 0xCBF43926u;
+}
+
+}  // namespace Crc32
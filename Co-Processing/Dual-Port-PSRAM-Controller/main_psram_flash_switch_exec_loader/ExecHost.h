@@ -1,12 +1,16 @@
 // ExecHost.h
 #pragma once
 #include <Arduino.h>
-#include <SoftwareSerial.h>
 #include <string.h>
 #include <stdlib.h>
 #include "ConsolePrint.h"
 #include "CoProcProto.h"
+#include "CoProcLink.h"
+#include "CoProcShared.h"
 #include "blob_mailbox_config.h"
+#include "MailboxRing.h"
+#include "RelocBlob.h"
+#include "Lz4Block.h"
 
 #ifndef MAX_EXEC_ARGS
 #define MAX_EXEC_ARGS 64
@@ -18,6 +22,9 @@
   } while (0)
 #endif
 
+#include "ExecOverlay.h"
+#include "ExecProfile.h"
+
 // Tuning for SoftwareSerial and transport robustness
 #ifndef EXECHOST_DATA_CHUNK
 #define EXECHOST_DATA_CHUNK 128  // 64..256 recommended for 115200 SoftwareSerial
@@ -39,6 +46,137 @@
 #define EXECHOST_ACCEPT_TRAILER_CRC 1  // consume optional trailer CRC on responses
 #endif
 
+// Windowed uploads (CMD_*_WDATA); used when the co-processor answers the negotiation in *_BEGIN
+#ifndef EXECHOST_WIN_CHUNK
+#define EXECHOST_WIN_CHUNK 8192  // chunk asked for; the co-processor caps it at its REQ_MAX - 8
+#endif
+#ifndef EXECHOST_WIN_FRAMES
+#define EXECHOST_WIN_FRAMES 8  // frames per burst / in flight (max CoProc::WIN_MAX)
+#endif
+#ifndef EXECHOST_WIN_ACK_MS
+#define EXECHOST_WIN_ACK_MS 1000  // wait for the ACK that closes a burst
+#endif
+#ifndef EXECHOST_WIN_RETRIES
+#define EXECHOST_WIN_RETRIES 8  // consecutive rounds without progress before giving up
+#endif
+
+// Compressed uploads (LZ4 over *_WDATA) when HELLO advertises CoProc::FEAT_LZ4
+#ifndef EXECHOST_LZ4
+#define EXECHOST_LZ4 1
+#endif
+#ifndef EXECHOST_LZ4_MAX_INPUT
+#define EXECHOST_LZ4_MAX_INPUT (256u * 1024u)  // the raw image is held in RAM while packing; larger go raw
+#endif
+
+// Link speed: after the first HELLO that advertises CoProc::FEAT_LINK_BAUD, step the rate up
+#ifndef EXECHOST_LINK_AUTO
+#define EXECHOST_LINK_AUTO 1
+#endif
+#ifndef EXECHOST_LINK_MAX_BAUD
+#define EXECHOST_LINK_MAX_BAUD 921600
+#endif
+#ifndef EXECHOST_LINK_TRIAL_MS
+#define EXECHOST_LINK_TRIAL_MS 1000  // co-processor reverts an uncommitted rate after this
+#endif
+#ifndef EXECHOST_LINK_PROBE_MS
+#define EXECHOST_LINK_PROBE_MS 3000  // HELLO reply wait; on timeout retry at the attach rate
+#endif
+
+// Async RPC (coprocSubmit / coprocPoll) and CMD_EVENT frames when HELLO advertises CoProc::FEAT_ASYNC
+#ifndef EXECHOST_RPC_SLOTS
+#define EXECHOST_RPC_SLOTS 8  // requests in flight without a blocking wait
+#endif
+#ifndef EXECHOST_RPC_JOBS
+#define EXECHOST_RPC_JOBS 4  // EXEC_ASYNC jobs waiting for EVT_JOB_DONE
+#endif
+#ifndef EXECHOST_RPC_BODY_MAX
+#define EXECHOST_RPC_BODY_MAX 256  // async reply / event payload kept; longer replies complete with ST_SIZE
+#endif
+#ifndef EXECHOST_RPC_TIMEOUT_MS
+#define EXECHOST_RPC_TIMEOUT_MS 5000  // default per-request deadline
+#endif
+#ifndef EXECHOST_RPC_JOB_GRACE_MS
+#define EXECHOST_RPC_JOB_GRACE_MS 2000  // wait past a job's own timeout before reporting ST_TIMEOUT
+#endif
+#ifndef EXECHOST_RX_LEN_MAX
+#define EXECHOST_RX_LEN_MAX 65536  // larger 'len' in a polled header is treated as noise
+#endif
+#ifndef EXECHOST_FUTURE_BYTES
+#define EXECHOST_FUTURE_BYTES 16  // reply bytes a CoprocFuture keeps
+#endif
+// Function ids (CMD_FUNC_LIST) and batched calls (CMD_FUNC_BATCH) when HELLO advertises CoProc::FEAT_FUNC_BATCH
+#ifndef EXECHOST_FUNC_IDS
+#define EXECHOST_FUNC_IDS 32  // co-processor functions cached by name; the rest stay reachable through CMD_FUNC
+#endif
+#ifndef EXECHOST_FUNC_NAME
+#define EXECHOST_FUNC_NAME 24  // longest cached name
+#endif
+#ifndef EXECHOST_BATCH_BYTES
+#define EXECHOST_BATCH_BYTES 512  // CMD_FUNC_BATCH request buffer in a CoprocBatch
+#endif
+// Co-processor job queue (CMD_JOB_SUBMIT / CMD_RESULTS) when HELLO advertises CoProc::FEAT_JOB_QUEUE
+#ifndef EXECHOST_RESULTS_MAX
+#define EXECHOST_RESULTS_MAX 16  // results taken per CMD_RESULTS round trip
+#endif
+// Fan-out over several co-processors (addCoProc / coprocFanSubmit / coprocFanPoll)
+#ifndef EXECHOST_COPROC_LINKS
+#define EXECHOST_COPROC_LINKS 4  // co-processor links ExecHost keeps state for
+#endif
+#ifndef EXECHOST_FAN_JOBS
+#define EXECHOST_FAN_JOBS 16  // fan jobs queued or placed and not reported yet
+#endif
+#ifndef EXECHOST_FAN_ARGS
+#define EXECHOST_FAN_ARGS 8  // arguments kept per fan job
+#endif
+#ifndef EXECHOST_FAN_NAME
+#define EXECHOST_FAN_NAME 32  // longest file name a fan job keeps
+#endif
+#ifndef EXECHOST_FAN_PER_LINK
+#define EXECHOST_FAN_PER_LINK 8  // fan jobs placed on one board at a time (its queue is COPROC_JOB_QUEUE deep)
+#endif
+#ifndef EXECHOST_FAN_POLL_MS
+#define EXECHOST_FAN_POLL_MS 20  // CMD_RESULTS interval per busy board
+#endif
+#ifndef EXECHOST_FAN_FAILS
+#define EXECHOST_FAN_FAILS 3  // link failures in a row before a board is taken out and its jobs move
+#endif
+#ifndef EXECHOST_FAN_BACKOFF_MS
+#define EXECHOST_FAN_BACKOFF_MS 5000  // a board that is down gets probed again after this
+#endif
+#ifndef EXECHOST_FAN_BUSY_MS
+#define EXECHOST_FAN_BUSY_MS 250  // a board that refused a job (queue full, load error) is skipped this long
+#endif
+#ifndef EXECHOST_FAN_TRIES
+#define EXECHOST_FAN_TRIES 3  // moves per job before it completes with ST_TIMEOUT
+#endif
+// coprocBench()
+#ifndef EXECHOST_BENCH_ROUNDS
+#define EXECHOST_BENCH_ROUNDS 32  // samples per latency test (at most EXECHOST_BENCH_SAMPLES kept)
+#endif
+#ifndef EXECHOST_BENCH_SAMPLES
+#define EXECHOST_BENCH_SAMPLES 64
+#endif
+#ifndef EXECHOST_BENCH_LOAD_BYTES
+#define EXECHOST_BENCH_LOAD_BYTES 8192  // LOAD_DATA bytes sent per chunk size
+#endif
+#ifndef EXECHOST_BENCH_CHUNK_MAX
+#define EXECHOST_BENCH_CHUNK_MAX 512  // largest LOAD_DATA chunk tried (sizes double from 32)
+#endif
+
+// Local core1 job queue
+#ifndef EXECHOST_JOB_SLOTS
+#define EXECHOST_JOB_SLOTS 8  // queued + running + finished-but-unreported jobs
+#endif
+#ifndef EXECHOST_JOB_INFO
+#define EXECHOST_JOB_INFO 96  // legacy (raw blob) mailbox text kept per completed job
+#endif
+#ifndef EXECHOST_JOB_HISTORY
+#define EXECHOST_JOB_HISTORY 8  // completed jobs listed by 'jobs'
+#endif
+#ifndef EXECHOST_KILL_GRACE_MS
+#define EXECHOST_KILL_GRACE_MS 50  // after a cancel request, restart core1 if the job keeps running
+#endif
+
 // Simple FS function pointer table injected by the sketch from activeFs binding.
 struct ExecFSTable {
   // The subset needed for exec/coprocessor operations
@@ -78,13 +216,13 @@ static inline int exechost_call_with_args_thumb(void* entryThumb, uint32_t argc,
 class ExecHost {
 public:
   ExecHost()
-    : _console(nullptr), _fs{}, _fsValid(false), _link(nullptr), _coproc_seq(1),
-      _timeout_override_ms(0), _bg_raw(nullptr), _bg_buf(nullptr), _bg_sz(0),
-      _bg_active(false), _bg_start_ms(0), _bg_timeout_ms(0), _bg_cancel_requested(false) {
-    _bg_fname[0] = '\0';
+    : _console(nullptr), _fs{}, _fsValid(false),
+      _timeout_override_ms(0), _jobSeq(0), _nextJobId(1), _doneHead(0), _doneTail(0), _histCount(0) {
+    for (uint32_t i = 0; i < EXECHOST_JOB_SLOTS; ++i) _slots[i].state = JOB_FREE;
     _job.code = 0;
     _job.size = 0;
     _job.argc = 0;
+    _job.profile = false;
     _result = 0;
     _status = 0;
     _job_flag = 0u;
@@ -101,13 +239,25 @@ public:
     _fsValid = (_fs.getFileSize && _fs.readFile);
   }
 
-  // Attach and initialize co-processor link (SoftwareSerial)
-  void attachCoProc(SoftwareSerial* link, uint32_t baud) {
-    _link = link;
-    if (_link) {
-      _link->begin(baud);
-      _link->listen();
-    }
+  // Firmware services that relocatable (RBL1) blobs may import
+  void attachExports(const RBlob::Export* tbl, size_t n) {
+    _exports = tbl;
+    _nExports = n;
+  }
+
+  // PSRAM both MCUs can reach; blobs and scripts then go over as CMD_LOAD_REF instead of the link
+  void attachShared(CoProc::SharedMem* m) {
+    _p->shared = m;
+  }
+  CoProc::SharedMem* coprocShared() const {
+    return _p->shared;
+  }
+
+  // Attach and initialize co-processor link at its boot rate (link 0; addCoProc() adds more). Selects it.
+  void attachCoProc(CoProc::Link* link, uint32_t baud) {
+    _p = &_peers[0];
+    if (!_nPeers) _nPeers = 1;
+    peerReset(_peers[0], link, baud);
   }
 
   // Timeout override management
@@ -121,12 +271,24 @@ public:
     return _timeout_override_ms ? _timeout_override_ms : defaultMs;
   }
 
-  // Core1 worker (call from setup1/loop1)
+  // Job status codes (completion records / 'jobs')
+  enum : int32_t {
+    JOB_OK = 0,
+    JOB_BAD_IMAGE = -1,
+    JOB_CANCELED = -2,  // killed before core1 started it
+    JOB_KILLED = -3,    // core1 restarted after the job ignored its cancel token
+  };
+
+  // Core1 worker (call from setup1/loop1). Also runs again after a hard kill restarts core1.
   void core1Setup() {
+    execProfCyclesInit();
     _job_flag = 0u;
   }
   void core1Poll() {
-    if (_job_flag != 1u) return;
+    if (_job_flag != 1u) {
+      core1RunQueued();
+      return;
+    }
     __asm volatile("dsb" ::
                      : "memory");
     __asm volatile("isb" ::
@@ -138,14 +300,24 @@ public:
     local.argc = _job.argc;
     if (local.argc > MAX_EXEC_ARGS) local.argc = MAX_EXEC_ARGS;
     for (uint32_t i = 0; i < local.argc; ++i) local.args[i] = _job.args[i];
+    const bool paint = _job.profile && execProfStackPaint(EXECPROF_STACK_BOTTOM, EXECPROF_STACK_TOP);
     int32_t rv = 0;
     int32_t st = 0;
+    uint32_t t0 = micros();
+    uint32_t c0 = execProfCyclesNow();
     if (local.code == 0 || (local.size & 1u)) {
       st = -1;
     } else {
       void* entryThumb = (void*)(local.code | 1u);  // set Thumb bit
       rv = exechost_call_with_args_thumb(entryThumb, local.argc, local.args);
     }
+    uint32_t c1 = execProfCyclesNow();
+    _c1RunUs = micros() - t0;
+    _c1EnterUs = t0;
+    bool exact = false;
+    _c1Cycles = execProfCyclesSpan(c0, c1, _c1RunUs, exact);
+    _c1CyclesExact = exact;
+    _c1Stack = paint ? execProfStackUsed(EXECPROF_STACK_BOTTOM, EXECPROF_STACK_TOP) : 0u;
     _result = rv;
     _status = st;
     __asm volatile("dsb" ::
@@ -155,41 +327,73 @@ public:
     _job_flag = 3u;
   }
 
-  // Mailbox helpers (shared with blobs)
-  void mailboxClearFirstByte() {
-    volatile uint8_t* mb = (volatile uint8_t*)(uintptr_t)BLOB_MAILBOX_ADDR;
-    mb[0] = 0;
+  // Mailbox helpers (shared with blobs): an SPSC ring (MailboxRing.h) that core0 drains while
+  // core1 produces. core0 is always an attached consumer, so producers wait instead of dropping.
+  static volatile void* mailboxArea() {
+    return (volatile void*)(uintptr_t)BLOB_MAILBOX_ADDR;
+  }
+  void mailboxReset() {
+    Mbx::init(mailboxArea(), BLOB_MAILBOX_MAX, true);
+    _mbxCol = 0;
+    _mbxDropped = 0;
   }
+  // Print whatever the producer has written so far; 'tag' prefixes each new line (background jobs).
+  // Stops at absolute ring position 'limit' when given, so output is attributed to the right job.
+  void mailboxPump(const char* tag = nullptr, const uint32_t* limit = nullptr) {
+    volatile void* mb = mailboxArea();
+    if (!Mbx::valid(mb, BLOB_MAILBOX_MAX)) return;
+    char chunk[64];
+    for (;;) {
+      uint32_t n = limit ? Mbx::readUntil(mb, chunk, sizeof(chunk), *limit) : Mbx::read(mb, chunk, sizeof(chunk));
+      if (n == 0) break;
+      if (!_console) continue;
+      for (uint32_t i = 0; i < n; ++i) {
+        if (_mbxCol == 0 && tag) _console->print(tag);
+        _console->print(chunk[i]);
+        _mbxCol = (chunk[i] == '\n') ? 0 : _mbxCol + 1;
+      }
+    }
+  }
+  // After a run: drain the rest of the stream, or show a legacy blob's NUL-terminated text
   void mailboxPrintIfAny() {
-    if (!_console) return;
-    const volatile char* p = (const volatile char*)(uintptr_t)BLOB_MAILBOX_ADDR;
-    if (p[0] == '\0') return;
-    _console->print(" Info=\"");
-    for (size_t i = 0; i < BLOB_MAILBOX_MAX; ++i) {
-      char c = p[i];
-      if (!c) break;
-      _console->print(c);
+    volatile void* mb = mailboxArea();
+    if (!Mbx::valid(mb, BLOB_MAILBOX_MAX)) {
+      char text[BLOB_MAILBOX_MAX + 1];
+      if (Mbx::legacyText(mb, BLOB_MAILBOX_MAX, text, sizeof(text)) && _console) _console->printf(" Info=\"%s\"\n", text);
+      mailboxReset();
+      return;
+    }
+    mailboxPump();
+    mailboxEndLine();
+    uint32_t dropped = Mbx::at(mb)->dropped;
+    if (dropped < _mbxDropped) _mbxDropped = 0;  // ring was repaired in between
+    if (dropped != _mbxDropped) {
+      if (_console) _console->printf(" (mailbox: %u bytes dropped)\n", (unsigned)(dropped - _mbxDropped));
+      _mbxDropped = dropped;
     }
-    _console->println("\"");
+  }
+  void mailboxEndLine() {
+    if (_mbxCol && _console) _console->println();
+    _mbxCol = 0;
   }
   void mailboxSetCancelFlag(uint8_t v) {
-    volatile uint8_t* mb = (volatile uint8_t*)(uintptr_t)BLOB_MAILBOX_ADDR;
-    mb[0] = v;
+    Mbx::setCancel(mailboxArea(), v);
   }
   void mailboxClearCancelFlag() {
-    volatile uint8_t* mb = (volatile uint8_t*)(uintptr_t)BLOB_MAILBOX_ADDR;
-    mb[0] = 0;
+    Mbx::setCancel(mailboxArea(), 0);
   }
   uint8_t mailboxGetCancelFlag() {
-    volatile uint8_t* mb = (volatile uint8_t*)(uintptr_t)BLOB_MAILBOX_ADDR;
-    return mb[0];
+    return Mbx::cancel(mailboxArea());
   }
 
-  // Load a file into an aligned exec buffer (malloc rawOut, returns aligned pointer)
-  bool loadFileToExecBuf(const char* fname, void*& rawOut, uint8_t*& alignedBuf, uint32_t& szOut) {
+  // Load a file into an aligned exec buffer (malloc rawOut, returns aligned pointer).
+  // RBL1 containers are relocated and linked against the export table; entryOut receives the
+  // entry offset (raw blobs: 0). Without entryOut, containers must have their entry at offset 0.
+  bool loadFileToExecBuf(const char* fname, void*& rawOut, uint8_t*& alignedBuf, uint32_t& szOut, uint32_t* entryOut = nullptr) {
     rawOut = nullptr;
     alignedBuf = nullptr;
     szOut = 0;
+    if (entryOut) *entryOut = 0;
     if (!_fsValid || !_fs.getFileSize || !_fs.readFile) {
       if (_console) _console->println("load: FS not attached");
       return false;
@@ -199,6 +403,22 @@ public:
       if (_console) _console->println("load: missing/empty");
       return false;
     }
+    RBlob::Header h;
+    if (sz >= sizeof(h) && _fs.readFileRange && _fs.readFileRange(fname, 0, (uint8_t*)&h, sizeof(h)) == sizeof(h) && h.magic == RBlob::MAGIC) {
+      uint32_t entry = 0;
+      if (!loadRelocBlob(fname, sz, h, rawOut, alignedBuf, szOut, entry)) return false;
+      if (entryOut) {
+        *entryOut = entry;
+      } else if (entry != 0) {
+        if (_console) _console->println("load: caller cannot run a blob whose entry is not at offset 0");
+        freeExecBuf(rawOut);
+        rawOut = nullptr;
+        alignedBuf = nullptr;
+        szOut = 0;
+        return false;
+      }
+      return true;
+    }
     if (sz & 1u) {
       if (_console) _console->println("load: odd-sized blob (Thumb requires 16-bit alignment)");
       return false;
@@ -220,220 +440,256 @@ public:
     return true;
   }
 
-  // Foreground exec: load from FS and run on core1; prints return + mailbox
-  bool execBlobForeground(const char* fname, int argc, const int32_t* argv, int& retVal) {
+  // Release a buffer from loadFileToExecBuf (also disarms the overlay manager if it owns it)
+  void freeExecBuf(void* raw) {
+    if (!raw) return;
+    if (g_ovl.active && g_ovl.root >= (uint8_t*)raw && g_ovl.root < (uint8_t*)raw + 4) execOvlEnd();
+    free(raw);
+  }
+
+  // Foreground exec: load from FS and run on core1; prints return + mailbox.
+  // 'profile' (exec -p) adds an image CRC and the core1 stack high-water mark, then prints the
+  // phase report and this blob's history. Timings and cycles are recorded on every run.
+  bool execBlobForeground(const char* fname, int argc, const int32_t* argv, int& retVal, bool profile = false) {
     if (argc < 0) argc = 0;
     if (argc > (int)MAX_EXEC_ARGS) argc = (int)MAX_EXEC_ARGS;
     void* raw = nullptr;
     uint8_t* buf = nullptr;
     uint32_t sz = 0;
-    if (!loadFileToExecBuf(fname, raw, buf, sz)) return false;
-    mailboxClearFirstByte();
-    uintptr_t code = (uintptr_t)buf;
+    uint32_t entry = 0;
+    ExecProfSample prof;
+    uint32_t t0 = micros();
+    if (!loadFileToExecBuf(fname, raw, buf, sz, &entry)) return false;
+    prof.loadUs = micros() - t0;
+    prof.size = sz;
+    if (profile) {
+      t0 = micros();
+      prof.crc = CoProc::crc32_ieee(buf, sz);
+      prof.crcUs = micros() - t0;
+    }
+    uintptr_t code = (uintptr_t)buf + entry;
     if (_console) {
       _console->print("Calling entry on core1 at 0x");
-      _console->println((uintptr_t)buf, HEX);
+      _console->println(code, HEX);
     }
-    bool ok = runOnCore1(code, sz, (uint32_t)argc, argv, retVal, timeout(100000));
+    bool ok = runOnCore1(code, sz, (uint32_t)argc, argv, retVal, timeout(100000), &prof, profile);
     if (!ok) {
       if (_console) _console->println("exec: core1 run failed");
-      free(raw);
+      freeExecBuf(raw);
       return false;
     }
     if (_console) {
       _console->print("Return=");
       _console->println(retVal);
+      if (g_ovl.active) {
+        _console->printf("Overlays: %u page-ins, %u us loading, max return depth %u\n",
+                         (unsigned)g_ovl.loads, (unsigned)g_ovl.loadUs, (unsigned)g_ovl.maxDepth);
+      }
     }
     mailboxPrintIfAny();
-    free(raw);
+    execProfRecord(fname, prof);
+    if (profile) {
+      execProfPrintSample(_console, fname, prof);
+      execProfPrintHistory(_console, fname);
+    }
+    freeExecBuf(raw);
     return true;
   }
 
-  // Background job submission; caller must have loaded raw/buf/sz via loadFileToExecBuf
-  bool submitBackground(const char* fname, void* raw, uint8_t* alignedBuf, uint32_t sz,
-                        uint32_t argc, const int32_t* argv, uint32_t timeoutMs) {
-    if (!fname || !raw || !alignedBuf || sz == 0) return false;
-    if (_job_flag != 0u) {
-      if (_console) _console->println("core1 busy");
-      return false;
-    }
-    _bg_cancel_requested = false;
-    _bg_raw = raw;
-    _bg_buf = alignedBuf;
-    _bg_sz = sz;
-    _bg_active = true;
-    _bg_start_ms = millis();
-    _bg_timeout_ms = timeoutMs;
-    strncpy(_bg_fname, fname, sizeof(_bg_fname) - 1);
-    _bg_fname[sizeof(_bg_fname) - 1] = '\0';
-    _job.code = (uintptr_t)alignedBuf;
-    _job.size = sz;
-    _job.argc = (argc > MAX_EXEC_ARGS) ? MAX_EXEC_ARGS : argc;
-    for (uint32_t i = 0; i < (uint32_t)_job.argc; ++i) _job.args[i] = (int32_t)argv[i];
-    mailboxClearCancelFlag();
+  // Queue a loaded image for core1; the queue owns 'raw' from here on (also when this fails).
+  // Higher 'prio' runs first, equal priorities in submission order. Returns the job id or -1.
+  int32_t submitJob(const char* fname, void* raw, uint8_t* code, uint32_t sz,
+                    uint32_t argc, const int32_t* argv, uint8_t prio, uint32_t timeoutMs) {
+    if (!fname || !raw || !code || sz == 0) {
+      freeExecBuf(raw);
+      return -1;
+    }
+    JobSlot* js = nullptr;
+    for (uint32_t i = 0; i < EXECHOST_JOB_SLOTS && !js; ++i) {
+      if (_slots[i].state == JOB_FREE) js = &_slots[i];
+    }
+    if (!js) {
+      if (_console) _console->printf("job queue full (%u slots)\n", (unsigned)EXECHOST_JOB_SLOTS);
+      freeExecBuf(raw);
+      return -1;
+    }
+    js->id = _nextJobId++;
+    js->seq = ++_jobSeq;
+    js->prio = prio;
+    js->raw = raw;
+    js->code = (uintptr_t)code;
+    js->size = sz;
+    js->argc = (argc > MAX_EXEC_ARGS) ? MAX_EXEC_ARGS : argc;
+    for (uint32_t i = 0; i < js->argc; ++i) js->args[i] = argv[i];
+    js->timeoutMs = timeoutMs;
+    js->submitMs = millis();
+    js->startMs = 0;
+    js->cancel = 0;
+    js->killAtMs = 0;
+    strncpy(js->name, fname, sizeof(js->name) - 1);
+    js->name[sizeof(js->name) - 1] = '\0';
     __asm volatile("dsb" ::
                      : "memory");
-    __asm volatile("isb" ::
-                     : "memory");
-    _job_flag = 1u;
+    js->state = JOB_QUEUED;  // publish: core1 may claim it from here on
     if (_console) {
-      _console->printf("Background job '%s' started on core1 at 0x%08X (sz=%u)\n",
-                       _bg_fname, (unsigned)_job.code, (unsigned)_job.size);
+      _console->printf("Job #%u '%s' queued (prio %u, sz=%u)\n", (unsigned)js->id, js->name,
+                       (unsigned)prio, (unsigned)sz);
     }
-    return true;
+    return (int32_t)js->id;
   }
 
-  // Poll background exec completion/timeout; call each main loop
-  void pollBackground() {
-    if (!_bg_active) {
-      if (_job_flag == 3u) {
-        __asm volatile("dsb" ::
-                         : "memory");
-        __asm volatile("isb" ::
-                         : "memory");
-        _job_flag = 0u;
-      }
-      return;
-    }
+  // Drain the completion ring and enforce timeouts; never blocks. Call each main loop.
+  void pollJobs() {
     if (_job_flag == 3u) {
-      int32_t result = (int32_t)_result;
-      int32_t status = (int32_t)_status;
-      if (_bg_cancel_requested) {
-        if (_console) _console->printf("Background job '%s' finished on core1 but was canceled — result ignored\n", _bg_fname);
-      } else {
-        if (_console) {
-          _console->printf("Background job '%s' completed: Return=%d\n", _bg_fname, (int)result);
-          if (status != 0) _console->printf(" Background job status=%d\n", (int)status);
-        }
-        mailboxPrintIfAny();
-      }
-      mailboxClearCancelFlag();
-      if (_bg_raw) free((void*)_bg_raw);
-      _bg_raw = nullptr;
-      _bg_buf = nullptr;
-      _bg_sz = 0;
-      _bg_active = false;
-      _bg_start_ms = 0;
-      _bg_timeout_ms = 0;
-      _bg_fname[0] = '\0';
-      _bg_cancel_requested = false;
+      // A foreground run that timed out on core0 finished late; release the handshake
+      _job_flag = 0u;
+    }
+    char tag[16];
+    while (_doneTail != _doneHead) {
       __asm volatile("dsb" ::
                        : "memory");
-      __asm volatile("isb" ::
+      const volatile JobDone& d = _done[_doneTail % EXECHOST_JOB_SLOTS];
+      // Output up to the end of this job belongs to it; the running job's output follows
+      uint32_t end = d.mbxEnd;
+      snprintf(tag, sizeof(tag), "[#%u] ", (unsigned)_slots[d.slot % EXECHOST_JOB_SLOTS].id);
+      mailboxPump(tag, &end);
+      mailboxEndLine();
+      ExecProfSample prof;
+      prof.runUs = d.runUs;
+      prof.cycles = d.cycles;
+      prof.cyclesExact = d.cyclesExact != 0;
+      finishJob(d.slot, d.result, d.status, prof, (const char*)d.info);
+      __asm volatile("dsb" ::
                        : "memory");
-      _job_flag = 0u;
-      return;
-    }
-    uint32_t timeoutMs = _bg_timeout_ms ? _bg_timeout_ms : 0;
-    if (_bg_active && timeoutMs != 0) {
-      uint32_t elapsed = (uint32_t)(millis() - _bg_start_ms);
-      if (elapsed > timeoutMs) {
-        if (_console) _console->println("core1 timeout (background job)");
-        _bg_cancel_requested = true;
+      ++_doneTail;
+    }
+    for (uint32_t i = 0; i < EXECHOST_JOB_SLOTS; ++i) {
+      if (_slots[i].state != JOB_RUNNING) continue;
+      snprintf(tag, sizeof(tag), "[#%u] ", (unsigned)_slots[i].id);
+      mailboxPump(tag);
+    }
+    for (uint32_t i = 0; i < EXECHOST_JOB_SLOTS; ++i) {
+      JobSlot& js = _slots[i];
+      if (js.state != JOB_RUNNING) continue;
+      uint32_t now = millis();
+      if (!js.cancel && js.timeoutMs && (uint32_t)(now - js.startMs) > js.timeoutMs) {
+        if (_console) _console->printf("Job #%u '%s' timed out after %u ms; canceling\n", (unsigned)js.id, js.name, (unsigned)js.timeoutMs);
+        js.cancel = 1;
+      }
+      if (!js.cancel) continue;
+      if (!js.killAtMs) {
+        // Running jobs see the token through the mailbox flag; give them a grace period
         mailboxSetCancelFlag(1);
-        const uint32_t graceMs = 50;
-        uint32_t waited = 0;
-        while (waited < graceMs) {
-          if (_job_flag == 3u) {
-            return;
-          }
-          delay(1);
-          ++waited;
-        }
-        if (_bg_raw) free((void*)_bg_raw);
-        _bg_raw = nullptr;
-        _bg_buf = nullptr;
-        _bg_sz = 0;
-        _bg_active = false;
-        _bg_start_ms = 0;
-        _bg_timeout_ms = 0;
-        _bg_fname[0] = '\0';
-        __asm volatile("dsb" ::
-                         : "memory");
-        __asm volatile("isb" ::
-                         : "memory");
-        _job_flag = 0u;
-        return;
+        js.killAtMs = now + EXECHOST_KILL_GRACE_MS;
+        if (!js.killAtMs) js.killAtMs = 1;
+      } else if ((int32_t)(now - js.killAtMs) >= 0) {
+        hardKill(i);
       }
     }
   }
 
-  // Query background status (for console)
-  bool bgActive() const {
-    return _bg_active;
-  }
-  const char* bgName() const {
-    return _bg_fname;
-  }
-  uint32_t bgElapsedMs() const {
-    return _bg_active ? (millis() - _bg_start_ms) : 0;
-  }
-  uint32_t bgTimeoutMs() const {
-    return _bg_timeout_ms;
-  }
-  uint32_t core1JobFlag() const {
-    return _job_flag;
+  // Cancel a queued job (core1 drops it when it would start it) or ask a running one to stop
+  bool killJob(uint32_t id) {
+    for (uint32_t i = 0; i < EXECHOST_JOB_SLOTS; ++i) {
+      JobSlot& js = _slots[i];
+      if ((js.state == JOB_QUEUED || js.state == JOB_RUNNING) && js.id == id) {
+        js.cancel = 1;  // pollJobs escalates for running jobs
+        return true;
+      }
+    }
+    return false;
   }
 
-  // Cancel helpers used by console
-  bool cancelQueuedBackgroundIfAny() {
-    if (_job_flag == 1u) {
-      __asm volatile("dsb" ::
-                       : "memory");
-      __asm volatile("isb" ::
-                       : "memory");
-      _job_flag = 0u;
-      void* raw = (void*)_bg_raw;
-      if (raw) free(raw);
-      _bg_raw = nullptr;
-      _bg_buf = nullptr;
-      _bg_sz = 0;
-      _bg_active = false;
-      _bg_start_ms = 0;
-      _bg_timeout_ms = 0;
-      _bg_fname[0] = '\0';
-      _bg_cancel_requested = false;
-      return true;
+  void printJobs() {
+    if (!_console) return;
+    uint32_t queued = 0, running = 0;
+    for (uint32_t i = 0; i < EXECHOST_JOB_SLOTS; ++i) {
+      if (_slots[i].state == JOB_QUEUED) ++queued;
+      if (_slots[i].state == JOB_RUNNING) ++running;
+    }
+    _console->printf("Jobs: %u running, %u queued (%u slots)\n", (unsigned)running, (unsigned)queued, (unsigned)EXECHOST_JOB_SLOTS);
+    uint32_t now = millis();
+    for (int pass = 0; pass < 2; ++pass) {
+      for (uint32_t i = 0; i < EXECHOST_JOB_SLOTS; ++i) {
+        const JobSlot& js = _slots[i];
+        if (js.state != (pass == 0 ? JOB_RUNNING : JOB_QUEUED)) continue;
+        uint32_t since = (pass == 0) ? js.startMs : js.submitMs;
+        _console->printf("  #%-4u %-7s prio %-3u %6u ms  timeout %u ms  %s%s\n", (unsigned)js.id,
+                         pass == 0 ? "running" : "queued", (unsigned)js.prio, (unsigned)(now - since),
+                         (unsigned)js.timeoutMs, js.name, js.cancel ? "  (cancel requested)" : "");
+      }
+    }
+    uint32_t n = _histCount < EXECHOST_JOB_HISTORY ? _histCount : EXECHOST_JOB_HISTORY;
+    if (n) _console->println("Recent:");
+    for (uint32_t k = 0; k < n; ++k) {
+      const JobHist& h = _hist[(_histCount - 1 - k) % EXECHOST_JOB_HISTORY];
+      _console->printf("  #%-4u %-9s Return=%-6d %6u us  %s\n", (unsigned)h.id, jobStatusName(h.status),
+                       (int)h.result, (unsigned)h.runUs, h.name);
     }
-    return false;
   }
-  bool requestCancelRunningBackground() {
-    if (_job_flag == 2u) {
-      _bg_cancel_requested = true;
-      mailboxSetCancelFlag(1);
-      return true;
+
+  bool jobsBusy() const {
+    for (uint32_t i = 0; i < EXECHOST_JOB_SLOTS; ++i) {
+      if (_slots[i].state == JOB_QUEUED || _slots[i].state == JOB_RUNNING) return true;
     }
     return false;
   }
+  uint32_t core1JobFlag() const {
+    return _job_flag;
+  }
 
-  // Low-level run when already in RAM/aligned
-  bool runOnCore1(uintptr_t codeAligned, uint32_t sz, uint32_t argc, const int32_t* argv, int& retVal, uint32_t timeoutMs) {
+  // Low-level run when already in RAM/aligned. 'prof' receives dispatch/run time and cycles;
+  // 'paintStack' also measures the core1 stack high-water mark.
+  bool runOnCore1(uintptr_t codeAligned, uint32_t sz, uint32_t argc, const int32_t* argv, int& retVal, uint32_t timeoutMs,
+                  ExecProfSample* prof = nullptr, bool paintStack = false) {
     if (_job_flag != 0u) {
       if (_console) _console->println("core1 busy");
       return false;
     }
+    for (uint32_t i = 0; i < EXECHOST_JOB_SLOTS; ++i) {
+      if (_slots[i].state == JOB_RUNNING) {
+        if (_console) _console->printf("core1 busy (job #%u running)\n", (unsigned)_slots[i].id);
+        return false;
+      }
+    }
     if (argc > MAX_EXEC_ARGS) argc = MAX_EXEC_ARGS;
     _job.code = codeAligned;
     _job.size = sz;
     _job.argc = argc;
+    _job.profile = paintStack;
     for (uint32_t i = 0; i < argc; ++i) _job.args[i] = argv[i];
     _status = 0;
     _result = 0;
+    pollJobs();  // report finished background jobs and their output first
+    mailboxClearCancelFlag();
     __asm volatile("dsb" ::
                      : "memory");
     __asm volatile("isb" ::
                      : "memory");
+    uint32_t postUs = micros();
     _job_flag = 1u;
     uint32_t start = millis();
     while (_job_flag != 3u) {
-      tight_loop_contents();
+      mailboxPump();  // stream output while the blob runs
       if ((millis() - start) > timeoutMs) {
         if (_job_flag == 3u) break;
-        if (_console) _console->println("core1 timeout");
+        mailboxEndLine();
+        // The caller frees the image next; core1 must not still be running it (as in hardKill)
+        if (_console) _console->println("core1 timeout; restarting core1");
+        rp2040.restartCore1();
         _job_flag = 0u;
         return false;
       }
     }
+    mailboxPump();
+    mailboxEndLine();
+    if (prof) {
+      prof->dispatchUs = _c1EnterUs - postUs;
+      prof->runUs = _c1RunUs;
+      prof->cycles = _c1Cycles;
+      prof->cyclesExact = _c1CyclesExact;
+      prof->stackUsed = _c1Stack;
+    }
     if (_status != 0) {
       if (_console) {
         _console->print("core1 error status=");
@@ -448,50 +704,124 @@ public:
   }
 
   // ---------------- Co-processor RPC (SoftwareSerial) ----------------
-  bool coprocHello() {
+  bool coprocHello(bool print = true) {
     CoProc::Frame rh;
     uint8_t buf[16];
     uint32_t rl = 0;
     int32_t st = 0;
-    if (!coprocRequest(CoProc::CMD_HELLO, nullptr, 0, rh, buf, sizeof(buf), rl, &st)) return false;
+    _p->coprocFeaturesKnown = true;  // one probe per attach; a failed probe means no optional features
+    _p->coprocFeatures = 0;
+    bool ok = coprocRequest(CoProc::CMD_HELLO, nullptr, 0, rh, buf, sizeof(buf), rl, &st, EXECHOST_LINK_PROBE_MS);
+    if (!ok && _p->link && _p->link->baud() != _p->linkBaseBaud) {
+      // Co-processor restarted at its boot rate: follow it and negotiate again
+      if (_console) _console->printf("coproc(serial): no reply at %u bps, back to %u\n",
+                                     (unsigned)_p->link->baud(), (unsigned)_p->linkBaseBaud);
+      _p->link->begin(_p->linkBaseBaud);
+      _p->linkNegotiated = false;
+      ok = coprocRequest(CoProc::CMD_HELLO, nullptr, 0, rh, buf, sizeof(buf), rl, &st, EXECHOST_LINK_PROBE_MS);
+    }
+    if (!ok) return false;
     if (st != CoProc::ST_OK || rl < 12) return false;
     int32_t version = 0, features = 0;
     memcpy(&version, buf + 4, 4);
     memcpy(&features, buf + 8, 4);
-    if (_console) _console->printf("CoProc HELLO: version=%d features=0x%08X\n", version, (unsigned)features);
+    _p->coprocFeatures = (uint32_t)features;
+    if (print && _console) _console->printf("CoProc HELLO: version=%d features=0x%08X\n", version, (unsigned)features);
+    if (_p->evtMask && (_p->coprocFeatures & CoProc::FEAT_ASYNC)) coprocSendSubscribe(_p->evtMask);  // HELLO cleared it
+#if EXECHOST_LINK_AUTO
+    if (!_p->linkNegotiated && (_p->coprocFeatures & CoProc::FEAT_LINK_BAUD)) coprocLinkNegotiate(EXECHOST_LINK_MAX_BAUD);
+#endif
     return true;
   }
 
-  bool coprocInfo() {
+  // Step the link rate up to 'maxBaud', or down to it (LINK_BAUD/ECHO/COMMIT); keeps the last rate that verified
+  bool coprocLinkNegotiate(uint32_t maxBaud) {
+    if (!_p->link) return false;
+    if (!coprocHasFeature(CoProc::FEAT_LINK_BAUD)) {
+      if (_console) _console->println("CoProc link: no FEAT_LINK_BAUD, staying at the boot rate");
+      return false;
+    }
+    _p->linkNegotiated = true;
+    auto req = [this](uint16_t cmd, const uint8_t* p, uint32_t n, uint8_t* resp, uint32_t cap, uint32_t& rl, uint32_t ms) {
+      CoProc::Frame rh;
+      return coprocRequest(cmd, p, n, rh, resp, cap, rl, nullptr, ms);
+    };
+    uint32_t t0 = millis();
+    CoProc::LinkNegotiation r = CoProc::negotiateLinkBaud(*_p->link, req, CoProc::kLinkRates,
+                                                          sizeof(CoProc::kLinkRates) / sizeof(CoProc::kLinkRates[0]),
+                                                          maxBaud, EXECHOST_LINK_TRIAL_MS);
+    if (!r.to) {
+      // Both rates failed: start over from the boot rate on the next HELLO
+      _p->link->begin(_p->linkBaseBaud);
+      _p->linkNegotiated = false;
+      if (_console) _console->printf("CoProc link: lost at %u bps, back to %u\n", (unsigned)r.failedAt, (unsigned)_p->linkBaseBaud);
+      return false;
+    }
+    if (_console) {
+      _console->printf("CoProc link: %u -> %u bps (%s", (unsigned)r.from, (unsigned)r.to, _p->link->name());
+      if (r.failedAt) _console->printf(", %u failed", (unsigned)r.failedAt);
+      _console->printf(", %u ms)\n", (unsigned)(millis() - t0));
+    }
+    return true;
+  }
+
+  void coprocLinkInfo() {
+    if (!_console) return;
+    if (!_p->link) {
+      _console->println("CoProc link: not attached");
+      return;
+    }
+    _console->printf("CoProc link: %s @ %u bps (boot %u, max %u)\n", _p->link->name(), (unsigned)_p->link->baud(),
+                     (unsigned)_p->linkBaseBaud, (unsigned)EXECHOST_LINK_MAX_BAUD);
+  }
+
+  bool coprocReadInfo(CoProc::Info& inf) {
     CoProc::Frame rh;
     uint8_t buf[32];
     uint32_t rl = 0;
     int32_t st = 0;
     if (!coprocRequest(CoProc::CMD_INFO, nullptr, 0, rh, buf, sizeof(buf), rl, &st)) return false;
     if (st != CoProc::ST_OK || rl < (int32_t)(4 + sizeof(CoProc::Info))) return false;
-    CoProc::Info inf{};
     memcpy(&inf, buf + 4, sizeof(inf));
+    return true;
+  }
+
+  bool coprocInfo() {
+    CoProc::Info inf{};
+    if (!coprocReadInfo(inf)) return false;
     if (_console)
       _console->printf("CoProc INFO: flags=0x%08X blob_len=%u mailbox_max=%u\n",
                        (unsigned)inf.impl_flags, (unsigned)inf.blob_len, (unsigned)inf.mailbox_max);
     return true;
   }
 
-  bool coprocLoadBuffer(const uint8_t* data, uint32_t len) {
-    uint8_t b4[4];
-    memcpy(b4, &len, 4);
+  bool coprocLoadBuffer(const uint8_t* data, uint32_t len, bool useCache = true) {
+    if (useCache && coprocHasFeature(CoProc::FEAT_CACHE)
+        && coprocCacheSelect(CoProc::CACHE_BLOB, len, CoProc::crc32_ieee(data, len), "LOAD"))
+      return true;
+    if (coprocLoadRef(CoProc::CACHE_BLOB, len, fetchFromMemory, (void*)data, "LOAD")) return true;
+    uint32_t t0 = millis();
+    PackedImage pk;
+    coprocPack(data, len, pk);
+    uint32_t chunk = 0, window = 0;
+    int mode = coprocBeginTransfer(CoProc::CMD_LOAD_BEGIN, "LOAD_BEGIN", len, chunk, window, &pk);
+    if (mode < 0) return false;
     CoProc::Frame rh;
     uint8_t rbuf[8];
     uint32_t rl = 0;
     int32_t st = 0;
-    if (!coprocRequest(CoProc::CMD_LOAD_BEGIN, b4, 4, rh, rbuf, sizeof(rbuf), rl, &st)) return false;
-    if (st != CoProc::ST_OK) {
-      if (_console) _console->printf("LOAD_BEGIN failed st=%d\n", st);
-      return false;
-    }
     const uint32_t CHUNK = EXECHOST_DATA_CHUNK;
     uint32_t sent = 0;
     uint32_t rollingCrc = 0;  // seed=0 for rolling over chunks
+    if (mode == 2) {
+      uint32_t packedCrc = 0;
+      if (!coprocSendWindowed(CoProc::CMD_LOAD_WDATA, pk.len, chunk, window, fetchFromMemory, pk.data, packedCrc)) return false;
+      rollingCrc = pk.rawCrc;
+      sent = len;
+    } else if (mode > 0) {
+      if (!coprocSendWindowed(CoProc::CMD_LOAD_WDATA, len, chunk, window, fetchFromMemory, (void*)data, rollingCrc)) return false;
+      sent = len;
+    }
     while (sent < len) {
       uint32_t n = (len - sent > CHUNK) ? CHUNK : (len - sent);
       if (!coprocRequest(CoProc::CMD_LOAD_DATA, data + sent, n, rh, rbuf, sizeof(rbuf), rl, &st)) return false;
@@ -513,11 +843,12 @@ public:
       if (_console) _console->printf("LOAD_END failed st=%d\n", st);
       return false;
     }
-    if (_console) _console->printf("CoProc LOAD OK (%u bytes)\n", (unsigned)len);
+    coprocPrintLoadOk("LOAD", len, mode, pk, t0);
     return true;
   }
 
-  bool coprocLoadFile(const char* fname) {
+  // useCache: first ask whether the co-processor still holds this image (CMD_QUERY)
+  bool coprocLoadFile(const char* fname, bool useCache = true) {
     if (!_fsValid || !_fs.getFileSize || !_fs.readFileRange) {
       if (_console) _console->println("coproc: FS not attached");
       return false;
@@ -535,21 +866,34 @@ public:
       if (_console) _console->println("coproc: odd-sized blob (Thumb needs even)");
       return false;
     }
-    uint8_t b4[4];
-    memcpy(b4, &size, 4);
+    uint32_t key = 0;
+    if (useCache && coprocImageKey(fname, size, key) && coprocCacheSelect(CoProc::CACHE_BLOB, size, key, "LOAD")) return true;
+    FileFetch src{ &_fs, fname };
+    if (coprocLoadRef(CoProc::CACHE_BLOB, size, fetchFromFile, &src, "LOAD")) return true;
+    uint32_t t0 = millis();
+    PackedImage pk;
+    coprocPackFile(fname, size, pk);
+    uint32_t chunk = 0, window = 0;
+    int mode = coprocBeginTransfer(CoProc::CMD_LOAD_BEGIN, "LOAD_BEGIN", size, chunk, window, &pk);
+    if (mode < 0) return false;
     CoProc::Frame rh;
     uint8_t rbuf[8];
     uint32_t rl = 0;
     int32_t st = 0;
-    if (!coprocRequest(CoProc::CMD_LOAD_BEGIN, b4, 4, rh, rbuf, sizeof(rbuf), rl, &st)) return false;
-    if (st != CoProc::ST_OK) {
-      if (_console) _console->printf("LOAD_BEGIN failed st=%d\n", st);
-      return false;
-    }
     const uint32_t CHUNK = EXECHOST_DATA_CHUNK;
     uint8_t buf[CHUNK];
     uint32_t sent = 0, offset = 0;
     uint32_t rollingCrc = 0;
+    if (mode == 2) {
+      uint32_t packedCrc = 0;
+      if (!coprocSendWindowed(CoProc::CMD_LOAD_WDATA, pk.len, chunk, window, fetchFromMemory, pk.data, packedCrc)) return false;
+      rollingCrc = pk.rawCrc;
+      offset = sent = size;
+    } else if (mode > 0) {
+      FileFetch ff{ &_fs, fname };
+      if (!coprocSendWindowed(CoProc::CMD_LOAD_WDATA, size, chunk, window, fetchFromFile, &ff, rollingCrc)) return false;
+      offset = sent = size;
+    }
     while (offset < size) {
       uint32_t n = (size - offset > CHUNK) ? CHUNK : (size - offset);
       uint32_t got = _fs.readFileRange(fname, offset, buf, n);
@@ -578,7 +922,7 @@ public:
       if (_console) _console->printf("LOAD_END failed st=%d\n", st);
       return false;
     }
-    if (_console) _console->printf("CoProc LOAD OK (%u bytes)\n", (unsigned)size);
+    coprocPrintLoadOk("LOAD", size, mode, pk, t0);
     return true;
   }
 
@@ -690,7 +1034,13 @@ public:
       if (_console) _console->println("coproc exec: missing file name");
       return false;
     }
-    if (!coprocLoadFile(fname)) {
+    // Held by the co-processor already: one EXEC_CACHED frame instead of LOAD_* + EXEC
+    uint32_t size = 0, key = 0;
+    if (_fsValid && _fs.getFileSize(fname, size) && coprocImageKey(fname, size, key)) {
+      int r = coprocExecCached(CoProc::CACHE_BLOB, size, key, argv, argc);
+      if (r != 0) return r > 0;
+    }
+    if (!coprocLoadFile(fname, false)) {
       if (_console) _console->println("coproc exec: LOAD_* failed");
       return false;
     }
@@ -703,7 +1053,7 @@ public:
 
   bool coprocStatus() {
     CoProc::Frame rh;
-    uint8_t buf[8];
+    uint8_t buf[20];
     uint32_t rl = 0;
     int32_t st = 0;
     if (!coprocRequest(CoProc::CMD_STATUS, nullptr, 0, rh, buf, sizeof(buf), rl, &st)) return false;
@@ -711,6 +1061,14 @@ public:
     uint32_t es = 0;
     memcpy(&es, buf + 4, 4);
     if (_console) _console->printf("CoProc STATUS: exec_state=%u\n", (unsigned)es);
+    if (rl >= 20 && _console) {
+      uint32_t id = 0;
+      int32_t jst = 0, jrv = 0;
+      memcpy(&id, buf + 8, 4);
+      memcpy(&jst, buf + 12, 4);
+      memcpy(&jrv, buf + 16, 4);
+      if (id) _console->printf("CoProc STATUS: last async job %u status=%d return=%d\n", (unsigned)id, (int)jst, (int)jrv);
+    }
     return true;
   }
 
@@ -733,12 +1091,15 @@ public:
     int32_t st = 0;
     if (!coprocRequest(CoProc::CMD_MAILBOX_RD, in, 4, rh, out, sizeof(out), rl, &st)) return false;
     if (st != CoProc::ST_OK || rl < 8) return false;
-    uint32_t n = 0;
+    uint32_t n = 0, dropped = 0;
     memcpy(&n, out + 4, 4);
+    if (n > rl - 8) n = rl - 8;
+    if (rl >= 12 + n) memcpy(&dropped, out + 8 + n, 4);  // older firmware sends no trailer
     if (_console) {
       _console->print("CoProc MAILBOX: ");
       for (uint32_t i = 0; i < n; ++i) _console->print((char)out[8 + i]);
       _console->println();
+      if (dropped) _console->printf("CoProc MAILBOX: %u byte(s) dropped so far\n", (unsigned)dropped);
     }
     return true;
   }
@@ -773,7 +1134,7 @@ public:
     return true;
   }
 
-  bool coprocScriptLoadFile(const char* fname) {
+  bool coprocScriptLoadFile(const char* fname, bool useCache = true) {
     if (!_fsValid || !_fs.getFileSize || !_fs.readFileRange) {
       if (_console) _console->println("coproc script: FS not attached");
       return false;
@@ -787,24 +1148,36 @@ public:
       if (_console) _console->println("coproc script: empty file");
       return false;
     }
-
-    // SCRIPT_BEGIN
-    uint8_t b4[4];
-    memcpy(b4, &size, 4);
+    uint32_t key = 0;
+    if (useCache && coprocImageKey(fname, size, key) && coprocCacheSelect(CoProc::CACHE_SCRIPT, size, key, "SCRIPT")) return true;
+    FileFetch src{ &_fs, fname };
+    if (coprocLoadRef(CoProc::CACHE_SCRIPT, size, fetchFromFile, &src, "SCRIPT")) return true;
+
+    // SCRIPT_BEGIN (negotiates a windowed, possibly compressed upload when the co-processor supports it)
+    uint32_t t0 = millis();
+    PackedImage pk;
+    coprocPackFile(fname, size, pk);
+    uint32_t chunk = 0, window = 0;
+    int mode = coprocBeginTransfer(CoProc::CMD_SCRIPT_BEGIN, "SCRIPT_BEGIN", size, chunk, window, &pk);
+    if (mode < 0) return false;
     CoProc::Frame rh;
     uint8_t rbuf[32];
     uint32_t rl = 0;
     int32_t st = 0;
-    if (!coprocRequest(CoProc::CMD_SCRIPT_BEGIN, b4, 4, rh, rbuf, sizeof(rbuf), rl, &st)) return false;
-    if (st != CoProc::ST_OK) {
-      if (_console) _console->printf("SCRIPT_BEGIN failed st=%d\n", st);
-      return false;
-    }
-
-    // Stream DATA with smaller chunks + pacing (SoftwareSerial friendly)
     const uint32_t CHUNK = EXECHOST_DATA_CHUNK;
     uint8_t buf[CHUNK];
     uint32_t offset = 0;
+    if (mode > 0) {
+      FileFetch ff{ &_fs, fname };
+      uint32_t crcUnused = 0;  // SCRIPT_END below checks the device CRC
+      bool ok = (mode == 2)
+                  ? coprocSendWindowed(CoProc::CMD_SCRIPT_WDATA, pk.len, chunk, window, fetchFromMemory, pk.data, crcUnused)
+                  : coprocSendWindowed(CoProc::CMD_SCRIPT_WDATA, size, chunk, window, fetchFromFile, &ff, crcUnused);
+      if (!ok) return false;
+      offset = size;
+    }
+
+    // Otherwise stream DATA with smaller chunks + pacing (SoftwareSerial friendly)
     while (offset < size) {
       uint32_t n = (size - offset > CHUNK) ? CHUNK : (size - offset);
       uint32_t got = _fs.readFileRange(fname, offset, buf, n);
@@ -834,7 +1207,9 @@ public:
       if (_console) {
         uint32_t have = 0;
         if (rl >= 12) memcpy(&have, rbuf + 8, 4);
-        _console->printf("CoProc SCRIPT LOAD OK (%u bytes) crc=0x%08X\n", (unsigned)size, (unsigned)have);
+        char tail[24];
+        snprintf(tail, sizeof(tail), " crc=0x%08X", (unsigned)have);
+        coprocPrintLoadOk("SCRIPT LOAD", size, mode, pk, t0, tail);
       }
       return true;
     }
@@ -983,7 +1358,12 @@ public:
   }
 
   bool coprocScriptExecFile(const char* fname, const int32_t* argv, uint32_t argc) {
-    if (!coprocScriptLoadFile(fname)) return false;
+    uint32_t size = 0, key = 0;
+    if (_fsValid && _fs.getFileSize(fname, size) && coprocImageKey(fname, size, key)) {
+      int r = coprocExecCached(CoProc::CACHE_SCRIPT, size, key, argv, argc);
+      if (r != 0) return r > 0;
+    }
+    if (!coprocScriptLoadFile(fname, false)) return false;
     return coprocScriptExec(argv, argc);
   }
 
@@ -1087,98 +1467,855 @@ public:
     return (respStatus == CoProc::ST_OK);
   }
 
-private:
-  // Serial helpers
-  bool linkReadByte(uint8_t& b, uint32_t timeoutMs) {
-    if (!_link) return false;
-    uint32_t start = millis();
-    while ((millis() - start) <= timeoutMs) {
-      if (_link->available() > 0) {
-        int v = _link->read();
-        if (v >= 0) {
-          b = (uint8_t)v;
-          return true;
+  // ---------------- Function ids and batched calls (CMD_FUNC_LIST, CMD_FUNC_BATCH) ----------------
+  // The name -> id table is fetched once per attach. A batch carries the table CRC it was built
+  // against; the co-processor refuses it with ST_STATE when its registry changed, and the table is
+  // fetched again so the caller can rebuild the batch.
+  struct CoprocBatch {
+    uint8_t buf[EXECHOST_BATCH_BYTES];  // table_crc, count, then (id, argc, argv) per call
+    uint32_t len;
+    uint32_t count;
+    uint32_t tableCrc;
+    bool overflow;
+    CoprocBatch() {
+      clear();
+    }
+    void clear() {
+      len = 8;
+      count = 0;
+      tableCrc = 0;
+      overflow = false;
+    }
+  };
+
+  // Fetch the id table (paged CMD_FUNC_LIST); no-op when already known unless refresh is set
+  bool coprocFuncResolve(bool refresh = false) {
+    if (_p->funcIdsKnown && !refresh) return true;
+    _p->funcIdsKnown = false;
+    _p->nFuncIds = 0;
+    if (!coprocHasFeature(CoProc::FEAT_FUNC_BATCH)) {
+      if (_console) _console->println("CoProc FUNC_LIST: no FEAT_FUNC_BATCH");
+      return false;
+    }
+    uint8_t rbuf[256];
+    for (int attempt = 0; attempt < 3; ++attempt) {  // the registry changed between pages: start over
+      uint32_t first = 0, crc = 0, total = 0;
+      bool ok = true, restart = false;
+      _p->nFuncIds = 0;
+      do {
+        uint8_t req[8];
+        uint32_t maxBytes = sizeof(rbuf);
+        memcpy(req, &first, 4);
+        memcpy(req + 4, &maxBytes, 4);
+        uint32_t rl = 0;
+        int32_t st = 0;
+        if (!coprocCall(CoProc::CMD_FUNC_LIST, req, sizeof(req), rbuf, sizeof(rbuf), rl, &st, 2000) || st != CoProc::ST_OK
+            || rl < 16) {
+          ok = false;
+          break;
         }
-      }
-      tight_loop_contents();
-      yield();
+        uint32_t pcrc = 0, n = 0;
+        memcpy(&pcrc, rbuf + 4, 4);
+        memcpy(&total, rbuf + 8, 4);
+        memcpy(&n, rbuf + 12, 4);
+        if (first && pcrc != crc) {
+          restart = true;
+          break;
+        }
+        crc = pcrc;
+        size_t p = 16;
+        for (uint32_t i = 0; i < n; ++i) {
+          uint16_t id = 0;
+          int8_t argc = 0;
+          uint8_t nl = 0;
+          if (p + 4 > rl) break;
+          memcpy(&id, rbuf + p, 2);
+          memcpy(&argc, rbuf + p + 2, 1);
+          memcpy(&nl, rbuf + p + 3, 1);
+          p += 4;
+          if (p + nl > rl) break;
+          if (nl <= EXECHOST_FUNC_NAME && _p->nFuncIds < EXECHOST_FUNC_IDS) {
+            FuncId& f = _p->funcIds[_p->nFuncIds++];
+            memcpy(f.name, rbuf + p, nl);
+            f.name[nl] = '\0';
+            f.id = id;
+            f.argc = argc;
+          }
+          p += nl;
+          first = (uint32_t)id + 1;
+        }
+        if (n == 0) break;
+      } while (first < total);
+      if (!ok) break;
+      if (restart) continue;
+      _p->funcTableCrc = crc;
+      _p->funcIdsKnown = true;
+      if (_console && total > _p->nFuncIds)
+        _console->printf("CoProc FUNC_LIST: %u of %u functions cached\n", (unsigned)_p->nFuncIds, (unsigned)total);
+      return true;
     }
+    if (_console) _console->println("CoProc FUNC_LIST failed");
     return false;
   }
 
-  bool linkReadExact(uint8_t* dst, size_t n, uint32_t timeoutPerByteMs) {
-    for (size_t i = 0; i < n; ++i) {
-      if (!linkReadByte(dst[i], timeoutPerByteMs)) return false;
-    }
-    return true;
+  uint32_t coprocFuncTableCrc() const {
+    return _p->funcTableCrc;
   }
 
-  bool linkWriteAll(const uint8_t* src, size_t n, uint32_t timeoutMs) {
-    if (!_link) return false;
-    uint32_t start = millis();
-    size_t off = 0;
-    while (off < n) {
-      size_t wrote = _link->write(src + off, n - off);
-      if (wrote > 0) {
-        off += wrote;
-        continue;
+  // Id of a co-processor function, or -1 (unknown name, or no FEAT_FUNC_BATCH)
+  int32_t coprocFuncId(const char* name, int8_t* argcOut = nullptr) {
+    if (!name || !coprocFuncResolve()) return -1;
+    for (uint32_t i = 0; i < _p->nFuncIds; ++i) {
+      if (strcmp(_p->funcIds[i].name, name) == 0) {
+        if (argcOut) *argcOut = _p->funcIds[i].argc;
+        return _p->funcIds[i].id;
       }
-      if ((millis() - start) > timeoutMs) return false;
-      yield();
     }
-    _link->flush();
-    return true;
+    return -1;
   }
 
-  bool readResponseHeader(CoProc::Frame& rh, uint32_t overallTimeoutMs = 120000) {
-    const uint8_t magicBytes[4] = { (uint8_t)('C'), (uint8_t)('P'), (uint8_t)('R'), (uint8_t)('0') };
-    uint8_t w[4] = { 0, 0, 0, 0 };
-    uint32_t start = millis();
-    while ((millis() - start) <= overallTimeoutMs) {
-      uint8_t b;
-      if (!linkReadByte(b, 50)) {
-        yield();
-        continue;
-      }
-      w[0] = w[1];
-      w[1] = w[2];
-      w[2] = w[3];
-      w[3] = b;
-      if (w[0] == magicBytes[0] && w[1] == magicBytes[1] && w[2] == magicBytes[2] && w[3] == magicBytes[3]) {
-        union {
-          CoProc::Frame f;
-          uint8_t bytes[sizeof(CoProc::Frame)];
-        } u;
-        memcpy(u.bytes, w, 4);
-        if (!linkReadExact(u.bytes + 4, sizeof(CoProc::Frame) - 4, 200)) return false;
-        rh = u.f;
-        return true;
-      }
+  // Print the id table
+  bool coprocFuncList() {
+    if (!coprocFuncResolve(true)) return false;
+    if (!_console) return true;
+    _console->printf("CoProc functions (table crc=0x%08X):\n", (unsigned)_p->funcTableCrc);
+    for (uint32_t i = 0; i < _p->nFuncIds; ++i) {
+      if (_p->funcIds[i].argc < 0) _console->printf("  %3u  %-24s argc=any\n", (unsigned)_p->funcIds[i].id, _p->funcIds[i].name);
+      else _console->printf("  %3u  %-24s argc=%d\n", (unsigned)_p->funcIds[i].id, _p->funcIds[i].name, (int)_p->funcIds[i].argc);
     }
-    return false;
+    return true;
   }
 
-  bool coprocRequest(uint16_t cmd,
-                     const uint8_t* payload, uint32_t len,
-                     CoProc::Frame& respHdr,
-                     uint8_t* respBuf, uint32_t respCap, uint32_t& respLen,
-                     int32_t* statusOut = nullptr) {
-    if (!_link) {
-      if (_console) _console->println("coproc(serial): link not attached");
+  // Append one call to a batch; false on unknown name, argc mismatch or a full buffer
+  bool coprocBatchAdd(CoprocBatch& b, const char* name, const int32_t* argv, uint32_t argc) {
+    int8_t want = -1;
+    int32_t id = coprocFuncId(name, &want);
+    if (id < 0) {
+      if (_console) _console->printf("FUNC_BATCH: unknown function '%s'\n", name ? name : "");
+      return false;
+    }
+    if (want >= 0 && (uint32_t)want != argc) {
+      if (_console) _console->printf("FUNC_BATCH: '%s' takes %d args\n", name, (int)want);
+      return false;
+    }
+    return coprocBatchAddId(b, (uint16_t)id, argv, argc);
+  }
+  bool coprocBatchAddId(CoprocBatch& b, uint16_t id, const int32_t* argv, uint32_t argc) {
+    if (argc > MAX_EXEC_ARGS || b.len + 4 + 4 * argc > sizeof(b.buf)) {
+      b.overflow = true;
       return false;
     }
+    uint16_t n = (uint16_t)argc;
+    memcpy(b.buf + b.len, &id, 2);
+    memcpy(b.buf + b.len + 2, &n, 2);
+    if (argc) memcpy(b.buf + b.len + 4, argv, 4 * argc);
+    b.len += 4 + 4 * argc;
+    b.tableCrc = _p->funcTableCrc;
+    ++b.count;
+    return true;
+  }
 
-    // Prepare request header
-    CoProc::Frame req{};
-    req.magic = CoProc::MAGIC;
-    req.version = CoProc::VERSION;
-    req.cmd = cmd;
-    req.seq = _coproc_seq++;
+  // Run a batch in one round trip. results[i] is the return value of call i; *nDone counts the calls
+  // that ran (the co-processor stops at the first bad id or argc).
+  bool coprocFuncBatch(CoprocBatch& b, int32_t* results, uint32_t maxResults, uint32_t* nDone = nullptr) {
+    if (nDone) *nDone = 0;
+    if (b.overflow) {
+      if (_console) _console->println("FUNC_BATCH: batch overflowed EXECHOST_BATCH_BYTES");
+      return false;
+    }
+    if (b.count == 0) return true;
+    memcpy(b.buf, &b.tableCrc, 4);
+    memcpy(b.buf + 4, &b.count, 4);
+    uint32_t cap = 8 + 4 * b.count;
+    uint8_t* rbuf = (uint8_t*)malloc(cap);
+    if (!rbuf) {
+      if (_console) _console->println("FUNC_BATCH: malloc failed");
+      return false;
+    }
+    uint32_t rl = 0;
+    int32_t st = 0;
+    bool ok = coprocCall(CoProc::CMD_FUNC_BATCH, b.buf, b.len, rbuf, cap, rl, &st, 5000);
+    if (!ok || rl < 8) {
+      free(rbuf);
+      if (_console && ok) _console->println("FUNC_BATCH: short response");
+      return false;
+    }
+    uint32_t done = 0;
+    memcpy(&done, rbuf + 4, 4);
+    if (done > b.count || rl < 8 + 4 * done) done = (rl - 8) / 4;
+    for (uint32_t i = 0; i < done && i < maxResults; ++i) memcpy(&results[i], rbuf + 8 + 4 * i, 4);
+    free(rbuf);
+    if (nDone) *nDone = done;
+    if (st == CoProc::ST_STATE) {
+      if (_console) _console->println("FUNC_BATCH: function table changed, rebuild the batch");
+      coprocFuncResolve(true);
+    } else if (st != CoProc::ST_OK && _console) {
+      _console->printf("FUNC_BATCH: status=%d after %u of %u calls\n", (int)st, (unsigned)done, (unsigned)b.count);
+    }
+    return st == CoProc::ST_OK;
+  }
+
+  // ---------------- Async RPC (CMD_EVENT, CMD_EXEC_ASYNC) ----------------
+  // coprocSubmit() sends a request and returns; its callback runs from coprocPoll() (call it from
+  // loop()) or from inside any blocking coproc* call that reads the reply first. Each request has its
+  // own deadline. Callbacks must not make blocking coproc* calls; submitting more requests is fine.
+  // 'status' is the reply's leading int32, or ST_TIMEOUT / ST_SIZE / ST_CRC / an EVT_ERROR status.
+  typedef void (*CoprocDone)(void* ctx, int32_t status, const uint8_t* resp, uint32_t len);
+  // EXEC_ASYNC completion (EVT_JOB_DONE); jobId is 0 when the job never started
+  typedef void (*CoprocJobDone)(void* ctx, uint32_t jobId, int32_t status, int32_t result);
+  // Every CMD_EVENT frame: type (CoProc::EVT_*) and the fields after it
+  typedef void (*CoprocEvent)(void* ctx, uint32_t type, const uint8_t* data, uint32_t len);
+
+  // Reply holder for callers that poll a flag instead of writing a callback
+  struct CoprocFuture {
+    bool done;
+    int32_t status;
+    uint32_t len;  // reply bytes kept (at most EXECHOST_FUTURE_BYTES)
+    uint8_t resp[EXECHOST_FUTURE_BYTES];
+  };
+
+  // Send without waiting; returns the request seq, 0 when nothing was sent (table full, link down)
+  uint32_t coprocSubmit(uint16_t cmd, const uint8_t* payload, uint32_t len, CoprocDone done, void* ctx,
+                        uint32_t timeoutMs = EXECHOST_RPC_TIMEOUT_MS) {
+    return rpcSubmit(cmd, payload, len, done, ctx, -1, timeoutMs);
+  }
+  uint32_t coprocSubmit(uint16_t cmd, const uint8_t* payload, uint32_t len, CoprocFuture& f,
+                        uint32_t timeoutMs = EXECHOST_RPC_TIMEOUT_MS) {
+    f.done = false;
+    f.status = CoProc::ST_OK;
+    f.len = 0;
+    uint32_t seq = coprocSubmit(cmd, payload, len, futureDone, &f, timeoutMs);
+    if (!seq) {
+      f.status = CoProc::ST_STATE;
+      f.done = true;
+    }
+    return seq;
+  }
+
+  // Poll until 'f' completes; false if it is still pending after maxMs (its own deadline still applies)
+  bool coprocWait(CoprocFuture& f, uint32_t maxMs = EXECHOST_RPC_TIMEOUT_MS) {
+    uint32_t t0 = millis();
+    while (!f.done && (millis() - t0) <= maxMs) {
+      coprocPoll();
+      if (!f.done) yield();
+    }
+    return f.done;
+  }
+
+  // Forget a submitted request; a late reply is dropped
+  bool coprocForget(uint32_t seq) {
+    int i = rpcFind(seq);
+    if (i < 0) return false;
+    _p->rpc[i].used = false;
+    return true;
+  }
+
+  // Non-blocking: take what each link has buffered, dispatch replies and events, expire deadlines.
+  // Callbacks run with their own link selected.
+  void coprocPoll() {
+    CoprocPeer* sel = _p;
+    for (uint32_t i = 0; i < _nPeers; ++i) {
+      _p = &_peers[i];
+      if (!_p->link) continue;
+      while (_p->link->available() > 0) {
+        int v = _p->link->read();
+        if (v < 0) break;
+        ++_p->stats.bytes_rx;
+        rxFeed((uint8_t)v);
+      }
+      rpcExpire();
+    }
+    _p = sel;
+  }
+
+  // Requests plus EXEC_ASYNC jobs still outstanding
+  uint32_t coprocPending() const {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < EXECHOST_RPC_SLOTS; ++i)
+      if (_p->rpc[i].used) ++n;
+    for (uint32_t i = 0; i < EXECHOST_RPC_JOBS; ++i)
+      if (_p->rjob[i].used) ++n;
+    return n;
+  }
+
+  // Event sink (nullptr = print mailbox and error events to the console)
+  void coprocOnEvent(CoprocEvent fn, void* ctx) {
+    _evtFn = fn;
+    _evtCtx = ctx;
+  }
+
+  // Choose the unsolicited events the co-processor sends (CoProc::EVT_*); kept across re-HELLO
+  bool coprocSubscribe(uint32_t mask) {
+    if (!coprocHasFeature(CoProc::FEAT_ASYNC)) {
+      if (_console) _console->println("CoProc events: no FEAT_ASYNC");
+      return false;
+    }
+    _p->evtMask = mask;
+    return coprocSendSubscribe(mask);
+  }
+  uint32_t coprocEventMask() const {
+    return _p->evtMask;
+  }
+
+  // Start the current blob (CoProc::CACHE_BLOB) or script (CACHE_SCRIPT) and return at once; 'done'
+  // runs on EVT_JOB_DONE (nullptr prints the result). False when the job could not be sent.
+  bool coprocExecAsync(uint32_t kind, const int32_t* argv, uint32_t argc, CoprocJobDone done = nullptr, void* ctx = nullptr) {
+    if (!coprocHasFeature(CoProc::FEAT_ASYNC)) {
+      if (_console) _console->println("coproc(async): co-processor has no EXEC_ASYNC");
+      return false;
+    }
+    if (!(_p->evtMask & CoProc::EVT_JOB_DONE) && !coprocSubscribe(_p->evtMask | CoProc::EVT_JOB_DONE)) return false;
+    int j = -1;
+    for (uint32_t i = 0; i < EXECHOST_RPC_JOBS && j < 0; ++i)
+      if (!_p->rjob[i].used) j = (int)i;
+    if (j < 0) {
+      if (_console) _console->println("coproc(async): too many jobs in flight");
+      return false;
+    }
+    if (argc > MAX_EXEC_ARGS) argc = MAX_EXEC_ARGS;
+    uint32_t timeoutMs = timeout(100000);
+    uint8_t payload[4 + 4 + MAX_EXEC_ARGS * 4 + 4];
+    size_t off = 0;
+    CoProc::writePOD(payload, sizeof(payload), off, kind);
+    CoProc::writePOD(payload, sizeof(payload), off, argc);
+    for (uint32_t i = 0; i < argc; ++i) CoProc::writePOD(payload, sizeof(payload), off, argv[i]);
+    CoProc::writePOD(payload, sizeof(payload), off, timeoutMs);
+    RpcJob& w = _p->rjob[j];
+    w.used = true;
+    w.kind = kind;
+    w.id = 0;
+    w.t0 = millis();
+    w.timeoutMs = timeoutMs;
+    w.done = done;
+    w.ctx = ctx;
+    if (!rpcSubmit(CoProc::CMD_EXEC_ASYNC, payload, (uint32_t)off, nullptr, nullptr, j, EXECHOST_RPC_TIMEOUT_MS)) {
+      w.used = false;
+      return false;
+    }
+    return true;
+  }
+
+  // Upload 'fname' unless the co-processor holds it, then coprocExecAsync()
+  bool coprocExecFileAsync(const char* fname, const int32_t* argv, uint32_t argc, bool script,
+                           CoprocJobDone done = nullptr, void* ctx = nullptr) {
+    if (!fname || !*fname) {
+      if (_console) _console->println("coproc start: missing file name");
+      return false;
+    }
+    if (!(script ? coprocScriptLoadFile(fname) : coprocLoadFile(fname))) return false;
+    return coprocExecAsync(script ? CoProc::CACHE_SCRIPT : CoProc::CACHE_BLOB, argv, argc, done, ctx);
+  }
+
+  // ---------------- Job queue (CMD_JOB_SUBMIT, CMD_RESULTS) ----------------
+  // Queue a run of the current blob or script on the co-processor; higher 'priority' starts first.
+  // The image can be replaced as soon as this returns. Results come back through coprocResults()
+  // (and as EVT_JOB_DONE when subscribed, printed unless an event sink is set).
+  struct CoprocResult {
+    uint32_t id;
+    int32_t status;
+    int32_t result;
+  };
+  bool coprocJobSubmit(uint32_t kind, const int32_t* argv, uint32_t argc, uint32_t priority, uint32_t* jobId = nullptr) {
+    if (!coprocHasFeature(CoProc::FEAT_JOB_QUEUE)) {
+      if (_console) _console->println("coproc(queue): co-processor has no JOB_SUBMIT");
+      return false;
+    }
+    if (argc > MAX_EXEC_ARGS) argc = MAX_EXEC_ARGS;
+    uint8_t payload[4 + 4 + 4 + MAX_EXEC_ARGS * 4 + 4];
+    size_t off = 0;
+    CoProc::writePOD(payload, sizeof(payload), off, kind);
+    CoProc::writePOD(payload, sizeof(payload), off, priority);
+    CoProc::writePOD(payload, sizeof(payload), off, argc);
+    for (uint32_t i = 0; i < argc; ++i) CoProc::writePOD(payload, sizeof(payload), off, argv[i]);
+    CoProc::writePOD(payload, sizeof(payload), off, timeout(100000));
+    uint8_t resp[8];
+    uint32_t rl = 0;
+    int32_t st = 0;
+    if (!coprocCall(CoProc::CMD_JOB_SUBMIT, payload, (uint32_t)off, resp, sizeof(resp), rl, &st, EXECHOST_RPC_TIMEOUT_MS)) return false;
+    if (st != CoProc::ST_OK || rl < 8) {
+      if (_console) _console->printf("JOB_SUBMIT: status=%d%s\n", (int)st, (st == CoProc::ST_NOMEM) ? " (queue full)" : "");
+      return false;
+    }
+    if (jobId) memcpy(jobId, resp + 4, 4);
+    return true;
+  }
+
+  // Upload 'fname' unless the co-processor holds it, then coprocJobSubmit()
+  bool coprocJobSubmitFile(const char* fname, const int32_t* argv, uint32_t argc, bool script, uint32_t priority,
+                           uint32_t* jobId = nullptr) {
+    if (!fname || !*fname) {
+      if (_console) _console->println("coproc submit: missing file name");
+      return false;
+    }
+    if (!(script ? coprocScriptLoadFile(fname) : coprocLoadFile(fname))) return false;
+    return coprocJobSubmit(script ? CoProc::CACHE_SCRIPT : CoProc::CACHE_BLOB, argv, argc, priority, jobId);
+  }
+
+  // Drain up to 'max' finished jobs, oldest first. 'dropped' counts results the ring overwrote since
+  // boot; 'pending' is the jobs still queued or running.
+  bool coprocResults(CoprocResult* out, uint32_t max, uint32_t& n, uint32_t* dropped = nullptr, uint32_t* pending = nullptr) {
+    n = 0;
+    if (!coprocHasFeature(CoProc::FEAT_JOB_QUEUE)) {
+      if (_console) _console->println("coproc(queue): co-processor has no RESULTS");
+      return false;
+    }
+    uint8_t resp[16 + EXECHOST_RESULTS_MAX * sizeof(CoprocResult)];
+    if (max > EXECHOST_RESULTS_MAX) max = EXECHOST_RESULTS_MAX;
+    uint32_t rl = 0;
+    int32_t st = 0;
+    if (!coprocCall(CoProc::CMD_RESULTS, (const uint8_t*)&max, 4, resp, sizeof(resp), rl, &st, EXECHOST_RPC_TIMEOUT_MS)) return false;
+    if (st != CoProc::ST_OK || rl < 16) {
+      if (_console) _console->printf("RESULTS: status=%d\n", (int)st);
+      return false;
+    }
+    uint32_t got = 0;
+    memcpy(&got, resp + 4, 4);
+    if (dropped) memcpy(dropped, resp + 8, 4);
+    if (pending) memcpy(pending, resp + 12, 4);
+    if (got > max || rl < 16 + got * sizeof(CoprocResult)) return false;
+    memcpy(out, resp + 16, got * sizeof(CoprocResult));
+    n = got;
+    return true;
+  }
+
+  // ---------------- Several co-processors (addCoProc, coprocSelect, coprocFan*) ----------------
+  // attachCoProc() sets up link 0 and addCoProc() adds boards on links of their own. Every coproc* call
+  // above talks to the selected link (coprocSelect); coprocPoll() serves all of them. coprocFanSubmit()
+  // queues a job here, and coprocFanPoll() places it on the least busy board that has the features and
+  // caps it asks for, drains results, and moves the jobs of a board that stops answering to the others.
+  // A moved job may run twice when the first board was only slow.
+  struct CoprocHealth {
+    bool probed = false;  // HELLO + INFO answered or failed since attach (or since the board went down)
+    bool up = false;
+    uint32_t caps = 0;  // application tags (coprocSetCaps), matched against a fan job's needCaps
+    CoProc::Info info = {};  // from the last probe
+    uint32_t fails = 0;  // link failures in a row
+    uint32_t downUntil = 0;  // millis() of the next probe while down
+    uint32_t busyUntil = 0;  // skipped for new jobs until then after refusing one
+    uint32_t lastPollMs = 0;
+    uint32_t lastProgressMs = 0;  // last placement on an idle board, or last result
+    uint32_t inFlight = 0;  // fan jobs placed and not reported yet
+    uint32_t done = 0;
+    uint32_t failTotal = 0;
+  };
+  // Fan job completion; 'link' is the board that ran it (or the last one tried)
+  typedef void (*CoprocFanDone)(void* ctx, uint32_t fanId, uint32_t link, int32_t status, int32_t result);
+
+  // Another co-processor on its own link; returns its index, or -1 when EXECHOST_COPROC_LINKS are taken
+  int addCoProc(CoProc::Link* link, uint32_t baud, uint32_t caps = 0) {
+    if (!link || _nPeers >= EXECHOST_COPROC_LINKS) return -1;
+    uint32_t i = _nPeers++;
+    peerReset(_peers[i], link, baud);
+    _peers[i].health.caps = caps;
+    return (int)i;
+  }
+  uint32_t coprocCount() const {
+    return _nPeers;
+  }
+  // Point the coproc* calls at link 'i'
+  bool coprocSelect(uint32_t i) {
+    if (i >= _nPeers) return false;
+    _p = &_peers[i];
+    return true;
+  }
+  uint32_t coprocCurrent() const {
+    return (uint32_t)(_p - _peers);
+  }
+  bool coprocSetCaps(uint32_t i, uint32_t caps) {
+    if (i >= _nPeers) return false;
+    _peers[i].health.caps = caps;
+    return true;
+  }
+  const CoprocHealth* coprocHealth(uint32_t i) const {
+    return (i < _nPeers) ? &_peers[i].health : nullptr;
+  }
+
+  // HELLO + INFO on link 'i'; a board in ISP mode answers but does not take jobs
+  bool coprocProbe(uint32_t i) {
+    if (i >= _nPeers) return false;
+    CoprocPeer* sel = _p;
+    _p = &_peers[i];
+    CoprocHealth& h = _p->health;
+    uint32_t to = _p->stats.timeouts;
+    bool ok = coprocHello(false) && coprocReadInfo(h.info);
+    h.probed = true;
+    if (ok) {
+      h.fails = 0;
+      h.up = !(h.info.impl_flags & (1u << 8));  // isp_active
+    } else {
+      h.up = false;
+      ++h.failTotal;
+      h.downUntil = millis() + EXECHOST_FAN_BACKOFF_MS;
+      if (_p->stats.timeouts != to && _console)
+        _console->printf("coproc fan: link %u (%s) not answering\n", (unsigned)i, _p->link ? _p->link->name() : "-");
+    }
+    _p = sel;
+    return ok;
+  }
+
+  // Queue a run of 'fname' (blob, or script when 'script') for whichever board suits it; returns the fan
+  // id, 0 when the table is full or the file is missing. needCaps / needFeatures: all of these bits must be
+  // set in the board's caps / HELLO features. The result arrives through coprocFanOnDone().
+  uint32_t coprocFanSubmit(const char* fname, const int32_t* argv, uint32_t argc, bool script, uint32_t priority = 0,
+                           uint32_t needCaps = 0, uint32_t needFeatures = 0) {
+    uint32_t size = 0;
+    if (!fname || !*fname || strlen(fname) > EXECHOST_FAN_NAME || !_fsValid || !_fs.getFileSize(fname, size)) {
+      if (_console) _console->printf("coproc fan: no file '%s'\n", fname ? fname : "");
+      return 0;
+    }
+    if (argc > EXECHOST_FAN_ARGS) {
+      if (_console) _console->printf("coproc fan: at most %u args\n", (unsigned)EXECHOST_FAN_ARGS);
+      return 0;
+    }
+    FanJob* j = nullptr;
+    for (uint32_t i = 0; i < EXECHOST_FAN_JOBS && !j; ++i)
+      if (_fan[i].state == FAN_FREE) j = &_fan[i];
+    if (!j) {
+      if (_console) _console->println("coproc fan: too many jobs outstanding");
+      return 0;
+    }
+    if (++_fanSeq == 0) _fanSeq = 1;
+    j->id = _fanSeq;
+    j->state = FAN_QUEUED;
+    j->script = script;
+    strcpy(j->file, fname);
+    j->prio = priority;
+    j->needCaps = needCaps;
+    j->needFeat = needFeatures | CoProc::FEAT_JOB_QUEUE;
+    j->argc = argc;
+    for (uint32_t i = 0; i < argc; ++i) j->argv[i] = argv[i];
+    j->peer = 0;
+    j->remoteId = 0;
+    j->tries = 0;
+    return j->id;
+  }
+
+  // Fan job completions (nullptr = print them)
+  void coprocFanOnDone(CoprocFanDone fn, void* ctx) {
+    _fanDone = fn;
+    _fanCtx = ctx;
+  }
+
+  // Fan jobs queued here or running on a board
+  uint32_t coprocFanPending() const {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < EXECHOST_FAN_JOBS; ++i)
+      if (_fan[i].state != FAN_FREE) ++n;
+    return n;
+  }
+
+  // Call from loop(): probes boards, places queued jobs, collects results, moves jobs off dead boards.
+  // Costs nothing while no fan job is outstanding.
+  void coprocFanPoll() {
+    if (!_nPeers || !coprocFanPending()) return;
+    CoprocPeer* sel = _p;
+    uint32_t now = millis();
+    for (uint32_t i = 0; i < _nPeers; ++i) {
+      CoprocHealth& h = _peers[i].health;
+      if (!h.probed || (!h.up && (int32_t)(now - h.downUntil) >= 0)) coprocProbe(i);
+    }
+    // Highest priority first, then oldest; stop at the first job no board takes
+    bool placed = true;
+    while (placed) {
+      FanJob* next = nullptr;
+      for (uint32_t i = 0; i < EXECHOST_FAN_JOBS; ++i) {
+        FanJob& j = _fan[i];
+        if (j.state != FAN_QUEUED) continue;
+        if (!next || j.prio > next->prio || (j.prio == next->prio && (int32_t)(j.id - next->id) < 0)) next = &j;
+      }
+      placed = next && fanPlace(*next);
+    }
+    for (uint32_t i = 0; i < _nPeers; ++i) fanCollect(i);
+    _p = sel;
+  }
+
+  // One line per link plus the fan queue
+  void coprocFanReport() {
+    if (!_console) return;
+    for (uint32_t i = 0; i < _nPeers; ++i) {
+      const CoprocPeer& pr = _peers[i];
+      const CoprocHealth& h = pr.health;
+      _console->printf("%c%u %-10s %7u bps  %-5s feat=0x%08X caps=0x%X  running=%u done=%u fails=%u\n",
+                       (&pr == _p) ? '*' : ' ', (unsigned)i, pr.link ? pr.link->name() : "-",
+                       pr.link ? (unsigned)pr.link->baud() : 0u,
+                       !h.probed ? "?" : h.up ? "up" : (h.info.impl_flags & (1u << 8)) ? "isp" : "down",
+                       (unsigned)pr.coprocFeatures, (unsigned)h.caps, (unsigned)h.inFlight, (unsigned)h.done,
+                       (unsigned)h.failTotal);
+    }
+    uint32_t queued = 0, total = coprocFanPending();
+    for (uint32_t i = 0; i < EXECHOST_FAN_JOBS; ++i)
+      if (_fan[i].state == FAN_QUEUED) ++queued;
+    _console->printf("fan jobs: %u waiting, %u placed\n", (unsigned)queued, (unsigned)(total - queued));
+  }
+
+  // ---------------- Link statistics and benchmark (CMD_STATS) ----------------
+  // Framing counters of this end; coprocStats() fetches the co-processor's and prints both
+  const CoProc::LinkStats& coprocLinkStats() const {
+    return _p->stats;
+  }
+  // reset: zero both ends once read. 'remote' (optional) receives the co-processor's counters.
+  bool coprocStats(bool reset = false, CoProc::LinkStats* remote = nullptr) {
+    CoProc::LinkStats rs = {};
+    bool haveRemote = false;
+    if (coprocHasFeature(CoProc::FEAT_STATS)) {
+      uint32_t flags = reset ? (uint32_t)CoProc::STATS_RESET : 0u;
+      uint8_t resp[8 + sizeof(CoProc::LinkStats) + 64];  // room for fields a newer co-processor appends
+      uint32_t rl = 0;
+      int32_t st = 0;
+      if (coprocCall(CoProc::CMD_STATS, (const uint8_t*)&flags, 4, resp, sizeof(resp), rl, &st, EXECHOST_RPC_TIMEOUT_MS)
+          && st == CoProc::ST_OK && rl >= 8) {
+        uint32_t n = 0;
+        memcpy(&n, resp + 4, 4);
+        if (n > CoProc::STATS_FIELDS) n = CoProc::STATS_FIELDS;
+        if (rl >= 8 + 4 * n) {
+          memcpy(&rs, resp + 8, 4 * n);
+          haveRemote = true;
+        }
+      }
+    } else if (_console) {
+      _console->println("coproc stats: co-processor has no CMD_STATS, local counters only");
+    }
+    if (_console) {
+      const uint32_t* l = (const uint32_t*)&_p->stats;
+      const uint32_t* r = (const uint32_t*)&rs;
+      _console->printf("%-12s %10s %10s\n", "link", "host", haveRemote ? "coproc" : "-");
+      for (uint32_t i = 0; i < CoProc::STATS_FIELDS; ++i)
+        _console->printf("%-12s %10u %10u\n", CoProc::statsFieldName(i), (unsigned)l[i], (unsigned)r[i]);
+    }
+    if (remote) *remote = rs;
+    if (reset) _p->stats = CoProc::LinkStats{};
+    return haveRemote;
+  }
+
+  // Measure the link: HELLO round trips, LOAD_DATA throughput per chunk size, FUNC call rate
+  // ('func' takes no arguments; single calls and, with FEAT_FUNC_BATCH, one batch) and SCRIPT_EXEC
+  // latency of a one-line script. Replaces the co-processor's current blob and script.
+  bool coprocBench(uint32_t rounds = EXECHOST_BENCH_ROUNDS, const char* func = "ping") {
+    if (!_p->link) {
+      if (_console) _console->println("coproc bench: link not attached");
+      return false;
+    }
+    if (rounds == 0) rounds = 1;
+    if (rounds > EXECHOST_BENCH_SAMPLES) rounds = EXECHOST_BENCH_SAMPLES;
+    uint32_t us[EXECHOST_BENCH_SAMPLES];
+    CoProc::Frame rh;
+    uint8_t rbuf[16];
+    uint32_t rl = 0;
+    int32_t st = 0;
+    bool ok = true;
+    if (_console) _console->printf("coproc bench: %s link at %u bps, %u rounds\n", _p->link->name(), (unsigned)_p->link->baud(),
+                                   (unsigned)rounds);
+
+    // HELLO round trip (it clears the event mask; restored below)
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < rounds; ++i) {
+      uint32_t t0 = micros();
+      if (!coprocRequest(CoProc::CMD_HELLO, nullptr, 0, rh, rbuf, sizeof(rbuf), rl, &st, EXECHOST_RPC_TIMEOUT_MS)) break;
+      us[n++] = micros() - t0;
+    }
+    if (_p->evtMask && (_p->coprocFeatures & CoProc::FEAT_ASYNC)) coprocSendSubscribe(_p->evtMask);
+    ok = benchReport("HELLO", us, n, rounds) && ok;
+
+    // LOAD_DATA throughput, legacy (acknowledged) frames
+    uint8_t chunkBuf[EXECHOST_BENCH_CHUNK_MAX];
+    for (uint32_t i = 0; i < sizeof(chunkBuf); ++i) chunkBuf[i] = (uint8_t)(i * 31u + 7u);
+    const uint32_t total = EXECHOST_BENCH_LOAD_BYTES & ~1u;
+    for (uint32_t chunk = 32; chunk <= EXECHOST_BENCH_CHUNK_MAX; chunk *= 2) {
+      uint32_t t0 = millis();
+      bool good = coprocRequest(CoProc::CMD_LOAD_BEGIN, (const uint8_t*)&total, 4, rh, rbuf, sizeof(rbuf), rl, &st)
+                  && st == CoProc::ST_OK;
+      uint32_t crc = 0;
+      for (uint32_t sent = 0; good && sent < total;) {
+        uint32_t k = (total - sent > chunk) ? chunk : total - sent;
+        good = coprocRequest(CoProc::CMD_LOAD_DATA, chunkBuf, k, rh, rbuf, sizeof(rbuf), rl, &st) && st == CoProc::ST_OK;
+        crc = CoProc::crc32_ieee(chunkBuf, k, crc);
+        sent += k;
+      }
+      good = good && coprocRequest(CoProc::CMD_LOAD_END, (const uint8_t*)&crc, 4, rh, rbuf, sizeof(rbuf), rl, &st)
+             && st == CoProc::ST_OK;
+      uint32_t ms = millis() - t0;
+      if (_console) {
+        if (good) {
+          _console->printf("  LOAD_DATA %4u B chunks: %u B in %u ms, %u B/s (%u frames)\n", (unsigned)chunk, (unsigned)total,
+                           (unsigned)ms, (unsigned)((uint64_t)total * 1000u / (ms ? ms : 1)), (unsigned)((total + chunk - 1) / chunk));
+        } else {
+          _console->printf("  LOAD_DATA %4u B chunks: failed (status=%d)\n", (unsigned)chunk, (int)st);
+        }
+      }
+      ok = good && ok;
+    }
+
+    // FUNC call rate
+    uint32_t nameLen = func ? (uint32_t)strlen(func) : 0;
+    if (nameLen && nameLen <= CoProc::FUNC_NAME_MAX) {
+      uint8_t payload[4 + CoProc::FUNC_NAME_MAX + 4];
+      size_t off = 0;
+      const uint32_t argc = 0;
+      CoProc::writePOD(payload, sizeof(payload), off, nameLen);
+      memcpy(payload + off, func, nameLen);
+      off += nameLen;
+      CoProc::writePOD(payload, sizeof(payload), off, argc);
+      n = 0;
+      uint32_t t0 = millis();
+      for (uint32_t i = 0; i < rounds; ++i) {
+        if (!coprocRequest(CoProc::CMD_FUNC, payload, (uint32_t)off, rh, rbuf, sizeof(rbuf), rl, &st) || st != CoProc::ST_OK) break;
+        ++n;
+      }
+      benchRate("FUNC", n, millis() - t0, rounds, st);
+      ok = (n == rounds) && ok;
+      int id = coprocFuncId(func);
+      if (id >= 0) {
+        CoprocBatch b;
+        while (b.count < rounds && b.len + 4 <= sizeof(b.buf) && coprocBatchAddId(b, (uint16_t)id, nullptr, 0)) {}
+        uint32_t done = 0;
+        int32_t results[EXECHOST_BENCH_SAMPLES];
+        t0 = millis();
+        bool good = coprocFuncBatch(b, results, EXECHOST_BENCH_SAMPLES, &done);
+        benchRate("FUNC_BATCH", done, millis() - t0, b.count, good ? CoProc::ST_OK : CoProc::ST_EXEC);
+        ok = good && ok;
+      }
+    }
+
+    // SCRIPT_EXEC startup: a one-line script, so the time is mostly request, VM setup and reply
+    static const char scr[] = "RET 0\n";
+    const uint32_t slen = sizeof(scr) - 1;
+    uint32_t scrc = CoProc::crc32_ieee(scr, slen);
+    bool loaded = coprocRequest(CoProc::CMD_SCRIPT_BEGIN, (const uint8_t*)&slen, 4, rh, rbuf, sizeof(rbuf), rl, &st) && st == CoProc::ST_OK
+                  && coprocRequest(CoProc::CMD_SCRIPT_DATA, (const uint8_t*)scr, slen, rh, rbuf, sizeof(rbuf), rl, &st) && st == CoProc::ST_OK
+                  && coprocRequest(CoProc::CMD_SCRIPT_END, (const uint8_t*)&scrc, 4, rh, rbuf, sizeof(rbuf), rl, &st) && st == CoProc::ST_OK;
+    n = 0;
+    if (loaded) {
+      uint32_t req[2] = { 0, 1000 };  // argc 0, timeout_ms
+      for (uint32_t i = 0; i < rounds; ++i) {
+        uint32_t t0 = micros();
+        if (!coprocRequest(CoProc::CMD_SCRIPT_EXEC, (const uint8_t*)req, sizeof(req), rh, rbuf, sizeof(rbuf), rl, &st)
+            || st != CoProc::ST_OK)
+          break;
+        us[n++] = micros() - t0;
+      }
+    }
+    ok = benchReport("SCRIPT_EXEC", us, n, rounds) && ok;
+    return ok;
+  }
+
+  // Blocking request for sketch-side helpers; async replies and events seen meanwhile are dispatched
+  bool coprocCall(uint16_t cmd, const uint8_t* payload, uint32_t len, uint8_t* resp, uint32_t cap, uint32_t& respLen,
+                  int32_t* statusOut = nullptr, uint32_t timeoutMs = 180000) {
+    CoProc::Frame rh;
+    return coprocRequest(cmd, payload, len, rh, resp, cap, respLen, statusOut, timeoutMs);
+  }
+
+private:
+  // Serial helpers
+  bool linkReadByte(uint8_t& b, uint32_t timeoutMs) {
+    if (!_p->link) return false;
+    uint32_t start = millis();
+    while ((millis() - start) <= timeoutMs) {
+      if (_p->link->available() > 0) {
+        int v = _p->link->read();
+        if (v >= 0) {
+          b = (uint8_t)v;
+          ++_p->stats.bytes_rx;
+          return true;
+        }
+      }
+      tight_loop_contents();
+      yield();
+    }
+    return false;
+  }
+
+  bool linkReadExact(uint8_t* dst, size_t n, uint32_t timeoutPerByteMs) {
+    for (size_t i = 0; i < n; ++i) {
+      if (!linkReadByte(dst[i], timeoutPerByteMs)) return false;
+    }
+    return true;
+  }
+
+  bool linkWriteAll(const uint8_t* src, size_t n, uint32_t timeoutMs) {
+    if (!_p->link) return false;
+    uint32_t start = millis();
+    size_t off = 0;
+    while (off < n) {
+      size_t wrote = _p->link->write(src + off, n - off);
+      if (wrote > 0) {
+        off += wrote;
+        _p->stats.bytes_tx += (uint32_t)wrote;
+        continue;
+      }
+      if ((millis() - start) > timeoutMs) return false;
+      yield();
+    }
+    _p->link->flush();
+    return true;
+  }
+
+  bool readResponseHeader(CoProc::Frame& rh, uint32_t overallTimeoutMs = 120000) {
+    const uint8_t magicBytes[4] = { (uint8_t)('C'), (uint8_t)('P'), (uint8_t)('R'), (uint8_t)('0') };
+    uint8_t w[4] = { 0, 0, 0, 0 };
+    uint32_t scanned = (_p->rxGot < 4) ? _p->rxGot : 0;  // bytes seen by the magic scan
+    rxFinishPartial(w);
+    uint32_t start = millis();
+    while ((millis() - start) <= overallTimeoutMs) {
+      uint8_t b;
+      if (!linkReadByte(b, 50)) {
+        rpcExpire();
+        yield();
+        continue;
+      }
+      w[0] = w[1];
+      w[1] = w[2];
+      w[2] = w[3];
+      w[3] = b;
+      ++scanned;
+      if (w[0] == magicBytes[0] && w[1] == magicBytes[1] && w[2] == magicBytes[2] && w[3] == magicBytes[3]) {
+        if (scanned > 4) {
+          ++_p->stats.resyncs;
+          _p->stats.skipped += scanned - 4;
+        }
+        scanned = 0;
+        union {
+          CoProc::Frame f;
+          uint8_t bytes[sizeof(CoProc::Frame)];
+        } u;
+        memcpy(u.bytes, w, 4);
+        if (!linkReadExact(u.bytes + 4, sizeof(CoProc::Frame) - 4, 200)) {
+          ++_p->stats.timeouts;
+          return false;
+        }
+        if (coprocDivert(u.f)) {
+          memset(w, 0, sizeof(w));
+          continue;
+        }
+        ++_p->stats.frames_rx;
+        rh = u.f;
+        return true;
+      }
+    }
+    ++_p->stats.timeouts;
+    return false;
+  }
+
+  // Send one request frame (header, payload, optional trailer CRC); 'seqOut' receives its seq
+  bool coprocSendFrame(uint16_t cmd, const uint8_t* payload, uint32_t len, uint32_t* seqOut = nullptr) {
+    if (!_p->link) {
+      if (_console) _console->println("coproc(serial): link not attached");
+      return false;
+    }
+
+    // Prepare request header
+    CoProc::Frame req{};
+    req.magic = CoProc::MAGIC;
+    req.version = CoProc::VERSION;
+    req.cmd = cmd;
+    req.seq = _p->coproc_seq++;
     req.len = len;
     uint32_t reqCrc = (len && payload) ? CoProc::crc32_ieee(payload, len) : 0;
     req.crc32 = reqCrc;
+    if (seqOut) *seqOut = req.seq;
 
     // Send header
+    ++_p->stats.frames_tx;
     if (!linkWriteAll(reinterpret_cast<const uint8_t*>(&req), sizeof(req), 2000)) {
       if (_console) _console->println("coproc(serial): write header failed");
       return false;
@@ -1203,61 +2340,79 @@ private:
       }
 #endif
     }
+    return true;
+  }
+
+  // Read the payload announced by a response header (plus the optional trailer CRC)
+  bool coprocReadBody(const CoProc::Frame& respHdr, uint8_t* respBuf, uint32_t respCap, uint32_t& respLen) {
+    respLen = 0;
+    if (!respHdr.len) return true;
+    if (respHdr.len > respCap) {
+      if (_console) _console->printf("coproc(serial): resp too large %u > cap %u\n",
+                                     (unsigned)respHdr.len, (unsigned)respCap);
+      return false;
+    }
+    if (!linkReadExact(respBuf, respHdr.len, 200)) {
+      ++_p->stats.timeouts;
+      if (_console) _console->println("coproc(serial): resp payload timeout");
+      return false;
+    }
+    respLen = respHdr.len;
+
+    // Validate header CRC over payload if present
+    if (respHdr.crc32) {
+      uint32_t c = CoProc::crc32_ieee(respBuf, respLen);
+      if (c != respHdr.crc32) {
+        // Continue anyway; some firmwares rely on trailer CRC only
+        ++_p->stats.crc_errors;
+        if (_console) _console->printf("coproc(serial): resp CRC mismatch calc=0x%08X hdr=0x%08X\n",
+                                       (unsigned)c, (unsigned)respHdr.crc32);
+      }
+    }
+
+#if EXECHOST_ACCEPT_TRAILER_CRC
+    // Opportunistically consume optional trailing CRC32(payload)
+    // Short timeout: if not present, proceed without it.
+    uint8_t tcrc[4];
+    bool gotAll = true;
+    for (int i = 0; i < 4; ++i) {
+      if (!linkReadByte(tcrc[i], 5)) {
+        gotAll = false;
+        break;
+      }
+    }
+    (void)gotAll;  // Optional: verify; not required here.
+#endif
+    return true;
+  }
+
+  bool coprocRequest(uint16_t cmd,
+                     const uint8_t* payload, uint32_t len,
+                     CoProc::Frame& respHdr,
+                     uint8_t* respBuf, uint32_t respCap, uint32_t& respLen,
+                     int32_t* statusOut = nullptr, uint32_t respTimeoutMs = 180000) {
+    if (!coprocSendFrame(cmd, payload, len)) return false;
 
     // Read response header
     memset(&respHdr, 0, sizeof(respHdr));
-    if (!readResponseHeader(respHdr, 180000)) {
+    if (!readResponseHeader(respHdr, respTimeoutMs)) {
       if (_console) _console->println("coproc(serial): read resp header timeout");
       return false;
     }
     if (respHdr.magic != CoProc::MAGIC || respHdr.version != CoProc::VERSION) {
+      ++_p->stats.bad_headers;
       if (_console) _console->println("coproc(serial): bad resp header (magic/version)");
       return false;
     }
     if (respHdr.cmd != (uint16_t)(cmd | 0x80)) {
+      ++_p->stats.bad_headers;
       if (_console) _console->printf("coproc(serial): bad resp cmd 0x%02X (expected 0x%02X)\n",
                                      (unsigned)respHdr.cmd, (unsigned)(cmd | 0x80));
       return false;
     }
 
     // Read response payload
-    respLen = 0;
-    if (respHdr.len) {
-      if (respHdr.len > respCap) {
-        if (_console) _console->printf("coproc(serial): resp too large %u > cap %u\n",
-                                       (unsigned)respHdr.len, (unsigned)respCap);
-        return false;
-      }
-      if (!linkReadExact(respBuf, respHdr.len, 200)) {
-        if (_console) _console->println("coproc(serial): resp payload timeout");
-        return false;
-      }
-      respLen = respHdr.len;
-
-      // Validate header CRC over payload if present
-      if (respHdr.crc32) {
-        uint32_t c = CoProc::crc32_ieee(respBuf, respLen);
-        if (c != respHdr.crc32) {
-          // Continue anyway; some firmwares rely on trailer CRC only
-          if (_console) _console->printf("coproc(serial): resp CRC mismatch calc=0x%08X hdr=0x%08X\n",
-                                         (unsigned)c, (unsigned)respHdr.crc32);
-        }
-      }
-
-#if EXECHOST_ACCEPT_TRAILER_CRC
-      // Opportunistically consume optional trailing CRC32(payload)
-      // Short timeout: if not present, proceed without it.
-      uint8_t tcrc[4];
-      bool gotAll = true;
-      for (int i = 0; i < 4; ++i) {
-        if (!linkReadByte(tcrc[i], 5)) {
-          gotAll = false;
-          break;
-        }
-      }
-      (void)gotAll;  // Optional: verify; not required here.
-#endif
-    }
+    if (!coprocReadBody(respHdr, respBuf, respCap, respLen)) return false;
 
     // Extract status if requested
     if (statusOut) {
@@ -1272,19 +2427,929 @@ private:
     return true;
   }
 
+  // ---------------- Async RPC plumbing ----------------
+  struct RpcSlot {
+    bool used;
+    uint16_t cmd;
+    uint32_t seq;
+    uint32_t t0;
+    uint32_t timeoutMs;
+    int job;  // >= 0: EXEC_ASYNC start reply for _p->rjob[job]
+    CoprocDone done;
+    void* ctx;
+  };
+  struct RpcJob {
+    bool used;
+    uint32_t kind;
+    uint32_t id;  // 0 until the EXEC_ASYNC reply names it
+    uint32_t t0;
+    uint32_t timeoutMs;
+    CoprocJobDone done;
+    void* ctx;
+  };
+
+  static void futureDone(void* ctx, int32_t status, const uint8_t* resp, uint32_t len) {
+    CoprocFuture* f = (CoprocFuture*)ctx;
+    f->status = status;
+    f->len = (len < sizeof(f->resp)) ? len : (uint32_t)sizeof(f->resp);
+    if (f->len) memcpy(f->resp, resp, f->len);
+    f->done = true;
+  }
+
+  uint32_t rpcSubmit(uint16_t cmd, const uint8_t* payload, uint32_t len, CoprocDone done, void* ctx, int job,
+                     uint32_t timeoutMs) {
+    int i = -1;
+    for (uint32_t k = 0; k < EXECHOST_RPC_SLOTS && i < 0; ++k)
+      if (!_p->rpc[k].used) i = (int)k;
+    if (i < 0) {
+      if (_console) _console->println("coproc(async): request table full");
+      return 0;
+    }
+    uint32_t seq = 0;
+    if (!coprocSendFrame(cmd, payload, len, &seq)) return 0;
+    RpcSlot& s = _p->rpc[i];
+    s.used = true;
+    s.cmd = cmd;
+    s.seq = seq;
+    s.t0 = millis();
+    s.timeoutMs = timeoutMs;
+    s.job = job;
+    s.done = done;
+    s.ctx = ctx;
+    return seq;
+  }
+
+  int rpcFind(uint32_t seq) const {
+    for (uint32_t i = 0; i < EXECHOST_RPC_SLOTS; ++i)
+      if (_p->rpc[i].used && _p->rpc[i].seq == seq) return (int)i;
+    return -1;
+  }
+
+  void rpcComplete(int i, int32_t status, const uint8_t* resp, uint32_t len) {
+    RpcSlot s = _p->rpc[i];
+    _p->rpc[i].used = false;  // free first: the callback may submit again
+    if (s.job >= 0) {
+      rjobStarted(s.job, status, resp, len);
+    } else if (s.done) {
+      s.done(s.ctx, status, resp, len);
+    }
+  }
+
+  void rjobStarted(int j, int32_t status, const uint8_t* resp, uint32_t len) {
+    RpcJob& w = _p->rjob[j];
+    if (status == CoProc::ST_OK && len >= 8) {
+      memcpy(&w.id, resp + 4, 4);
+      w.t0 = millis();
+      if (!w.done && _console) _console->printf("CoProc job %u started\n", (unsigned)w.id);
+      return;
+    }
+    rjobFinish(j, 0, (status == CoProc::ST_OK) ? (int32_t)CoProc::ST_PARAM : status, 0);
+  }
+
+  void rjobFinish(int j, uint32_t id, int32_t status, int32_t result) {
+    RpcJob w = _p->rjob[j];
+    _p->rjob[j].used = false;
+    if (w.done) {
+      w.done(w.ctx, id, status, result);
+    } else if (_console) {
+      _console->printf("CoProc job %u%s: status=%d return=%d\n", (unsigned)id,
+                       (w.kind == CoProc::CACHE_SCRIPT) ? " (script)" : "", (int)status, (int)result);
+    }
+  }
+
+  void rpcExpire() {
+    uint32_t now = millis();
+    for (uint32_t i = 0; i < EXECHOST_RPC_SLOTS; ++i)
+      if (_p->rpc[i].used && (now - _p->rpc[i].t0) > _p->rpc[i].timeoutMs) {
+        ++_p->stats.timeouts;
+        rpcComplete((int)i, CoProc::ST_TIMEOUT, nullptr, 0);
+      }
+    for (uint32_t j = 0; j < EXECHOST_RPC_JOBS; ++j) {
+      const RpcJob& w = _p->rjob[j];
+      if (w.used && w.id && w.timeoutMs && (now - w.t0) > w.timeoutMs + EXECHOST_RPC_JOB_GRACE_MS)
+        rjobFinish((int)j, w.id, CoProc::ST_TIMEOUT, 0);
+    }
+  }
+
+  bool coprocSendSubscribe(uint32_t mask) {
+    CoProc::Frame rh;
+    uint8_t rbuf[8];
+    uint32_t rl = 0;
+    int32_t st = 0;
+    if (!coprocRequest(CoProc::CMD_SUBSCRIBE, (const uint8_t*)&mask, 4, rh, rbuf, sizeof(rbuf), rl, &st)) return false;
+    return st == CoProc::ST_OK;
+  }
+
+  // A whole frame no blocking call waits for: an event or a coprocSubmit() reply
+  void rxDispatch(const CoProc::Frame& f, const uint8_t* body, uint32_t len, bool truncated) {
+    int32_t linkErr = truncated ? (int32_t)CoProc::ST_SIZE : 0;
+    if (!truncated && len && f.crc32 && CoProc::crc32_ieee(body, len) != f.crc32) linkErr = CoProc::ST_CRC;
+    ++_p->stats.frames_rx;
+    if (linkErr == CoProc::ST_CRC) ++_p->stats.crc_errors;
+    if (f.cmd == (uint16_t)(CoProc::CMD_EVENT | 0x80)) {
+      if (!linkErr && len >= 4) rxEvent(body, len);
+      return;
+    }
+    int i = rpcFind(f.seq);
+    if (i < 0 || f.cmd != (uint16_t)(_p->rpc[i].cmd | 0x80)) return;  // late reply to a request that timed out
+    int32_t st = CoProc::ST_OK;
+    if (linkErr) {
+      st = linkErr;
+      len = 0;
+    } else if (len >= 4) {
+      memcpy(&st, body, 4);
+    }
+    rpcComplete(i, st, body, len);
+  }
+
+  void rxEvent(const uint8_t* p, uint32_t len) {
+    uint32_t type = 0, a = 0, b = 0, c = 0;
+    memcpy(&type, p, 4);
+    if (len >= 8) memcpy(&a, p + 4, 4);
+    if (len >= 12) memcpy(&b, p + 8, 4);
+    if (len >= 16) memcpy(&c, p + 12, 4);
+    bool handled = false;
+    if (type == CoProc::EVT_JOB_DONE && len >= 16) {
+      for (uint32_t j = 0; j < EXECHOST_RPC_JOBS && !handled; ++j) {
+        if (_p->rjob[j].used && _p->rjob[j].id == a) {
+          rjobFinish((int)j, a, (int32_t)b, (int32_t)c);
+          handled = true;
+        }
+      }
+    } else if (type == CoProc::EVT_ERROR && len >= 16) {
+      // Dropped request: fail its waiter now instead of at the deadline
+      int i = rpcFind(c);
+      if (i >= 0) rpcComplete(i, (int32_t)a, nullptr, 0);
+    }
+    if (_evtFn) {
+      _evtFn(_evtCtx, type, p + 4, len - 4);
+      return;
+    }
+    if (!_console) return;
+    if (type == CoProc::EVT_JOB_DONE && !handled && len >= 16) {
+      _console->printf("CoProc job %u: status=%d return=%d\n", (unsigned)a, (int)b, (int)c);
+    } else if (type == CoProc::EVT_MAILBOX && len >= 8) {
+      _console->printf("CoProc mailbox: %u byte(s) ready\n", (unsigned)a);
+    } else if (type == CoProc::EVT_ERROR && len >= 16) {
+      _console->printf("CoProc error: status=%d cmd=0x%02X seq=%u\n", (int)a, (unsigned)b, (unsigned)c);
+    }
+  }
+
+  // coprocPoll() frame assembly: magic, header, then the body (kept up to EXECHOST_RPC_BODY_MAX)
+  void rxFeed(uint8_t b) {
+    static const uint8_t magic[4] = { (uint8_t)('C'), (uint8_t)('P'), (uint8_t)('R'), (uint8_t)('0') };
+    if (_p->rxGot < 4) {
+      if (b == magic[_p->rxGot]) {
+        _p->rxHdr.bytes[_p->rxGot++] = b;
+        if (_p->rxGot == 4 && _p->rxSkipped) {
+          ++_p->stats.resyncs;
+          _p->stats.skipped += _p->rxSkipped;
+          _p->rxSkipped = 0;
+        }
+      } else {
+        _p->rxSkipped += _p->rxGot;
+        _p->rxGot = 0;
+        if (b == magic[0]) _p->rxHdr.bytes[_p->rxGot++] = b;
+        else ++_p->rxSkipped;
+      }
+      return;
+    }
+    if (_p->rxGot < sizeof(CoProc::Frame)) {
+      _p->rxHdr.bytes[_p->rxGot++] = b;
+      if (_p->rxGot < sizeof(CoProc::Frame)) return;
+      if (_p->rxHdr.f.version != CoProc::VERSION || _p->rxHdr.f.len > EXECHOST_RX_LEN_MAX) {
+        ++_p->stats.bad_headers;
+        _p->rxGot = 0;  // not a frame: resync on the next magic
+      } else if (_p->rxHdr.f.len == 0) {
+        rxEnd();
+      }
+      return;
+    }
+    uint32_t pos = _p->rxGot - (uint32_t)sizeof(CoProc::Frame);
+    if (pos < EXECHOST_RPC_BODY_MAX) _p->rxBody[pos] = b;
+    ++_p->rxGot;
+    if (pos + 1 == _p->rxHdr.f.len) rxEnd();
+  }
+
+  void rxEnd() {
+    CoProc::Frame f = _p->rxHdr.f;
+    _p->rxGot = 0;
+    bool truncated = f.len > EXECHOST_RPC_BODY_MAX;
+    rxDispatch(f, _p->rxBody, truncated ? 0 : f.len, truncated);
+  }
+
+  // Before a blocking read scans the link: finish the frame coprocPoll() was in the middle of, or hand
+  // a partly matched magic to the scanner window 'w'
+  void rxFinishPartial(uint8_t w[4]) {
+    if (_p->rxGot >= 4) {
+      uint8_t b;
+      while (_p->rxGot && linkReadByte(b, 200)) rxFeed(b);
+    } else {
+      for (uint32_t i = 0; i < _p->rxGot; ++i) w[4 - _p->rxGot + i] = _p->rxHdr.bytes[i];
+    }
+    _p->rxGot = 0;
+  }
+
+  // Blocking readers hand over frames that belong to the async side (events, coprocSubmit() replies)
+  bool coprocDivert(const CoProc::Frame& f) {
+    if (f.magic != CoProc::MAGIC || f.version != CoProc::VERSION) return false;
+    if (f.cmd != (uint16_t)(CoProc::CMD_EVENT | 0x80)) {
+      int i = rpcFind(f.seq);
+      if (i < 0 || f.cmd != (uint16_t)(_p->rpc[i].cmd | 0x80)) return false;
+    }
+    if (f.len > EXECHOST_RPC_BODY_MAX) {
+      uint8_t sink[32];
+      for (uint32_t left = f.len; left;) {
+        uint32_t n = (left > sizeof(sink)) ? (uint32_t)sizeof(sink) : left;
+        if (!linkReadExact(sink, n, 200)) return true;
+        left -= n;
+      }
+      rxDispatch(f, _p->rxBody, 0, true);
+      return true;
+    }
+    if (!linkReadExact(_p->rxBody, f.len, 200)) return true;  // lost; the request runs into its deadline
+    rxDispatch(f, _p->rxBody, f.len, false);
+    return true;
+  }
+
+  // ---------------- Windowed uploads (CMD_*_WDATA) ----------------
+  // Source of upload bytes: copy 'n' bytes at 'off' into 'dst'
+  typedef bool (*XferFetch)(void* ctx, uint32_t off, uint8_t* dst, uint32_t n);
+  struct FileFetch {
+    const ExecFSTable* fs;
+    const char* fname;
+  };
+  static bool fetchFromMemory(void* ctx, uint32_t off, uint8_t* dst, uint32_t n) {
+    memcpy(dst, (const uint8_t*)ctx + off, n);
+    return true;
+  }
+  static bool fetchFromFile(void* ctx, uint32_t off, uint8_t* dst, uint32_t n) {
+    const FileFetch* f = (const FileFetch*)ctx;
+    return f->fs->readFileRange && f->fs->readFileRange(f->fname, off, dst, n) == n;
+  }
+
+  // Image packed for a compressed upload; data == nullptr means send it raw
+  struct PackedImage {
+    uint8_t* data = nullptr;
+    uint32_t len = 0;
+    uint32_t rawCrc = 0;  // CRC32 of the decoded image (what *_END checks)
+    ~PackedImage() {
+      free(data);
+    }
+  };
+
+  // *_BEGIN offering a windowed upload, compressed when 'pk' holds a packed image. Returns 2 (windowed,
+  // send pk), 1 (windowed, raw), 0 (the co-processor answered with a plain status, so use *_DATA) or
+  // -1 on failure.
+  int coprocBeginTransfer(uint16_t beginCmd, const char* what, uint32_t total, uint32_t& chunk, uint32_t& window,
+                          const PackedImage* pk = nullptr) {
+    uint32_t req[5] = { total, (uint32_t)EXECHOST_WIN_CHUNK, (uint32_t)EXECHOST_WIN_FRAMES, CoProc::CODEC_LZ4, 0 };
+    uint32_t reqLen = 12;
+    if (pk && pk->data) {
+      req[4] = pk->len;
+      reqLen = sizeof(req);
+    }
+    CoProc::Frame rh;
+    uint8_t rbuf[32];
+    uint32_t rl = 0;
+    int32_t st = 0;
+    chunk = window = 0;
+    if (!coprocRequest(beginCmd, (const uint8_t*)req, reqLen, rh, rbuf, sizeof(rbuf), rl, &st)) return -1;
+    if (st != CoProc::ST_OK) {
+      if (_console) _console->printf("%s failed st=%d\n", what, st);
+      return -1;
+    }
+    if (rl < 12) return 0;
+    memcpy(&chunk, rbuf + 4, 4);
+    memcpy(&window, rbuf + 8, 4);
+    if (window > CoProc::WIN_MAX) window = CoProc::WIN_MAX;
+    if (chunk == 0 || window == 0 || chunk > (uint32_t)EXECHOST_WIN_CHUNK) return 0;
+    uint32_t codec = CoProc::CODEC_NONE;
+    if (rl >= 16) memcpy(&codec, rbuf + 12, 4);
+    return (reqLen > 12 && codec == CoProc::CODEC_LZ4) ? 2 : 1;
+  }
+
+  // ---------------- Compressed uploads ----------------
+  bool coprocHasFeature(uint32_t bit) {
+    if (!_p->coprocFeaturesKnown) coprocHello(false);
+    return (_p->coprocFeatures & bit) != 0;
+  }
+
+  // ---------------- Content cache (CMD_QUERY / CMD_EXEC_CACHED) ----------------
+  // CRC32 of a file, the key the co-processor files the image under; false when it has no cache
+  bool coprocImageKey(const char* fname, uint32_t size, uint32_t& crc) {
+    if (!size || !coprocHasFeature(CoProc::FEAT_CACHE)) return false;
+    uint8_t buf[256];
+    uint32_t c = 0xFFFFFFFFu;
+    for (uint32_t off = 0; off < size;) {
+      uint32_t n = (size - off > sizeof(buf)) ? (uint32_t)sizeof(buf) : size - off;
+      if (_fs.readFileRange(fname, off, buf, n) != n) return false;
+      c = Crc32::update(c, buf, n);
+      off += n;
+    }
+    crc = c ^ 0xFFFFFFFFu;
+    return true;
+  }
+
+  // QUERY with QUERY_SELECT: true when the co-processor made the held image current
+  bool coprocCacheSelect(uint32_t kind, uint32_t len, uint32_t crc, const char* what) {
+    uint32_t req[4] = { kind, len, crc, CoProc::QUERY_SELECT };
+    CoProc::Frame rh;
+    uint8_t rbuf[16];
+    uint32_t rl = 0;
+    int32_t st = 0;
+    if (!coprocRequest(CoProc::CMD_QUERY, (const uint8_t*)req, sizeof(req), rh, rbuf, sizeof(rbuf), rl, &st)) return false;
+    if (st != CoProc::ST_OK) return false;
+    if (_console) _console->printf("%s cached: %u bytes, crc=0x%08X (no upload)\n", what, (unsigned)len, (unsigned)crc);
+    return true;
+  }
+
+  // EXEC_CACHED: 1 = ran from the cache, 0 = not held (upload needed), -1 = failed
+  int coprocExecCached(uint32_t kind, uint32_t len, uint32_t crc, const int32_t* argv, uint32_t argc) {
+    if (argc > MAX_EXEC_ARGS) argc = MAX_EXEC_ARGS;
+    uint32_t timeoutMs = timeout(100000);
+    uint8_t payload[12 + 4 + MAX_EXEC_ARGS * 4 + 4];
+    uint32_t key[3] = { kind, len, crc };
+    size_t off = 0;
+    memcpy(payload + off, key, sizeof(key));
+    off += sizeof(key);
+    memcpy(payload + off, &argc, 4);
+    off += 4;
+    if (argc) memcpy(payload + off, argv, argc * 4);
+    off += argc * 4;
+    memcpy(payload + off, &timeoutMs, 4);
+    off += 4;
+    CoProc::Frame rh;
+    uint8_t rbuf[16];
+    uint32_t rl = 0;
+    int32_t st = 0;
+    if (!coprocRequest(CoProc::CMD_EXEC_CACHED, payload, (uint32_t)off, rh, rbuf, sizeof(rbuf), rl, &st)) return -1;
+    if (rl < 8) {
+      if (_console) _console->println("coproc: short EXEC_CACHED response");
+      return -1;
+    }
+    if (st == CoProc::ST_NOT_FOUND) return 0;
+    int32_t retCode = 0;
+    memcpy(&retCode, rbuf + 4, 4);
+    const bool script = (kind == CoProc::CACHE_SCRIPT);
+    if (_console) _console->printf("CoProc %s (cached): status=%d return=%d\n", script ? "SCRIPT EXEC" : "EXEC", (int)st, (int)retCode);
+    if (script) (void)coprocMailboxRead(BLOB_MAILBOX_MAX);
+    return 1;
+  }
+
+  // LZ4-pack 'raw' if the co-processor can decode it and it saves at least 1/16 of the bytes
+  bool coprocPack(const uint8_t* raw, uint32_t n, PackedImage& pk) {
+#if EXECHOST_LZ4
+    if (n < 64 || n > EXECHOST_LZ4_MAX_INPUT || !coprocHasFeature(CoProc::FEAT_LZ4)) return false;
+    uint32_t cap = n - n / 16u;
+    uint8_t* dst = (uint8_t*)malloc(cap);
+    uint32_t* table = (uint32_t*)malloc(Lz4::HASH_ENTRIES * sizeof(uint32_t));
+    uint32_t m = (dst && table) ? Lz4::compress(raw, n, dst, cap, table) : 0;
+    free(table);
+    if (!m) {
+      free(dst);
+      return false;
+    }
+    pk.data = dst;
+    pk.len = m;
+    pk.rawCrc = Crc32::compute(raw, n);
+    return true;
+#else
+    (void)raw;
+    (void)n;
+    (void)pk;
+    return false;
+#endif
+  }
+
+  bool coprocPackFile(const char* fname, uint32_t size, PackedImage& pk) {
+#if EXECHOST_LZ4
+    if (size > EXECHOST_LZ4_MAX_INPUT || !coprocHasFeature(CoProc::FEAT_LZ4)) return false;
+    uint8_t* raw = (uint8_t*)malloc(size);
+    if (!raw) return false;
+    bool ok = _fs.readFileRange(fname, 0, raw, size) == size && coprocPack(raw, size, pk);
+    free(raw);
+    return ok;
+#else
+    (void)fname;
+    (void)size;
+    (void)pk;
+    return false;
+#endif
+  }
+
+  // "CoProc LOAD OK (...)" with transfer mode, compression ratio and effective throughput
+  // Stage the image in the shared PSRAM window and hand it over with one CMD_LOAD_REF. False means
+  // "not done": the caller falls back to the serial upload.
+  bool coprocLoadRef(uint32_t kind, uint32_t len, XferFetch fetch, void* ctx, const char* what) {
+    if (!_p->shared || !CoProc::sharedRefValid(CoProc::SHARED_REF_BASE, len) || !coprocHasFeature(CoProc::FEAT_LOAD_REF))
+      return false;
+    uint32_t t0 = millis();
+    uint32_t crc = 0;
+    if (!CoProc::sharedStage(*_p->shared, len, fetch, ctx, crc)) {
+      if (_console) _console->printf("%s: staging in shared PSRAM failed, using the link\n", what);
+      return false;
+    }
+    uint32_t req[4] = { kind, CoProc::SHARED_REF_BASE, len, crc };
+    CoProc::Frame rh;
+    uint8_t rbuf[8];
+    uint32_t rl = 0;
+    int32_t st = 0;
+    if (!coprocRequest(CoProc::CMD_LOAD_REF, (const uint8_t*)req, sizeof(req), rh, rbuf, sizeof(rbuf), rl, &st)) return false;
+    if (st != CoProc::ST_OK) {
+      if (_console) _console->printf("%s: LOAD_REF st=%d, using the link\n", what, (int)st);
+      return false;
+    }
+    coprocPrintLoadOk(what, len, 0, PackedImage{}, t0, " via shared PSRAM");
+    return true;
+  }
+
+  // coprocBench(): latency percentiles of n samples (sorted in place)
+  bool benchReport(const char* what, uint32_t* us, uint32_t n, uint32_t want) {
+    for (uint32_t i = 1; i < n; ++i) {
+      uint32_t v = us[i], j = i;
+      for (; j && us[j - 1] > v; --j) us[j] = us[j - 1];
+      us[j] = v;
+    }
+    if (!_console) return n == want;
+    if (!n) {
+      _console->printf("  %-11s failed\n", what);
+      return false;
+    }
+    _console->printf("  %-11s us: min %u  p50 %u  p90 %u  p99 %u  max %u (%u/%u ok)\n", what, (unsigned)us[0],
+                     (unsigned)us[(n - 1) * 50 / 100], (unsigned)us[(n - 1) * 90 / 100], (unsigned)us[(n - 1) * 99 / 100],
+                     (unsigned)us[n - 1], (unsigned)n, (unsigned)want);
+    return n == want;
+  }
+  void benchRate(const char* what, uint32_t n, uint32_t ms, uint32_t want, int32_t st) {
+    if (!_console) return;
+    if (n < want) _console->printf("  %-11s stopped after %u of %u calls (status=%d)\n", what, (unsigned)n, (unsigned)want, (int)st);
+    if (n) _console->printf("  %-11s %u calls in %u ms, %u calls/s\n", what, (unsigned)n, (unsigned)ms,
+                            (unsigned)((uint64_t)n * 1000u / (ms ? ms : 1)));
+  }
+
+  void coprocPrintLoadOk(const char* what, uint32_t size, int mode, const PackedImage& pk, uint32_t t0,
+                         const char* tail = "") {
+    if (!_console) return;
+    uint32_t ms = millis() - t0;
+    char lz[40] = "";
+    if (mode == 2) {
+      uint32_t pm = (uint32_t)((uint64_t)pk.len * 1000u / size);
+      snprintf(lz, sizeof(lz), ", lz4 %u->%u (%u.%u%%)", (unsigned)size, (unsigned)pk.len, (unsigned)(pm / 10),
+               (unsigned)(pm % 10));
+    }
+    _console->printf("CoProc %s OK (%u bytes%s%s, %u ms, %u B/s)%s\n", what, (unsigned)size,
+                     mode > 0 ? ", windowed" : "", lz, (unsigned)ms,
+                     (unsigned)((uint64_t)size * 1000u / (ms ? ms : 1)), tail);
+  }
+
+  // Stream 'total' bytes as *_WDATA bursts of up to 'window' frames. Only the last frame of a burst
+  // asks for an ACK; NAKed chunks and anything past the co-processor's 'high' mark are resent, and
+  // a lost ACK is recovered with an empty poll frame. crcOut: CRC32 of the whole image.
+  bool coprocSendWindowed(uint16_t cmd, uint32_t total, uint32_t chunk, uint32_t window,
+                          XferFetch fetch, void* ctx, uint32_t& crcOut) {
+    const uint32_t nChunks = (total + chunk - 1) / chunk;
+    uint8_t* frame = (uint8_t*)malloc(CoProc::WIN_HDR_BYTES + chunk);
+    if (!frame) {
+      if (_console) _console->println("coproc: window buffer malloc failed");
+      return false;
+    }
+    uint32_t base = 0, next = 0, nak = 0;
+    uint32_t crcState = 0xFFFFFFFFu, crcNext = 0;  // chunks are folded once, in order
+    uint32_t stall = 0, resent = 0, bursts = 0;
+    bool poll = false, ok = false;
+    uint32_t t0 = millis();
+    while (base < nChunks) {
+      // Burst: NAKed chunks first, then new ones inside the window (none when polling)
+      uint32_t list[CoProc::WIN_MAX];
+      uint32_t n = 0;
+      for (uint32_t i = 0; !poll && i < CoProc::WIN_MAX && n < window; ++i) {
+        if (nak & (1u << i)) list[n++] = base + i;
+      }
+      resent += n;
+      while (!poll && n < window && next < nChunks && next < base + window) list[n++] = next++;
+      nak = 0;
+      poll = false;
+      uint32_t ackSeq = 0;
+      bool sent = true;
+      if (n == 0) {
+        uint32_t hdr[2] = { 0, CoProc::WIN_ACK_REQ };
+        sent = coprocSendFrame(cmd, (const uint8_t*)hdr, sizeof(hdr), &ackSeq);
+      }
+      for (uint32_t k = 0; k < n && sent; ++k) {
+        uint32_t idx = list[k];
+        uint32_t off = idx * chunk;
+        uint32_t len = (total - off < chunk) ? total - off : chunk;
+        uint32_t flags = (k == n - 1) ? CoProc::WIN_ACK_REQ : 0u;
+        memcpy(frame, &idx, 4);
+        memcpy(frame + 4, &flags, 4);
+        if (!fetch(ctx, off, frame + CoProc::WIN_HDR_BYTES, len)) {
+          if (_console) _console->println("coproc: read error");
+          sent = false;
+          break;
+        }
+        if (idx == crcNext) {
+          crcState = CoProc::crc32_ieee(frame + CoProc::WIN_HDR_BYTES, len, crcState) ^ 0xFFFFFFFFu;
+          ++crcNext;
+        }
+        sent = coprocSendFrame(cmd, frame, CoProc::WIN_HDR_BYTES + len, &ackSeq);
+      }
+      if (!sent) break;
+      ++bursts;
+      // Wait for this burst's ACK; replies to anything else are stale and skipped
+      uint32_t ack[4];
+      if (!coprocReadAck(cmd, ackSeq, ack)) {
+        if (++stall > EXECHOST_WIN_RETRIES) {
+          if (_console) _console->println("coproc: windowed upload stalled (no ACK)");
+          break;
+        }
+        poll = true;
+        continue;
+      }
+      if ((int32_t)ack[0] != CoProc::ST_OK) {
+        if (_console) _console->printf("coproc: WDATA st=%d at chunk %u\n", (int)(int32_t)ack[0], (unsigned)ack[1]);
+        break;
+      }
+      if (ack[1] > nChunks || ack[1] < base) {
+        if (_console) _console->println("coproc: bad window ACK");
+        break;
+      }
+      stall = (ack[1] > base) ? 0 : stall + 1;
+      if (stall > EXECHOST_WIN_RETRIES) {
+        if (_console) _console->println("coproc: windowed upload stalled (no progress)");
+        break;
+      }
+      base = ack[1];
+      nak = ack[2];
+      if (ack[3] < next) next = (ack[3] > base) ? ack[3] : base;  // tail of the burst never arrived
+      if (base >= nChunks) ok = true;
+    }
+    free(frame);
+    crcOut = crcState ^ 0xFFFFFFFFu;
+    if (ok && _console) {
+      _console->printf("CoProc window: %u x %u B, %u bursts, %u resent, %u ms\n", (unsigned)nChunks,
+                       (unsigned)chunk, (unsigned)bursts, (unsigned)resent, (unsigned)(millis() - t0));
+    }
+    return ok;
+  }
+
+  // Read the ACK for frame 'seq' (status, ack, nak_mask, high), skipping unrelated replies
+  bool coprocReadAck(uint16_t cmd, uint32_t seq, uint32_t ack[4]) {
+    uint32_t start = millis();
+    while ((uint32_t)(millis() - start) <= EXECHOST_WIN_ACK_MS) {
+      CoProc::Frame rh;
+      uint8_t buf[64];
+      uint32_t rl = 0;
+      if (!readResponseHeader(rh, EXECHOST_WIN_ACK_MS)) return false;
+      if (rh.magic != CoProc::MAGIC || rh.version != CoProc::VERSION) continue;
+      if (!coprocReadBody(rh, buf, sizeof(buf), rl)) return false;
+      if (rh.cmd != (uint16_t)(cmd | 0x80) || rh.seq != seq) continue;
+      if (rl < 16) {
+        // Status-only reply (e.g. ST_STATE): report it with no progress
+        int32_t st = CoProc::ST_PARAM;
+        if (rl >= 4) memcpy(&st, buf, 4);
+        ack[0] = (uint32_t)(st == CoProc::ST_OK ? CoProc::ST_PARAM : st);
+        ack[1] = ack[2] = ack[3] = 0;
+        return true;
+      }
+      memcpy(ack, buf, 16);
+      return true;
+    }
+    return false;
+  }
+
 private:
+  // RBL1 container: read tables, load image into an aligned buffer (+bss), then relocate and link
+  bool loadRelocBlob(const char* fname, uint32_t fileSize, const RBlob::Header& h,
+                     void*& rawOut, uint8_t*& alignedBuf, uint32_t& szOut, uint32_t& entryOut) {
+    RBlob::OverlayHeader oh{};
+    const bool ovl = (h.version == RBlob::VERSION_OVL);
+    if (ovl && _fs.readFileRange(fname, sizeof(h), (uint8_t*)&oh, sizeof(oh)) != sizeof(oh)) {
+      if (_console) _console->println("load: read failed");
+      return false;
+    }
+    const char* why = RBlob::validate(h, fileSize, ovl ? &oh : nullptr);
+    if (why) {
+      if (_console) _console->printf("load: bad RBL1 container (%s)\n", why);
+      return false;
+    }
+    uint32_t tsz = RBlob::tablesSize(h, ovl ? &oh : nullptr);
+    uint8_t* tables = nullptr;
+    if (tsz) {
+      tables = (uint8_t*)malloc(tsz);
+      if (!tables) {
+        if (_console) _console->println("load: malloc failed");
+        return false;
+      }
+      if (_fs.readFileRange(fname, h.headerSize, tables, tsz) != tsz) {
+        if (_console) _console->println("load: read failed");
+        free(tables);
+        return false;
+      }
+    }
+    // Overlay programs: the region sits right after root+bss; overlays stay on the FS
+    const uint32_t rootSize = h.imageSize + h.bssSize;
+    uint32_t memSize = rootSize + (ovl ? oh.regionSize : 0u);
+    void* raw = malloc(memSize + 4);
+    if (!raw) {
+      if (_console) _console->println("load: malloc failed");
+      free(tables);
+      return false;
+    }
+    uint8_t* buf = (uint8_t*)((((uintptr_t)raw) + 3) & ~((uintptr_t)3));
+    if (_fs.readFileRange(fname, h.headerSize + tsz, buf, h.imageSize) != h.imageSize) {
+      if (_console) _console->println("load: read failed");
+      free(raw);
+      free(tables);
+      return false;
+    }
+    const char* badName = nullptr;
+    uint16_t badId = 0;
+    why = RBlob::link(h, tables, buf, _exports, _nExports, &badName, &badId);
+    RBlob::OverlayDesc* desc = nullptr;
+    if (!why && ovl) {
+      // Keep only the overlay table; it is consulted on every page-in
+      uint32_t dsz = (uint32_t)oh.nOverlays * sizeof(RBlob::OverlayDesc);
+      desc = (RBlob::OverlayDesc*)malloc(dsz);
+      if (!desc) {
+        why = "malloc failed";
+      } else {
+        memcpy(desc, tables + tsz - dsz, dsz);
+        for (uint32_t i = 0; i < oh.nOverlays && !why; ++i) why = RBlob::validateOverlay(desc[i], oh, fileSize);
+        if (why) {
+          free(desc);
+          desc = nullptr;
+        }
+      }
+    }
+    free(tables);
+    if (why) {
+      if (_console) {
+        if (badName) _console->printf("load: %s '%s'\n", why, badName);
+        else if (badId) _console->printf("load: %s id=%u\n", why, (unsigned)badId);
+        else _console->printf("load: %s\n", why);
+      }
+      free(raw);
+      return false;
+    }
+    if (_console) {
+      _console->printf("load: RBL1 image=%u bss=%u relocs=%u imports=%u entry=+0x%X\n",
+                       (unsigned)h.imageSize, (unsigned)h.bssSize, (unsigned)h.nRelocs,
+                       (unsigned)h.nImports, (unsigned)h.entryOff);
+      if (ovl) {
+        _console->printf("load: %u overlays paged through a %u-byte region\n",
+                         (unsigned)oh.nOverlays, (unsigned)oh.regionSize);
+      }
+    }
+    if (ovl) execOvlBegin(fname, fileSize, _fs.readFileRange, oh, desc, buf, rootSize, buf + rootSize);
+    rawOut = raw;
+    alignedBuf = buf;
+    szOut = memSize;
+    entryOut = h.entryOff;
+    return true;
+  }
+
   struct ExecJob {
+    uintptr_t code;
+    uint32_t size;
+    uint32_t argc;
+    bool profile;  // paint the core1 stack for this run
+    int32_t args[MAX_EXEC_ARGS];
+  };
+
+  enum : uint8_t { JOB_FREE = 0,
+                   JOB_QUEUED,
+                   JOB_RUNNING,
+                   JOB_DONE };
+  struct JobSlot {
+    volatile uint8_t state;
+    volatile uint8_t cancel;  // cancellation token: checked by core1 before start, mirrored to the mailbox flag
+    uint8_t prio;
+    uint32_t id;
+    uint32_t seq;
+    void* raw;
     uintptr_t code;
     uint32_t size;
     uint32_t argc;
     int32_t args[MAX_EXEC_ARGS];
+    uint32_t timeoutMs;
+    uint32_t submitMs;
+    volatile uint32_t startMs;
+    uint32_t killAtMs;
+    char name[32 + 1];  // filename max = 32 per original ActiveFS::MAX_NAME
+  };
+  struct JobDone {
+    uint32_t slot;
+    int32_t result;
+    int32_t status;
+    uint32_t runUs;
+    uint32_t cycles;
+    uint32_t cyclesExact;
+    uint32_t mbxEnd;  // ring position after the job's last output
+    char info[EXECHOST_JOB_INFO];
+  };
+  struct JobHist {
+    uint32_t id;
+    int32_t result;
+    int32_t status;
+    uint32_t runUs;
+    char name[32 + 1];
   };
 
+  static const char* jobStatusName(int32_t st) {
+    switch (st) {
+      case JOB_OK: return "done";
+      case JOB_BAD_IMAGE: return "bad-image";
+      case JOB_CANCELED: return "canceled";
+      case JOB_KILLED: return "killed";
+      default: return "error";
+    }
+  }
+
+  // core1: take the highest-priority queued job (oldest first on ties), run it, post the completion
+  void core1RunQueued() {
+    JobSlot* best = nullptr;
+    uint32_t bestIdx = 0;
+    for (uint32_t i = 0; i < EXECHOST_JOB_SLOTS; ++i) {
+      JobSlot& js = _slots[i];
+      if (js.state != JOB_QUEUED) continue;
+      if (!best || js.prio > best->prio || (js.prio == best->prio && (int32_t)(js.seq - best->seq) < 0)) {
+        best = &js;
+        bestIdx = i;
+      }
+    }
+    if (!best) return;
+    __asm volatile("dsb" ::
+                     : "memory");
+    __asm volatile("isb" ::
+                     : "memory");
+    int32_t rv = 0;
+    int32_t st = JOB_OK;
+    uint32_t t0 = micros();
+    uint32_t c0 = execProfCyclesNow();
+    uint32_t mbxStart = Mbx::position(mailboxArea());
+    mailboxClearCancelFlag();  // before RUNNING is visible, so a cancel from core0 is never lost
+    best->startMs = millis();
+    best->state = JOB_RUNNING;
+    __asm volatile("dsb" ::
+                     : "memory");
+    if (best->cancel) {
+      st = JOB_CANCELED;
+    } else if (best->code == 0 || (best->size & 1u)) {
+      st = JOB_BAD_IMAGE;
+    } else {
+      rv = exechost_call_with_args_thumb((void*)(best->code | 1u), best->argc, best->args);
+    }
+    volatile JobDone& d = _done[_doneHead % EXECHOST_JOB_SLOTS];
+    d.slot = bestIdx;
+    d.result = rv;
+    d.status = st;
+    d.runUs = micros() - t0;
+    bool exact = false;
+    d.cycles = execProfCyclesSpan(c0, execProfCyclesNow(), d.runUs, exact);
+    d.cyclesExact = exact;
+    // Raw blobs that write legacy NUL-terminated text break the ring; keep that text with the
+    // completion and repair the ring before the next job (core0 never reads a broken ring).
+    // Anything still unread from earlier jobs was overwritten; restarting at the old head keeps
+    // their end positions from matching newer output.
+    d.info[0] = 0;
+    if (!Mbx::valid(mailboxArea(), BLOB_MAILBOX_MAX)) {
+      char text[EXECHOST_JOB_INFO];
+      Mbx::legacyText(mailboxArea(), BLOB_MAILBOX_MAX, text, sizeof(text));
+      for (size_t i = 0; i < sizeof(text); ++i) d.info[i] = text[i];
+      Mbx::init(mailboxArea(), BLOB_MAILBOX_MAX, true, mbxStart);
+    }
+    d.mbxEnd = Mbx::position(mailboxArea());
+    best->state = JOB_DONE;
+    __asm volatile("dsb" ::
+                     : "memory");
+    __asm volatile("isb" ::
+                     : "memory");
+    ++_doneHead;
+  }
+
+  // core0: report a finished job, release its image and slot
+  void finishJob(uint32_t slot, int32_t result, int32_t status, const ExecProfSample& prof, const char* info) {
+    if (slot >= EXECHOST_JOB_SLOTS) return;
+    JobSlot& js = _slots[slot];
+    const uint32_t runUs = prof.runUs;
+    if (_console) {
+      if (status == JOB_OK && js.cancel) {
+        _console->printf("Job #%u '%s' finished after cancel; Return=%d ignored\n", (unsigned)js.id, js.name, (int)result);
+      } else if (status == JOB_OK) {
+        _console->printf("Job #%u '%s' completed: Return=%d (%u us)\n", (unsigned)js.id, js.name, (int)result, (unsigned)runUs);
+        if (info && info[0]) _console->printf(" Info=\"%s\"\n", info);
+      } else {
+        _console->printf("Job #%u '%s' %s\n", (unsigned)js.id, js.name, jobStatusName(status));
+      }
+    }
+    JobHist& h = _hist[_histCount++ % EXECHOST_JOB_HISTORY];
+    h.id = js.id;
+    h.result = result;
+    h.status = (status == JOB_OK && js.cancel) ? JOB_CANCELED : status;
+    h.runUs = runUs;
+    memcpy(h.name, js.name, sizeof(h.name));
+    if (status == JOB_OK && !js.cancel) {
+      ExecProfSample s = prof;
+      s.size = js.size;
+      execProfRecord(js.name, s);
+    }
+    if (js.cancel) mailboxClearCancelFlag();
+    freeExecBuf(js.raw);
+    js.raw = nullptr;
+    __asm volatile("dsb" ::
+                     : "memory");
+    js.state = JOB_FREE;
+  }
+
+  // The job ignored its cancel token: restart core1 (setup1 -> core1Setup) and reclaim the slot.
+  // A job stopped this way may leave whatever it was driving (GPIO, FS reads) half done.
+  void hardKill(uint32_t slot) {
+    JobSlot& js = _slots[slot];
+    if (_console) _console->printf("Job #%u '%s' still running %u ms after cancel; restarting core1\n",
+                                   (unsigned)js.id, js.name, (unsigned)EXECHOST_KILL_GRACE_MS);
+    rp2040.restartCore1();
+    // Finished just before the reset? Then its completion is already in the ring.
+    for (uint32_t t = _doneTail; t != _doneHead; ++t) {
+      if (_done[t % EXECHOST_JOB_SLOTS].slot == slot) return;
+    }
+    // RUNNING, or DONE with the ring push cut short by the reset
+    if (js.state != JOB_FREE) {
+      ExecProfSample prof;
+      prof.runUs = (millis() - js.startMs) * 1000u;
+      finishJob(slot, 0, JOB_KILLED, prof, nullptr);
+    }
+  }
+
   ConsolePrint* _console;
   ExecFSTable _fs;
   bool _fsValid;
-  SoftwareSerial* _link;
-  uint32_t _coproc_seq;
+  const RBlob::Export* _exports = nullptr;
+  size_t _nExports = 0;
+  // Everything that belongs to one co-processor link; coproc* calls address *_p (coprocSelect)
+  struct FuncId {
+    char name[EXECHOST_FUNC_NAME + 1];
+    uint16_t id;
+    int8_t argc;  // -1 = any
+  };
+  struct CoprocPeer {
+    CoProc::Link* link = nullptr;
+    uint32_t linkBaseBaud = 0;  // attach rate; the co-processor boots at it
+    bool linkNegotiated = false;
+    uint32_t coproc_seq = 1;
+    uint32_t coprocFeatures = 0;  // HELLO features, probed once per attach
+    bool coprocFeaturesKnown = false;
+    CoProc::SharedMem* shared = nullptr;
+    CoProc::LinkStats stats = {};  // this end's framing counters (CMD_STATS reports the other end)
+
+    // CMD_FUNC_LIST cache
+    FuncId funcIds[EXECHOST_FUNC_IDS];
+    uint32_t nFuncIds = 0;
+    uint32_t funcTableCrc = 0;
+    bool funcIdsKnown = false;
+
+    // Async RPC: requests in flight, EXEC_ASYNC jobs and the coprocPoll() frame assembler
+    RpcSlot rpc[EXECHOST_RPC_SLOTS] = {};
+    RpcJob rjob[EXECHOST_RPC_JOBS] = {};
+    uint32_t evtMask = 0;
+    union {
+      CoProc::Frame f;
+      uint8_t bytes[sizeof(CoProc::Frame)];
+    } rxHdr = {};
+    uint32_t rxGot = 0;  // bytes of the current frame seen so far (header + body)
+    uint32_t rxSkipped = 0;  // bytes the coprocPoll() magic scan dropped since the last header
+    uint8_t rxBody[EXECHOST_RPC_BODY_MAX];
+
+    // Fan-out: what the dispatcher knows about this board
+    CoprocHealth health;
+  };
+  CoprocPeer _peers[EXECHOST_COPROC_LINKS];
+  uint32_t _nPeers = 0;
+  CoprocPeer* _p = &_peers[0];
+  CoprocEvent _evtFn = nullptr;  // event sink, shared by all links
+  void* _evtCtx = nullptr;
+  // Fan-out job table (coprocFanSubmit)
+  enum : uint8_t { FAN_FREE = 0,
+                   FAN_QUEUED,
+                   FAN_PLACED };
+  struct FanJob {
+    uint8_t state = FAN_FREE;
+    bool script = false;
+    char file[EXECHOST_FAN_NAME + 1];
+    uint32_t id = 0;
+    uint32_t prio = 0;
+    uint32_t needCaps = 0;
+    uint32_t needFeat = 0;
+    uint32_t argc = 0;
+    int32_t argv[EXECHOST_FAN_ARGS];
+    uint32_t peer = 0;  // board it is placed on (or last tried)
+    uint32_t remoteId = 0;  // that board's job id
+    uint32_t tries = 0;  // times moved off a failed board
+  };
+  FanJob _fan[EXECHOST_FAN_JOBS];
+  uint32_t _fanSeq = 0;
+  CoprocFanDone _fanDone = nullptr;
+  void* _fanCtx = nullptr;
   uint32_t _timeout_override_ms;
 
   // core1 shared state
@@ -1293,13 +3358,148 @@ private:
   volatile int32_t _status;
   volatile uint32_t _job_flag;  // 0=idle,1=ready,2=running,3=done
 
-  // background job
-  volatile void* _bg_raw;
-  volatile uint8_t* _bg_buf;
-  volatile uint32_t _bg_sz;
-  volatile bool _bg_active;
-  volatile uint32_t _bg_start_ms;
-  volatile uint32_t _bg_timeout_ms;
-  char _bg_fname[32 + 1];  // filename max = 32 per original ActiveFS::MAX_NAME
-  volatile bool _bg_cancel_requested;
+  // Job queue. Each slot state has one writer at a time: core0 moves FREE->QUEUED and DONE->FREE,
+  // core1 moves QUEUED->RUNNING->DONE (core0 only after restarting core1 in hardKill).
+  JobSlot _slots[EXECHOST_JOB_SLOTS];
+  uint32_t _jobSeq;
+  uint32_t _nextJobId;
+  // Completion ring: core1 writes entries and _doneHead, core0 reads them and advances _doneTail.
+  // Every slot reports once before it is reused, so the ring can never overflow.
+  volatile JobDone _done[EXECHOST_JOB_SLOTS];
+  volatile uint32_t _doneHead;
+  volatile uint32_t _doneTail;
+  JobHist _hist[EXECHOST_JOB_HISTORY];
+  uint32_t _histCount;
+
+  // Last core1 run (handshake path), written by core1 before _job_flag = 3
+  volatile uint32_t _c1EnterUs = 0;
+  volatile uint32_t _c1RunUs = 0;
+  volatile uint32_t _c1Cycles = 0;
+  volatile bool _c1CyclesExact = false;
+  volatile uint32_t _c1Stack = 0;
+
+  uint32_t _mbxCol = 0;      // console column of streamed mailbox output
+  uint32_t _mbxDropped = 0;  // ring 'dropped' counter already reported
+
+  // ---------------- Fan-out plumbing ----------------
+  // Fresh state for a link; shared memory and the framing counters stay
+  void peerReset(CoprocPeer& pr, CoProc::Link* link, uint32_t baud) {
+    pr.link = link;
+    pr.linkBaseBaud = baud;
+    pr.linkNegotiated = false;
+    pr.coprocFeaturesKnown = false;
+    pr.evtMask = 0;
+    pr.funcIdsKnown = false;
+    pr.nFuncIds = 0;
+    pr.rxGot = 0;
+    for (uint32_t i = 0; i < EXECHOST_RPC_SLOTS; ++i) pr.rpc[i].used = false;
+    for (uint32_t i = 0; i < EXECHOST_RPC_JOBS; ++i) pr.rjob[i].used = false;
+    uint32_t caps = pr.health.caps;
+    pr.health = CoprocHealth();
+    pr.health.caps = caps;
+    for (uint32_t i = 0; i < EXECHOST_FAN_JOBS; ++i) {
+      FanJob& j = _fan[i];
+      if (j.state == FAN_PLACED && &_peers[j.peer] == &pr) j.state = FAN_QUEUED;  // the board is gone; place again
+    }
+    if (link) link->begin(baud);
+  }
+
+  // Least busy board that qualifies; on a link failure try the next one. Selects the board it uses.
+  bool fanPlace(FanJob& j) {
+    uint32_t tried = 0;
+    uint32_t now = millis();
+    for (;;) {
+      int best = -1;
+      for (uint32_t i = 0; i < _nPeers; ++i) {
+        const CoprocPeer& pr = _peers[i];
+        const CoprocHealth& h = pr.health;
+        if ((tried & (1u << i)) || !h.up || h.inFlight >= EXECHOST_FAN_PER_LINK) continue;
+        if ((int32_t)(now - h.busyUntil) < 0) continue;
+        if ((h.caps & j.needCaps) != j.needCaps || (pr.coprocFeatures & j.needFeat) != j.needFeat) continue;
+        const CoprocHealth* b = best < 0 ? nullptr : &_peers[best].health;
+        if (!b || h.inFlight < b->inFlight || (h.inFlight == b->inFlight && h.failTotal < b->failTotal)) best = (int)i;
+      }
+      if (best < 0) return false;
+      tried |= 1u << best;
+      _p = &_peers[best];
+      CoprocHealth& h = _p->health;
+      uint32_t to = _p->stats.timeouts;
+      uint32_t rid = 0;
+      if (coprocJobSubmitFile(j.file, j.argv, j.argc, j.script, j.prio, &rid)) {
+        if (!h.inFlight) h.lastProgressMs = millis();
+        ++h.inFlight;
+        h.fails = 0;
+        j.state = FAN_PLACED;
+        j.peer = (uint32_t)best;
+        j.remoteId = rid;
+        return true;
+      }
+      if (_p->stats.timeouts != to) fanLinkFailed((uint32_t)best);
+      else h.busyUntil = millis() + EXECHOST_FAN_BUSY_MS;  // answered with an error: queue full or bad image
+    }
+  }
+
+  // Take finished jobs from board 'i'; a board that stops reporting for a whole job timeout is dropped
+  void fanCollect(uint32_t i) {
+    CoprocHealth& h = _peers[i].health;
+    if (!h.up || !h.inFlight) return;
+    uint32_t now = millis();
+    if (now - h.lastPollMs < EXECHOST_FAN_POLL_MS) return;
+    h.lastPollMs = now;
+    _p = &_peers[i];
+    uint32_t to = _p->stats.timeouts;
+    CoprocResult res[EXECHOST_RESULTS_MAX];
+    uint32_t n = 0;
+    if (!coprocResults(res, EXECHOST_RESULTS_MAX, n)) {
+      if (_p->stats.timeouts != to) fanLinkFailed(i);
+      return;
+    }
+    h.fails = 0;
+    if (n) h.lastProgressMs = millis();
+    for (uint32_t r = 0; r < n; ++r) {
+      for (uint32_t k = 0; k < EXECHOST_FAN_JOBS; ++k) {
+        FanJob& j = _fan[k];
+        if (j.state == FAN_PLACED && j.peer == i && j.remoteId == res[r].id) {
+          fanFinish(j, res[r].status, res[r].result);
+          break;
+        }
+      }
+    }
+    if (h.inFlight && millis() - h.lastProgressMs > timeout(100000) + EXECHOST_RPC_JOB_GRACE_MS) {
+      if (_console) _console->printf("coproc fan: link %u stalled\n", (unsigned)i);
+      h.fails = EXECHOST_FAN_FAILS - 1;
+      fanLinkFailed(i);
+    }
+  }
+
+  // Count a link failure; at EXECHOST_FAN_FAILS the board goes down and its jobs go back to the queue
+  void fanLinkFailed(uint32_t i) {
+    CoprocHealth& h = _peers[i].health;
+    ++h.failTotal;
+    if (++h.fails < EXECHOST_FAN_FAILS) return;
+    h.up = false;
+    h.downUntil = millis() + EXECHOST_FAN_BACKOFF_MS;
+    if (_console) _console->printf("coproc fan: link %u down, moving %u job(s)\n", (unsigned)i, (unsigned)h.inFlight);
+    for (uint32_t k = 0; k < EXECHOST_FAN_JOBS; ++k) {
+      FanJob& j = _fan[k];
+      if (j.state != FAN_PLACED || j.peer != i) continue;
+      if (++j.tries >= EXECHOST_FAN_TRIES) {
+        fanFinish(j, CoProc::ST_TIMEOUT, 0);
+      } else {
+        j.state = FAN_QUEUED;
+      }
+    }
+    h.inFlight = 0;
+  }
+
+  void fanFinish(FanJob& j, int32_t status, int32_t result) {
+    CoprocHealth& h = _peers[j.peer].health;
+    if (j.state == FAN_PLACED && h.inFlight) --h.inFlight;
+    ++h.done;
+    j.state = FAN_FREE;
+    if (_fanDone) _fanDone(_fanCtx, j.id, j.peer, status, result);
+    else if (_console)
+      _console->printf("coproc fan #%u (%s, link %u): status=%d return=%d\n", (unsigned)j.id, j.file, (unsigned)j.peer,
+                       (int)status, (int)result);
+  }
 };
\ No newline at end of file
@@ -0,0 +1,188 @@
+// ExecOverlay.h
+// Demand-paged overlays for RBL1 version 2 blobs (format: RelocBlob.h).
+// Resident: root image + bss + one overlay region. A call through a root stub lands in
+// ovl_dispatch (core1), which asks ovl_enter() to page the target overlay into the region.
+// When that evicts another overlay, the caller's return address and overlay are pushed on a
+// small return stack and LR is redirected to ovl_return, which pages the caller back in.
+// Arguments in r0-r3 and on the stack pass through untouched (only r12 is used as scratch).
+#pragma once
+#include <Arduino.h>
+#include <string.h>
+#include <stdlib.h>
+#include "RelocBlob.h"
+#include "blob_mailbox_config.h"
+#include "MailboxRing.h"
+
+#ifndef EXEC_OVL_RET_DEPTH
+#define EXEC_OVL_RET_DEPTH 32  // nested cross-overlay calls
+#endif
+
+struct ExecOverlayState {
+  bool active = false;
+  char fname[48] = { 0 };
+  uint32_t fileSize = 0;
+  uint32_t (*readRange)(const char*, uint32_t, uint8_t*, uint32_t) = nullptr;
+  RBlob::OverlayHeader oh{};
+  RBlob::OverlayDesc* desc = nullptr;  // malloc'd copy of the overlay table
+  uint8_t* root = nullptr;
+  uint32_t rootSize = 0;  // image + bss
+  uint8_t* region = nullptr;
+  int32_t resident = -1;
+  uint32_t depth = 0;
+  uint32_t retAddr[EXEC_OVL_RET_DEPTH];
+  int16_t retOvl[EXEC_OVL_RET_DEPTH];
+  // stats for the last run
+  uint32_t loads = 0;
+  uint32_t loadUs = 0;
+  uint32_t maxDepth = 0;
+};
+static ExecOverlayState g_ovl;
+
+static void execOvlMailboxNote(const char* msg, int32_t n) {
+  char tmp[48];
+  snprintf(tmp, sizeof(tmp), "%s%ld\n", msg, (long)n);
+  Mbx::writeStr((volatile void*)(uintptr_t)BLOB_MAILBOX_ADDR, tmp);
+}
+
+// Page overlay 'id' into the region and apply its fixups (runs on core1)
+static bool execOvlLoad(int32_t id) {
+  if (id == g_ovl.resident) return true;
+  if (id < 0 || id >= (int32_t)g_ovl.oh.nOverlays) return false;
+  const RBlob::OverlayDesc& d = g_ovl.desc[id];
+  uint32_t t0 = micros();
+  g_ovl.resident = -1;  // region is invalid until fully linked
+  if (g_ovl.readRange(g_ovl.fname, d.fileOff, g_ovl.region, d.size) != d.size) return false;
+  // Fixups stream through a small stack buffer; core1 never touches the heap here
+  RBlob::OvlReloc rel[16];
+  RBlob::OverlayDesc part = d;
+  for (uint32_t done = 0; done < d.nRelocs; done += part.nRelocs) {
+    part.nRelocs = (uint16_t)((d.nRelocs - done) < 16u ? (d.nRelocs - done) : 16u);
+    uint32_t rsz = (uint32_t)part.nRelocs * sizeof(RBlob::OvlReloc);
+    if (g_ovl.readRange(g_ovl.fname, d.relocOff + done * sizeof(RBlob::OvlReloc), (uint8_t*)rel, rsz) != rsz) return false;
+    if (RBlob::linkOverlay(part, rel, g_ovl.region, g_ovl.root, g_ovl.rootSize)) return false;
+  }
+  __asm volatile("dsb" ::
+                   : "memory");
+  __asm volatile("isb" ::
+                   : "memory");
+  g_ovl.resident = id;
+  ++g_ovl.loads;
+  g_ovl.loadUs += micros() - t0;
+  return true;
+}
+
+extern "C" int32_t ovl_fail(void) {
+  return -1;
+}
+extern "C" void ovl_return(void);
+
+// Called by ovl_dispatch with the stub descriptor and the caller's LR.
+// Returns target (r0) and the LR to install (r1) as a 64-bit pair.
+extern "C" __attribute__((used)) uint64_t ovl_enter(uint32_t descWord, uint32_t lr) {
+  int32_t id = (int32_t)(descWord >> 24);
+  uint32_t target = (uint32_t)(uintptr_t)g_ovl.region + (descWord & 0x00FFFFFFu);
+  if (!g_ovl.active) {
+    execOvlMailboxNote("ovl: no overlay program, id=", id);
+    return (uint64_t)(uint32_t)(uintptr_t)&ovl_fail | ((uint64_t)lr << 32);
+  }
+  if (id == g_ovl.resident) return (uint64_t)target | ((uint64_t)lr << 32);
+  if (g_ovl.resident >= 0) {
+    // The resident overlay is about to be evicted while something may still return into it
+    if (g_ovl.depth >= EXEC_OVL_RET_DEPTH) {
+      execOvlMailboxNote("ovl: return stack overflow, id=", id);
+      return (uint64_t)(uint32_t)(uintptr_t)&ovl_fail | ((uint64_t)lr << 32);
+    }
+    g_ovl.retAddr[g_ovl.depth] = lr;
+    g_ovl.retOvl[g_ovl.depth] = (int16_t)g_ovl.resident;
+    ++g_ovl.depth;
+    if (g_ovl.depth > g_ovl.maxDepth) g_ovl.maxDepth = g_ovl.depth;
+    lr = (uint32_t)(uintptr_t)&ovl_return;
+  }
+  if (!execOvlLoad(id)) {
+    execOvlMailboxNote("ovl: load failed, id=", id);
+    if (lr == (uint32_t)(uintptr_t)&ovl_return) lr = g_ovl.retAddr[--g_ovl.depth];
+    return (uint64_t)(uint32_t)(uintptr_t)&ovl_fail | ((uint64_t)lr << 32);
+  }
+  return (uint64_t)target | ((uint64_t)lr << 32);
+}
+
+// Called by ovl_return: page the caller's overlay back in and hand back its return address
+extern "C" __attribute__((used)) uint32_t ovl_leave(void) {
+  if (g_ovl.depth == 0) {
+    execOvlMailboxNote("ovl: return stack underflow", 0);
+    for (;;) tight_loop_contents();
+  }
+  --g_ovl.depth;
+  int32_t id = g_ovl.retOvl[g_ovl.depth];
+  if (!execOvlLoad(id)) {
+    // No way back into the caller; park core1 so the host times out instead of running garbage
+    execOvlMailboxNote("ovl: reload failed, id=", id);
+    for (;;) tight_loop_contents();
+  }
+  return g_ovl.retAddr[g_ovl.depth];
+}
+
+// Veneers (Thumb-1, valid on M0+ and M33). The stub did 'push {r0, r1}' and put desc in r0.
+extern "C" void ovl_dispatch(void);
+__asm__(
+  "  .pushsection .text.ovl_dispatch,\"ax\",%progbits\n"
+  "  .syntax unified\n"
+  "  .thumb\n"
+  "  .balign 2\n"
+  "  .global ovl_dispatch\n"
+  "  .type ovl_dispatch, %function\n"
+  "  .thumb_func\n"
+  "ovl_dispatch:\n"
+  "  mov  r12, r0\n"
+  "  pop  {r0, r1}\n"
+  "  push {r0, r1, r2, r3}\n"
+  "  mov  r0, r12\n"
+  "  mov  r1, lr\n"
+  "  bl   ovl_enter\n"
+  "  mov  r12, r0\n"
+  "  mov  lr, r1\n"
+  "  pop  {r0, r1, r2, r3}\n"
+  "  bx   r12\n"
+  "  .size ovl_dispatch, .-ovl_dispatch\n"
+  "  .global ovl_return\n"
+  "  .type ovl_return, %function\n"
+  "  .thumb_func\n"
+  "ovl_return:\n"
+  "  push {r0, r1}\n"
+  "  bl   ovl_leave\n"
+  "  mov  r12, r0\n"
+  "  pop  {r0, r1}\n"
+  "  bx   r12\n"
+  "  .size ovl_return, .-ovl_return\n"
+  "  .popsection\n");
+
+// Arm the overlay manager for a freshly linked version 2 root (core0, before the run).
+// Takes ownership of 'desc' (malloc'd).
+static void execOvlBegin(const char* fname, uint32_t fileSize,
+                         uint32_t (*readRange)(const char*, uint32_t, uint8_t*, uint32_t),
+                         const RBlob::OverlayHeader& oh, RBlob::OverlayDesc* desc,
+                         uint8_t* root, uint32_t rootSize, uint8_t* region) {
+  free(g_ovl.desc);
+  strncpy(g_ovl.fname, fname, sizeof(g_ovl.fname) - 1);
+  g_ovl.fname[sizeof(g_ovl.fname) - 1] = 0;
+  g_ovl.fileSize = fileSize;
+  g_ovl.readRange = readRange;
+  g_ovl.oh = oh;
+  g_ovl.desc = desc;
+  g_ovl.root = root;
+  g_ovl.rootSize = rootSize;
+  g_ovl.region = region;
+  g_ovl.resident = -1;
+  g_ovl.depth = 0;
+  g_ovl.loads = 0;
+  g_ovl.loadUs = 0;
+  g_ovl.maxDepth = 0;
+  g_ovl.active = true;
+}
+// Disarm once the image memory is released
+static void execOvlEnd() {
+  g_ovl.active = false;
+  g_ovl.resident = -1;
+  free(g_ovl.desc);
+  g_ovl.desc = nullptr;
+}
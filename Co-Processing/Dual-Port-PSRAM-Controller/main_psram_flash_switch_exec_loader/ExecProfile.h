@@ -0,0 +1,192 @@
+// ExecProfile.h
+// Profiling for blobs run on core1 ('exec -p'): phase timings, a cycle count taken on core1,
+// the core1 stack high-water mark, and a short rolling history per blob name.
+// - Cycles: RP2350 reads the DWT cycle counter, RP2040 (Cortex-M0+, no DWT) the 24-bit SysTick
+//   counter. Both are per core, so core1 enables and reads its own. A run longer than one counter
+//   wrap is reported as an estimate from micros() and the CPU clock.
+// - Stack: core1 paints its free stack (linker symbols __StackOneBottom/__StackOneTop) before the
+//   call and scans for the lowest overwritten word afterwards. If core1 runs on a separate heap
+//   stack (core1_separate_stack) the SP is outside that range and nothing is measured.
+#pragma once
+#include <Arduino.h>
+#include <string.h>
+#include "ConsolePrint.h"
+
+#ifndef EXECPROF_NAMES
+#define EXECPROF_NAMES 8  // blob names with a history (least recently used is replaced)
+#endif
+#ifndef EXECPROF_HISTORY
+#define EXECPROF_HISTORY 8  // runs kept per name
+#endif
+#ifndef EXECPROF_STACK_MARGIN
+#define EXECPROF_STACK_MARGIN 64  // bytes left unpainted below the painting frame
+#endif
+
+#ifndef F_CPU
+#define F_CPU 125000000
+#endif
+
+#if !defined(EXECPROF_STACK_BOTTOM) && (defined(PICO_RP2040) || defined(PICO_RP2350))
+extern "C" uint32_t __StackOneBottom;
+extern "C" uint32_t __StackOneTop;
+#define EXECPROF_STACK_BOTTOM ((uintptr_t)&__StackOneBottom)
+#define EXECPROF_STACK_TOP ((uintptr_t)&__StackOneTop)
+#endif
+#ifndef EXECPROF_STACK_BOTTOM
+#define EXECPROF_STACK_BOTTOM ((uintptr_t)0)
+#define EXECPROF_STACK_TOP ((uintptr_t)0)
+#endif
+
+static constexpr uint32_t EXECPROF_PAINT = 0xC5C5C5C5u;
+
+struct ExecProfSample {
+  uint32_t loadUs = 0;      // FS read + relocation (core0)
+  uint32_t crcUs = 0;       // CRC32 over the loaded image (core0, -p only)
+  uint32_t dispatchUs = 0;  // core0 hand-off until core1 enters the blob
+  uint32_t runUs = 0;       // blob entry to return (core1)
+  uint32_t cycles = 0;
+  bool cyclesExact = false;
+  uint32_t stackUsed = 0;  // core1 stack high-water mark in bytes, 0 = not measured
+  uint32_t crc = 0;
+  uint32_t size = 0;
+};
+
+struct ExecProfName {
+  char name[32 + 1];
+  uint32_t runs;      // total, also the history write index
+  uint32_t lastUsed;  // LRU stamp
+  ExecProfSample s[EXECPROF_HISTORY];
+};
+static ExecProfName g_execProf[EXECPROF_NAMES];
+static uint32_t g_execProfClock = 0;
+
+// ----- cycle counter (core1) -----
+static inline void execProfCyclesInit() {
+#if defined(PICO_RP2350)
+  volatile uint32_t* demcr = (volatile uint32_t*)0xE000EDFCu;
+  volatile uint32_t* dwtCtrl = (volatile uint32_t*)0xE0001000u;
+  *demcr |= (1u << 24);  // TRCENA
+  *dwtCtrl |= 1u;        // CYCCNTENA
+#elif defined(PICO_RP2040)
+  volatile uint32_t* csr = (volatile uint32_t*)0xE000E010u;
+  volatile uint32_t* rvr = (volatile uint32_t*)0xE000E014u;
+  volatile uint32_t* cvr = (volatile uint32_t*)0xE000E018u;
+  if (!(*csr & 1u)) {  // leave an already running SysTick (RTOS tick) alone
+    *rvr = 0x00FFFFFFu;
+    *cvr = 0;
+    *csr = 5u;  // ENABLE | CLKSOURCE=processor, no interrupt
+  }
+#endif
+}
+static inline uint32_t execProfCyclesNow() {
+#if defined(PICO_RP2350)
+  return *(volatile uint32_t*)0xE0001004u;
+#elif defined(PICO_RP2040)
+  return *(volatile uint32_t*)0xE000E018u;
+#else
+  return 0;
+#endif
+}
+// Cycles between two counter reads; 'us' (same interval) decides whether the counter wrapped
+static inline uint32_t execProfCyclesSpan(uint32_t a, uint32_t b, uint32_t us, bool& exact) {
+  const uint32_t mhz = (uint32_t)(F_CPU / 1000000u);
+  const uint64_t est = (uint64_t)us * mhz;
+#if defined(PICO_RP2350)
+  uint64_t wrap = 0x100000000ull;
+  uint32_t d = b - a;  // counts up
+#elif defined(PICO_RP2040)
+  uint64_t wrap = (uint64_t)(*(volatile uint32_t*)0xE000E014u & 0x00FFFFFFu) + 1u;
+  uint32_t d = (uint32_t)((a - b) & 0x00FFFFFFu) % (uint32_t)wrap;  // counts down
+#else
+  uint64_t wrap = 0;
+  uint32_t d = 0;
+  (void)a;
+  (void)b;
+#endif
+  // micros() resolution: only trust the counter with a clear margin below one wrap
+  exact = wrap && (est + 2u * mhz) < wrap;
+  if (exact) return d;
+  return est > 0xFFFFFFFFull ? 0xFFFFFFFFu : (uint32_t)est;
+}
+
+// ----- core1 stack high-water mark -----
+// Paint everything below the caller's frame. Not inlined so its own frame is the lowest live one.
+static __attribute__((noinline)) bool execProfStackPaint(uintptr_t lo, uintptr_t hi) {
+  volatile uint32_t here = 0;
+  uintptr_t sp = (uintptr_t)&here;
+  if (!lo || sp <= lo + EXECPROF_STACK_MARGIN || sp > hi) return false;
+  uintptr_t end = (sp - EXECPROF_STACK_MARGIN) & ~(uintptr_t)3;
+  for (volatile uint32_t* p = (volatile uint32_t*)((lo + 3) & ~(uintptr_t)3); (uintptr_t)p < end; ++p) *p = EXECPROF_PAINT;
+  return true;
+}
+static inline uint32_t execProfStackUsed(uintptr_t lo, uintptr_t hi) {
+  const volatile uint32_t* p = (const volatile uint32_t*)((lo + 3) & ~(uintptr_t)3);
+  while ((uintptr_t)p < hi && *p == EXECPROF_PAINT) ++p;
+  return (uint32_t)(hi - (uintptr_t)p);
+}
+
+// ----- history -----
+static ExecProfName* execProfFind(const char* name, bool create) {
+  ExecProfName* victim = nullptr;
+  for (uint32_t i = 0; i < EXECPROF_NAMES; ++i) {
+    ExecProfName& e = g_execProf[i];
+    if (e.name[0] && !strncmp(e.name, name, sizeof(e.name) - 1)) {
+      e.lastUsed = ++g_execProfClock;
+      return &e;
+    }
+    if (!victim || !e.name[0] || (victim->name[0] && e.lastUsed < victim->lastUsed)) victim = &e;
+  }
+  if (!create || !victim) return nullptr;
+  memset(victim, 0, sizeof(*victim));
+  strncpy(victim->name, name, sizeof(victim->name) - 1);
+  victim->lastUsed = ++g_execProfClock;
+  return victim;
+}
+
+static void execProfRecord(const char* name, const ExecProfSample& s) {
+  if (!name || !*name) return;
+  ExecProfName* e = execProfFind(name, true);
+  e->s[e->runs++ % EXECPROF_HISTORY] = s;
+}
+
+static void execProfPrintSample(ConsolePrint* c, const char* name, const ExecProfSample& s) {
+  if (!c) return;
+  c->printf("Profile '%s' (sz=%u, crc32=0x%08X):\n", name, (unsigned)s.size, (unsigned)s.crc);
+  c->printf("  load     %8u us\n", (unsigned)s.loadUs);
+  c->printf("  crc      %8u us\n", (unsigned)s.crcUs);
+  c->printf("  dispatch %8u us\n", (unsigned)s.dispatchUs);
+  c->printf("  run      %8u us  %s%u cycles\n", (unsigned)s.runUs, s.cyclesExact ? "" : "~", (unsigned)s.cycles);
+  if (s.stackUsed) {
+    c->printf("  stack    %8u bytes of %u (core1 high-water)\n", (unsigned)s.stackUsed,
+              (unsigned)(EXECPROF_STACK_TOP - EXECPROF_STACK_BOTTOM));
+  } else {
+    c->println("  stack         n/a (core1 not on the SCRATCH_X stack)");
+  }
+}
+
+// One line per name: runs, then min/avg/max run time and max stack over the kept history
+static void execProfPrintHistory(ConsolePrint* c, const char* onlyName = nullptr) {
+  if (!c) return;
+  bool any = false;
+  for (uint32_t i = 0; i < EXECPROF_NAMES; ++i) {
+    const ExecProfName& e = g_execProf[i];
+    if (!e.name[0] || !e.runs) continue;
+    if (onlyName && strncmp(e.name, onlyName, sizeof(e.name) - 1)) continue;
+    uint32_t n = e.runs < EXECPROF_HISTORY ? e.runs : EXECPROF_HISTORY;
+    uint32_t mn = 0xFFFFFFFFu, mx = 0, stk = 0;
+    uint64_t sum = 0, cyc = 0;
+    for (uint32_t k = 0; k < n; ++k) {
+      const ExecProfSample& s = e.s[k];
+      if (s.runUs < mn) mn = s.runUs;
+      if (s.runUs > mx) mx = s.runUs;
+      if (s.stackUsed > stk) stk = s.stackUsed;
+      sum += s.runUs;
+      cyc += s.cycles;
+    }
+    if (!any) c->println("  runs  kept   min us   avg us   max us  avg cycles  stack  name");
+    any = true;
+    c->printf("  %-5u %-4u %8u %8u %8u %11u  %5u  %s\n", (unsigned)e.runs, (unsigned)n, (unsigned)mn,
+              (unsigned)(sum / n), (unsigned)mx, (unsigned)(cyc / n), (unsigned)stk, e.name);
+  }
+  if (!any) c->println(onlyName ? "  (no history for this blob)" : "  (no profiled runs yet)");
+}
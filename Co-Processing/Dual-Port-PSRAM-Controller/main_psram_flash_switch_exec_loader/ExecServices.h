@@ -0,0 +1,82 @@
+// ========== Firmware services exported to relocatable (RBL1) blobs ==========
+// Called from core1 while the blob runs. Foreground exec keeps core0 parked in runOnCore1, so the
+// FS services are safe there; a background blob that reads the FS races with console commands.
+// Mailbox output goes into the streaming ring (MailboxRing.h); core0 prints it while the blob runs.
+extern "C" {
+static void svc_mbox_puts(const char* s) {
+  Mbx::writeStr(ExecHost::mailboxArea(), s);
+}
+static void svc_mbox_write(const void* data, uint32_t len) {
+  Mbx::write(ExecHost::mailboxArea(), data, len);
+}
+static void svc_mbox_putd(int32_t v) {
+  char tmp[12];
+  snprintf(tmp, sizeof(tmp), "%ld", (long)v);
+  svc_mbox_puts(tmp);
+}
+static void svc_mbox_putx(uint32_t v) {
+  char tmp[11];
+  snprintf(tmp, sizeof(tmp), "0x%08lX", (unsigned long)v);
+  svc_mbox_puts(tmp);
+}
+static void svc_mbox_clear(void) {
+  // Nothing to do: streamed output belongs to the reader once written
+}
+static int32_t svc_cancel_requested(void) {
+  return Mbx::cancel(ExecHost::mailboxArea());
+}
+static void svc_delay_us(uint32_t us) {
+  delayMicroseconds(us);
+}
+static void svc_delay_ms(uint32_t ms) {
+  delay(ms);
+}
+static uint32_t svc_millis(void) {
+  return millis();
+}
+static uint32_t svc_micros(void) {
+  return micros();
+}
+static void svc_gpio_mode(uint32_t pin, uint32_t mode) {
+  static const uint8_t modes[] = { INPUT, OUTPUT, INPUT_PULLUP, INPUT_PULLDOWN };
+  pinMode(pin, modes[mode & 3u]);
+}
+static void svc_gpio_write(uint32_t pin, uint32_t v) {
+  digitalWrite(pin, v ? HIGH : LOW);
+}
+static int32_t svc_gpio_read(uint32_t pin) {
+  return digitalRead(pin);
+}
+static int32_t svc_fs_size(const char* name) {
+  uint32_t sz = 0;
+  if (!name || !activeFs.getFileSize(name, sz)) return -1;
+  return (int32_t)sz;
+}
+static int32_t svc_fs_read(const char* name, uint32_t off, void* dst, uint32_t len) {
+  uint32_t sz = 0;
+  if (!name || !dst || !activeFs.getFileSize(name, sz) || off > sz) return -1;
+  if (len > sz - off) len = sz - off;
+  if (len == 0) return 0;
+  return (int32_t)activeFs.readFileRange(name, off, (uint8_t*)dst, len);
+}
+}
+
+static const RBlob::Export g_execExports[] = {
+  { RBlob::SVC_MBOX_PUTS, "svc_mbox_puts", (const void*)&svc_mbox_puts },
+  { RBlob::SVC_MBOX_PUTD, "svc_mbox_putd", (const void*)&svc_mbox_putd },
+  { RBlob::SVC_MBOX_PUTX, "svc_mbox_putx", (const void*)&svc_mbox_putx },
+  { RBlob::SVC_MBOX_CLEAR, "svc_mbox_clear", (const void*)&svc_mbox_clear },
+  { RBlob::SVC_DELAY_US, "svc_delay_us", (const void*)&svc_delay_us },
+  { RBlob::SVC_DELAY_MS, "svc_delay_ms", (const void*)&svc_delay_ms },
+  { RBlob::SVC_MILLIS, "svc_millis", (const void*)&svc_millis },
+  { RBlob::SVC_MICROS, "svc_micros", (const void*)&svc_micros },
+  { RBlob::SVC_GPIO_MODE, "svc_gpio_mode", (const void*)&svc_gpio_mode },
+  { RBlob::SVC_GPIO_WRITE, "svc_gpio_write", (const void*)&svc_gpio_write },
+  { RBlob::SVC_GPIO_READ, "svc_gpio_read", (const void*)&svc_gpio_read },
+  { RBlob::SVC_FS_SIZE, "svc_fs_size", (const void*)&svc_fs_size },
+  { RBlob::SVC_FS_READ, "svc_fs_read", (const void*)&svc_fs_read },
+  { RBlob::SVC_OVL_DISPATCH, "ovl_dispatch", (const void*)&ovl_dispatch },
+  { RBlob::SVC_MBOX_WRITE, "svc_mbox_write", (const void*)&svc_mbox_write },
+  { RBlob::SVC_CANCEL_REQUESTED, "svc_cancel_requested", (const void*)&svc_cancel_requested },
+};
+static const size_t g_execExports_count = sizeof(g_execExports) / sizeof(g_execExports[0]);
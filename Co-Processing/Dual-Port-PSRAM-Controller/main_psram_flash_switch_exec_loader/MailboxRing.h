@@ -0,0 +1,182 @@
+#pragma once
+/*
+  MailboxRing.h
+  Single-producer/single-consumer byte ring in the blob mailbox area (BLOB_MAILBOX_ADDR / BLOB_MAILBOX[]).
+  Producer: the running blob or script (core1, or the script VM). Consumer: the host console or the
+  CMD_MAILBOX_RD handler. Output can be drained while the producer is still running.
+  - Layout (32-bit words, then data):
+      +0  ctrl     bits 0..7 cancel flag (the byte legacy blobs poll), bit 8 consumer attached
+      +4  magic    MAGIC while the area holds a ring
+      +8  size     data bytes
+      +12 head     bytes ever written   (producer only)
+      +16 tail     bytes ever read      (consumer only)
+      +20 dropped  bytes discarded while full with no consumer attached (producer only)
+      +24 data[size]
+  - head/tail are free running (used = head - tail). Each side publishes its index only after the
+    data it covers, with a barrier in between, so neither side needs a lock.
+  - Full ring: with a consumer attached the producer waits (unless canceled), otherwise the rest is
+    dropped and counted.
+  - Legacy raw blobs write a NUL-terminated string from offset 0. That lands in ctrl (a short one
+    leaves the magic alone), so a ctrl word other than cancel 0/1 plus ATTACHED, or a broken magic,
+    marks the area as text; consumers then read it once (legacyText) and re-initialise it.
+*/
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifndef tight_loop_contents
+#define tight_loop_contents() \
+  do { \
+  } while (0)
+#endif
+
+namespace Mbx {
+
+static constexpr uint32_t MAGIC = 0x3158424D;  // 'M''B''X''1'
+static constexpr uint32_t CTRL_CANCEL_MASK = 0xFFu;
+static constexpr uint32_t CTRL_ATTACHED = 1u << 8;
+
+struct Ring {
+  volatile uint32_t ctrl;
+  volatile uint32_t magic;
+  volatile uint32_t size;
+  volatile uint32_t head;
+  volatile uint32_t tail;
+  volatile uint32_t dropped;
+  volatile uint8_t data[1];  // size bytes
+};
+static constexpr uint32_t HEADER_BYTES = 24;
+
+static inline void barrier() {
+#if defined(__arm__)
+  __asm volatile("dsb" ::
+                   : "memory");
+#else
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);  // host builds (hostlink/rxsim)
+#endif
+}
+
+static inline Ring* at(volatile void* area) {
+  return (Ring*)area;
+}
+
+// (Re)initialise; discards unread data. Only when no producer is running. 'start' lets positions
+// handed out before a repair stay ordered against the new ones.
+static inline void init(volatile void* area, uint32_t areaBytes, bool attached, uint32_t start = 0) {
+  Ring* r = at(area);
+  r->magic = 0;
+  barrier();
+  r->size = (areaBytes > HEADER_BYTES) ? areaBytes - HEADER_BYTES : 0;
+  r->head = start;
+  r->tail = start;
+  r->dropped = 0;
+  r->ctrl = attached ? CTRL_ATTACHED : 0u;
+  barrier();
+  r->magic = MAGIC;
+}
+
+// Consumers only ever store cancel 0 or 1; any other ctrl bit is legacy text written over it
+static inline bool ctrlIsText(uint32_t ctrl) {
+  return (ctrl & ~(CTRL_ATTACHED | 1u)) != 0;
+}
+
+static inline bool valid(volatile void* area, uint32_t areaBytes) {
+  const Ring* r = at(area);
+  return r->magic == MAGIC && !ctrlIsText(r->ctrl) && r->size == areaBytes - HEADER_BYTES
+         && (uint32_t)(r->head - r->tail) <= r->size;
+}
+
+// ----- control word (consumer writes, producer reads) -----
+static inline void setCancel(volatile void* area, uint8_t v) {
+  Ring* r = at(area);
+  r->ctrl = (r->ctrl & ~CTRL_CANCEL_MASK) | v;
+  barrier();
+}
+static inline uint8_t cancel(volatile void* area) {
+  uint32_t c = at(area)->ctrl;
+  return ctrlIsText(c) ? 0 : (uint8_t)(c & CTRL_CANCEL_MASK);
+}
+static inline void setAttached(volatile void* area, bool on) {
+  Ring* r = at(area);
+  r->ctrl = on ? (r->ctrl | CTRL_ATTACHED) : (r->ctrl & ~CTRL_ATTACHED);
+  barrier();
+}
+
+// ----- producer -----
+// Returns the number of bytes stored; the rest was dropped (no consumer) or the job was canceled.
+static inline uint32_t write(volatile void* area, const void* src, uint32_t n) {
+  Ring* r = at(area);
+  if (r->magic != MAGIC || !src) return 0;
+  const uint8_t* s = (const uint8_t*)src;
+  const uint32_t size = r->size;
+  uint32_t head = r->head;
+  uint32_t done = 0;
+  while (done < n) {
+    uint32_t space = size - (uint32_t)(head - r->tail);
+    if (space == 0) {
+      if ((r->ctrl & CTRL_ATTACHED) && !(r->ctrl & CTRL_CANCEL_MASK)) {
+        tight_loop_contents();
+        continue;
+      }
+      r->dropped = r->dropped + (n - done);
+      break;
+    }
+    uint32_t idx = head % size;  // size need not be a power of two
+    uint32_t chunk = n - done;
+    if (chunk > space) chunk = space;
+    if (chunk > size - idx) chunk = size - idx;
+    for (uint32_t i = 0; i < chunk; ++i) r->data[idx + i] = s[done + i];
+    done += chunk;
+    head += chunk;
+    barrier();
+    r->head = head;
+  }
+  return done;
+}
+static inline uint32_t writeStr(volatile void* area, const char* s) {
+  return s ? write(area, s, (uint32_t)strlen(s)) : 0;
+}
+
+// ----- consumer -----
+static inline uint32_t used(volatile void* area) {
+  const Ring* r = at(area);
+  return (r->magic == MAGIC) ? (uint32_t)(r->head - r->tail) : 0u;
+}
+static inline uint32_t read(volatile void* area, void* dst, uint32_t max) {
+  Ring* r = at(area);
+  if (r->magic != MAGIC || !dst) return 0;
+  const uint32_t size = r->size;
+  uint32_t tail = r->tail;
+  uint32_t avail = (uint32_t)(r->head - tail);
+  barrier();
+  if (avail > max) avail = max;
+  uint8_t* d = (uint8_t*)dst;
+  for (uint32_t i = 0; i < avail; ++i) d[i] = r->data[(tail + i) % size];
+  barrier();
+  r->tail = tail + avail;
+  return avail;
+}
+// Read at most 'max' bytes but do not cross absolute position 'limit' (a head value seen earlier)
+static inline uint32_t readUntil(volatile void* area, void* dst, uint32_t max, uint32_t limit) {
+  int32_t before = (int32_t)(limit - at(area)->tail);
+  if (before <= 0) return 0;
+  if ((uint32_t)before > max) before = (int32_t)max;
+  return read(area, dst, before);
+}
+static inline uint32_t position(volatile void* area) {
+  return at(area)->head;
+}
+
+// Not valid(): copy the legacy NUL-terminated text (up to outCap-1 bytes). Returns its length.
+static inline uint32_t legacyText(volatile void* area, uint32_t areaBytes, char* out, uint32_t outCap) {
+  const volatile char* p = (const volatile char*)area;
+  uint32_t n = 0;
+  while (n + 1 < outCap && n < areaBytes && p[n]) {
+    out[n] = p[n];
+    ++n;
+  }
+  if (outCap) out[n] = 0;
+  return n;
+}
+
+}  // namespace Mbx
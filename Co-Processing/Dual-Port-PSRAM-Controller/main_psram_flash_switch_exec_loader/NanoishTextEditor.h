@@ -114,7 +114,7 @@ struct NanoEditor {
         if (p < sizeof(buf) - 1) buf[p++] = (char)ch;
         if (ch == 'R') break;
       } else {
-        Exec.pollBackground();
+        Exec.pollJobs();
         tight_loop_contents();
         yield();
       }
@@ -605,7 +605,7 @@ struct NanoEditor {
           // Try to parse CSI or SS3 or simple Alt combos
           uint32_t tstart = millis();
           while (!Serial.available() && (millis() - tstart) < 200) {
-            Exec.pollBackground();
+            Exec.pollJobs();
             tight_loop_contents();
             yield();
           }
@@ -620,7 +620,7 @@ struct NanoEditor {
             for (;;) {
               uint32_t ts = millis();
               while (!Serial.available() && (millis() - ts) < 200) {
-                Exec.pollBackground();
+                Exec.pollJobs();
                 tight_loop_contents();
                 yield();
               }
@@ -662,7 +662,7 @@ struct NanoEditor {
             // SS3 sequences: 'H' Home, 'F' End on some terms
             uint32_t ts = millis();
             while (!Serial.available() && (millis() - ts) < 200) {
-              Exec.pollBackground();
+              Exec.pollJobs();
               tight_loop_contents();
               yield();
             }
@@ -679,7 +679,7 @@ struct NanoEditor {
         }
         return ch;
       }
-      Exec.pollBackground();
+      Exec.pollJobs();
       tight_loop_contents();
       yield();
     }
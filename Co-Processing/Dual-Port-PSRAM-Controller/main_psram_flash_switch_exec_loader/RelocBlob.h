@@ -0,0 +1,239 @@
+#pragma once
+/*
+  RelocBlob.h
+  Relocatable blob container ("RBL1") shared by the firmware loader and rblob/mkrblob.py.
+  - File: Header | uint32 relocs[nRelocs] | Import imports[nImports] | strtab | image
+    (every part is a multiple of 4 bytes, so the image starts 4-aligned).
+  - Relocations: image word at 'off' += load base (R_ARM_ABS32 against the blob itself).
+  - Imports: image word at 'slotOff' = address of an exported firmware service (Thumb bit set).
+    Resolved by name (NUL-terminated in strtab) or, when nameOff == NO_NAME, by service id.
+  - bss: 'bssSize' zero bytes follow the image in RAM; the entry is image + entryOff.
+  Blobs call imports through the patched word (built with -mlong-calls), so code stays
+  position independent while delay loops, formatting, GPIO and FS access run in firmware.
+  Raw blobs (no magic) keep loading unchanged.
+  Version 2 adds overlays (see ExecOverlay.h):
+  - OverlayHeader follows Header; OverlayDesc[nOverlays] follows strtab; root image follows.
+  - Only the root (+bss) and one region of regionSize bytes are resident. Overlay images and
+    their OvlReloc lists stay in the file and are read into the region on demand.
+  - Calls into an overlay go through 12-byte stubs in the root that jump to the imported
+    'ovl_dispatch' service with desc = (overlay index << 24) | offset of the function (Thumb bit set).
+*/
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace RBlob {
+
+static constexpr uint32_t MAGIC = 0x314C4252;  // 'R''B''L''1'
+static constexpr uint16_t VERSION = 0x0001;
+static constexpr uint16_t VERSION_OVL = 0x0002;
+static constexpr uint16_t NO_NAME = 0xFFFF;
+static constexpr uint16_t MAX_RELOCS = 1024;
+static constexpr uint16_t MAX_IMPORTS = 64;
+static constexpr uint32_t MAX_STRTAB = 1024;
+static constexpr uint16_t MAX_OVERLAYS = 255;
+
+// Service ids (stable; append only). Names are the same without the SVC_ prefix, lowercase.
+enum : uint16_t {
+  SVC_MBOX_PUTS = 1,  // void  svc_mbox_puts(const char* s)      append text to the mailbox
+  SVC_MBOX_PUTD = 2,  // void  svc_mbox_putd(int32_t v)          append decimal
+  SVC_MBOX_PUTX = 3,  // void  svc_mbox_putx(uint32_t v)         append 0x%08X
+  SVC_MBOX_CLEAR = 4, // void  svc_mbox_clear(void)               no-op since the mailbox streams
+  SVC_DELAY_US = 5,   // void  svc_delay_us(uint32_t us)
+  SVC_DELAY_MS = 6,   // void  svc_delay_ms(uint32_t ms)
+  SVC_MILLIS = 7,     // uint32_t svc_millis(void)
+  SVC_MICROS = 8,     // uint32_t svc_micros(void)
+  SVC_GPIO_MODE = 9,  // void  svc_gpio_mode(uint32_t pin, uint32_t mode)  0=in 1=out 2=in+pullup 3=in+pulldown
+  SVC_GPIO_WRITE = 10,// void  svc_gpio_write(uint32_t pin, uint32_t v)
+  SVC_GPIO_READ = 11, // int32_t svc_gpio_read(uint32_t pin)
+  SVC_FS_SIZE = 12,   // int32_t svc_fs_size(const char* name)  -1 if missing
+  SVC_FS_READ = 13,   // int32_t svc_fs_read(const char* name, uint32_t off, void* dst, uint32_t len)  bytes read, -1 on error
+  SVC_OVL_DISPATCH = 14,  // overlay call veneer target; referenced by mkrblob stubs only
+  SVC_MBOX_WRITE = 15,    // void  svc_mbox_write(const void* p, uint32_t n)  append raw bytes (waits while the ring is full)
+  SVC_CANCEL_REQUESTED = 16,  // int32_t svc_cancel_requested(void)  nonzero once the host asked the job to stop
+};
+
+struct Header {
+  uint32_t magic;       // MAGIC
+  uint16_t version;     // VERSION
+  uint16_t headerSize;  // sizeof(Header); readers skip unknown trailing fields
+  uint32_t imageSize;   // code+rodata+data bytes stored in the file (multiple of 4)
+  uint32_t bssSize;     // zero-filled bytes after the image
+  uint32_t entryOff;    // even offset of the entry function inside the image
+  uint16_t nRelocs;
+  uint16_t nImports;
+  uint32_t strtabSize;  // multiple of 4
+  uint32_t reserved;    // 0
+};
+static_assert(sizeof(Header) == 32, "RBlob::Header layout");
+
+struct Import {
+  uint32_t slotOff;  // 4-aligned offset of the 32-bit slot inside the image
+  uint16_t id;       // service id (used when nameOff == NO_NAME)
+  uint16_t nameOff;  // offset into strtab, or NO_NAME
+};
+static_assert(sizeof(Import) == 8, "RBlob::Import layout");
+
+// Version 2 only, directly after Header
+struct OverlayHeader {
+  uint16_t nOverlays;
+  uint16_t reserved;    // 0
+  uint32_t regionSize;  // >= every overlay size, multiple of 4
+};
+static_assert(sizeof(OverlayHeader) == 8, "RBlob::OverlayHeader layout");
+
+struct OverlayDesc {
+  uint32_t fileOff;   // image bytes in the file (4-aligned)
+  uint32_t size;      // multiple of 4
+  uint32_t relocOff;  // OvlReloc[nRelocs] in the file
+  uint16_t nRelocs;
+  uint16_t reserved;
+};
+static_assert(sizeof(OverlayDesc) == 16, "RBlob::OverlayDesc layout");
+
+// Overlay fixups: kind in bits 31..28 of offKind, word offset (in the overlay) in bits 27..0
+enum : uint32_t {
+  OVL_ROOT = 0,       // word += root base
+  OVL_REGION = 1,     // word += region base
+  OVL_CALL_ROOT = 2,  // BL encoded as if region == root; add (root - region) to its offset
+  OVL_IMPORT = 3,     // word = resolved import slot at root + arg
+};
+struct OvlReloc {
+  uint32_t offKind;
+  uint32_t arg;
+};
+static_assert(sizeof(OvlReloc) == 8, "RBlob::OvlReloc layout");
+
+// Firmware export table entry
+struct Export {
+  uint16_t id;
+  const char* name;
+  const void* fn;
+};
+
+// relocs|imports|strtab, plus the overlay table for version 2
+static inline uint32_t tablesSize(const Header& h, const OverlayHeader* oh = nullptr) {
+  return (uint32_t)h.nRelocs * 4u + (uint32_t)h.nImports * sizeof(Import) + h.strtabSize +
+         (oh ? (uint32_t)oh->nOverlays * sizeof(OverlayDesc) : 0u);
+}
+
+// Sanity-check a header against the file size; returns nullptr or a short reason.
+// Version 2 files carry overlays after the root image, so only a lower bound applies there.
+static inline const char* validate(const Header& h, uint32_t fileSize, const OverlayHeader* oh = nullptr) {
+  if (h.magic != MAGIC) return "bad magic";
+  if (h.version != VERSION && !(h.version == VERSION_OVL && oh)) return "unsupported version";
+  uint32_t minHeader = (h.version == VERSION_OVL) ? sizeof(Header) + sizeof(OverlayHeader) : sizeof(Header);
+  if (h.headerSize < minHeader || (h.headerSize & 3u)) return "bad header size";
+  if (h.nRelocs > MAX_RELOCS || h.nImports > MAX_IMPORTS || h.strtabSize > MAX_STRTAB) return "tables too large";
+  if ((h.imageSize & 3u) || (h.strtabSize & 3u) || (h.bssSize & 3u)) return "misaligned section";
+  if (h.imageSize == 0 || h.entryOff >= h.imageSize || (h.entryOff & 1u)) return "bad entry";
+  uint64_t rootEnd = (uint64_t)h.headerSize + tablesSize(h, h.version == VERSION_OVL ? oh : nullptr) + h.imageSize;
+  if (h.version == VERSION_OVL) {
+    if (oh->nOverlays == 0 || oh->nOverlays > MAX_OVERLAYS) return "bad overlay count";
+    if (oh->regionSize == 0 || (oh->regionSize & 3u)) return "bad overlay region";
+    if (rootEnd > fileSize) return "size mismatch";
+  } else if (rootEnd != fileSize) {
+    return "size mismatch";
+  }
+  return nullptr;
+}
+
+// Check one overlay descriptor against the file and the region
+static inline const char* validateOverlay(const OverlayDesc& d, const OverlayHeader& oh, uint32_t fileSize) {
+  if ((d.size & 3u) || d.size == 0 || d.size > oh.regionSize) return "bad overlay size";
+  if ((uint64_t)d.fileOff + d.size > fileSize) return "overlay out of file";
+  if ((uint64_t)d.relocOff + (uint64_t)d.nRelocs * sizeof(OvlReloc) > fileSize) return "overlay relocs out of file";
+  return nullptr;
+}
+
+// Apply one overlay's fixups after its image was read into 'region'
+static inline const char* linkOverlay(const OverlayDesc& d, const OvlReloc* rel, uint8_t* region,
+                                      const uint8_t* root, uint32_t rootSize) {
+  const uint32_t rootBase = (uint32_t)(uintptr_t)root;
+  const uint32_t regionBase = (uint32_t)(uintptr_t)region;
+  for (uint32_t i = 0; i < d.nRelocs; ++i) {
+    uint32_t kind = rel[i].offKind >> 28;
+    uint32_t off = rel[i].offKind & 0x0FFFFFFFu;
+    if (off > d.size - 4u) return "overlay reloc out of range";
+    uint32_t w;
+    memcpy(&w, region + off, 4);
+    if (kind == OVL_ROOT) {
+      w += rootBase;
+    } else if (kind == OVL_REGION) {
+      w += regionBase;
+    } else if (kind == OVL_IMPORT) {
+      if (rel[i].arg > rootSize - 4u || (rel[i].arg & 3u)) return "overlay import out of range";
+      memcpy(&w, root + rel[i].arg, 4);
+    } else if (kind == OVL_CALL_ROOT) {
+      // Thumb-2 BL: S:imm10 / J1:J2:imm11, J = NOT(I xor S)
+      uint16_t hi = (uint16_t)w, lo = (uint16_t)(w >> 16);
+      uint32_t s = (hi >> 10) & 1u;
+      uint32_t i1 = 1u - (((lo >> 13) & 1u) ^ s), i2 = 1u - (((lo >> 11) & 1u) ^ s);
+      int32_t v = (int32_t)((s << 24) | (i1 << 23) | (i2 << 22) | ((uint32_t)(hi & 0x3FFu) << 12) | ((uint32_t)(lo & 0x7FFu) << 1));
+      if (s) v -= (1 << 25);
+      v += (int32_t)(rootBase - regionBase);
+      if (v < -(1 << 24) || v >= (1 << 24)) return "overlay call out of range";
+      uint32_t u = (uint32_t)v & 0x1FFFFFFu;
+      s = (u >> 24) & 1u;
+      i1 = (u >> 23) & 1u;
+      i2 = (u >> 22) & 1u;
+      hi = (uint16_t)((hi & 0xF800u) | (s << 10) | ((u >> 12) & 0x3FFu));
+      lo = (uint16_t)((lo & 0xD000u) | ((1u - (i1 ^ s)) << 13) | ((1u - (i2 ^ s)) << 11) | ((u >> 1) & 0x7FFu));
+      w = (uint32_t)hi | ((uint32_t)lo << 16);
+    } else {
+      return "bad overlay reloc kind";
+    }
+    memcpy(region + off, &w, 4);
+  }
+  return nullptr;
+}
+
+static inline const Export* findExport(const Export* tbl, size_t n, uint16_t id, const char* name) {
+  for (size_t i = 0; i < n; ++i) {
+    if (name ? (strcmp(tbl[i].name, name) == 0) : (tbl[i].id == id)) return &tbl[i];
+  }
+  return nullptr;
+}
+
+// Patch relocations and imports in place. 'tables' holds relocs|imports|strtab as read from the file,
+// 'image' is the loaded image (imageSize + bssSize bytes). Returns nullptr or a reason; on an unresolved
+// import, *badName/*badId identify it.
+static inline const char* link(const Header& h, const uint8_t* tables, uint8_t* image,
+                               const Export* exports, size_t nExports,
+                               const char** badName = nullptr, uint16_t* badId = nullptr) {
+  const uint8_t* relocs = tables;
+  const uint8_t* imports = relocs + (uint32_t)h.nRelocs * 4u;
+  const char* strtab = (const char*)(imports + (uint32_t)h.nImports * sizeof(Import));
+  const uint32_t base = (uint32_t)(uintptr_t)image;
+  for (uint32_t i = 0; i < h.nRelocs; ++i) {
+    uint32_t off;
+    memcpy(&off, relocs + i * 4u, 4);
+    if (off > h.imageSize - 4u) return "reloc out of range";
+    uint32_t w;
+    memcpy(&w, image + off, 4);
+    w += base;
+    memcpy(image + off, &w, 4);
+  }
+  for (uint32_t i = 0; i < h.nImports; ++i) {
+    Import im;
+    memcpy(&im, imports + i * sizeof(Import), sizeof(Import));
+    if (im.slotOff > h.imageSize - 4u || (im.slotOff & 3u)) return "import slot out of range";
+    const char* name = nullptr;
+    if (im.nameOff != NO_NAME) {
+      if (im.nameOff >= h.strtabSize || !memchr(strtab + im.nameOff, 0, h.strtabSize - im.nameOff)) return "bad import name";
+      name = strtab + im.nameOff;
+    }
+    const Export* e = findExport(exports, nExports, im.id, name);
+    if (!e) {
+      if (badName) *badName = name;
+      if (badId) *badId = im.id;
+      return "unresolved import";
+    }
+    uint32_t w = (uint32_t)(uintptr_t)e->fn;
+    memcpy(image + im.slotOff, &w, 4);
+  }
+  memset(image + h.imageSize, 0, h.bssSize);
+  return nullptr;
+}
+
+}  // namespace RBlob
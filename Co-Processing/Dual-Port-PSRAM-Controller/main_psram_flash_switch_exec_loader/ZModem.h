@@ -1,4 +1,6 @@
 // ==================== Minimal ZMODEM receiver (rz-lite) ====================
+#include "Crc32.h"
+
 namespace ZModem {
 // ZMODEM constants
 static constexpr uint8_t ZPAD = 0x2A;  // '*'
@@ -27,18 +29,6 @@ static constexpr uint32_t CANFC32 = 0x0001;
 static constexpr uint32_t ESCCTL = 0x0002;
 static constexpr uint32_t ESC8 = 0x0008;
 
-// CRC-32 (IEEE)
-static inline uint32_t crc32_update(uint32_t c, uint8_t b) {
-  c ^= b;
-  for (int i = 0; i < 8; ++i) {
-    c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
-  }
-  return c;
-}
-static inline uint32_t crc32(const uint8_t* p, size_t n, uint32_t c = 0xFFFFFFFFu) {
-  for (size_t i = 0; i < n; ++i) c = crc32_update(c, p[i]);
-  return ~c;
-}
 
 // Read a byte from Serial with timeout (ms)
 static bool sread(uint8_t& b, uint32_t timeoutMs) {
@@ -104,7 +94,7 @@ static void sendHeaderBin32(uint8_t type, uint32_t p0) {
   hdr[2] = (uint8_t)((p0 >> 8) & 0xFF);
   hdr[3] = (uint8_t)((p0 >> 16) & 0xFF);
   hdr[4] = (uint8_t)((p0 >> 24) & 0xFF);
-  uint32_t c = crc32(hdr, 5);
+  uint32_t c = Crc32::compute(hdr, 5);
   // Emit escaped
   for (int i = 0; i < 5; ++i) writeEscaped(hdr[i]);
   writeEscaped((uint8_t)(c & 0xFF));
@@ -150,7 +140,7 @@ static bool recvHeaderBin32(uint8_t& type, uint32_t& p0, uint32_t timeoutMs) {
   if (!readZDLE(c2, timeoutMs)) return false;
   if (!readZDLE(c3, timeoutMs)) return false;
   uint32_t cGot = (uint32_t)c0 | ((uint32_t)c1 << 8) | ((uint32_t)c2 << 16) | ((uint32_t)c3 << 24);
-  uint32_t cExp = crc32(hdr, 5);
+  uint32_t cExp = Crc32::compute(hdr, 5);
   // For compatibility, accept even if CRC mismatches (some senders vary on escapes). Log but continue.
   if (cGot != cExp) {
     Console.printf("[rz] header CRC32 mismatch (got=0x%08lX exp=0x%08lX), continuing\n",
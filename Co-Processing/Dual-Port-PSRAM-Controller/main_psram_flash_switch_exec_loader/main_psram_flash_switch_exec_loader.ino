@@ -9,9 +9,10 @@
 #define W25Q_SPI_CLOCK_HZ 104000000UL     // 1 MHz NOR
 #define MX35_SPI_CLOCK_HZ 104000000UL     // 1 MHz NAND
 #include "UnifiedSPIMemSimpleFS.h"
-// ------- Co-Processor over Software Serial (framed RPC) -------
+// ------- Co-Processor over serial (framed RPC) -------
 #include <SoftwareSerial.h>
 #include "CoProcProto.h"
+#include "CoProcLink.h"
 #include "CoProcLang.h"
 #ifndef COPROC_BAUD
 //#define COPROC_BAUD 230400
@@ -24,7 +25,36 @@
 #ifndef PIN_COPROC_TX
 #define PIN_COPROC_TX 1  // GP1 (main TX)
 #endif
-static SoftwareSerial coprocLink(PIN_COPROC_RX, PIN_COPROC_TX, false);  // RX, TX, non-inverted
+// Transport: 0 = SoftwareSerial, 1 = hardware UART0 (Serial1), 2 = PIO UART. The rate is the boot
+// rate of both ends; the link steps up from it after the first HELLO (see CoProcLink.h).
+#ifndef COPROC_LINK
+#define COPROC_LINK 0
+#endif
+#if COPROC_LINK == 1
+// UART0 only has TX on GP0 and RX on GP1: both boards swap roles, the crossed wires stay as they are
+static CoProc::UartLink coprocLink(Serial1, PIN_COPROC_RX /*TX*/, PIN_COPROC_TX /*RX*/);
+#elif COPROC_LINK == 2
+static CoProc::PioUartLink coprocLink(PIN_COPROC_TX, PIN_COPROC_RX, 512);
+#else
+static SoftwareSerial coprocSerial(PIN_COPROC_RX, PIN_COPROC_TX, false);  // RX, TX, non-inverted
+static CoProc::SoftSerialLink coprocLink(coprocSerial);
+#endif
+// Second co-processor for 'coproc fan' / 'coproc use' on a PIO UART (0 = only the main link). Same boot rate.
+#ifndef COPROC2_LINK
+#define COPROC2_LINK 0
+#endif
+#if COPROC2_LINK
+#ifndef PIN_COPROC2_RX
+#define PIN_COPROC2_RX 16  // GP16
+#endif
+#ifndef PIN_COPROC2_TX
+#define PIN_COPROC2_TX 17  // GP17
+#endif
+#ifndef COPROC2_CAPS
+#define COPROC2_CAPS 0  // application caps tags of that board (fan jobs may ask for them)
+#endif
+static CoProc::PioUartLink coprocLink2(PIN_COPROC2_TX, PIN_COPROC2_RX, 512);
+#endif
 // Store ASCII scripts as raw multi-line strings, expose pointer + length.
 #ifndef DECLARE_ASCII_SCRIPT
 #define DECLARE_ASCII_SCRIPT(name, literal) \
@@ -888,6 +918,7 @@ int8_t BLOB_MAILBOX[BLOB_MAILBOX_MAX] = { 0 };
 // ================= ExecHost header =================
 #include "ExecHost.h"
 static ExecHost Exec;
+static CoProc::MemDeviceShared g_coprocShared;  // PSRAM the co-processor also reaches (CMD_LOAD_REF)
 // ================= FSHelpers header =================
 static void updateExecFsTable() {
   ExecFSTable t{};
@@ -902,6 +933,7 @@ static void updateExecFsTable() {
   //t.deleteFile = activeFs.deleteFile;
   Exec.attachFS(t);
 }
+#include "ExecServices.h"
 
 #include "MemDiag.h"
 #include "BlobGen.h"
@@ -913,6 +945,7 @@ static void updateExecFsTable() {
 #include "InputHelper.h"
 #include "CrossFSUtils.h"
 #include "CompilerHelpers.h"
+#include "CompileRunCache.h"
 #include "ZModem.h"
 // ========== Serial console / command handling ==========
 static int nextToken(char*& p, char*& tok) {
@@ -929,6 +962,49 @@ static int nextToken(char*& p, char*& tok) {
   }
   return 1;
 }
+// crcbench: throughput of each Crc32.h kernel over the same heap buffer
+static void crcBench(uint32_t kb) {
+  if (kb == 0 || kb > 256) kb = 16;
+  const uint32_t n = kb * 1024u;
+  uint8_t* buf = (uint8_t*)malloc(n);
+  if (!buf) {
+    Console.println("crcbench: malloc failed");
+    return;
+  }
+  uint32_t x = 0x12345678u;
+  for (uint32_t i = 0; i < n; ++i) {
+    x = x * 1664525u + 1013904223u;
+    buf[i] = (uint8_t)(x >> 24);
+  }
+  struct Kernel {
+    const char* name;
+    uint32_t (*fn)(uint32_t, const void*, size_t);
+  };
+  static const Kernel kernels[] = {
+    { "bitwise", Crc32::updateBitwise },
+    { "nibble", Crc32::updateNibble },
+    { "table", Crc32::updateTable },
+    { "slice4", Crc32::updateSlice4 },
+    { "slice8", Crc32::updateSlice8 },
+  };
+  Console.printf("CRC32 over %u bytes (CRC32_IMPL=%d, self-test %s)\n", (unsigned)n, (int)CRC32_IMPL,
+                 Crc32::selfTest() ? "ok" : "FAILED");
+  const uint32_t ref = Crc32::compute(buf, n);
+  for (const Kernel& k : kernels) {
+    uint32_t reps = 0, crc = 0;
+    uint32_t t0 = micros(), us = 0;
+    do {
+      crc = k.fn(0xFFFFFFFFu, buf, n) ^ 0xFFFFFFFFu;
+      ++reps;
+      us = micros() - t0;
+    } while (us < 200000u);
+    uint32_t bpus100 = (uint32_t)(((uint64_t)n * reps * 100u) / (us ? us : 1));
+    Console.printf("  %-8s %6u us/pass  %4u.%02u bytes/us%s\n", k.name, (unsigned)(us / reps),
+                   (unsigned)(bpus100 / 100), (unsigned)(bpus100 % 100), crc == ref ? "" : "  MISMATCH");
+  }
+  free(buf);
+}
+
 static void printHelp() {
   Console.println("Commands (filename max 32 chars):");
   Console.println("  help                         - this help");
@@ -948,7 +1024,12 @@ static void printHelp() {
   Console.println("  cat <file> [n]               - print file contents (text); default: entire file (truncates at 4096)");
   Console.println("  cp <src> <dst|folder/> [-f]  - copy file; -f overwrites destination");
   Console.println("  fscp <sFS:path> <dFS:path|folder/> [-f] - copy across filesystems (FS=flash|psram|nand)");
-  Console.printf("  exec <file> [a0..aN] [&]     - execute blob with 0..%d int args on core1; '&' to background\n", (int)MAX_EXEC_ARGS);
+  Console.printf("  exec <file> [a0..aN] [&]     - execute raw or RBL1 blob with 0..%d int args on core1; '&' to background\n", (int)MAX_EXEC_ARGS);
+  Console.println("  exec <file> [a0..aN] & [prio] [timeout_ms] - queue for core1; higher prio runs first (default 0)");
+  Console.println("  exec -p <file> [a0..aN]      - run in the foreground and report load/crc/dispatch/run us, cycles, core1 stack");
+  Console.println("  exec -p                      - per-blob run history (foreground and background)");
+  Console.println("  jobs                         - list running/queued core1 jobs and recent results");
+  Console.println("  kill <id>                    - cancel a queued job or stop a running one");
   Console.println("  del <file>                   - delete a file");
   Console.println("  rm <file>                    - alias for 'del'");
   Console.println("  format                       - format active FS");
@@ -957,6 +1038,7 @@ static void printHelp() {
   Console.println("  wipebootloader               - erase chip then reboot to bootloader (DANGEROUS to FS)");
   Console.println("  meminfo                      - show heap/stack info");
   Console.println("  psramsmoketest               - safe, non-destructive PSRAM test");
+  Console.println("  crcbench [kb]                - CRC32 kernel throughput in bytes/us (default 16 KB)");
   Console.println("  reboot                       - reboot the MCU");
   Console.println("  timeout [ms]                 - show or set core1 timeout override (0=defaults)");
   Console.println("  puthex <file> <hex>          - upload binary as hex string");
@@ -964,7 +1046,9 @@ static void printHelp() {
   Console.println("  putb64s <file> [expected]    - paste base64; end with ESC[201~ (auto), Ctrl-D, or a line '.'");
   Console.println("  hash <file> [sha256]         - print SHA-256 of file");
   Console.println("  sha256 <file>                - alias for 'hash <file>'");
-  Console.println("  cc <src> <dst>               - compile Tiny-C source file to binary");
+  Console.println("  cc <src> <dst> [target]      - compile Tiny-C source file to binary");
+  Console.println("  run <src.c> [a0..aN]         - compile (cached by source SHA-256) and execute on core1");
+  Console.println("  runcache [clear]             - list or drop cached run images");
   Console.println("  history                      - print recent command history");
   Console.println("  termwidth [cols]             - show or set terminal width used by line editor");
   Console.println();
@@ -984,7 +1068,19 @@ static void printHelp() {
   Console.println("  mv <src> <dst|folder/>      - move/rename file");
   Console.println();
   Console.println("Co-Processor (serial RPC) commands:");
-  Console.println("  coproc ping|info|exec|sexec|func|status|mbox|cancel|reset|isp enter|exit");
+  Console.println("  coproc ping|info|link [max_bps]|exec|sexec|func|status|mbox|cancel|reset|isp enter|exit");
+  Console.println("  coproc start|sstart <file> [a0..] - run a blob/script in the background; result prints when done");
+  Console.println("  coproc submit|ssubmit <file> <prio> [a0..] - queue a blob/script run (higher prio first)");
+  Console.println("  coproc results              - drain finished co-processor jobs");
+  Console.println("  coproc bench [n] [fn]       - link latency/throughput (replaces the co-processor's blob and script)");
+  Console.println("  coproc stats [reset]        - link counters on both ends");
+  Console.println("  coproc events [on|off]      - show co-processor mailbox/error events as they arrive");
+  Console.println("  coproc funcs                - list co-processor functions and their ids");
+  Console.println("  coproc shared [on|off]      - hand blobs/scripts over through the shared PSRAM window");
+  Console.println("  coproc batch <fn> [a..] ; <fn> [a..] ... - run several functions in one round trip");
+  Console.println("  coproc links                - co-processors, their health and fan-out load");
+  Console.println("  coproc use <n>              - send the other coproc commands to link n");
+  Console.println("  coproc fan|sfan <file> <prio> [caps] [a0..] - run on whichever co-processor is free (caps: required tags)");
   Console.println();
   Console.println("Linux hints: base64 -w0 your.bin  |  xxd -p -c 999999 your.bin | tr -d '\\n'");
 }
@@ -1254,17 +1350,93 @@ static void handleCommand(char* line) {
     if (!cmdFsCpImpl(srcSpec, dstSpec, force)) {
       Console.println("fscp failed");
     }
+  } else if (!strcmp(t0, "exec")) {
+    char* fn;
+    if (!nextToken(p, fn)) {
+      Console.println("usage: exec [-p] <file> [a0 ... aN] [& [prio] [timeout_ms]]");
+      return;
+    }
+    bool profile = false;
+    if (!strcmp(fn, "-p")) {
+      profile = true;
+      if (!nextToken(p, fn)) {
+        Console.println("Exec profile history:");
+        execProfPrintHistory(&Console);
+        return;
+      }
+    }
+    static int32_t argvN[MAX_EXEC_ARGS];
+    int argc = 0;
+    bool background = false;
+    uint8_t prio = 0;
+    uint32_t jobTimeout = Exec.timeout(100000);
+    char* tok = nullptr;
+    while (nextToken(p, tok)) {
+      if (!strcmp(tok, "&")) {
+        background = true;
+        if (nextToken(p, tok)) prio = (uint8_t)strtoul(tok, nullptr, 0);
+        if (nextToken(p, tok)) jobTimeout = (uint32_t)strtoul(tok, nullptr, 0);
+        break;
+      }
+      if (argc < (int)MAX_EXEC_ARGS) argvN[argc++] = (int32_t)strtol(tok, nullptr, 0);
+    }
+    if (profile && background) Console.println("exec: -p is foreground only; the job's run time still goes to 'exec -p' history");
+    if (!background) {
+      int rv = 0;
+      if (!Exec.execBlobForeground(fn, argc, argvN, rv, profile)) Console.println("exec failed");
+    } else {
+      void* raw = nullptr;
+      uint8_t* buf = nullptr;
+      uint32_t sz = 0;
+      uint32_t entry = 0;
+      if (!Exec.loadFileToExecBuf(fn, raw, buf, sz, &entry)) {
+        Console.println("exec: load failed");
+        return;
+      }
+      if (g_ovl.active && g_ovl.root == buf) {
+        // Page-ins read the FS from core1; only safe while core0 is parked in the foreground run
+        Console.println("exec: overlay programs run in the foreground only");
+        Exec.freeExecBuf(raw);
+        return;
+      }
+      Exec.submitJob(fn, raw, buf + entry, sz - entry, (uint32_t)argc, argvN, prio, jobTimeout);
+    }
+  } else if (!strcmp(t0, "jobs")) {
+    Exec.printJobs();
+  } else if (!strcmp(t0, "kill")) {
+    char* idStr;
+    if (!nextToken(p, idStr)) {
+      Console.println("usage: kill <id>");
+      return;
+    }
+    uint32_t id = (uint32_t)strtoul(idStr, nullptr, 0);
+    if (Exec.killJob(id)) Console.printf("Job #%u: cancel requested\n", (unsigned)id);
+    else Console.printf("kill: no queued or running job #%u\n", (unsigned)id);
   } else if (!strcmp(t0, "coproc")) {
     char* sub;
     if (!nextToken(p, sub)) {
       Console.println("coproc cmds:");
-      Console.println("  coproc ping|info|exec <file> [a0..]|sexec <file> [a0..]|func <name> [a0..]|status|mbox [n]|cancel|reset|isp enter|exit");
+      Console.println("  coproc ping|info|link [max_bps]|exec <file> [a0..]|sexec <file> [a0..]|func <name> [a0..]|status|mbox [n]|cancel|reset|isp enter|exit");
+      Console.println("  coproc start|sstart <file> [a0..]|submit|ssubmit <file> <prio> [a0..]|results|bench [n] [fn]|stats [reset]|events [on|off]|funcs|batch <fn> [a..] ; <fn> [a..] ...|shared [on|off]");
+      Console.println("  coproc links|use <n>|fan|sfan <file> <prio> [caps] [a0..aN]");
       return;
     }
     if (!strcmp(sub, "ping")) {
       if (!Exec.coprocHello()) Console.println("coproc ping failed");
     } else if (!strcmp(sub, "info")) {
       if (!Exec.coprocInfo()) Console.println("coproc info failed");
+    } else if (!strcmp(sub, "link")) {
+      char* tok = nullptr;
+      if (!nextToken(p, tok)) {
+        Exec.coprocLinkInfo();
+        return;
+      }
+      uint32_t maxBaud = (uint32_t)strtoul(tok, nullptr, 0);
+      if (!maxBaud) {
+        Console.println("usage: coproc link [max_bps]");
+        return;
+      }
+      if (!Exec.coprocLinkNegotiate(maxBaud)) Console.println("coproc link failed");
     } else if (!strcmp(sub, "sexec")) {
       char* fname = nullptr;
       if (!nextToken(p, fname)) {
@@ -1295,6 +1467,95 @@ static void handleCommand(char* line) {
         return;
       }
       if (!Exec.coprocExecTokens(tokens, argc)) Console.println("coproc exec failed");
+    } else if (!strcmp(sub, "start") || !strcmp(sub, "sstart")) {
+      const bool script = (sub[0] == 's' && sub[1] == 's');
+      char* fname = nullptr;
+      if (!nextToken(p, fname)) {
+        Console.printf("usage: coproc %s <file> [a0..aN]\n", sub);
+        return;
+      }
+      int32_t argvN[MAX_EXEC_ARGS];
+      uint32_t argc = 0;
+      char* tok = nullptr;
+      while (nextToken(p, tok) && argc < MAX_EXEC_ARGS) argvN[argc++] = (int32_t)strtol(tok, nullptr, 0);
+      if (!Exec.coprocExecFileAsync(fname, argvN, argc, script)) Console.printf("coproc %s failed\n", sub);
+    } else if (!strcmp(sub, "submit") || !strcmp(sub, "ssubmit")) {
+      const bool script = (sub[0] == 's' && sub[1] == 's');
+      char* fname = nullptr;
+      char* prio = nullptr;
+      if (!nextToken(p, fname) || !nextToken(p, prio)) {
+        Console.printf("usage: coproc %s <file> <prio> [a0..aN]\n", sub);
+        return;
+      }
+      int32_t argvN[MAX_EXEC_ARGS];
+      uint32_t argc = 0;
+      char* tok = nullptr;
+      while (nextToken(p, tok) && argc < MAX_EXEC_ARGS) argvN[argc++] = (int32_t)strtol(tok, nullptr, 0);
+      uint32_t id = 0;
+      if (Exec.coprocJobSubmitFile(fname, argvN, argc, script, (uint32_t)strtoul(prio, nullptr, 0), &id))
+        Console.printf("coproc job %u queued\n", (unsigned)id);
+      else Console.printf("coproc %s failed\n", sub);
+    } else if (!strcmp(sub, "fan") || !strcmp(sub, "sfan")) {
+      const bool script = (sub[0] == 's');
+      char* fname = nullptr;
+      char* prio = nullptr;
+      if (!nextToken(p, fname) || !nextToken(p, prio)) {
+        Console.printf("usage: coproc %s <file> <prio> [caps] [a0..aN]\n", sub);
+        return;
+      }
+      int32_t argvN[EXECHOST_FAN_ARGS];
+      uint32_t argc = 0;
+      uint32_t caps = 0;
+      char* tok = nullptr;
+      if (nextToken(p, tok)) caps = (uint32_t)strtoul(tok, nullptr, 0);
+      while (nextToken(p, tok) && argc < EXECHOST_FAN_ARGS) argvN[argc++] = (int32_t)strtol(tok, nullptr, 0);
+      uint32_t id = Exec.coprocFanSubmit(fname, argvN, argc, script, (uint32_t)strtoul(prio, nullptr, 0), caps);
+      if (id) Console.printf("coproc fan #%u queued (%u outstanding)\n", (unsigned)id, (unsigned)Exec.coprocFanPending());
+      else Console.printf("coproc %s failed\n", sub);
+    } else if (!strcmp(sub, "links")) {
+      Exec.coprocFanReport();
+    } else if (!strcmp(sub, "use")) {
+      char* tok = nullptr;
+      if (!nextToken(p, tok) || !Exec.coprocSelect((uint32_t)strtoul(tok, nullptr, 0))) {
+        Console.printf("usage: coproc use <0..%u>\n", (unsigned)(Exec.coprocCount() ? Exec.coprocCount() - 1 : 0));
+        return;
+      }
+      Console.printf("coproc: using link %u\n", (unsigned)Exec.coprocCurrent());
+    } else if (!strcmp(sub, "bench")) {
+      char* tok = nullptr;
+      char* fn = nullptr;
+      uint32_t rounds = EXECHOST_BENCH_ROUNDS;
+      if (nextToken(p, tok)) rounds = (uint32_t)strtoul(tok, nullptr, 0);
+      if (!nextToken(p, fn)) fn = (char*)"ping";
+      if (!Exec.coprocBench(rounds, fn)) Console.println("coproc bench: some tests failed");
+    } else if (!strcmp(sub, "stats")) {
+      char* arg = nullptr;
+      bool reset = nextToken(p, arg) && !strcmp(arg, "reset");
+      Exec.coprocStats(reset);
+    } else if (!strcmp(sub, "results")) {
+      ExecHost::CoprocResult res[EXECHOST_RESULTS_MAX];
+      uint32_t n = 0, dropped = 0, pending = 0;
+      if (!Exec.coprocResults(res, EXECHOST_RESULTS_MAX, n, &dropped, &pending)) {
+        Console.println("coproc results failed");
+        return;
+      }
+      for (uint32_t i = 0; i < n; ++i)
+        Console.printf("  job %u: status=%d return=%d\n", (unsigned)res[i].id, (int)res[i].status, (int)res[i].result);
+      Console.printf("coproc results: %u shown, %u pending, %u dropped\n", (unsigned)n, (unsigned)pending, (unsigned)dropped);
+    } else if (!strcmp(sub, "events")) {
+      char* arg = nullptr;
+      const uint32_t all = CoProc::EVT_JOB_DONE | CoProc::EVT_MAILBOX | CoProc::EVT_ERROR;
+      if (!nextToken(p, arg)) {
+        uint32_t m = Exec.coprocEventMask();
+        Console.printf("coproc events: %s (mask=0x%X, %u pending)\n", (m & CoProc::EVT_MAILBOX) ? "on" : "off", (unsigned)m,
+                       (unsigned)Exec.coprocPending());
+      } else if (!strcmp(arg, "on")) {
+        if (!Exec.coprocSubscribe(all)) Console.println("coproc events failed");
+      } else if (!strcmp(arg, "off")) {
+        if (!Exec.coprocSubscribe(CoProc::EVT_JOB_DONE)) Console.println("coproc events failed");  // background jobs still report
+      } else {
+        Console.println("usage: coproc events [on|off]");
+      }
     } else if (!strcmp(sub, "func")) {
       char* name = nullptr;
       if (!nextToken(p, name)) {
@@ -1314,6 +1575,67 @@ static void handleCommand(char* line) {
       } else {
         Console.println("coproc func failed");
       }
+    } else if (!strcmp(sub, "shared")) {
+      char* arg = nullptr;
+      if (nextToken(p, arg)) {
+        if (!strcmp(arg, "on") && g_coprocShared.device()) Exec.attachShared(&g_coprocShared);
+        else if (!strcmp(arg, "off")) Exec.attachShared(nullptr);
+        else {
+          Console.println("usage: coproc shared [on|off] (on needs the PSRAM)");
+          return;
+        }
+      }
+      Console.printf("coproc shared: %s (window 0x%06X, %u bytes)\n", Exec.coprocShared() ? "on" : "off",
+                     (unsigned)CoProc::SHARED_REF_BASE, (unsigned)CoProc::SHARED_REF_SIZE);
+    } else if (!strcmp(sub, "funcs")) {
+      if (!Exec.coprocFuncList()) Console.println("coproc funcs failed");
+    } else if (!strcmp(sub, "batch")) {
+      // Calls are separated by ';' (its own token or glued to the last arg)
+      struct Call {
+        const char* name;
+        uint32_t first, argc;
+      };
+      static Call calls[64];
+      static int32_t args[256];
+      static int32_t results[64];
+      static ExecHost::CoprocBatch batch;
+      uint32_t nCalls = 0, nArgs = 0;
+      bool open = false;
+      char* tok = nullptr;
+      while (nextToken(p, tok)) {
+        size_t tl = strlen(tok);
+        bool sep = (tl && tok[tl - 1] == ';');
+        if (sep) tok[--tl] = 0;
+        if (tl) {
+          if (!open) {
+            if (nCalls >= 64) break;
+            calls[nCalls++] = { tok, nArgs, 0 };
+            open = true;
+          } else if (nArgs < 256) {
+            args[nArgs++] = (int32_t)strtol(tok, nullptr, 0);
+            ++calls[nCalls - 1].argc;
+          }
+        }
+        if (sep) open = false;
+      }
+      if (nCalls == 0) {
+        Console.println("usage: coproc batch <fn> [a0..] ; <fn> [a0..] ...");
+        return;
+      }
+      bool ok = false;
+      uint32_t done = 0;
+      for (int attempt = 0; attempt < 2 && !ok; ++attempt) {  // second pass after a function table refresh
+        batch.clear();
+        uint32_t i = 0;
+        for (; i < nCalls; ++i)
+          if (!Exec.coprocBatchAdd(batch, calls[i].name, args + calls[i].first, calls[i].argc)) break;
+        if (i < nCalls) break;
+        uint32_t crc = batch.tableCrc;
+        ok = Exec.coprocFuncBatch(batch, results, 64, &done);
+        if (!ok && Exec.coprocFuncTableCrc() == crc) break;
+      }
+      for (uint32_t i = 0; i < done; ++i) Console.printf("  %s -> %d\n", calls[i].name, (int)results[i]);
+      if (!ok) Console.printf("coproc batch failed (%u of %u calls ran)\n", (unsigned)done, (unsigned)nCalls);
     } else if (!strcmp(sub, "status")) {
       if (!Exec.coprocStatus()) Console.println("coproc status failed");
     } else if (!strcmp(sub, "mbox")) {
@@ -1339,7 +1661,7 @@ static void handleCommand(char* line) {
         Console.println("usage: coproc isp enter|exit");
       }
     } else {
-      Console.println("usage: coproc ping|info|exec|sexec|func|status|mbox|cancel|reset|isp");
+      Console.println("usage: coproc ping|info|link|exec|sexec|start|sstart|events|func|status|mbox|cancel|reset|isp");
     }
   } else if (!strcmp(t0, "blobs")) {
     listBlobs();
@@ -1381,6 +1703,9 @@ static void handleCommand(char* line) {
   } else if (!strcmp(t0, "psramsmoketest")) {
     psramPrintCapacityReport(uniMem);
     psramSafeSmokeTest(fsPSRAM);
+  } else if (!strcmp(t0, "crcbench")) {
+    char* kbStr;
+    crcBench(nextToken(p, kbStr) ? (uint32_t)strtoul(kbStr, nullptr, 0) : 16u);
   } else if (!strcmp(t0, "reboot")) {
     Console.printf("Rebooting..\n");
     delay(20);
@@ -1516,14 +1841,37 @@ static void handleCommand(char* line) {
   } else if (!strcmp(t0, "cc")) {
     char* src;
     char* dst;
+    char* target;
     if (!nextToken(p, src) || !nextToken(p, dst)) {
-      Console.println("usage: cc <src> <dst>");
+      Console.println("usage: cc <src> <dst> [thumb1|thumb2|xtensa]");
       Console.println("example: cc myprog.c myprog.bin");
       return;
     }
-    if (!compileTinyCFileToFile(src, dst)) {
+    nextToken(p, target);  // optional; nullptr when absent
+    if (!compileTinyCFileToFile(src, dst, target)) {
       Console.println("cc: failed");
     }
+  } else if (!strcmp(t0, "run")) {
+    char* src;
+    if (!nextToken(p, src)) {
+      Console.println("usage: run <src.c> [a0 ... aN]");
+      return;
+    }
+    static int32_t argvN[MAX_EXEC_ARGS];
+    int argc = 0;
+    char* tok = nullptr;
+    while (argc < (int)MAX_EXEC_ARGS && nextToken(p, tok)) argvN[argc++] = (int32_t)strtol(tok, nullptr, 0);
+    if (!runTinyCFile(src, argc, argvN)) {
+      Console.println("run: failed");
+    }
+  } else if (!strcmp(t0, "runcache")) {
+    char* sub;
+    if (nextToken(p, sub) && !strcmp(sub, "clear")) {
+      runCacheClear();
+      Console.println("run cache cleared (rc_*.bin files on FS are kept)");
+    } else {
+      runCachePrint();
+    }
   } else if (!strcmp(t0, "pwd")) {
     Console.print("cwd: /");
     Console.println(g_cwd);
@@ -1855,10 +2203,19 @@ void setup() {
   for (size_t i = 0; i < BLOB_MAILBOX_MAX; ++i) BLOB_MAILBOX[i] = 0;
 
   Exec.attachConsole(&Console);
+  Exec.mailboxReset();  // streaming ring, console attached
   Exec.attachCoProc(&coprocLink, COPROC_BAUD);
+#if COPROC2_LINK
+  Exec.addCoProc(&coprocLink2, COPROC_BAUD, COPROC2_CAPS);
+#endif
   updateExecFsTable();
+  Exec.attachExports(g_execExports, g_execExports_count);
+  if (psramOk) {
+    g_coprocShared.setDevice(fsPSRAM.raw().device());
+    Exec.attachShared(&g_coprocShared);
+  }
 
-  Console.printf("Controller serial link ready @ %u bps (RX=GP%u, TX=GP%u)\n", (unsigned)COPROC_BAUD, (unsigned)PIN_COPROC_RX, (unsigned)PIN_COPROC_TX);
+  Console.printf("Controller serial link ready @ %u bps (%s, GP%u/GP%u)\n", (unsigned)COPROC_BAUD, coprocLink.name(), (unsigned)PIN_COPROC_RX, (unsigned)PIN_COPROC_TX);
   Console.printf("System ready. Type 'help'\n> ");
 }
 void setup1() {
@@ -1869,7 +2226,9 @@ void loop1() {
   tight_loop_contents();
 }
 void loop() {
-  Exec.pollBackground();
+  Exec.pollJobs();
+  Exec.coprocPoll();  // async co-processor replies and events
+  Exec.coprocFanPoll();  // fan-out jobs across the co-processors
   if (g_b64u.active) {
     b64uPump();
     return;
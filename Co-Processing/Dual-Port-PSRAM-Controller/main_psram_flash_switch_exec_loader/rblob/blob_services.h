@@ -0,0 +1,33 @@
+// blob_services.h - firmware services importable by RBL1 blobs (see ../RelocBlob.h).
+// Build blobs with -mlong-calls; mkrblob.py turns each call into an import slot patched at load time.
+#pragma once
+#include <stdint.h>
+
+// Place a function (and nothing it writes) in overlay n; see ../ExecOverlay.h. Overlay code may use
+// root data/bss, root functions, services and its own BLOB_OVERLAY_CONST tables.
+#define BLOB_OVERLAY(n) __attribute__((section(".ovl" #n), noinline))
+#define BLOB_OVERLAY_CONST(n) __attribute__((section(".ovl" #n ".rodata")))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void svc_mbox_puts(const char* s);  // append text to the mailbox (streamed to the console as it runs)
+void svc_mbox_putd(int32_t v);      // append decimal
+void svc_mbox_putx(uint32_t v);     // append 0x%08X
+void svc_mbox_write(const void* p, uint32_t n);  // append raw bytes; waits while the ring is full
+void svc_mbox_clear(void);          // no-op (kept for older blobs)
+int32_t svc_cancel_requested(void);  // nonzero once 'kill' or a timeout asked the job to stop
+void svc_delay_us(uint32_t us);
+void svc_delay_ms(uint32_t ms);
+uint32_t svc_millis(void);
+uint32_t svc_micros(void);
+void svc_gpio_mode(uint32_t pin, uint32_t mode);  // 0=in 1=out 2=in+pullup 3=in+pulldown
+void svc_gpio_write(uint32_t pin, uint32_t v);
+int32_t svc_gpio_read(uint32_t pin);
+int32_t svc_fs_size(const char* name);                                       // -1 if missing
+int32_t svc_fs_read(const char* name, uint32_t off, void* dst, uint32_t len);  // bytes read, -1 on error
+
+#ifdef __cplusplus
+}
+#endif
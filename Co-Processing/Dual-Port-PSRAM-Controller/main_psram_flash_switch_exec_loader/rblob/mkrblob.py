@@ -0,0 +1,355 @@
+#!/usr/bin/env python3
+"""mkrblob.py - pack an ARM Thumb relocatable object (.o) into an RBL1 blob.
+
+  mkrblob.py in.o out.rbl [--entry=name]   (default entry symbol: entry)
+
+Layout and loader: see ../RelocBlob.h. The object must be built with -mlong-calls so that
+calls to firmware services go through a literal word (R_ARM_ABS32 against an undefined
+symbol); those words become import slots, resolved by name on the device. ABS32 words that
+point into the blob become relocations. BL/B.W between blob functions are resolved here.
+
+Overlays (version 2, ../ExecOverlay.h): code and constants placed in sections named
+.ovl<N>[.*] (see BLOB_OVERLAY in blob_services.h) become overlay N. Only the root and
+one region as large as the biggest overlay are resident on the device. References to overlay
+functions from anywhere else go through generated root stubs. Overlays must be read-only and
+may only reference their own constants.
+"""
+import re
+import struct
+import sys
+
+MAGIC = 0x314C4252
+VERSION, VERSION_OVL = 1, 2
+HEADER_SIZE, OVL_HEADER_SIZE = 32, 8
+MAX_RELOCS, MAX_IMPORTS, MAX_STRTAB, MAX_OVERLAYS = 1024, 64, 1024, 255
+OVL_ROOT, OVL_REGION, OVL_CALL_ROOT, OVL_IMPORT = 0, 1, 2, 3
+STUB_SIZE, MAX_STUBS = 12, 85  # ldr r1 of the last stub must still reach the shared slot
+
+SHT_PROGBITS, SHT_SYMTAB, SHT_NOBITS, SHT_REL, SHT_RELA = 1, 2, 8, 9, 4
+SHF_WRITE, SHF_ALLOC = 0x1, 0x2
+SHN_UNDEF, SHN_ABS = 0, 0xFFF1
+STT_FUNC = 2
+R_ARM_NONE, R_ARM_ABS32, R_ARM_REL32 = 0, 2, 3
+R_ARM_THM_CALL, R_ARM_THM_JUMP24, R_ARM_V4BX = 10, 30, 40
+ROOT = -1
+
+
+def die(msg):
+    sys.exit("mkrblob: " + msg)
+
+
+def align(v, a):
+    return (v + a - 1) & ~(a - 1) if a > 1 else v
+
+
+def cstr(data, off):
+    return data[off:data.index(b"\0", off)].decode()
+
+
+def read_elf(data):
+    if data[:4] != b"\x7fELF" or data[4] != 1 or data[5] != 1:
+        die("not a 32-bit little-endian ELF")
+    e_type, e_machine = struct.unpack_from("<HH", data, 16)
+    if e_type != 1 or e_machine != 40:
+        die("expected an ARM relocatable object (ET_REL)")
+    e_shoff, = struct.unpack_from("<I", data, 32)
+    e_shentsize, e_shnum, e_shstrndx = struct.unpack_from("<HHH", data, 46)
+    secs = []
+    for i in range(e_shnum):
+        f = struct.unpack_from("<IIIIIIIIII", data, e_shoff + i * e_shentsize)
+        secs.append(dict(name_off=f[0], type=f[1], flags=f[2], offset=f[4], size=f[5],
+                         link=f[6], info=f[7], addralign=f[8], entsize=f[9]))
+    shstr = secs[e_shstrndx]
+    for s in secs:
+        s["name"] = cstr(data, shstr["offset"] + s["name_off"])
+    return secs
+
+
+def thm_branch_offset(hi, lo):
+    s = (hi >> 10) & 1
+    j1, j2 = (lo >> 13) & 1, (lo >> 11) & 1
+    i1, i2 = 1 - (j1 ^ s), 1 - (j2 ^ s)
+    v = (s << 24) | (i1 << 23) | (i2 << 22) | ((hi & 0x3FF) << 12) | ((lo & 0x7FF) << 1)
+    return v - (1 << 25) if s else v
+
+
+def thm_branch_encode(hi, lo, off, name):
+    if not -(1 << 24) <= off < (1 << 24):
+        die("branch to '%s' out of range" % name)
+    v = off & 0x1FFFFFF
+    s = (v >> 24) & 1
+    i1, i2 = (v >> 23) & 1, (v >> 22) & 1
+    j1, j2 = 1 - (i1 ^ s), 1 - (i2 ^ s)
+    hi = (hi & 0xF800) | (s << 10) | ((v >> 12) & 0x3FF)
+    lo = (lo & 0xD000) | (j1 << 13) | (j2 << 11) | ((v >> 1) & 0x7FF)
+    return hi, lo
+
+
+class Segment:
+    def __init__(self, seg_id):
+        self.id = seg_id
+        self.image = bytearray()
+        self.relocs = []  # root: offsets; overlays: (off, kind, arg)
+
+    def place(self, data, alignment):
+        self.image += b"\0" * (align(len(self.image), alignment) - len(self.image))
+        off = len(self.image)
+        self.image += data
+        return off
+
+    def pad4(self):
+        self.image += b"\0" * (align(len(self.image), 4) - len(self.image))
+
+
+def pack(obj, entry_name):
+    secs = read_elf(obj)
+
+    def seg_of(s):
+        m = re.match(r"^\.ovl(\d+)(\..*)?$", s["name"])
+        return int(m.group(1)) if m else ROOT
+
+    def kind(s):
+        if s["type"] == SHT_NOBITS:
+            return 3
+        if s["name"].startswith(".text") or seg_of(s) != ROOT and ".rodata" not in s["name"]:
+            return 0
+        if ".rodata" in s["name"]:
+            return 1
+        return 2
+
+    alloc = [i for i, s in enumerate(secs)
+             if s["flags"] & SHF_ALLOC and s["type"] in (SHT_PROGBITS, SHT_NOBITS) and s["size"]
+             and not s["name"].startswith(".ARM.")]
+    alloc.sort(key=lambda i: (kind(secs[i]), i))
+
+    # Overlay numbers from the section names map to dense indices in ascending order
+    ovl_nums = sorted(set(seg_of(secs[i]) for i in alloc) - {ROOT})
+    if len(ovl_nums) > MAX_OVERLAYS:
+        die("too many overlays")
+    ovl_index = {n: k for k, n in enumerate(ovl_nums)}
+    root = Segment(ROOT)
+    ovls = [Segment(k) for k in range(len(ovl_nums))]
+    where = {}  # section index -> (segment, offset)
+    for i in alloc:
+        s = secs[i]
+        n = seg_of(s)
+        if n != ROOT and (s["type"] == SHT_NOBITS or s["flags"] & SHF_WRITE):
+            die("overlay section %s must be read-only (no data/bss in overlays)" % s["name"])
+        if s["type"] == SHT_NOBITS:
+            continue
+        seg = root if n == ROOT else ovls[ovl_index[n]]
+        where[i] = (seg, seg.place(obj[s["offset"]:s["offset"] + s["size"]], s["addralign"]))
+    for seg in ovls:
+        seg.pad4()
+
+    symtab = next((s for s in secs if s["type"] == SHT_SYMTAB), None)
+    if symtab is None:
+        die("no symbol table")
+    strtab_off = secs[symtab["link"]]["offset"]
+    syms = []
+    func_starts = set()  # (segment, offset | 1) of every function placed in an overlay
+    for k in range(symtab["size"] // 16):
+        name, value, size, info, other, shndx = struct.unpack_from("<IIIBBH", obj, symtab["offset"] + k * 16)
+        syms.append((cstr(obj, strtab_off + name) if name else "", value, shndx))
+        if info & 15 == STT_FUNC and shndx in where and where[shndx][0].id != ROOT:
+            func_starts.add((where[shndx][0].id, (where[shndx][1] + value) | 1))
+
+    fixups = []  # (segment, P, rtype, rsym)
+    for rs in secs:
+        if rs["type"] == SHT_RELA:
+            die("RELA sections are not supported")
+        if rs["type"] != SHT_REL or rs["info"] not in where:
+            continue
+        seg, sbase = where[rs["info"]]
+        for k in range(rs["size"] // 8):
+            r_off, r_info = struct.unpack_from("<II", obj, rs["offset"] + k * 8)
+            if r_info & 0xFF not in (R_ARM_NONE, R_ARM_V4BX):
+                fixups.append((seg, sbase + r_off, r_info & 0xFF, r_info >> 8))
+
+    bss_where = {}
+
+    def sym_loc(k):
+        name, value, shndx = syms[k]
+        if shndx == SHN_UNDEF:
+            return None
+        if shndx == SHN_ABS:
+            die("absolute symbol '%s' is not supported" % name)
+        if shndx in where:
+            seg, off = where[shndx]
+            return seg.id, off + value
+        if shndx in bss_where:
+            return ROOT, bss_where[shndx] + value
+        die("symbol '%s' lives in a section that is not loaded (%s)" % (name, secs[shndx]["name"]))
+
+    def stub_target(seg, P, rtype, rsym):
+        """Overlay function (segment, offset|1) that this fixup must reach through a stub, or None."""
+        shndx = syms[rsym][2]
+        if shndx not in where or where[shndx][0].id == ROOT:
+            return None
+        tseg, toff = where[shndx][0].id, where[shndx][1] + syms[rsym][1]
+        if rtype == R_ARM_ABS32:
+            # Function pointers always go through the stub: they may be called from anywhere
+            dest = toff + struct.unpack_from("<I", seg.image, P)[0]
+            return (tseg, dest) if dest & 1 and (tseg, dest) in func_starts else None
+        if rtype in (R_ARM_THM_CALL, R_ARM_THM_JUMP24) and tseg != seg.id:
+            hi, lo = struct.unpack_from("<HH", seg.image, P)
+            return tseg, ((toff & ~1) + thm_branch_offset(hi, lo) + 4) | 1
+        return None
+
+    # Stubs, the shared ovl_dispatch slot and slots for overlay-only imports extend the root image
+    stub_of = {}
+    overlay_imports = set()
+    for seg, P, rtype, rsym in fixups:
+        t = stub_target(seg, P, rtype, rsym)
+        if t and t not in stub_of:
+            stub_of[t] = len(stub_of)
+        if seg.id != ROOT and rtype == R_ARM_ABS32 and syms[rsym][2] == SHN_UNDEF:
+            overlay_imports.add(syms[rsym][0])
+    if len(stub_of) > MAX_STUBS:
+        die("too many overlay entry points (%d > %d)" % (len(stub_of), MAX_STUBS))
+    root.pad4()
+    stubs_off = len(root.image)
+    root.image += b"\0" * (STUB_SIZE * len(stub_of))
+    root_imports = []  # (slotOff, name)
+    import_slot = {}
+    for name in (["ovl_dispatch"] if stub_of else []) + sorted(overlay_imports):
+        import_slot[name] = len(root.image)
+        root_imports.append((len(root.image), name))
+        root.image += b"\0" * 4
+    for (tseg, toff), k in stub_of.items():
+        S = stubs_off + STUB_SIZE * k
+        # push {r0, r1}; ldr r0, [pc, #4]; ldr r1, <ovl_dispatch slot>; bx r1; .word desc
+        ldr_r1 = 0x4900 | ((import_slot["ovl_dispatch"] - (S + 8)) >> 2)
+        struct.pack_into("<HHHHI", root.image, S, 0xB403, 0x4801, ldr_r1, 0x4708, (tseg << 24) | toff)
+
+    bss = 0
+    for i in alloc:
+        s = secs[i]
+        if s["type"] != SHT_NOBITS:
+            continue
+        off = align(len(root.image) + bss, max(s["addralign"], 1))
+        bss_where[i] = off
+        bss = off + s["size"] - len(root.image)
+    bss = align(bss, 4)
+
+    for seg, P, rtype, rsym in fixups:
+        sname = syms[rsym][0]
+        loc = sym_loc(rsym)
+        img = seg.image
+        stub = stub_target(seg, P, rtype, rsym)
+        if rtype == R_ARM_ABS32:
+            A, = struct.unpack_from("<I", img, P)
+            if loc is None:
+                if A != 0:
+                    die("import '%s' with addend %d" % (sname, A))
+                if P & 3:
+                    die("import slot for '%s' is not word aligned" % sname)
+                if seg.id == ROOT:
+                    root_imports.append((P, sname))
+                else:
+                    seg.relocs.append((P, OVL_IMPORT, import_slot[sname]))
+                continue
+            tseg, dest = loc[0], (loc[1] + A) & 0xFFFFFFFF
+            if stub:
+                tseg, dest = ROOT, (stubs_off + STUB_SIZE * stub_of[stub]) | 1
+            struct.pack_into("<I", img, P, dest)
+            if tseg == ROOT:
+                if seg.id == ROOT:
+                    root.relocs.append(P)
+                else:
+                    seg.relocs.append((P, OVL_ROOT, 0))
+            elif tseg == seg.id:
+                seg.relocs.append((P, OVL_REGION, 0))
+            else:
+                die("reference to '%s' reaches into another overlay's constants" % (sname or "section data"))
+        elif rtype == R_ARM_REL32:
+            if loc is None or loc[0] != seg.id:
+                die("PC-relative reference to '%s' outside its own segment" % sname)
+            A, = struct.unpack_from("<i", img, P)
+            struct.pack_into("<I", img, P, (loc[1] + A - P) & 0xFFFFFFFF)
+        elif rtype in (R_ARM_THM_CALL, R_ARM_THM_JUMP24):
+            if loc is None:
+                die("direct call to '%s'; build the blob with -mlong-calls" % sname)
+            hi, lo = struct.unpack_from("<HH", img, P)
+            tseg, S, A = loc[0], loc[1], thm_branch_offset(hi, lo)
+            if stub:
+                tseg, S, A = ROOT, stubs_off + STUB_SIZE * stub_of[stub], -4
+            # Overlay -> root branches are encoded as if the region sat at the root base;
+            # the loader adds (root - region) when the overlay is paged in (OVL_CALL_ROOT)
+            hi, lo = thm_branch_encode(hi, lo, (S & ~1) + A - P, sname)
+            struct.pack_into("<HH", img, P, hi, lo)
+            if tseg == ROOT and seg.id != ROOT:
+                seg.relocs.append((P, OVL_CALL_ROOT, 0))
+        else:
+            die("unsupported relocation type %d against '%s'" % (rtype, sname))
+
+    entry = None
+    for k, (name, value, shndx) in enumerate(syms):
+        if name == entry_name and shndx != SHN_UNDEF:
+            seg_id, off = sym_loc(k)
+            if seg_id != ROOT:
+                die("entry '%s' must not live in an overlay" % entry_name)
+            entry = off & ~1
+    if entry is None:
+        die("entry symbol '%s' not found" % entry_name)
+
+    names = bytearray()
+    name_off = {}
+    imp_bytes = bytearray()
+    for slot, name in root_imports:
+        if name not in name_off:
+            name_off[name] = len(names)
+            names += name.encode() + b"\0"
+        imp_bytes += struct.pack("<IHH", slot, 0, name_off[name])
+    names += b"\0" * (align(len(names), 4) - len(names))
+    rel_bytes = b"".join(struct.pack("<I", p) for p in sorted(root.relocs))
+    if len(root.relocs) > MAX_RELOCS or len(root_imports) > MAX_IMPORTS or len(names) > MAX_STRTAB:
+        die("too many relocations/imports for the loader limits")
+    nrel, nimp = len(root.relocs), len(root_imports)
+    if not ovls:
+        hdr = struct.pack("<IHHIIIHHII", MAGIC, VERSION, HEADER_SIZE, len(root.image), bss, entry,
+                          nrel, nimp, len(names), 0)
+        out = hdr + rel_bytes + bytes(imp_bytes) + bytes(names) + bytes(root.image)
+        return out, "image=%u bss=%u relocs=%u imports=%s" % (
+            len(root.image), bss, nrel, ",".join(sorted(name_off)) or "-")
+
+    region = max(len(o.image) for o in ovls)
+    head_size = HEADER_SIZE + OVL_HEADER_SIZE
+    pos = head_size + len(rel_bytes) + len(imp_bytes) + len(names) + 16 * len(ovls) + len(root.image)
+    desc = bytearray()
+    tail = bytearray()
+    for o in ovls:
+        if len(o.relocs) > 0xFFFF:
+            die("overlay %d has too many fixups" % o.id)
+        img_off = pos + len(tail)
+        tail += o.image
+        rel_off = pos + len(tail)
+        for P, k, arg in o.relocs:
+            tail += struct.pack("<II", (k << 28) | P, arg)
+        desc += struct.pack("<IIIHH", img_off, len(o.image), rel_off, len(o.relocs), 0)
+    hdr = struct.pack("<IHHIIIHHII", MAGIC, VERSION_OVL, head_size, len(root.image), bss, entry,
+                      nrel, nimp, len(names), 0) + struct.pack("<HHI", len(ovls), 0, region)
+    out = hdr + rel_bytes + bytes(imp_bytes) + bytes(names) + bytes(desc) + bytes(root.image) + bytes(tail)
+    info = "root=%u bss=%u relocs=%u imports=%s overlays=%u region=%u stubs=%u (resident %u of %u bytes)" % (
+        len(root.image), bss, nrel, ",".join(sorted(name_off)) or "-", len(ovls), region, len(stub_of),
+        len(root.image) + bss + region, len(root.image) + bss + sum(len(o.image) for o in ovls))
+    return out, info
+
+
+def main(argv):
+    args = [a for a in argv[1:] if not a.startswith("--")]
+    entry = "entry"
+    for a in argv[1:]:
+        if a.startswith("--entry="):
+            entry = a.split("=", 1)[1]
+    if len(args) != 2:
+        die("usage: mkrblob.py in.o out.rbl [--entry=name]")
+    with open(args[0], "rb") as f:
+        blob, info = pack(f.read(), entry)
+    with open(args[1], "wb") as f:
+        f.write(blob)
+    print("%s: %s" % (args[1], info))
+
+
+if __name__ == "__main__":
+    main(sys.argv)
@@ -0,0 +1,29 @@
+// svc_blink.cpp - RBL1 example: blink a pin through firmware services and report via the mailbox.
+//   exec svc_blink.rbl <pin> <count> <period_ms>
+#include "blob_services.h"
+
+static uint32_t toggles;  // .bss: zeroed by the loader
+
+extern "C" int32_t entry(int32_t pin, int32_t count, int32_t period_ms) {
+  if (pin < 0 || pin > 29) {
+    svc_mbox_puts("svc_blink: bad pin ");
+    svc_mbox_putd(pin);
+    return -1;
+  }
+  if (period_ms <= 0) period_ms = 250;
+  svc_gpio_mode((uint32_t)pin, 1);
+  uint32_t t0 = svc_millis();
+  for (int32_t i = 0; i < count; ++i) {
+    svc_gpio_write((uint32_t)pin, 1);
+    svc_delay_ms((uint32_t)period_ms / 2);
+    svc_gpio_write((uint32_t)pin, 0);
+    svc_delay_ms((uint32_t)period_ms / 2);
+    ++toggles;
+  }
+  svc_mbox_puts("svc_blink: ");
+  svc_mbox_putd((int32_t)toggles);
+  svc_mbox_puts(" cycles in ");
+  svc_mbox_putd((int32_t)(svc_millis() - t0));
+  svc_mbox_puts(" ms");
+  return (int32_t)toggles;
+}
@@ -0,0 +1,49 @@
+// svc_ovl.cpp - RBL1 overlay example: three phases that never need to be resident together.
+//   exec svc_ovl.rbl <n>
+// Each phase lives in its own overlay; only the root and the largest phase occupy SRAM.
+#include "blob_services.h"
+
+static int32_t acc;  // root .bss, shared by every overlay
+
+static void note(const char* what, int32_t v) {
+  svc_mbox_puts(what);
+  svc_mbox_putd(v);
+  svc_mbox_puts(" ");
+}
+
+BLOB_OVERLAY_CONST(0) static const uint8_t k_squares[8] = { 0, 1, 4, 9, 16, 25, 36, 49 };
+
+BLOB_OVERLAY(0) int32_t phase_squares(int32_t n) {
+  for (int32_t i = 0; i < n; ++i) acc += k_squares[i & 7];
+  note("sq=", acc);
+  return acc;
+}
+
+BLOB_OVERLAY(1) int32_t phase_fib(int32_t n) {
+  int32_t a = 0, b = 1;
+  for (int32_t i = 0; i < n; ++i) {
+    int32_t t = a + b;
+    a = b;
+    b = t;
+  }
+  acc += a;
+  note("fib=", a);
+  return a;
+}
+
+// Overlay 2 calls into overlay 0: the loader evicts 2, runs 0, and pages 2 back in on return
+BLOB_OVERLAY(2) int32_t phase_mix(int32_t n) {
+  int32_t s = phase_squares(n);
+  note("mix=", s ^ acc);
+  return s ^ acc;
+}
+
+extern "C" int32_t entry(int32_t n) {
+  if (n <= 0) n = 10;
+  uint32_t t0 = svc_micros();
+  phase_squares(n);
+  phase_fib(n);
+  int32_t r = phase_mix(n);
+  note("us=", (int32_t)(svc_micros() - t0));
+  return r;
+}
@@ -451,7 +451,7 @@ static bool sha256File(const char* fname, uint8_t out[32]) {
   return true;
 }
 
-// ========== Compile Tiny-C source file -> raw Thumb binary on FS ==========
+// ========== Compile Tiny-C source file -> raw Thumb/Xtensa binary on FS ==========
 static void printCompileErrorContext(const char* src, size_t srcLen, size_t pos) {
   const size_t CONTEXT = 40;
   if (!src || srcLen == 0) return;
@@ -470,8 +470,33 @@ static void printCompileErrorContext(const char* src, size_t srcLen, size_t pos)
   Console.println("-------------------");
 }
 
-static bool compileTinyCFileToFile(const char* srcName, const char* dstName) {
+static void printCompileStats(const MCCompiler::Result& base, const MCCompiler::Result& opt, MCCompiler::Target target) {
+  if (!base.ok) return;
+  Console.print("compile: -O0 ");
+  Console.print((uint32_t)base.stats.codeBytes);
+  Console.print("+");
+  Console.print((uint32_t)base.stats.poolBytes);
+  Console.print(" bytes ~");
+  Console.print((uint32_t)base.stats.cycles);
+  Console.print(" cyc -> -O ");
+  Console.print((uint32_t)opt.stats.codeBytes);
+  Console.print("+");
+  Console.print((uint32_t)opt.stats.poolBytes);
+  Console.print(" bytes ~");
+  Console.print((uint32_t)opt.stats.cycles);
+  Console.print(" cyc (code+pool, static ");
+  Console.print(MCCompiler::targetName(target));
+  Console.println(" estimate)");
+}
+// targetArg: "thumb1" / "thumb2" / "xtensa", nullptr = the core this sketch runs on
+static bool compileTinyCFileToFile(const char* srcName, const char* dstName, const char* targetArg) {
   if (!checkNameLen(srcName) || !checkNameLen(dstName)) return false;
+  MCCompiler::Target target;
+  if (targetArg && !MCCompiler::parseTarget(targetArg, target)) {
+    Console.print("compile: unknown target: ");
+    Console.println(targetArg);
+    return false;
+  }
   if (!activeFs.exists(srcName)) {
     Console.print("compile: source not found: ");
     Console.println(srcName);
@@ -506,9 +531,23 @@ static bool compileTinyCFileToFile(const char* srcName, const char* dstName) {
     return false;
   }
 
-  MCCompiler comp;
+  // ~35 KB of AST/codegen tables: keep the compiler off the stack
+  MCCompiler* comp = new (std::nothrow) MCCompiler();
+  if (!comp) {
+    Console.println("compile: out of memory for compiler");
+    free(outBuf);
+    free(srcBuf);
+    return false;
+  }
+  if (targetArg) comp->setTarget(target);
+  target = comp->target();
   size_t outSize = 0;
-  MCCompiler::Result r = comp.compile(srcBuf, srcSize, outBuf, outCap, &outSize);
+  // Unoptimized pass only feeds the before/after report
+  comp->setOptions(MCCompiler::Options::none());
+  MCCompiler::Result base = comp->compile(srcBuf, srcSize, outBuf, outCap, &outSize);
+  comp->setOptions(MCCompiler::Options());
+  MCCompiler::Result r = comp->compile(srcBuf, srcSize, outBuf, outCap, &outSize);
+  delete comp;
   if (!r.ok) {
     Console.print("compile: error at pos ");
     Console.print((uint32_t)r.errorPos);
@@ -527,8 +566,11 @@ static bool compileTinyCFileToFile(const char* srcName, const char* dstName) {
     Console.print(dstName);
     Console.print(" (");
     Console.print((uint32_t)outSize);
-    Console.println(" bytes)");
-    if (outSize & 1u) {
+    Console.print(" bytes, ");
+    Console.print(MCCompiler::targetName(target));
+    Console.println(")");
+    printCompileStats(base, r, target);
+    if ((outSize & 1u) && target != MCCompiler::TARGET_XTENSA) {
       Console.println("note: odd-sized output; for Thumb execution, even size is recommended.");
     }
   } else {
@@ -551,6 +593,11 @@ static bool devWriteAbs(void* ctx, uint32_t absAddr, const uint8_t* data, uint32
   if (!dev) return false;
   return dev->write(absAddr, data, len);
 }
+static bool devReadAbs(void* ctx, uint32_t absAddr, uint8_t* data, uint32_t len) {
+  (void)ctx;
+  UnifiedSpiMem::MemDevice* dev = activeFsDevice();
+  return dev && dev->read(absAddr, data, len) == len;
+}
 static bool devFinalizeSize(void* ctx, const char* name, uint32_t size, uint32_t baseAddr, uint32_t cap) {
   (void)ctx;
   (void)baseAddr;
@@ -563,6 +610,19 @@ static bool devFinalizeSize(void* ctx, const char* name, uint32_t size, uint32_t
   }
 }
 
+// putbin resume point: the checkpointed size rounded down to an erase unit, with the rest of the
+// slot erased again, since NOR/NAND pages must not be programmed twice (a blank unit says nothing
+// about the ones after it: images carry 0xFF padding). PSRAM (no erase unit) resumes where it stopped.
+static bool putbinPrepareResume(const char* fn, uint32_t base, uint32_t cap, uint32_t size, uint32_t& off) {
+  UnifiedSpiMem::MemDevice* dev = activeFsDevice();
+  if (!dev) return false;
+  uint32_t unit = dev->eraseSize();
+  off = unit ? size - size % unit : size;
+  if (!unit) return true;
+  if (off < cap && !dev->eraseRange(base + off, cap - off)) return false;
+  return off == size || devFinalizeSize(nullptr, fn, off, base, cap);
+}
+
 // ========== Serial console / command handling ==========
 static int nextToken(char*& p, char*& tok) {
   while (*p && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) ++p;
@@ -612,9 +672,10 @@ static void printHelp() {
   Console.println("  puthex <file> <hex>          - upload binary as hex string");
   Console.println("  putb64 <file> <base64>       - upload binary as base64");
   Console.println("  putb64s <file> [expected]    - paste base64; end with ESC[201~ (auto), Ctrl-D, or a line '.'");
+  Console.println("  putbin <file> <size> [win|resume] - raw framed upload from a host tool; resume continues a partial file");
   Console.println("  hash <file> [sha256]         - print SHA-256 of file");
   Console.println("  sha256 <file>                - alias for 'hash <file>'");
-  Console.println("  cc <src> <dst>               - compile Tiny-C source file to binary");
+  Console.println("  cc <src> <dst> [target]      - compile Tiny-C source file to binary");
   Console.println("  history                      - print recent command history");
   Console.println("  termwidth [cols]             - show or set terminal width used by line editor");
   Console.println();
@@ -1182,12 +1243,14 @@ static void handleCommand(char* line) {
   } else if (!strcmp(t0, "cc")) {
     char* src;
     char* dst;
+    char* target;
     if (!nextToken(p, src) || !nextToken(p, dst)) {
-      Console.println("usage: cc <src> <dst>");
+      Console.println("usage: cc <src> <dst> [thumb1|thumb2|xtensa]");
       Console.println("example: cc myprog.c myprog.bin");
       return;
     }
-    if (!compileTinyCFileToFile(src, dst)) {
+    nextToken(p, target);  // optional; nullptr when absent
+    if (!compileTinyCFileToFile(src, dst, target)) {
       Console.println("cc: failed");
     }
 
@@ -1690,8 +1753,17 @@ static void handleCommand(char* line) {
   } else if (!strcmp(t0, "putbin")) {
     char* fn = nullptr;
     char* sz = nullptr;
+    char* mode = nullptr;
     if (!nextToken(p, fn) || !nextToken(p, sz)) {
-      Console.println("usage: putbin <file> <size>");
+      Console.println("usage: putbin <file> <size> [win|resume]");
+      return;
+    }
+    // win: per-frame ACK/NAK; resume: the same, continuing an interrupted putbin of this file
+    nextToken(p, mode);
+    bool windowed = mode && (!strcmp(mode, "win") || !strcmp(mode, "resume"));
+    bool resume = mode && !strcmp(mode, "resume");
+    if (mode && !windowed) {
+      Console.println("usage: putbin <file> <size> [win|resume]");
       return;
     }
     if (!checkNameLen(fn)) return;
@@ -1706,39 +1778,56 @@ static void handleCommand(char* line) {
       return;
     }
 
-    // Prepare sector-aligned slot
-    if (activeFs.exists && activeFs.exists(fn)) {
+    // A resume keeps the slot; its logical size is the prefix the last session checkpointed
+    uint32_t base = 0, size = 0, cap = 0, resumeOff = 0;
+    bool keep = resume && activeFs.exists && activeFs.exists(fn) && activeFs.getFileInfo(fn, base, size, cap)
+                && cap >= total && size <= total;
+    if (keep) {
+      if (!putbinPrepareResume(fn, base, cap, size, resumeOff)) {
+        Console.println("putbin: cannot prepare resume");
+        return;
+      }
+    } else if (activeFs.exists && activeFs.exists(fn)) {
       if (!activeFs.deleteFile(fn)) {
         Console.println("putbin: failed to delete existing file");
         return;
       }
     }
-    uint32_t eraseAlign = getEraseAlign();
-    uint32_t reserve = (total + (eraseAlign - 1)) & ~(eraseAlign - 1);
-    if (!activeFs.createFileSlot(fn, reserve, nullptr, 0)) {
-      Console.println("putbin: createFileSlot failed");
-      return;
-    }
+    if (!keep) {
+      uint32_t eraseAlign = getEraseAlign();
+      uint32_t reserve = (total + (eraseAlign - 1)) & ~(eraseAlign - 1);
+      if (!activeFs.createFileSlot(fn, reserve, nullptr, 0)) {
+        Console.println("putbin: createFileSlot failed");
+        return;
+      }
 
-    // Get base/cap
-    uint32_t base, size, cap;
-    if (!activeFs.getFileInfo(fn, base, size, cap)) {
-      Console.println("putbin: getFileInfo failed");
-      return;
-    }
-    if (cap < total) {
-      Console.println("putbin: slot cap < size");
-      return;
+      // Get base/cap
+      if (!activeFs.getFileInfo(fn, base, size, cap)) {
+        Console.println("putbin: getFileInfo failed");
+        return;
+      }
+      if (cap < total) {
+        Console.println("putbin: slot cap < size");
+        return;
+      }
     }
 
     shrxbin::Writer wr;
     wr.writeAbs = devWriteAbs;
     wr.finalizeSize = devFinalizeSize;
+    wr.readAbs = devReadAbs;
+    if (windowed) {
+      wr.checkpoint = devFinalizeSize;
+      // Every checkpoint is a directory entry; at most ~8 per upload
+      wr.checkpointEvery = (cap / 8 < 262144u) ? 262144u : cap / 8;
+    }
     wr.ctx = nullptr;
     wr.baseAddr = base;
     wr.cap = cap;
 
-    if (!shrxbin::begin(g_rxbin, Serial, fn, total, wr)) {
+    bool started = windowed ? shrxbin::beginWindowed(g_rxbin, Serial, fn, total, wr, resumeOff)
+                            : shrxbin::begin(g_rxbin, Serial, fn, total, wr);
+    if (!started) {
       Console.println("putbin: begin failed");
       return;
     }
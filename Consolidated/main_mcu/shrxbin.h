@@ -2,40 +2,49 @@
 // shrxbin.h - Header-only raw framed binary receiver over Stream
 // Frame (LE): MAGIC(4)=A5 5A 4B 52, u32 offset, u32 len, u32 crc32(payload), payload[len]
 // Commit: offset=0xFFFFFFFF, len=0, crc=0
+//
+// begin(): "READY", silent until the commit ("OK" / "ERR <why>"); any bad frame ends the session.
+// beginWindowed(): "READY <window> <maxFrame> <offset> <crc>", frames must start at <offset> (0, or
+// the committed prefix of a resumed file, whose CRC32 is <crc> in hex; a sender whose file does not
+// match sends the abort frame, offset=0xFFFFFFFE len=0, and starts over). Frames arrive in order and
+// each is answered on its own line:
+//   ACK <off> <len>    written (a duplicate of an already written frame is ACKed again)
+//   NAK <off> <why>    dropped; <off> is the offset the receiver wants next, the sender goes back
+//                      to it. Frames already in flight behind a NAK are dropped without another NAK.
+// The sender keeps at most <window> unACKed payload bytes in flight. A bad header is skipped by
+// scanning for the next magic, so one glitch costs a resend instead of the whole upload.
+// A windowed session checkpoints the contiguous written prefix through Writer::checkpoint (every
+// checkpointEvery bytes, and when it ends without its commit) and gives up after SHRXBIN_IDLE_MS
+// without input ("ERR idle <off>"), which gives the console back.
 
 #include <Arduino.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
+#include "Crc32.h"
 
 #ifndef SHRXBIN_MAX_FRAME
 #define SHRXBIN_MAX_FRAME 32768
 #endif
+#ifndef SHRXBIN_WINDOW
+#define SHRXBIN_WINDOW (4u * SHRXBIN_MAX_FRAME)  // unACKed bytes a windowed sender may have in flight
+#endif
+#ifndef SHRXBIN_IDLE_MS
+#define SHRXBIN_IDLE_MS 5000  // no input for this long ends a windowed session (0: wait forever)
+#endif
 
 namespace shrxbin {
 
-static inline uint32_t crc32_ieee(const uint8_t* p, size_t n) {
-  static bool init = false;
-  static uint32_t T[256];
-  if (!init) {
-    for (uint32_t i = 0; i < 256; ++i) {
-      uint32_t c = i;
-      for (int j = 0; j < 8; ++j)
-        c = (c & 1u) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
-      T[i] = c;
-    }
-    init = true;
-  }
-  uint32_t c = 0xFFFFFFFFu;
-  for (size_t i = 0; i < n; ++i)
-    c = T[(c ^ p[i]) & 0xFFu] ^ (c >> 8);
-  return c ^ 0xFFFFFFFFu;
-}
-
 struct Writer {
   // Must write 'len' bytes at absolute device address 'absAddr'
   bool (*writeAbs)(void* ctx, uint32_t absAddr, const uint8_t* data, uint32_t len) = nullptr;
   // Optional finalize: set logical file size in FS metadata
   bool (*finalizeSize)(void* ctx, const char* name, uint32_t size, uint32_t baseAddr, uint32_t cap) = nullptr;
+  // Optional: record 'size' bytes from the start as written (what a resume continues from)
+  bool (*checkpoint)(void* ctx, const char* name, uint32_t size, uint32_t baseAddr, uint32_t cap) = nullptr;
+  uint32_t checkpointEvery = 0;  // bytes between checkpoints while frames flow (0: only when a session fails)
+  // Optional: read back 'len' bytes at 'absAddr' (a resume hashes the kept prefix with it)
+  bool (*readAbs)(void* ctx, uint32_t absAddr, uint8_t* data, uint32_t len) = nullptr;
 
   void* ctx = nullptr;
   uint32_t baseAddr = 0;
@@ -49,7 +58,12 @@ struct State {
   char name[48];
   uint32_t total = 0;
   uint32_t received = 0;
+  uint32_t checkpointed = 0;
   bool active = false;
+  bool windowed = false;
+  bool nak = false;  // NAKed, waiting for the sender to come back to 'received'
+  uint32_t naks = 0;
+  uint32_t lastRxMs = 0;
   // Frame parsing
   uint8_t hdr[16];
   uint32_t hdrGot = 0;
@@ -60,11 +74,19 @@ struct State {
   uint8_t pay[SHRXBIN_MAX_FRAME];
 };
 
+static const uint8_t MAGIC[4] = { 0xA5, 0x5A, 0x4B, 0x52 };
+
 inline bool active(const State& st) {
   return st.active;
 }
 
+inline void checkpoint(State& st) {
+  if (!st.windowed || !st.wr.checkpoint || st.received == st.checkpointed) return;
+  if (st.wr.checkpoint(st.wr.ctx, st.name, st.received, st.wr.baseAddr, st.wr.cap)) st.checkpointed = st.received;
+}
+
 inline void end(State& st, bool ok, const char* msg = nullptr) {
+  if (!ok) checkpoint(st);
   st.active = false;
   st.hdrGot = st.payGot = 0;
   st.frameLen = 0;
@@ -83,12 +105,13 @@ inline void end(State& st, bool ok, const char* msg = nullptr) {
 
 inline bool begin(State& st, Stream& io, const char* fname, uint32_t total, const Writer& wr) {
   if (!wr.writeAbs) return false;
-  memset(&st, 0, sizeof(st));
+  st = State{};
   st.io = &io;
   st.wr = wr;
   st.total = total;
   st.received = 0;
   st.active = true;
+  st.lastRxMs = millis();
   if (fname) {
     strncpy(st.name, fname, sizeof(st.name) - 1);
     st.name[sizeof(st.name) - 1] = 0;
@@ -97,25 +120,85 @@ inline bool begin(State& st, Stream& io, const char* fname, uint32_t total, cons
   return true;
 }
 
+// Windowed session; 'resumeOff' bytes of the file are already written (0 for a fresh upload) and
+// are hashed through wr.readAbs for the READY line
+inline bool beginWindowed(State& st, Stream& io, const char* fname, uint32_t total, const Writer& wr, uint32_t resumeOff = 0) {
+  if (!wr.writeAbs || resumeOff > total || (resumeOff && !wr.readAbs)) return false;
+  st = State{};
+  st.io = &io;
+  st.wr = wr;
+  st.total = total;
+  st.received = st.checkpointed = resumeOff;
+  st.active = true;
+  st.windowed = true;
+  st.lastRxMs = millis();
+  if (fname) {
+    strncpy(st.name, fname, sizeof(st.name) - 1);
+    st.name[sizeof(st.name) - 1] = 0;
+  }
+  uint32_t crc = 0;
+  for (uint32_t off = 0; off < resumeOff;) {
+    uint32_t n = (resumeOff - off < SHRXBIN_MAX_FRAME) ? resumeOff - off : SHRXBIN_MAX_FRAME;
+    if (!wr.readAbs(wr.ctx, wr.baseAddr + off, st.pay, n)) {
+      st.active = false;
+      return false;
+    }
+    crc = Crc32::extend(crc, st.pay, n);
+    off += n;
+  }
+  st.io->printf("READY %lu %lu %lu %08lX\r\n", (unsigned long)SHRXBIN_WINDOW, (unsigned long)SHRXBIN_MAX_FRAME,
+                (unsigned long)resumeOff, (unsigned long)crc);
+  return true;
+}
+
+// Bad frame: a plain session ends, a windowed one NAKs and looks for the next header. 'wanted' is
+// false for frames that cannot be the one we asked for; those stay quiet while a NAK is pending.
+// Returns false when the session ended.
+inline bool reject(State& st, const char* why, bool wanted) {
+  st.hdrGot = st.payGot = 0;
+  st.frameLen = 0;
+  if (!st.windowed) {
+    end(st, false, why);
+    return false;
+  }
+  if (wanted || !st.nak) {
+    st.io->printf("NAK %lu %s\r\n", (unsigned long)st.received, why);
+    ++st.naks;
+  }
+  st.nak = true;
+  return true;
+}
+
 inline void pump(State& st) {
   if (!st.active || !st.io) return;
+  if (!st.io->available()) {
+    if (SHRXBIN_IDLE_MS && st.windowed && (uint32_t)(millis() - st.lastRxMs) > SHRXBIN_IDLE_MS) {
+      char msg[24];
+      snprintf(msg, sizeof(msg), "idle %lu", (unsigned long)st.received);
+      end(st, false, msg);
+    }
+    return;
+  }
+  st.lastRxMs = millis();
   while (st.io->available()) {
     if (st.hdrGot < 16) {
-      st.hdr[st.hdrGot++] = (uint8_t)st.io->read();
+      uint8_t b = (uint8_t)st.io->read();
+      if (st.hdrGot < 4 && b != MAGIC[st.hdrGot]) {
+        if (!reject(st, "bad-magic", false)) return;
+        if (b == MAGIC[0]) st.hdr[st.hdrGot++] = b;
+        continue;
+      }
+      st.hdr[st.hdrGot++] = b;
       if (st.hdrGot < 16) continue;
 
-      if (!(st.hdr[0] == 0xA5 && st.hdr[1] == 0x5A && st.hdr[2] == 0x4B && st.hdr[3] == 0x52)) {
-        end(st, false, "bad-magic");
-        return;
-      }
       st.frameOff = (uint32_t)st.hdr[4] | ((uint32_t)st.hdr[5] << 8) | ((uint32_t)st.hdr[6] << 16) | ((uint32_t)st.hdr[7] << 24);
       st.frameLen = (uint32_t)st.hdr[8] | ((uint32_t)st.hdr[9] << 8) | ((uint32_t)st.hdr[10] << 16) | ((uint32_t)st.hdr[11] << 24);
       st.frameCRC = (uint32_t)st.hdr[12] | ((uint32_t)st.hdr[13] << 8) | ((uint32_t)st.hdr[14] << 16) | ((uint32_t)st.hdr[15] << 24);
 
       if (st.frameOff == 0xFFFFFFFFu && st.frameLen == 0) {
         if (st.received != st.total) {
-          end(st, false, "size-mismatch");
-          return;
+          if (!reject(st, "size-mismatch", true)) return;
+          continue;
         }
         // finalize size if provided
         if (st.wr.finalizeSize) {
@@ -127,18 +210,25 @@ inline void pump(State& st) {
         end(st, true, nullptr);
         return;
       }
-
-      if (st.frameLen == 0 || st.frameLen > SHRXBIN_MAX_FRAME) {
-        end(st, false, "bad-len");
+      if (st.windowed && st.frameOff == 0xFFFFFFFEu && st.frameLen == 0) {
+        end(st, false, "aborted");
         return;
       }
-      if (st.frameOff != st.received) {
-        end(st, false, "bad-off");
-        return;
+
+      if (st.frameLen == 0 || st.frameLen > SHRXBIN_MAX_FRAME) {
+        if (!reject(st, "bad-len", false)) return;
+        continue;
       }
-      if (st.wr.cap && (st.frameOff + st.frameLen > st.wr.cap)) {
-        end(st, false, "cap");
-        return;
+      // A windowed session reads the payload first: it has to be skipped either way
+      if (!st.windowed) {
+        if (st.frameOff != st.received) {
+          end(st, false, "bad-off");
+          return;
+        }
+        if (st.wr.cap && (st.frameOff + st.frameLen > st.wr.cap)) {
+          end(st, false, "cap");
+          return;
+        }
       }
 
       st.payGot = 0;
@@ -149,9 +239,24 @@ inline void pump(State& st) {
     }
     if (st.payGot < st.frameLen) return;
 
-    uint32_t c = crc32_ieee(st.pay, st.frameLen);
+    const bool wanted = (st.frameOff == st.received);
+    uint32_t c = Crc32::compute(st.pay, st.frameLen);
     if (c != st.frameCRC) {
-      end(st, false, "crc");
+      if (!reject(st, "crc", wanted)) return;
+      continue;
+    }
+    if (st.frameOff < st.received && st.frameLen <= st.received - st.frameOff) {
+      // Resent after a lost ACK: already written
+      st.io->printf("ACK %lu %lu\r\n", (unsigned long)st.frameOff, (unsigned long)st.frameLen);
+      st.hdrGot = st.payGot = 0;
+      continue;
+    }
+    if (!wanted) {
+      if (!reject(st, "bad-off", false)) return;
+      continue;
+    }
+    if (st.wr.cap && (st.frameOff + st.frameLen > st.wr.cap)) {
+      end(st, false, "cap");
       return;
     }
 
@@ -164,7 +269,10 @@ inline void pump(State& st) {
     st.received += st.frameLen;
     st.hdrGot = 0;
     st.payGot = 0;
+    st.nak = false;
+    if (st.windowed) st.io->printf("ACK %lu %lu\r\n", (unsigned long)st.frameOff, (unsigned long)st.frameLen);
+    if (st.wr.checkpointEvery && st.received - st.checkpointed >= st.wr.checkpointEvery) checkpoint(st);
   }
 }
 
-}  // namespace shrxbin
\ No newline at end of file
+}  // namespace shrxbin
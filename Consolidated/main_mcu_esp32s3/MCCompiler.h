@@ -1,43 +1,150 @@
 // MCCompiler.h
-// Extremely simplified, single-header "compiler" for ARM Cortex-M0+ (RP2040).
-// It parses a tiny C-like fragment:
-//   int main() { return <expr>; }
-// Where <expr> supports:
-//   - 32-bit signed integer literals (decimal or 0x... hex)
-//   - binary operators: +, -, *
-//   - unary minus: -x
-//   - parentheses: ( ... )
-// It emits flat raw ARM Thumb-1 machine code bytes (no ELF, no headers).
-// Output is a callable function body with a minimal prologue/epilogue:
+// Small single-header "Tiny-C" compiler for the cores our boards run on:
+// ARM Cortex-M0+ (RP2040, Thumb-1), Cortex-M33 (RP2350, Thumb-2) and
+// Xtensa LX7 (ESP32-S3).
+// It accepts a C subset with 32-bit signed int as the only type:
 //
-//   push {lr}
-//   ... compute expression into r0 using a small temp stack on SP ...
-//   pop  {pc}
+//   int add3(int a, int b, int c) { return a + b + c; }
+//   int main(int n) {
+//     int acc = 0;
+//     for (int i = 0; i < n; i++) {
+//       if (i % 3 == 0 && i != 6) continue;
+//       acc += add3(i, i << 1, -1);
+//     }
+//     while (acc > 1000) acc = acc / 2;
+//     return acc;
+//   }
+//
+// Language:
+//   - functions: int/void f(int a, ...) { ... }, up to 8 int params (AAPCS:
+//     first four in r0-r3; Xtensa: first six in a2-a7; the rest on the
+//     stack), recursion, calls to functions defined later, prototypes
+//     "int f(int);"
+//   - statements: { }, int declarations with initializers, expression
+//     statements, if/else, while, do/while, for, break, continue, return
+//   - expressions: = += -= *= /= %= &= |= ^= <<= >>=, ?:, || &&, | ^ &,
+//     == != < <= > >=, << >> (arithmetic), + - * / %, unary - ! ~ +,
+//     ++/-- (prefix and postfix), calls, decimal/hex/char literals
+//   - comments: // and /* */
+//   - a source that does not start with int/void is compiled as a single
+//     expression (legacy mode): "(12 + 34) * 5" == "int main(){return (12+34)*5;}"
+// Not supported: globals, pointers, arrays, other types.
+//
+// Hardware intrinsics (inline loads/stores, addresses from the literal pool;
+// on Thumb the register map is chosen with setChip(), default = the chip
+// being built for; Xtensa always uses the ESP32-S3 map, see below):
+//   gpio_init(pin)         pin function -> SIO (RP2350: also clears pad ISO)
+//   gpio_oe_set(mask)      gpio_oe_clr(mask)     direction out / in
+//   gpio_set(mask)         gpio_clr(mask)        gpio_xor(mask)
+//   gpio_out(value)        gpio_in()             whole-bank write / read
+//   time_us()              TIMERAWL (1 MHz, wraps every ~71 min)
+//   busy_wait_cycles(n)    spins n cycles rounded up to 3 (SUBS + taken BGT)
+//   mmio_read(addr)        mmio_write(addr, v)   any other 32-bit register
+// e.g. a 1 MHz-ish square wave on GPIO 8 at 125 MHz:
+//   int main(int n) {
+//     gpio_init(8); gpio_oe_set(1 << 8);
+//     while (n--) { gpio_xor(1 << 8); busy_wait_cycles(54); }
+//     return 0;
+//   }
+// The set/clr/xor/out forms are void; each expands to the value, the SIO
+// base (MOVS+LSLS, no pool entry) and one STR. On the ESP32-S3 they address
+// GPIO 0-31 (GPIO_OUT / W1TS / W1TC / ENABLE_W1TS / W1TC / IN, with a MEMW
+// before each access; gpio_xor is a read-modify-write of GPIO_OUT),
+// gpio_init sets IO_MUX to GPIO + input enable and FUNCn_OUT_SEL to simple
+// output, time_us() latches SYSTIMER unit 0 (16 MHz / 16) and
+// busy_wait_cycles(n) spins until CCOUNT has advanced by n.
+//
+// It emits flat raw machine code bytes (no ELF, no headers) for the Target
+// chosen with setTarget() (default = the core being built for). Offset 0 is
+// the entry point: main() (a short entry stub jumps to it when it is not the
+// first function). Each Thumb function is:
+//
+//   push {r4-r7 as used, lr} ; sub sp,#locals
+//   ... body ...
+//   add sp,#locals ; pop {r4-r7 as used, pc}
+//   literal pool (a function too big for LDR to reach its pool is rebuilt
+//                 with constants assembled by MOVS/LSLS/ADDS instead,
+//                 or MOVW/MOVT on Thumb-2)
+//
+// Each Xtensa function uses the windowed ABI (callx8-compatible):
+//
+//   literal pool (L32R only reaches backwards; 4-byte aligned)
+//   entry a1,#frame
+//   ... body ...
+//   retw
 //
-// Result is machine code intended for Cortex-M0+ (Thumb-only). No FPU, no
-// external helper calls, no division, no variables, no function calls.
+// The Xtensa blob must be loaded 4-byte aligned into executable memory
+// (CALL8 targets are word aligned).
+//
+// Code generation:
+//   - The four most-used variables (uses weighted by loop depth) live in
+//     r4-r7, the rest in SP-relative slots. r0 is the accumulator, r1-r3
+//     are scratch/argument registers, deeper temporaries are pushed.
+//   - Conditions compile to CMP + Bcc with short-circuit && / || and loop
+//     rotation (one branch per iteration). Branches start as 16-bit forms
+//     and are relaxed until everything is in range: Bcc (+-256 B) becomes
+//     an inverted Bcc over B (+-2 KB) or over BL (+-4 MB); B becomes BL.
+//     LR is always saved, so BL is safe as a long jump.
+//   - / and % call a small shift-subtract helper appended to the output
+//     when used (division by zero yields 0, remainder = dividend).
+//   - Thumb-2 (Cortex-M33) keeps the same register plan and adds MOVW
+//     and modified immediates (ADDW/SUBW, AND/ORR/EOR/BIC/CMP/CMN.W #imm,
+//     UBFX), SDIV/MLS instead of the helper (SDIV by zero gives 0 with
+//     DIV_0_TRP clear, the reset default), ITE for comparison values,
+//     CBZ/CBNZ for forward tests against zero, and Bcc.W/B.W when a
+//     branch outgrows its 16-bit form.
+//   - Xtensa LX7: the six most-used variables live in a2-a7 (parameters
+//     stay in the register they arrive in), expression temporaries in
+//     a8-a15 ordered by register need; temporaries live across a call are
+//     spilled to the frame, arguments are built straight in a10-a15 for
+//     CALL8 (parked in the frame first when temporaries run short). Compares branch directly (BEQZ/BEQI/BLT/BBCI ...), relaxed to
+//     an inverted branch over J when out of range. / and % use QUOS/REMS
+//     behind a zero test (skipped for constant divisors).
+//
+// Optimizations (each can be switched off through Options):
+//   - foldConstants:  constant subtrees are evaluated at compile time with
+//                     32-bit wrap-around, identities (x+0, x*1, x*0, --x,
+//                     x/1, x|0, ...) are removed, chained constants are
+//                     reassociated ((x+3)+4 -> x+7) and branches on
+//                     constant conditions disappear.
+//   - strengthReduce: x*2^k -> LSLS, x*-1 -> NEGS, x/2^k and x%2^k -> shift
+//                     sequences, x&0xFF/0xFFFF -> UXTB/UXTH, x&(2^k-1) ->
+//                     shift pair, small constant operands use ADDS/SUBS/CMP
+//                     #imm, constants that are a shifted or negated imm8 are
+//                     built with MOVS+LSLS/NEGS/MVNS instead of a
+//                     literal-pool load, ==/!= as values are branchless.
+//                     Thumb-2 adds MOV.W/MVN.W #imm and UBFX; Xtensa uses
+//                     ADDI/ADDMI, SLLI/SRAI, EXTUI, MOVI+SLLI and
+//                     BEQI/BLTI/BBCI/BBSI forms.
+//   - peephole:       cleans the emitted instruction stream (PUSH{rX};POP{rX}
+//                     pairs, PUSH{rX};POP{rY} -> MOVS, dead loads, no-op
+//                     moves/adds, store-then-reload, redundant CMP #0,
+//                     branches to the next instruction, Bcc over B,
+//                     jump-to-jump, unreachable code).
+// Result::stats reports code/pool size, instruction count and a static
+// cycle sum (each instruction once, branches not taken; Cortex-M0+ timings,
+// rough estimates for the M33 and LX7), so callers can compare
+// Options::none() vs. the default.
 //
 // Usage example:
 //
 //   #include "MCCompiler.h"
-//   MCCompiler comp;
-//   uint8_t out[256];
+//   MCCompiler* comp = new MCCompiler();
+//   uint8_t out[512];
 //   size_t outSize = 0;
 //   const char* src = "int main(){ return (12 + 34) * 5; }";
-//   MCCompiler::Result res = comp.compile(src, strlen(src), out, sizeof(out), &outSize);
+//   MCCompiler::Result res = comp->compile(src, strlen(src), out, sizeof(out), &outSize);
 //   if (!res.ok) {
 //     Serial.print("Compile error at pos "); Serial.println(res.errorPos);
 //     Serial.println(res.errorMsg ? res.errorMsg : "Unknown error");
 //   } else {
-//     // 'out' now holds raw Thumb-1 opcodes for a function that returns r0.
-//     // NOTE: Executing generated code is not provided here.
+//     // 'out' now holds raw code for comp->target(); call offset 0 as
+//     // int (*)(int, int, int, int) (| 1 on Thumb).
 //   }
 //
 // Notes:
-// - Generates a literal pool at the end for constants > 255 using LDR (literal).
-// - Very small operator stack and output RPN buffer (configurable).
-// - No heap allocation; all fixed-size scratch buffers.
-// - All instructions are 16-bit Thumb encodings suitable for Cortex-M0+.
+// - Fixed-size AST, instruction and symbol tables (configurable below); the
+//   object is ~35 KB, so allocate it on the heap or statically.
 // - This header is self-contained (C++), Arduino-friendly.
 
 #ifndef MCCOMPILER_H_
@@ -49,15 +156,99 @@
 
 class MCCompiler {
 public:
+  struct Options {
+    bool foldConstants = true;
+    bool strengthReduce = true;
+    bool peephole = true;
+    // All passes off: plain tree-walk code, handy as a baseline / for debugging.
+    static Options none() {
+      Options o;
+      o.foldConstants = false;
+      o.strengthReduce = false;
+      o.peephole = false;
+      return o;
+    }
+  };
+
+  // Instruction set of the generated code.
+  enum Target : uint8_t { TARGET_THUMB1 = 0,  // Cortex-M0+ (RP2040)
+                          TARGET_THUMB2 = 1,  // ARMv7-M/ARMv8-M mainline (RP2350 Cortex-M33)
+                          TARGET_XTENSA = 2 };  // Xtensa LX7, windowed ABI (ESP32-S3)
+
+  // Register map used by the Thumb hardware intrinsics (gpio_*, time_us).
+  enum Chip : uint8_t { CHIP_RP2040 = 0,
+                        CHIP_RP2350 = 1 };
+
+  struct Stats {
+    size_t codeBytes = 0;  // instructions incl. prologues/epilogues/stub
+    size_t poolBytes = 0;  // literal pools incl. alignment padding
+    uint16_t insns = 0;    // instruction count
+    uint16_t functions = 0;
+    uint32_t cycles = 0;  // static sum (Cortex-M0+: single-cycle MULS)
+  };
+
   struct Result {
     bool ok = false;
     const char* errorMsg = nullptr;
     size_t errorPos = 0;
     size_t outSize = 0;
+    Stats stats;
   };
 
-  // Compile 'src[0..srcLen)' into raw Thumb-1 machine code in 'outBuf'.
-  // - outBuf receives: push{lr} ... body ... pop{pc} ... literal-pool
+  void setOptions(const Options& o) {
+    _opt = o;
+  }
+  const Options& options() const {
+    return _opt;
+  }
+
+  // Defaults to the core this sketch is built for.
+  void setTarget(Target t) {
+    _target = t;
+  }
+  Target target() const {
+    return _target;
+  }
+  // The core this sketch is built for
+  static Target nativeTarget() {
+#if defined(__XTENSA__)
+    return TARGET_XTENSA;
+#elif defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_8M_MAIN__)
+    return TARGET_THUMB2;
+#else
+    return TARGET_THUMB1;
+#endif
+  }
+  static const char* targetName(Target t) {
+    switch (t) {
+      case TARGET_THUMB1: return "thumb1";
+      case TARGET_THUMB2: return "thumb2";
+      case TARGET_XTENSA: return "xtensa";
+    }
+    return "?";
+  }
+  static bool parseTarget(const char* s, Target& t) {
+    for (int i = TARGET_THUMB1; i <= TARGET_XTENSA; i++) {
+      if (s && strcmp(s, targetName((Target)i)) == 0) {
+        t = (Target)i;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Defaults to the chip this sketch is built for (Thumb targets only).
+  void setChip(Chip c) {
+    _chip = c;
+  }
+  Chip chip() const {
+    return _chip;
+  }
+
+  // Compile 'src[0..srcLen)' into raw machine code for target() in 'outBuf'.
+  // - outBuf receives: [entry stub] functions (Thumb: each followed by its
+  //   literal pool, then the division helper; Xtensa: each preceded by its
+  //   literal pool)
   // - outCap: capacity of outBuf in bytes
   // - outSize: actual number of bytes written
   // Returns Result with ok=false on error.
@@ -69,140 +260,228 @@ public:
 
     _src = src;
     _srcLen = srcLen;
-
-    if (!parseProgram()) return makeErr();
-
-    // Convert to postfix (RPN) using Shunting-Yard on the recorded expression slice
-    if (!toRPN()) return makeErr();
-
-    // Emit machine code into outBuf
     _out = outBuf;
     _outCap = outCap;
-    _outSz = 0;
-
-    // Prologue: push {lr}
-    if (!emit16(0xB500)) return error("output buffer too small", _tokPosStart);
-
-    // Generate code for RPN
-    if (!emitRPN()) return makeErr();
 
-    // Final result should be exactly one stack item: pop -> r0
-    if (_stackDepth != 1) return error("internal stack depth mismatch", _tokPosEnd);
-    if (!emitPopR(0)) return error("output buffer too small", _tokPosEnd);
-
-    // Epilogue now (return BEFORE literal pool)
-    if (!emit16(0xBD00)) return error("output buffer too small", _tokPosEnd);  // POP {PC}
-
-    // Align to 4 for the literal pool storage
-    while ((_outSz & 0x3) != 0) {
-      if (!emit16(0xBF00)) return error("output buffer too small", _tokPosEnd);  // NOP
+    if (!next()) return makeErr();
+    if (_tok.kind == TK_INT || _tok.kind == TK_VOID) {
+      while (_tok.kind != TK_EOF) {
+        if (!parseFunction()) return makeErr();
+      }
+    } else {
+      if (!compileExpressionProgram()) return makeErr();
     }
-
-    // Append literal pool and fixup LDR literal imm8
-    if (!fixupAndEmitLiteralPool()) return makeErr();
+    if (!finishProgram()) return makeErr();
 
     *outSize = _outSz;
     Result r;
     r.ok = true;
     r.outSize = _outSz;
+    r.stats = _stats;
     return r;
   }
 
   // Limits (you can tweak for your environment)
-  static const int MAX_TOKENS = 256;    // max tokens in expression
-  static const int MAX_RPN = 256;       // max RPN items
-  static const int MAX_OPSTACK = 64;    // max operator stack
-  static const int MAX_LITERALS = 128;  // max unique literal constants
+  static const int MAX_NODES = 1024;    // AST nodes per function
+  static const int MAX_INSNS = 1024;    // emitted instructions per function
+  static const int MAX_LABELS = 256;    // branch targets per function
+  static const int MAX_VARS = 64;       // params + locals per function
+  static const int MAX_PARAMS = 8;      // r0-r3 + 4 / a2-a7 + 2 stack-passed
+  static const int MAX_FUNCS = 32;      // functions per program (incl. helpers)
+  static const int MAX_CALLS = 256;     // call sites per program
+  static const int MAX_LITERALS = 128;  // literal pool entries per function
+  static const int MAX_DEPTH = 64;      // expression / statement nesting
 
 private:
-  // Lexer/Parser support (extremely small)
+  // ---------------- Lexer ----------------
   enum TokKind : uint8_t {
     TK_EOF = 0,
     TK_NUM,
-    TK_PLUS,
-    TK_MINUS,
-    TK_MUL,
-    TK_LPAREN,
-    TK_RPAREN,
+    TK_IDENT,
+    // keywords
     TK_INT,
-    TK_MAIN,
+    TK_VOID,
     TK_RETURN,
+    TK_IF,
+    TK_ELSE,
+    TK_WHILE,
+    TK_FOR,
+    TK_DO,
+    TK_BREAK,
+    TK_CONTINUE,
+    // punctuation
+    TK_LPAREN,
+    TK_RPAREN,
     TK_LBRACE,
     TK_RBRACE,
-    TK_SEMI
+    TK_SEMI,
+    TK_COMMA,
+    TK_QUEST,
+    TK_COLON,
+    TK_PLUS,
+    TK_MINUS,
+    TK_MUL,
+    TK_DIV,
+    TK_MOD,
+    TK_AMP,
+    TK_PIPE,
+    TK_CARET,
+    TK_TILDE,
+    TK_NOT,
+    TK_SHL,
+    TK_SHR,
+    TK_LT,
+    TK_LE,
+    TK_GT,
+    TK_GE,
+    TK_EQ,
+    TK_NE,
+    TK_LAND,
+    TK_LOR,
+    TK_INC,
+    TK_DEC,
+    TK_ASSIGN,
+    TK_ADD_ASSIGN,
+    TK_SUB_ASSIGN,
+    TK_MUL_ASSIGN,
+    TK_DIV_ASSIGN,
+    TK_MOD_ASSIGN,
+    TK_AND_ASSIGN,
+    TK_OR_ASSIGN,
+    TK_XOR_ASSIGN,
+    TK_SHL_ASSIGN,
+    TK_SHR_ASSIGN
   };
   struct Token {
     TokKind kind;
-    int32_t ival;  // for TK_NUM
-    size_t pos;    // error location
+    int32_t ival;      // TK_NUM
+    uint32_t pos;      // error location
+    const char* name;  // TK_IDENT (points into the source)
+    uint16_t len;
+  };
+
+  // ---------------- AST ----------------
+  // Expression and statement nodes share one pool (reset per function).
+  // Lists (block statements, call arguments) are chained through 'next'.
+  enum NodeKind : uint8_t {
+    // expressions
+    N_NUM = 0,  // v = value
+    N_VAR,      // v = variable index
+    N_ASSIGN,   // v = variable index, a = value
+    N_PREINC,   // v = variable index, b = delta (+1/-1)
+    N_POSTINC,  // v = variable index, b = delta (+1/-1)
+    N_CALL,     // v = function index, a = first argument
+    N_INTRIN,   // v = intrinsic id, a = first argument
+    N_COND,     // a ? b : v
+    N_NEG,
+    N_BNOT,  // ~a
+    N_LNOT,  // !a
+    N_ADD,
+    N_SUB,
+    N_MUL,
+    N_DIV,
+    N_MOD,
+    N_AND,
+    N_OR,
+    N_XOR,
+    N_SHL,
+    N_SHR,
+    N_EQ,
+    N_NE,
+    N_LT,
+    N_LE,
+    N_GT,
+    N_GE,
+    N_LAND,
+    N_LOR,
+    // statements
+    N_NOP,
+    N_BLOCK,     // a = first statement
+    N_EXPR,      // a = expression
+    N_IF,        // a = cond, b = then, v = else (-1)
+    N_WHILE,     // a = cond, b = body
+    N_DO,        // a = body, b = cond
+    N_FOR,       // a = cond (-1), b = body, v = step (-1); init is a separate statement
+    N_RETURN,    // a = value (-1)
+    N_BREAK,
+    N_CONTINUE
+  };
+  struct Node {
+    NodeKind k;
+    int16_t a;
+    int16_t b;
+    int16_t next;
+    int32_t v;
+    uint32_t pos;
   };
 
-  // RPN item
-  enum RPNKind : uint8_t { RPN_NUM = 0,
-                           RPN_ADD,
-                           RPN_SUB,
-                           RPN_MUL,
-                           RPN_NEG };
-  struct RPNItem {
-    RPNKind k;
-    int32_t v;  // for numbers
-    size_t pos;
+  struct Var {
+    const char* name;
+    uint16_t len;
+    bool visible;  // false once its block is closed
+    int8_t reg;    // home register r4-r7, or -1
+    int16_t slot;  // SP slot when reg < 0 (-1: never used)
+    uint32_t weight;
   };
 
-  // Fixup for LDR literal instruction imm8
-  struct LdrFixup {
-    size_t instrOffset;  // byte offset where the 16-bit LDR literal is
-    int32_t value;       // constant to load
+  struct Func {
+    const char* name;  // nullptr for internal helpers
+    uint16_t len;
+    int8_t nparams;  // -1 until known
+    bool defined;
+    bool called;
+    uint32_t firstUse;  // source position of the first call (errors)
+    uint32_t off;       // output offset once emitted
   };
 
-  // Internal state
+  Options _opt;
+  Stats _stats;
+#if defined(PICO_RP2350)
+  Chip _chip = CHIP_RP2350;
+#else
+  Chip _chip = CHIP_RP2040;
+#endif
+  Target _target = nativeTarget();
+
+  // Source / lexer
   const char* _src = nullptr;
   size_t _srcLen = 0;
   size_t _idx = 0;
-
-  // expression capture bounds in source (after "return")
-  size_t _exprStart = 0;
-  size_t _exprEnd = 0;
-  size_t _tokPosStart = 0;
-  size_t _tokPosEnd = 0;
-
-  Token _toks[MAX_TOKENS];
-  int _ntok = 0;
-
-  // RPN
-  RPNItem _rpn[MAX_RPN];
-  int _nrpn = 0;
+  Token _tok;
 
   // Output buffer
   uint8_t* _out = nullptr;
   size_t _outCap = 0;
   size_t _outSz = 0;
 
-  // For constant pool and fixups
-  int32_t _literals[MAX_LITERALS];
-  int _nlit = 0;
-  LdrFixup _fixups[MAX_LITERALS];
-  int _nfix = 0;
+  // Program
+  Func _funcs[MAX_FUNCS];
+  int _nfuncs = 0;
 
-  // virtual eval stack depth (push {r0}, pop {r0}/{r1})
-  int _stackDepth = 0;
+  // Current function
+  Node _nodes[MAX_NODES];
+  int _nnodes = 0;
+  Var _vars[MAX_VARS];
+  int _nvars = 0;
+  int _nparams = 0;
+  int _blockScope = 0;  // first variable of the innermost block
+  int _loopDepth = 0;
+  int _nesting = 0;
+  uint32_t _retPos = 0;
 
-  // Error tracking
+  // Error tracking (first error wins)
   const char* _errMsg = nullptr;
   size_t _errPos = 0;
 
   void reset() {
     _idx = 0;
-    _ntok = 0;
-    _nrpn = 0;
-    _nlit = 0;
-    _nfix = 0;
     _out = nullptr;
     _outCap = 0;
     _outSz = 0;
-    _stackDepth = 0;
-    _exprStart = _exprEnd = 0;
-    _tokPosStart = _tokPosEnd = 0;
+    _stats = Stats();
+    _nfuncs = 0;
+    _thumb.setThumb2(_target == TARGET_THUMB2);
+    backend().reset();
     _errMsg = nullptr;
     _errPos = 0;
   }
@@ -214,7 +493,7 @@ private:
   Result makeErr() {
     Result r;
     r.ok = false;
-    r.errorMsg = _errMsg;
+    r.errorMsg = _errMsg ? _errMsg : "internal error";
     r.errorPos = _errPos;
     r.outSize = 0;
     return r;
@@ -225,10 +504,16 @@ private:
     return makeErr();
   }
   inline bool fail(const char* m, size_t p) {
-    _errMsg = m;
-    _errPos = p;
+    if (!_errMsg) {
+      _errMsg = m;
+      _errPos = p;
+    }
     return false;
   }
+  inline int failN(const char* m, size_t p) {
+    fail(m, p);
+    return -1;
+  }
 
   static bool isSpace(char c) {
     return c == ' ' || c == '\t' || c == '\r' || c == '\n';
@@ -245,566 +530,3597 @@ private:
     if (c >= 'A' && c <= 'F') return 10 + (c - 'A');
     return 0;
   }
-
-  void skipWs() {
-    while (_idx < _srcLen && isSpace(_src[_idx])) _idx++;
+  static bool isIdentStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+  }
+  static bool isIdentChar(char c) {
+    return isIdentStart(c) || isDigit(c);
   }
 
-  bool matchKW(const char* kw) {
-    size_t klen = strlen(kw);
-    if (_idx + klen > _srcLen) return false;
-    if (memcmp(_src + _idx, kw, klen) == 0) {
-      // ensure boundary
-      char after = (_idx + klen < _srcLen) ? _src[_idx + klen] : '\0';
-      if ((after >= 'a' && after <= 'z') || (after >= 'A' && after <= 'Z') || (after == '_') || (after >= '0' && after <= '9')) {
-        return false;
+  // Skip whitespace and comments. Returns false on an unterminated comment.
+  bool skipWs() {
+    for (;;) {
+      while (_idx < _srcLen && isSpace(_src[_idx])) _idx++;
+      if (_idx + 1 < _srcLen && _src[_idx] == '/' && _src[_idx + 1] == '/') {
+        while (_idx < _srcLen && _src[_idx] != '\n') _idx++;
+        continue;
+      }
+      if (_idx + 1 < _srcLen && _src[_idx] == '/' && _src[_idx + 1] == '*') {
+        size_t start = _idx;
+        _idx += 2;
+        while (_idx + 1 < _srcLen && !(_src[_idx] == '*' && _src[_idx + 1] == '/')) _idx++;
+        if (_idx + 1 >= _srcLen) return fail("unterminated comment", start);
+        _idx += 2;
+        continue;
       }
-      _idx += klen;
       return true;
     }
-    return false;
   }
 
-  bool parseProgram() {
-    // Two modes:
-    // 1) Full tiny form: "int main() { return <expr>; }"
-    // 2) Just an expression: "<expr>"
-    size_t save = _idx;
-    skipWs();
-    bool asTinyC = false;
-    size_t startPos = _idx;
-
-    if (matchKW("int")) {
-      skipWs();
-      if (matchKW("main")) {
-        skipWs();
-        if (_idx < _srcLen && _src[_idx] == '(') {
-          _idx++;
-          skipWs();
-        } else return fail("expected '(' after main", _idx);
+  struct Punct {
+    const char* s;
+    TokKind k;
+  };
 
-        if (_idx < _srcLen && _src[_idx] == ')') {
-          _idx++;
-          skipWs();
-        } else return fail("expected ')'", _idx);
+  // Advance to the next token. On a lexical error the token becomes TK_EOF
+  // and the error is recorded (parsers then unwind).
+  bool next() {
+    _tok.kind = TK_EOF;
+    _tok.ival = 0;
+    _tok.name = nullptr;
+    _tok.len = 0;
+    if (!skipWs()) return false;
+    _tok.pos = (uint32_t)_idx;
+    if (_idx >= _srcLen) return true;
+    char c = _src[_idx];
+    size_t pos = _idx;
 
-        if (_idx < _srcLen && _src[_idx] == '{') {
+    if (isDigit(c)) {
+      // number literal decimal or hex (wraps to 32 bits like the target)
+      uint32_t val = 0;
+      if (c == '0' && (_idx + 1 < _srcLen) && (_src[_idx + 1] == 'x' || _src[_idx + 1] == 'X')) {
+        _idx += 2;
+        if (_idx >= _srcLen || !isHex(_src[_idx])) return fail("malformed hex literal", pos);
+        while (_idx < _srcLen && isHex(_src[_idx])) {
+          val = (val << 4) | (uint32_t)hexVal(_src[_idx]);
           _idx++;
-          skipWs();
-        } else return fail("expected '{'", _idx);
-
-        if (!matchKW("return")) return fail("expected 'return'", _idx);
-        skipWs();
-        asTinyC = true;
+        }
       } else {
-        // "int" appeared but not tiny main - fallback to expr with the leading 'int' is illegal
-        _idx = save;
+        while (_idx < _srcLen && isDigit(_src[_idx])) {
+          val = val * 10u + (uint32_t)(_src[_idx] - '0');
+          _idx++;
+        }
       }
+      if (_idx < _srcLen && isIdentChar(_src[_idx])) return fail("malformed number", pos);
+      _tok.kind = TK_NUM;
+      _tok.ival = (int32_t)val;
+      return true;
     }
 
-    _exprStart = _idx;
-    if (!lexExpressionTokens()) return false;  // fills _toks[]
-    _exprEnd = _idx;
-
-    if (asTinyC) {
-      skipWs();
-      if (!consume(TK_SEMI)) return fail("expected ';' after return expr", _idx);
-      skipWs();
-      if (_idx >= _srcLen || _src[_idx] != '}') return fail("expected '}'", _idx);
-      _idx++;
-      skipWs();
-      if (_idx != _srcLen) {
-        // trailing stuff allowed? We'll allow whitespace only.
-        for (size_t i = _idx; i < _srcLen; i++)
-          if (!isSpace(_src[i])) return fail("trailing characters", i);
+    if (c == '\'') {
+      // character literal: 'a', '\n', '\t', '\r', '\0', '\\', '\''
+      if (_idx + 2 >= _srcLen) return fail("malformed character literal", pos);
+      char ch = _src[_idx + 1];
+      size_t n = 3;
+      if (ch == '\\') {
+        char e = _src[_idx + 2];
+        ch = (e == 'n') ? '\n' : (e == 't') ? '\t' : (e == 'r') ? '\r' : (e == '0') ? '\0' : e;
+        n = 4;
       }
-    } else {
-      // Expression-only mode: ensure we consumed entire input (whitespace allowed)
-      skipWs();
-      if (_idx != _srcLen) return fail("unexpected trailing characters", _idx);
+      if (_idx + n > _srcLen || _src[_idx + n - 1] != '\'') return fail("malformed character literal", pos);
+      _idx += n;
+      _tok.kind = TK_NUM;
+      _tok.ival = (uint8_t)ch;
+      return true;
     }
 
-    if (_ntok <= 0) return fail("empty expression", startPos);
-    _tokPosStart = _toks[0].pos;
-    _tokPosEnd = _toks[_ntok - 1].pos;
-    return true;
-  }
-
-  bool lexExpressionTokens() {
-    // produce tokens until we hit ';', '}' or EOF
-    _ntok = 0;
-    bool expectUnary = true;  // at start of an expression, '-' is unary
-
-    while (_idx < _srcLen) {
-      skipWs();
-      if (_idx >= _srcLen) break;
-
-      char c = _src[_idx];
-      size_t pos = _idx;
-
-      if (isDigit(c)) {
-        // number literal decimal or hex
-        int32_t val = 0;
-        if (c == '0' && (_idx + 1 < _srcLen) && (_src[_idx + 1] == 'x' || _src[_idx + 1] == 'X')) {
-          _idx += 2;
-          if (_idx >= _srcLen || !isHex(_src[_idx])) return fail("malformed hex literal", pos);
-          val = 0;
-          while (_idx < _srcLen && isHex(_src[_idx])) {
-            val = (val << 4) | hexVal(_src[_idx]);
-            _idx++;
-          }
-        } else {
-          val = 0;
-          while (_idx < _srcLen && isDigit(_src[_idx])) {
-            val = val * 10 + (_src[_idx] - '0');
-            _idx++;
-          }
-        }
-        if (!emitTokNum(val, pos)) return false;
-        expectUnary = false;
-        continue;
-      }
-
-      // punctuation or end of expr
-      if (c == ';' || c == '}') {
-        // do not consume here; caller may consume
-        break;
-      }
-
-      if (c == '(') {
-        if (!emitTok(TK_LPAREN, pos)) return false;
-        _idx++;
-        expectUnary = true;
-        continue;
-      }
-      if (c == ')') {
-        if (!emitTok(TK_RPAREN, pos)) return false;
-        _idx++;
-        expectUnary = false;
-        continue;
-      }
-      if (c == '*') {
-        if (!emitTok(TK_MUL, pos)) return false;
-        _idx++;
-        expectUnary = true;
-        continue;
-      }
-
-      if (c == '+') {
-        if (!emitTok(TK_PLUS, pos)) return false;
-        _idx++;
-        expectUnary = true;
-        continue;
-      }
+    if (isIdentStart(c)) {
+      size_t s = _idx;
+      while (_idx < _srcLen && isIdentChar(_src[_idx])) _idx++;
+      _tok.name = _src + s;
+      _tok.len = (uint16_t)(_idx - s);
+      _tok.kind = keyword(_tok.name, _tok.len);
+      return true;
+    }
 
-      if (c == '-') {
-        // distinguished later in toRPN
-        if (!emitTok(TK_MINUS, pos)) return false;
-        _idx++;
-        expectUnary = true;
-        continue;
+    static const Punct puncts[] = {
+      { "<<=", TK_SHL_ASSIGN }, { ">>=", TK_SHR_ASSIGN }, { "&&", TK_LAND }, { "||", TK_LOR }, { "==", TK_EQ }, { "!=", TK_NE }, { "<=", TK_LE }, { ">=", TK_GE }, { "<<", TK_SHL }, { ">>", TK_SHR }, { "++", TK_INC }, { "--", TK_DEC }, { "+=", TK_ADD_ASSIGN }, { "-=", TK_SUB_ASSIGN }, { "*=", TK_MUL_ASSIGN }, { "/=", TK_DIV_ASSIGN }, { "%=", TK_MOD_ASSIGN }, { "&=", TK_AND_ASSIGN }, { "|=", TK_OR_ASSIGN }, { "^=", TK_XOR_ASSIGN }, { "(", TK_LPAREN }, { ")", TK_RPAREN }, { "{", TK_LBRACE }, { "}", TK_RBRACE }, { ";", TK_SEMI }, { ",", TK_COMMA }, { "?", TK_QUEST }, { ":", TK_COLON }, { "+", TK_PLUS }, { "-", TK_MINUS }, { "*", TK_MUL }, { "/", TK_DIV }, { "%", TK_MOD }, { "&", TK_AMP }, { "|", TK_PIPE }, { "^", TK_CARET }, { "~", TK_TILDE }, { "!", TK_NOT }, { "<", TK_LT }, { ">", TK_GT }, { "=", TK_ASSIGN }
+    };
+    for (size_t i = 0; i < sizeof(puncts) / sizeof(puncts[0]); i++) {
+      size_t l = strlen(puncts[i].s);
+      if (_idx + l <= _srcLen && memcmp(_src + _idx, puncts[i].s, l) == 0) {
+        _idx += l;
+        _tok.kind = puncts[i].k;
+        return true;
       }
-
-      // If we see "return" during lex expr (tiny mode), it means caller didn't cut input correctly
-      if (matchKW("return")) return fail("unexpected 'return' in expression", pos);
-
-      // Otherwise it's invalid char
-      return fail("invalid character in expression", pos);
     }
-
-    return (_ntok > 0);
+    return fail("invalid character", pos);
   }
 
-  bool consume(TokKind want) {
-    skipWs();
-    if (_idx >= _srcLen) return false;
-    char c = _src[_idx];
-    if (want == TK_SEMI && c == ';') {
-      _idx++;
-      return true;
-    }
-    if (want == TK_RBRACE && c == '}') {
-      _idx++;
-      return true;
+  static TokKind keyword(const char* s, size_t n) {
+    struct KW {
+      const char* s;
+      TokKind k;
+    };
+    static const KW kws[] = { { "int", TK_INT }, { "void", TK_VOID }, { "return", TK_RETURN }, { "if", TK_IF }, { "else", TK_ELSE }, { "while", TK_WHILE }, { "for", TK_FOR }, { "do", TK_DO }, { "break", TK_BREAK }, { "continue", TK_CONTINUE } };
+    for (size_t i = 0; i < sizeof(kws) / sizeof(kws[0]); i++) {
+      if (strlen(kws[i].s) == n && memcmp(kws[i].s, s, n) == 0) return kws[i].k;
     }
-    return false;
+    return TK_IDENT;
   }
 
-  bool emitTok(TokKind k, size_t pos) {
-    if (_ntok >= MAX_TOKENS) return fail("too many tokens", pos);
-    _toks[_ntok].kind = k;
-    _toks[_ntok].ival = 0;
-    _toks[_ntok].pos = pos;
-    _ntok++;
+  bool accept(TokKind k) {
+    if (_tok.kind != k) return false;
+    next();
     return true;
   }
-  bool emitTokNum(int32_t v, size_t pos) {
-    if (_ntok >= MAX_TOKENS) return fail("too many tokens", pos);
-    _toks[_ntok].kind = TK_NUM;
-    _toks[_ntok].ival = v;
-    _toks[_ntok].pos = pos;
-    _ntok++;
-    return true;
+  bool expect(TokKind k, const char* msg) {
+    if (_tok.kind != k) return fail(msg, _tok.pos);
+    next();
+    return !_errMsg;
   }
 
-  // Operator precedence/associativity
-  // We will treat unary minus (NEG) as higher precedence than MUL, and MUL higher than PLUS/MINUS.
-  struct OpInfo {
-    uint8_t prec;
-    bool rightAssoc;
-    bool unary;
-    RPNKind rpn;
-  };
+  // ---------------- Symbols ----------------
 
-  static OpInfo opInfoFor(TokKind k, bool unaryMinus) {
-    if (k == TK_MINUS && unaryMinus) {
-      OpInfo o;
-      o.prec = 3;
-      o.rightAssoc = true;
-      o.unary = true;
-      o.rpn = RPN_NEG;
-      return o;
+  int findVar(const char* s, uint16_t n) const {
+    for (int i = _nvars - 1; i >= 0; i--) {
+      if (_vars[i].visible && _vars[i].len == n && memcmp(_vars[i].name, s, n) == 0) return i;
     }
-    if (k == TK_MUL) {
-      OpInfo o;
-      o.prec = 2;
-      o.rightAssoc = false;
-      o.unary = false;
-      o.rpn = RPN_MUL;
-      return o;
+    return -1;
+  }
+  int declareVar(const char* s, uint16_t n, uint32_t pos, int scopeStart) {
+    for (int i = scopeStart; i < _nvars; i++) {
+      if (_vars[i].visible && _vars[i].len == n && memcmp(_vars[i].name, s, n) == 0) return failN("variable redeclared", pos);
     }
-    if (k == TK_PLUS) {
-      OpInfo o;
-      o.prec = 1;
-      o.rightAssoc = false;
-      o.unary = false;
-      o.rpn = RPN_ADD;
-      return o;
+    if (_nvars >= MAX_VARS) return failN("too many variables", pos);
+    Var& v = _vars[_nvars];
+    v.name = s;
+    v.len = n;
+    v.visible = true;
+    v.reg = -1;
+    v.slot = -1;
+    v.weight = 0;
+    return _nvars++;
+  }
+  // Uses inside loops count more, so hot loop variables win the registers.
+  void touchVar(int v) {
+    int d = _loopDepth > 4 ? 4 : _loopDepth;
+    _vars[v].weight += 1u << (3 * d);
+  }
+
+  // ---------------- Intrinsics ----------------
+  // Built-in "functions" that lower to a few inline instructions.
+  enum IntrinsicId : uint8_t {
+    IN_GPIO_SET = 0,  // gpio_set(mask)      SIO GPIO_OUT_SET = mask
+    IN_GPIO_CLR,      // gpio_clr(mask)      SIO GPIO_OUT_CLR = mask
+    IN_GPIO_XOR,      // gpio_xor(mask)      SIO GPIO_OUT_XOR = mask
+    IN_GPIO_OUT,      // gpio_out(value)     SIO GPIO_OUT = value
+    IN_GPIO_OE_SET,   // gpio_oe_set(mask)   SIO GPIO_OE_SET = mask (outputs)
+    IN_GPIO_OE_CLR,   // gpio_oe_clr(mask)   SIO GPIO_OE_CLR = mask (inputs)
+    IN_GPIO_IN,       // gpio_in()           SIO GPIO_IN
+    IN_GPIO_INIT,     // gpio_init(pin)      pin function = SIO (and pad isolation off on RP2350)
+    IN_TIME_US,       // time_us()           TIMERAWL, free-running 1 MHz counter
+    IN_BUSY_WAIT,     // busy_wait_cycles(n) spin ~n cycles
+    IN_MMIO_READ,     // mmio_read(addr)     32-bit load
+    IN_MMIO_WRITE     // mmio_write(addr, v) 32-bit store
+  };
+  struct Intrinsic {
+    const char* name;
+    uint8_t nargs;
+  };
+  static const int NUM_INTRINSICS = IN_MMIO_WRITE + 1;
+  static const Intrinsic* intrinsics() {
+    static const Intrinsic tab[NUM_INTRINSICS] = {
+      { "gpio_set", 1 }, { "gpio_clr", 1 }, { "gpio_xor", 1 }, { "gpio_out", 1 }, { "gpio_oe_set", 1 }, { "gpio_oe_clr", 1 }, { "gpio_in", 0 }, { "gpio_init", 1 }, { "time_us", 0 }, { "busy_wait_cycles", 1 }, { "mmio_read", 1 }, { "mmio_write", 2 }
+    };
+    return tab;
+  }
+
+  // Per-chip addresses. SIO registers are reached as [base, #offset].
+  struct ChipRegs {
+    uint32_t sioBase;
+    uint8_t gpioIn, gpioOut, gpioSet, gpioClr, gpioXor, oeSet, oeClr;
+    uint32_t timerawl;
+    uint32_t ioBank0Ctrl0;  // GPIO0_CTRL, 8 bytes per pin
+    uint32_t padIsoClr0;    // atomic-clear alias of PADS_BANK0 GPIO0, 4 bytes per pin (0: none)
+  };
+  const ChipRegs& regs() const {
+    static const ChipRegs rp2040 = { 0xD0000000u, 0x04, 0x10, 0x14, 0x18, 0x1C, 0x24, 0x28, 0x40054028u, 0x40014004u, 0 };
+    static const ChipRegs rp2350 = { 0xD0000000u, 0x04, 0x10, 0x18, 0x20, 0x28, 0x38, 0x40, 0x400B0028u, 0x40028004u, 0x4003B004u };
+    return _chip == CHIP_RP2350 ? rp2350 : rp2040;
+  }
+
+  static int findIntrinsic(const char* s, uint16_t n) {
+    const Intrinsic* tab = intrinsics();
+    for (int i = 0; i < NUM_INTRINSICS; i++) {
+      if (strlen(tab[i].name) == n && memcmp(tab[i].name, s, n) == 0) return i;
     }
-    if (k == TK_MINUS) {
-      OpInfo o;
-      o.prec = 1;
-      o.rightAssoc = false;
-      o.unary = false;
-      o.rpn = RPN_SUB;
-      return o;
+    return -1;
+  }
+
+  int findFunc(const char* s, uint16_t n) const {
+    for (int i = 0; i < _nfuncs; i++) {
+      if (_funcs[i].name && _funcs[i].len == n && memcmp(_funcs[i].name, s, n) == 0) return i;
     }
-    OpInfo z;
-    z.prec = 0;
-    z.rightAssoc = false;
-    z.unary = false;
-    z.rpn = RPN_ADD;
-    return z;
+    return -1;
+  }
+  int addFunc(const char* s, uint16_t n, uint32_t pos) {
+    if (_nfuncs >= MAX_FUNCS) return failN("too many functions", pos);
+    Func& f = _funcs[_nfuncs];
+    f.name = s;
+    f.len = n;
+    f.nparams = -1;
+    f.defined = false;
+    f.called = false;
+    f.firstUse = pos;
+    f.off = 0;
+    return _nfuncs++;
+  }
+  bool isMain(int f) const {
+    return _funcs[f].name && _funcs[f].len == 4 && memcmp(_funcs[f].name, "main", 4) == 0;
   }
 
-  bool toRPN() {
-    _nrpn = 0;
-    _opTop = 0;
-    bool expectUnary = true;
+  // ---------------- Parser: program level ----------------
 
-    for (int i = 0; i < _ntok; i++) {
-      TokKind k = _toks[i].kind;
-      size_t pos = _toks[i].pos;
+  void beginFunction() {
+    _nnodes = 0;
+    _nvars = 0;
+    _nparams = 0;
+    _blockScope = 0;
+    _loopDepth = 0;
+    _nesting = 0;
+  }
 
-      if (k == TK_NUM) {
-        if (_nrpn >= MAX_RPN) return fail("RPN overflow", pos);
-        _rpn[_nrpn++] = RPNItem{ RPN_NUM, _toks[i].ival, pos };
-        expectUnary = false;
-        continue;
-      }
+  // Legacy mode: the whole source is one expression returned by main().
+  bool compileExpressionProgram() {
+    int f = addFunc("main", 4, 0);
+    if (f < 0) return false;
+    _funcs[f].nparams = 0;
+    beginFunction();
+    uint32_t pos = _tok.pos;
+    int e = parseExpr();
+    if (e < 0) return false;
+    if (_tok.kind != TK_EOF) return fail("unexpected trailing characters", _tok.pos);
+    int r = newNode(N_RETURN, e, -1, 0, pos);
+    if (r < 0) return false;
+    _retPos = pos;
+    return emitFunction(f, r);
+  }
 
-      if (k == TK_LPAREN) {
-        if (!pushLParen(pos)) return false;
-        expectUnary = true;
-        continue;
-      }
+  bool parseFunction() {
+    // ('int' | 'void') name '(' params ')' ( ';' | block )
+    if (_tok.kind != TK_INT && _tok.kind != TK_VOID) return fail("expected function definition", _tok.pos);
+    next();
+    if (_tok.kind != TK_IDENT) return fail("expected function name", _tok.pos);
+    Token name = _tok;
+    next();
+    if (_tok.kind != TK_LPAREN) return fail("global variables are not supported", _tok.pos);
+    next();
 
-      if (k == TK_RPAREN) {
-        // pop until '(' sentinel
-        bool matched = false;
-        while (_opTop > 0) {
-          if (_opPrec[_opTop - 1] == 0xFF && !_opAssoc[_opTop - 1]) {  // '('
-            matched = true;
-            _opTop--;
-            break;
-          }
-          if (!flushTopOpToRPN(_opPos[_opTop - 1])) return false;
-          _opTop--;
+    if (findIntrinsic(name.name, name.len) >= 0) return fail("name is reserved for an intrinsic", name.pos);
+    int f = findFunc(name.name, name.len);
+    if (f < 0) f = addFunc(name.name, name.len, name.pos);
+    if (f < 0) return false;
+    if (_funcs[f].defined) return fail("function redefined", name.pos);
+    beginFunction();
+
+    // parameters
+    int np = 0;
+    uint32_t unnamedPos = 0;
+    bool unnamed = false;
+    if (_tok.kind == TK_VOID) {
+      next();
+    } else if (_tok.kind != TK_RPAREN) {
+      for (;;) {
+        uint32_t ppos = _tok.pos;
+        if (!expect(TK_INT, "expected 'int' parameter")) return false;
+        if (np >= MAX_PARAMS) return fail("too many parameters (max 8)", ppos);
+        if (_tok.kind == TK_IDENT) {
+          if (declareVar(_tok.name, _tok.len, _tok.pos, 0) < 0) return false;
+          next();
+        } else if (!unnamed) {
+          unnamed = true;  // fine in a prototype: "int f(int, int);"
+          unnamedPos = ppos;
         }
-        if (!matched) return fail("mismatched ')'", pos);
-        expectUnary = false;
-        continue;
+        np++;
+        if (!accept(TK_COMMA)) break;
       }
+    }
+    if (!expect(TK_RPAREN, "expected ')'")) return false;
+    if (_funcs[f].nparams >= 0 && _funcs[f].nparams != np) return fail("parameter count differs from earlier use", name.pos);
+    _funcs[f].nparams = (int8_t)np;
+    _nparams = np;
 
-      // Operators: +, -, *
-      if (k == TK_PLUS || k == TK_MINUS || k == TK_MUL) {
-        bool isUnaryMinus = (k == TK_MINUS && expectUnary);
-        OpInfo oi = opInfoFor(k, isUnaryMinus);
-        if (!opPush(oi, pos)) return false;
-        expectUnary = true;
-        continue;
-      }
+    if (accept(TK_SEMI)) return !_errMsg;  // prototype
+
+    if (_tok.kind != TK_LBRACE) return fail("expected '{'", _tok.pos);
+    if (unnamed) return fail("expected parameter name", unnamedPos);
+    int body = parseBlock();
+    if (body < 0) return false;
+    return emitFunction(f, body);
+  }
 
-      return fail("invalid token in expression", pos);
+  // ---------------- Parser: statements ----------------
+
+  int newNode(NodeKind k, int a, int b, int32_t v, uint32_t pos) {
+    if (_nnodes >= MAX_NODES) return failN("function too large", pos);
+    Node& n = _nodes[_nnodes];
+    n.k = k;
+    n.a = (int16_t)a;
+    n.b = (int16_t)b;
+    n.next = -1;
+    n.v = v;
+    n.pos = pos;
+    return _nnodes++;
+  }
+
+  int parseBlock() {
+    uint32_t pos = _tok.pos;
+    if (!expect(TK_LBRACE, "expected '{'")) return -1;
+    int blk = newNode(N_BLOCK, -1, -1, 0, pos);
+    if (blk < 0) return -1;
+    int scope = _nvars;
+    int savedScope = _blockScope;
+    _blockScope = scope;
+    int last = -1;
+    while (_tok.kind != TK_RBRACE) {
+      if (_tok.kind == TK_EOF) return failN("expected '}'", _tok.pos);
+      int s = parseStmt();
+      if (s < 0) return -1;
+      if (last < 0) _nodes[blk].a = (int16_t)s;
+      else _nodes[last].next = (int16_t)s;
+      last = s;
     }
+    next();
+    for (int i = scope; i < _nvars; i++) _vars[i].visible = false;
+    _blockScope = savedScope;
+    return blk;
+  }
 
-    // Flush operators
-    while (_opTop > 0) {
-      if (_opPrec[_opTop - 1] == 0xFF && !_opAssoc[_opTop - 1]) {
-        return fail("mismatched '('", (_ntok > 0) ? _toks[_ntok - 1].pos : 0);
+  // "int a = 1, b, c = a + b;" -> block of assignments (or NOP)
+  int parseDecl() {
+    uint32_t pos = _tok.pos;
+    next();  // 'int'
+    int blk = newNode(N_BLOCK, -1, -1, 0, pos);
+    if (blk < 0) return -1;
+    int last = -1;
+    for (;;) {
+      if (_tok.kind != TK_IDENT) return failN("expected variable name", _tok.pos);
+      Token name = _tok;
+      next();
+      if (_tok.kind == TK_LPAREN) return failN("nested functions are not supported", _tok.pos);
+      if (accept(TK_ASSIGN)) {
+        // declared after its initializer: "int x = x;" is rejected, not garbage
+        int e = parseAssign();
+        if (e < 0) return -1;
+        int v = declareVar(name.name, name.len, name.pos, _blockScope);
+        if (v < 0) return -1;
+        touchVar(v);
+        int as = newNode(N_ASSIGN, e, -1, v, name.pos);
+        int st = (as < 0) ? -1 : newNode(N_EXPR, as, -1, 0, name.pos);
+        if (st < 0) return -1;
+        if (last < 0) _nodes[blk].a = (int16_t)st;
+        else _nodes[last].next = (int16_t)st;
+        last = st;
+      } else {
+        if (declareVar(name.name, name.len, name.pos, _blockScope) < 0) return -1;
       }
-      if (!flushTopOpToRPN(_opPos[_opTop - 1])) return false;
-      _opTop--;
+      if (!accept(TK_COMMA)) break;
     }
-
-    if (_nrpn <= 0) return fail("empty expression", (_ntok > 0) ? _toks[0].pos : 0);
-    return true;
+    if (!expect(TK_SEMI, "expected ';' after declaration")) return -1;
+    return blk;
+  }
+  int parseStmt() {
+    if (++_nesting > MAX_DEPTH) return failN("statements nested too deeply", _tok.pos);
+    int r = parseStmtInner();
+    _nesting--;
+    return r;
   }
 
-  // Tiny operator stack implementation (to support associativity and precedence cleanly)
-  uint8_t _opPrec[MAX_OPSTACK];  // precedence
-  bool _opRight[MAX_OPSTACK];    // right-assoc
-  bool _opUnary[MAX_OPSTACK];    // unary?
-  RPNKind _opRPN[MAX_OPSTACK];   // corresponding RPN op kind
-  size_t _opPos[MAX_OPSTACK];    // position for error context
-  bool _opAssoc[MAX_OPSTACK];    // occupied marker (true = operator; false = '(')
-  int _opTop = 0;
-
-  bool opPush(const OpInfo& oi, size_t pos) {
-    // Pop while top has higher prec, or equal prec and left-assoc
-    while (_opTop > 0 && _opAssoc[_opTop - 1]) {
-      uint8_t tp = _opPrec[_opTop - 1];
-      if (tp == 0xFF) break;  // '(' sentinel (shouldn't be marked as assoc=true, but guard anyway)
-      if (tp > oi.prec || (tp == oi.prec && !oi.rightAssoc)) {
-        if (!flushTopOpToRPN(_opPos[_opTop - 1])) return false;
-        _opTop--;
-      } else break;
-    }
-
-    if (_opTop >= MAX_OPSTACK) return fail("operator stack overflow", pos);
-    _opPrec[_opTop] = oi.prec;
-    _opRight[_opTop] = oi.rightAssoc;
-    _opUnary[_opTop] = oi.unary;
-    _opRPN[_opTop] = oi.rpn;
-    _opPos[_opTop] = pos;
-    _opAssoc[_opTop] = true;
-    _opTop++;
-    return true;
+  int parseLoopBody() {
+    _loopDepth++;
+    int b = parseStmt();
+    _loopDepth--;
+    return b;
   }
 
-  bool flushTopOpToRPN(size_t pos) {
-    if (_opTop <= 0) return fail("operator stack underflow", pos);
-    if (_nrpn >= MAX_RPN) return fail("RPN overflow", pos);
-    // push op to RPN
-    _rpn[_nrpn++] = RPNItem{ _opRPN[_opTop - 1], 0, pos };
-    return true;
+  int parseParenExpr() {
+    if (!expect(TK_LPAREN, "expected '('")) return -1;
+    int e = parseExpr();
+    if (e < 0) return -1;
+    if (!expect(TK_RPAREN, "expected ')'")) return -1;
+    return e;
   }
 
-  // Place a '(' sentinel in operator stack
-  bool pushLParen(size_t pos) {
-    if (_opTop >= MAX_OPSTACK) return fail("operator stack overflow", pos);
-    _opPrec[_opTop] = 0xFF;  // sentinel
-    _opRight[_opTop] = false;
-    _opUnary[_opTop] = false;
-    _opRPN[_opTop] = RPN_ADD;
-    _opPos[_opTop] = pos;
-    _opAssoc[_opTop] = false;  // mark as '('
-    _opTop++;
-    return true;
+  int parseStmtInner() {
+    uint32_t pos = _tok.pos;
+    switch (_tok.kind) {
+      case TK_LBRACE:
+        return parseBlock();
+      case TK_INT:
+        return parseDecl();
+      case TK_SEMI:
+        next();
+        return newNode(N_NOP, -1, -1, 0, pos);
+      case TK_IF:
+        {
+          next();
+          int c = parseParenExpr();
+          if (c < 0) return -1;
+          int t = parseStmt();
+          if (t < 0) return -1;
+          int e = -1;
+          if (accept(TK_ELSE)) {
+            e = parseStmt();
+            if (e < 0) return -1;
+          }
+          return newNode(N_IF, c, t, e, pos);
+        }
+      case TK_WHILE:
+        {
+          next();
+          _loopDepth++;  // the condition runs every iteration too
+          int c = parseParenExpr();
+          _loopDepth--;
+          if (c < 0) return -1;
+          int b = parseLoopBody();
+          if (b < 0) return -1;
+          return newNode(N_WHILE, c, b, 0, pos);
+        }
+      case TK_DO:
+        {
+          next();
+          int b = parseLoopBody();
+          if (b < 0) return -1;
+          if (!expect(TK_WHILE, "expected 'while' after do body")) return -1;
+          _loopDepth++;
+          int c = parseParenExpr();
+          _loopDepth--;
+          if (c < 0) return -1;
+          if (!expect(TK_SEMI, "expected ';'")) return -1;
+          return newNode(N_DO, b, c, 0, pos);
+        }
+      case TK_FOR:
+        return parseFor();
+      case TK_RETURN:
+        {
+          next();
+          int e = -1;
+          if (_tok.kind != TK_SEMI) {
+            e = parseExpr();
+            if (e < 0) return -1;
+          }
+          if (!expect(TK_SEMI, "expected ';' after return")) return -1;
+          return newNode(N_RETURN, e, -1, 0, pos);
+        }
+      case TK_BREAK:
+      case TK_CONTINUE:
+        {
+          NodeKind k = (_tok.kind == TK_BREAK) ? N_BREAK : N_CONTINUE;
+          if (_loopDepth == 0) return failN(k == N_BREAK ? "break outside loop" : "continue outside loop", pos);
+          next();
+          if (!expect(TK_SEMI, "expected ';'")) return -1;
+          return newNode(k, -1, -1, 0, pos);
+        }
+      case TK_ELSE:
+        return failN("'else' without 'if'", pos);
+      default:
+        {
+          int e = parseExpr();
+          if (e < 0) return -1;
+          if (!expect(TK_SEMI, "expected ';'")) return -1;
+          return newNode(N_EXPR, e, -1, 0, pos);
+        }
+    }
   }
 
-  // Emitters: 16-bit Thumb instructions (little-endian)
-  bool emit16(uint16_t hw) {
-    if (_outSz + 2 > _outCap) return false;
-    _out[_outSz + 0] = (uint8_t)(hw & 0xFF);
-    _out[_outSz + 1] = (uint8_t)(hw >> 8);
-    _outSz += 2;
-    return true;
+  int parseFor() {
+    uint32_t pos = _tok.pos;
+    next();
+    if (!expect(TK_LPAREN, "expected '(' after for")) return -1;
+    // for-init declarations are scoped to the loop
+    int saved = _blockScope;
+    _blockScope = _nvars;
+    int scope = _nvars;
+    int init = -1;
+    if (_tok.kind == TK_INT) {
+      init = parseDecl();
+      if (init < 0) return -1;
+    } else if (!accept(TK_SEMI)) {
+      int e = parseExpr();
+      if (e < 0) return -1;
+      if (!expect(TK_SEMI, "expected ';'")) return -1;
+      init = newNode(N_EXPR, e, -1, 0, pos);
+      if (init < 0) return -1;
+    }
+    _loopDepth++;
+    int cond = -1, step = -1;
+    if (_tok.kind != TK_SEMI) {
+      cond = parseExpr();
+      if (cond < 0) return -1;
+    }
+    if (!expect(TK_SEMI, "expected ';'")) return -1;
+    if (_tok.kind != TK_RPAREN) {
+      step = parseExpr();
+      if (step < 0) return -1;
+      step = newNode(N_EXPR, step, -1, 0, pos);
+      if (step < 0) return -1;
+    }
+    _loopDepth--;
+    if (!expect(TK_RPAREN, "expected ')'")) return -1;
+    int body = parseLoopBody();
+    if (body < 0) return -1;
+    for (int i = scope; i < _nvars; i++) _vars[i].visible = false;
+    _blockScope = saved;
+    int loop = newNode(N_FOR, cond, body, step, pos);
+    if (loop < 0 || init < 0) return loop;
+    // { init; for(;cond;step) body }
+    int blk = newNode(N_BLOCK, init, -1, 0, pos);
+    if (blk < 0) return -1;
+    _nodes[init].next = (int16_t)loop;
+    return blk;
   }
 
-  bool emitPushR(uint8_t r) {  // r in 0..7
-    if (r > 7) return false;
-    return emit16((uint16_t)(0xB400 | (1u << r)));  // PUSH {r}
+  // ---------------- Parser: expressions ----------------
+
+  int parseExpr() {
+    if (++_nesting > MAX_DEPTH) return failN("expression nested too deeply", _tok.pos);
+    int r = parseAssign();
+    _nesting--;
+    return r;
   }
-  bool emitPopR(uint8_t r) {
-    if (r > 7) return false;
-    return emit16((uint16_t)(0xBC00 | (1u << r)));  // POP {r}
+
+  static NodeKind compoundOp(TokKind k) {
+    switch (k) {
+      case TK_ADD_ASSIGN: return N_ADD;
+      case TK_SUB_ASSIGN: return N_SUB;
+      case TK_MUL_ASSIGN: return N_MUL;
+      case TK_DIV_ASSIGN: return N_DIV;
+      case TK_MOD_ASSIGN: return N_MOD;
+      case TK_AND_ASSIGN: return N_AND;
+      case TK_OR_ASSIGN: return N_OR;
+      case TK_XOR_ASSIGN: return N_XOR;
+      case TK_SHL_ASSIGN: return N_SHL;
+      case TK_SHR_ASSIGN: return N_SHR;
+      default: return N_NOP;
+    }
   }
 
-  bool emitADD_r0_r0_r1() {
-    // ADD (register) T1: 0001100 Rm(3) Rn(3) Rd(3)
-    // r0 = r0 + r1 => Rd=r0, Rn=r0, Rm=r1 => 0x1800 | (1<<6) | (0<<3) | 0
-    return emit16(0x1800 | (1u << 6));
+  int parseAssign() {
+    uint32_t pos = _tok.pos;
+    int lhs = parseCond();
+    if (lhs < 0) return -1;
+    TokKind k = _tok.kind;
+    if (k != TK_ASSIGN && compoundOp(k) == N_NOP) return lhs;
+    uint32_t opPos = _tok.pos;
+    if (_nodes[lhs].k != N_VAR) return failN("left side of assignment must be a variable", pos);
+    next();
+    int rhs = parseAssign();
+    if (rhs < 0) return -1;
+    int v = _nodes[lhs].v;
+    if (k != TK_ASSIGN) {
+      rhs = newBinary(compoundOp(k), lhs, rhs, opPos);
+      if (rhs < 0) return -1;
+    }
+    touchVar(v);
+    return newNode(N_ASSIGN, rhs, -1, v, opPos);
   }
-  bool emitSUB_r0_r0_r1() {
-    // SUB (register) T1: 0001101 Rm Rn Rd
-    // r0 = r0 - r1 => Rd=r0, Rn=r0, Rm=r1 => 0x1A00 | (1<<6)
-    return emit16(0x1A00 | (1u << 6));
+
+  int parseCond() {
+    int c = parseBinary(1);
+    if (c < 0 || _tok.kind != TK_QUEST) return c;
+    uint32_t pos = _tok.pos;
+    next();
+    int a = parseExpr();
+    if (a < 0) return -1;
+    if (!expect(TK_COLON, "expected ':'")) return -1;
+    int b = parseCond();
+    if (b < 0) return -1;
+    if (_opt.foldConstants && isNum(c)) return _nodes[c].v ? a : b;
+    return newNode(N_COND, c, a, b, pos);
   }
-  bool emitMULS_r0_r0_r1() {
-    // MULS Rd, Rm  (010000 1101 Rm Rdn) with Rdn=r0, Rm=r1 => 0x4340 | (1<<3) | 0
-    return emit16(0x4340 | (1u << 3));
+
+  static int binPrec(TokKind k, NodeKind& op) {
+    switch (k) {
+      case TK_LOR: op = N_LOR; return 1;
+      case TK_LAND: op = N_LAND; return 2;
+      case TK_PIPE: op = N_OR; return 3;
+      case TK_CARET: op = N_XOR; return 4;
+      case TK_AMP: op = N_AND; return 5;
+      case TK_EQ: op = N_EQ; return 6;
+      case TK_NE: op = N_NE; return 6;
+      case TK_LT: op = N_LT; return 7;
+      case TK_LE: op = N_LE; return 7;
+      case TK_GT: op = N_GT; return 7;
+      case TK_GE: op = N_GE; return 7;
+      case TK_SHL: op = N_SHL; return 8;
+      case TK_SHR: op = N_SHR; return 8;
+      case TK_PLUS: op = N_ADD; return 9;
+      case TK_MINUS: op = N_SUB; return 9;
+      case TK_MUL: op = N_MUL; return 10;
+      case TK_DIV: op = N_DIV; return 10;
+      case TK_MOD: op = N_MOD; return 10;
+      default: return 0;
+    }
   }
 
-  bool emitMOVS_r0_imm8(uint8_t imm) {
-    // MOVS (immediate) T1: 00100 Rd imm8 => Rd=r0, 0x2000 | imm8
-    return emit16(0x2000 | imm);
+  // Precedence climbing; all binary operators are left-associative.
+  int parseBinary(int minPrec) {
+    int lhs = parseUnary();
+    for (;;) {
+      if (lhs < 0) return -1;
+      NodeKind op = N_NOP;
+      int prec = binPrec(_tok.kind, op);
+      if (prec == 0 || prec < minPrec) return lhs;
+      uint32_t pos = _tok.pos;
+      next();
+      int rhs = parseBinary(prec + 1);
+      if (rhs < 0) return -1;
+      lhs = newBinary(op, lhs, rhs, pos);
+    }
   }
 
-  // LDR literal T1: 01001 Rt imm8 => LDR Rt, [PC, imm*4], base is aligned(PC,4)
-  // We'll emit with imm8=0 for now and fixup later once pool address is known.
-  bool emitLDR_lit_r0_andFixup(int32_t value) {
-    if (_nfix >= MAX_LITERALS) return fail("too many literal fixups", _tokPosEnd);
-    size_t instrOff = _outSz;
-    if (!emit16(0x4800 /* Rt=r0, imm8=0; fixup later */)) return false;
+  int parseUnary() {
+    uint32_t pos = _tok.pos;
+    TokKind k = _tok.kind;
+    if (k == TK_MINUS || k == TK_NOT || k == TK_TILDE || k == TK_PLUS) {
+      next();
+      if (++_nesting > MAX_DEPTH) return failN("expression nested too deeply", pos);
+      int a = parseUnary();
+      _nesting--;
+      if (a < 0 || k == TK_PLUS) return a;
+      return newUnary(k == TK_MINUS ? N_NEG : k == TK_NOT ? N_LNOT : N_BNOT, a, pos);
+    }
+    if (k == TK_INC || k == TK_DEC) {
+      next();
+      if (_tok.kind != TK_IDENT) return failN("++/-- needs a variable", _tok.pos);
+      int v = findVar(_tok.name, _tok.len);
+      if (v < 0) return failN("undeclared variable", _tok.pos);
+      next();
+      touchVar(v);
+      return newNode(N_PREINC, -1, k == TK_INC ? 1 : -1, v, pos);
+    }
+    return parsePostfix();
+  }
 
-    // track fixup and ensure literal uniqueness (dedupe)
-    int litIndex = findOrAddLiteral(value);
-    if (litIndex < 0) return fail("literal pool full", _tokPosEnd);
+  int parsePostfix() {
+    uint32_t pos = _tok.pos;
+    if (_tok.kind == TK_NUM) {
+      int32_t v = _tok.ival;
+      next();
+      return newNum(v, pos);
+    }
+    if (_tok.kind == TK_LPAREN) {
+      next();
+      int e = parseExpr();
+      if (e < 0) return -1;
+      if (!expect(TK_RPAREN, "expected ')'")) return -1;
+      return e;
+    }
+    if (_tok.kind != TK_IDENT) return failN("expected expression", pos);
+    Token name = _tok;
+    next();
+    if (_tok.kind == TK_LPAREN) return parseCall(name);
+    int v = findVar(name.name, name.len);
+    if (v < 0) return failN("undeclared variable", pos);
+    touchVar(v);
+    if (_tok.kind == TK_INC || _tok.kind == TK_DEC) {
+      int d = (_tok.kind == TK_INC) ? 1 : -1;
+      next();
+      return newNode(N_POSTINC, -1, d, v, pos);
+    }
+    return newNode(N_VAR, -1, -1, v, pos);
+  }
 
-    _fixups[_nfix].instrOffset = instrOff;
-    _fixups[_nfix].value = value;  // we will map to index on final emit
-    _nfix++;
-    return true;
+  int parseCall(const Token& name) {
+    next();  // '('
+    int in = findIntrinsic(name.name, name.len);
+    int f = -1;
+    if (in < 0) {
+      f = findFunc(name.name, name.len);
+      if (f < 0) f = addFunc(name.name, name.len, name.pos);
+      if (f < 0) return -1;
+    }
+    int first = -1, last = -1, argc = 0;
+    if (_tok.kind != TK_RPAREN) {
+      for (;;) {
+        int a = parseAssign();
+        if (a < 0) return -1;
+        if (++argc > MAX_PARAMS) return failN("too many arguments (max 8)", _nodes[a].pos);
+        if (last < 0) first = a;
+        else _nodes[last].next = (int16_t)a;
+        last = a;
+        if (!accept(TK_COMMA)) break;
+      }
+    }
+    if (!expect(TK_RPAREN, "expected ')' after arguments")) return -1;
+    if (in >= 0) {
+      if (argc != intrinsics()[in].nargs) return failN("wrong number of arguments", name.pos);
+      return newNode(N_INTRIN, first, argc, in, name.pos);
+    }
+    if (_funcs[f].nparams >= 0 && _funcs[f].nparams != argc) return failN("wrong number of arguments", name.pos);
+    _funcs[f].nparams = (int8_t)argc;
+    if (!_funcs[f].called) {
+      _funcs[f].called = true;
+      _funcs[f].firstUse = name.pos;
+    }
+    return newNode(N_CALL, first, argc, f, name.pos);
   }
 
-  int findLiteralIndex(int32_t v) const {
-    for (int i = 0; i < _nlit; i++)
-      if (_literals[i] == v) return i;
-    return -1;
+  // ---------------- Tree construction + optimizer ----------------
+
+  int newNum(int32_t v, uint32_t pos) {
+    return newNode(N_NUM, -1, -1, v, pos);
+  }
+  bool isNum(int n) const {
+    return n >= 0 && _nodes[n].k == N_NUM;
   }
-  int addLiteral(int32_t v) {
-    if (_nlit >= MAX_LITERALS) return -1;
-    _literals[_nlit++] = v;
-    return _nlit - 1;
+  bool isNum(int n, int32_t v) const {
+    return isNum(n) && _nodes[n].v == v;
   }
-  int findOrAddLiteral(int32_t v) {
-    int idx = findLiteralIndex(v);
-    if (idx >= 0) return idx;
-    return addLiteral(v);
+  // Reuse a NUM node in place when folding so the pool does not grow.
+  int setNum(int n, int32_t v) {
+    _nodes[n].k = N_NUM;
+    _nodes[n].a = _nodes[n].b = -1;
+    _nodes[n].v = v;
+    return n;
+  }
+  bool hasSideEffects(int n) const {
+    if (n < 0) return false;
+    const Node& nd = _nodes[n];
+    switch (nd.k) {
+      case N_NUM:
+      case N_VAR: return false;
+      case N_ASSIGN:
+      case N_PREINC:
+      case N_POSTINC:
+      case N_CALL:
+      case N_INTRIN: return true;
+      case N_COND: return hasSideEffects(nd.a) || hasSideEffects(nd.b) || hasSideEffects(nd.v);
+      default: return hasSideEffects(nd.a) || hasSideEffects(nd.b);
+    }
   }
 
-  bool loadImmToR0(int32_t v, size_t /*pos*/) {
-    // small imm: [0..255]
-    if (v >= 0 && v <= 255) return emitMOVS_r0_imm8((uint8_t)v);
-    // negative or large => LDR literal (fixup)
-    return emitLDR_lit_r0_andFixup(v);
+  static int log2Exact(uint32_t v) {
+    if (v == 0 || (v & (v - 1)) != 0) return -1;
+    int k = 0;
+    while ((v >>= 1) != 0) k++;
+    return k;
+  }
+  static bool isCompare(NodeKind k) {
+    return k >= N_EQ && k <= N_GE;
+  }
+  static bool isCommutative(NodeKind k) {
+    return k == N_ADD || k == N_MUL || k == N_AND || k == N_OR || k == N_XOR || k == N_EQ || k == N_NE;
+  }
+  // a OP b == b SWAP(OP) a
+  static NodeKind swapCompare(NodeKind k) {
+    switch (k) {
+      case N_LT: return N_GT;
+      case N_GT: return N_LT;
+      case N_LE: return N_GE;
+      case N_GE: return N_LE;
+      default: return k;
+    }
   }
 
-  bool emitRPN() {
-    _stackDepth = 0;
-    for (int i = 0; i < _nrpn; i++) {
-      const RPNItem& it = _rpn[i];
-      switch (it.k) {
-        case RPN_NUM:
-          {
-            if (!loadImmToR0(it.v, it.pos)) return fail("emit number failed", it.pos);
-            if (!emitPushR(0)) return fail("output buffer too small", it.pos);
-            _stackDepth++;
-            break;
-          }
-        case RPN_ADD:
-          {
-            if (!binaryOpPrep(it.pos)) return false;
-            if (!emitADD_r0_r0_r1()) return fail("output buffer too small", it.pos);
-            if (!emitPushR(0)) return fail("output buffer too small", it.pos);
-            _stackDepth++;
-            break;
-          }
-        case RPN_SUB:
-          {
-            if (!binaryOpPrep(it.pos)) return false;
-            if (!emitSUB_r0_r0_r1()) return fail("output buffer too small", it.pos);
-            if (!emitPushR(0)) return fail("output buffer too small", it.pos);
-            _stackDepth++;
-            break;
-          }
-        case RPN_MUL:
-          {
-            if (!binaryOpPrep(it.pos)) return false;
-            if (!emitMULS_r0_r0_r1()) return fail("output buffer too small", it.pos);
-            if (!emitPushR(0)) return fail("output buffer too small", it.pos);
-            _stackDepth++;
-            break;
-          }
-        case RPN_NEG:
-          {
-            // unary minus: pop r1 (x), movs r0,#0; sub r0,r0,r1; push r0
-            if (!ensureStack(1, it.pos)) return false;
-            if (!emitPopR(1)) return fail("output buffer too small", it.pos);  // r1 <- x
-            _stackDepth--;
-            if (!emitMOVS_r0_imm8(0)) return fail("output buffer too small", it.pos);
-            if (!emitSUB_r0_r0_r1()) return fail("output buffer too small", it.pos);
-            if (!emitPushR(0)) return fail("output buffer too small", it.pos);
-            _stackDepth++;
-            break;
-          }
-        default:
-          return fail("unsupported RPN op", it.pos);
-      }
+  // Compile-time evaluation with the same semantics as the generated code.
+  static int32_t evalBinary(NodeKind k, int32_t x, int32_t y) {
+    uint32_t ux = (uint32_t)x, uy = (uint32_t)y;
+    switch (k) {
+      case N_ADD: return (int32_t)(ux + uy);
+      case N_SUB: return (int32_t)(ux - uy);
+      case N_MUL: return (int32_t)(ux * uy);
+      case N_DIV:
+      case N_MOD:
+        {
+          if (y == 0) return (k == N_DIV) ? 0 : x;
+          uint32_t an = x < 0 ? 0u - ux : ux, ad = y < 0 ? 0u - uy : uy;
+          uint32_t q = an / ad, r = an % ad;
+          if (k == N_DIV) return (int32_t)(((x < 0) != (y < 0)) ? 0u - q : q);
+          return (int32_t)(x < 0 ? 0u - r : r);
+        }
+      case N_AND: return (int32_t)(ux & uy);
+      case N_OR: return (int32_t)(ux | uy);
+      case N_XOR: return (int32_t)(ux ^ uy);
+      case N_SHL: return (uy & 0xFF) >= 32 ? 0 : (int32_t)(ux << (uy & 0xFF));
+      case N_SHR: return (uy & 0xFF) >= 32 ? (x < 0 ? -1 : 0) : (x >> (uy & 0xFF));
+      case N_EQ: return x == y;
+      case N_NE: return x != y;
+      case N_LT: return x < y;
+      case N_LE: return x <= y;
+      case N_GT: return x > y;
+      case N_GE: return x >= y;
+      case N_LAND: return x && y;
+      case N_LOR: return x || y;
+      default: return 0;
     }
-    return true;
   }
 
-  bool ensureStack(int need, size_t pos) {
-    if (_stackDepth < need) return fail("stack underflow", pos);
-    return true;
+  int newUnary(NodeKind k, int a, uint32_t pos) {
+    if (_opt.foldConstants) {
+      if (isNum(a)) {
+        int32_t x = _nodes[a].v;
+        return setNum(a, k == N_NEG ? (int32_t)(0u - (uint32_t)x) : k == N_BNOT ? ~x : !x);
+      }
+      if (k != N_LNOT && _nodes[a].k == k) return _nodes[a].a;  // -(-x), ~~x
+      if (k == N_LNOT && isCompare(_nodes[a].k)) {              // !(a < b) -> a >= b
+        static const NodeKind inv[] = { N_NE, N_EQ, N_GE, N_GT, N_LE, N_LT };
+        _nodes[a].k = inv[_nodes[a].k - N_EQ];
+        return a;
+      }
+    }
+    return newNode(k, a, -1, 0, pos);
   }
 
-  bool binaryOpPrep(size_t pos) {
-    // pop b -> r1, pop a -> r0, compute (a op b), push r0
-    if (!ensureStack(2, pos)) return false;
-    if (!emitPopR(1)) return fail("output buffer too small", pos);
-    if (!emitPopR(0)) return fail("output buffer too small", pos);
-    _stackDepth -= 2;
-    return true;
+  int newBinary(NodeKind k, int a, int b, uint32_t pos) {
+    if (a < 0 || b < 0) return -1;
+    if (_opt.foldConstants) {
+      if (isNum(a) && isNum(b)) return setNum(a, evalBinary(k, _nodes[a].v, _nodes[b].v));
+      // short-circuit operators with a constant left side
+      if ((k == N_LAND || k == N_LOR) && isNum(a)) {
+        bool t = _nodes[a].v != 0;
+        if (k == N_LAND && !t) return setNum(a, 0);
+        if (k == N_LOR && t) return setNum(a, 1);
+        return newBinary(N_NE, b, setNum(a, 0), pos);  // 1 && x -> x != 0
+      }
+      // Canonical forms: constants on the right, x - c -> x + (-c)
+      if (isNum(a) && !isNum(b)) {
+        if (isCommutative(k)) {
+          int t = a;
+          a = b;
+          b = t;
+        } else if (isCompare(k)) {
+          int t = a;
+          a = b;
+          b = t;
+          k = swapCompare(k);
+        }
+      }
+      if (k == N_SUB && isNum(b)) {
+        setNum(b, (int32_t)(0u - (uint32_t)_nodes[b].v));
+        k = N_ADD;
+      }
+      if (k == N_SUB && isNum(a, 0)) return newUnary(N_NEG, b, pos);  // 0 - x
+      if (k == N_SUB && _nodes[b].k == N_NEG) {                         // x - (-y)
+        b = _nodes[b].a;
+        k = N_ADD;
+      }
+      if (k == N_ADD && _nodes[b].k == N_NEG) {  // x + (-y)
+        b = _nodes[b].a;
+        k = N_SUB;
+      }
+      if (isNum(b)) {
+        int32_t c = _nodes[b].v;
+        if ((k == N_ADD || k == N_OR || k == N_XOR || k == N_SHL || k == N_SHR) && c == 0) return a;
+        if ((k == N_MUL || k == N_DIV) && c == 1) return a;
+        if (k == N_AND && c == -1) return a;
+        if (k == N_DIV && c == -1) return newUnary(N_NEG, a, pos);
+        if (!hasSideEffects(a)) {
+          if ((k == N_MUL || k == N_AND) && c == 0) return b;
+          if (k == N_MOD && (c == 1 || c == -1)) return setNum(b, 0);
+        }
+        // Reassociate (x + c1) + c2 and (x * c1) * c2
+        Node& an = _nodes[a];
+        if (an.k == k && (k == N_ADD || k == N_MUL || k == N_AND || k == N_OR || k == N_XOR) && isNum(an.b)) {
+          setNum(an.b, evalBinary(k, _nodes[an.b].v, c));
+          return newBinary(k, an.a, an.b, pos);
+        }
+      }
+    }
+    if (_opt.strengthReduce && k == N_MUL) {
+      if (isNum(a)) {
+        int t = a;
+        a = b;
+        b = t;
+      }
+      if (isNum(b)) {
+        int32_t c = _nodes[b].v;
+        if (c == -1) return newNode(N_NEG, a, -1, 0, pos);
+        int sh = log2Exact((uint32_t)c);
+        if (sh >= 0) return newNode(N_SHL, a, setNum(b, sh), 0, pos);
+        sh = log2Exact(0u - (uint32_t)c);
+        if (sh > 0 && c != INT32_MIN) {
+          int s = newNode(N_SHL, a, setNum(b, sh), 0, pos);
+          if (s < 0) return -1;
+          return newNode(N_NEG, s, -1, 0, pos);
+        }
+      }
+    }
+    return newNode(k, a, b, 0, pos);
   }
 
-  bool fixupAndEmitLiteralPool() {
-    if (_nlit == 0) return true;  // no pool
+  // ---------------- Code generation ----------------
 
-    // pool starts at current _outSz (already 4-aligned)
-    size_t poolBase = _outSz;
+  bool emitFunction(int f, int body) {
+    _funcs[f].defined = true;
+    _retPos = _nodes[body].pos;
+    return backend().emitFunction(f, body);
+  }
 
-    // Emit all literals in order they were added
-    for (int i = 0; i < _nlit; i++) {
-      int32_t v = _literals[i];
-      if (_outSz + 4 > _outCap) return fail("output buffer too small for literal pool", _tokPosEnd);
-      _out[_outSz + 0] = (uint8_t)(v & 0xFF);
-      _out[_outSz + 1] = (uint8_t)((v >> 8) & 0xFF);
-      _out[_outSz + 2] = (uint8_t)((v >> 16) & 0xFF);
-      _out[_outSz + 3] = (uint8_t)((v >> 24) & 0xFF);
-      _outSz += 4;
+  bool finishProgram() {
+    int mainF = -1;
+    for (int i = 0; i < _nfuncs; i++) {
+      if (!_funcs[i].defined && _funcs[i].called) return fail("call to undefined function", _funcs[i].firstUse);
+      if (isMain(i)) mainF = i;
     }
+    if (mainF < 0) return fail("no main() function", 0);
+    return backend().finishProgram(mainF);
+  }
 
-    // Now fixup all LDR literal imm8 fields
-    for (int fi = 0; fi < _nfix; fi++) {
-      const LdrFixup& fx = _fixups[fi];
-      int litIdx = findLiteralIndex(fx.value);
-      if (litIdx < 0) return fail("internal: literal not found", fx.instrOffset);
+  // ---------------- Back ends ----------------
+  // Code generation sits behind the Backend interface: one implementation per
+  // instruction set, all reading the same AST and appending to _out. The
+  // instruction list, label and literal tables live in the compiler and are
+  // shared (one back end runs per compile).
 
-      size_t instrAddr = fx.instrOffset;  // byte offset
-      size_t pcAtInstr = instrAddr + 4;   // PC for Thumb is instr address + 4
-      size_t pcAligned = pcAtInstr & ~((size_t)3);
+  // Symbolic instruction list for one function. Sizes are settled by branch
+  // relaxation when the function is laid out.
+  enum InsnKind : uint8_t {
+    IK_HW = 0,  // plain instruction: 16-bit Thumb or 24-bit Xtensa encoding
+    IK_HW32,    // Thumb-2 32-bit instruction, op = first halfword | second << 16
+    IK_IT,      // Thumb-2 ITE block: op = ITE | then-MOV << 16, val = else-MOV
+    IK_LDRLIT,  // literal load: op = LDR/L32R with Rt, val = constant
+    IK_B,       // val = label
+    IK_BCC,     // op = condition (Thumb) / branch with zero offset (Xtensa), val = label
+    IK_CBZ,     // Thumb-2 CBZ/CBNZ with zero offset, val = label
+    IK_BL,      // call, val = function index
+    IK_LABEL,   // val = label
+    IK_DEAD     // removed by peephole
+  };
+  struct Insn {
+    uint32_t op;
+    InsnKind kind;
+    uint8_t size;
+    int32_t val;
+  };
+
+  struct CallFix {
+    uint32_t off;  // output offset of the call instruction
+    int16_t func;
+  };
+
+  class Backend {
+  public:
+    explicit Backend(MCCompiler& comp)
+      : c(comp), _nodes(comp._nodes), _vars(comp._vars), _funcs(comp._funcs), _insns(comp._insns) {}
+    virtual ~Backend() {}
+
+    virtual void reset() {
+      _ncalls = 0;
+      _haveStub = false;
+    }
+    // Generate one parsed function (homes, code, constants) at the end of _out.
+    virtual bool emitFunction(int f, int body) = 0;
+    // After the last function: helpers, entry stub, call displacements.
+    virtual bool finishProgram(int mainF) = 0;
+
+  protected:
+    virtual bool isBarrier(const Insn& in) const = 0;  // control never falls through
+    virtual void invertBranch(Insn& in) const = 0;     // IK_BCC / IK_CBZ: opposite condition
+
+    MCCompiler& c;
+    Node* _nodes;
+    Var* _vars;
+    Func* _funcs;
+    Insn* _insns;
+    int _ninsn = 0;
+    int _nlabels = 0;
+    int _nlit = 0;
+    int _ncalls = 0;
+    bool _haveStub = false;
+    int _nesting = 0;
+    int _retLabel = -1;
+    int _breakLabel[MAX_DEPTH];
+    int _contLabel[MAX_DEPTH];
+    int _nloops = 0;
+
+    bool fail(const char* m, size_t p) {
+      return c.fail(m, p);
+    }
+    bool isNum(int n) const {
+      return c.isNum(n);
+    }
+    bool isNum(int n, int32_t v) const {
+      return c.isNum(n, v);
+    }
+    bool isLeaf(int n) const {
+      return n >= 0 && (_nodes[n].k == N_NUM || _nodes[n].k == N_VAR);
+    }
+
+    void beginFunction() {
+      _ninsn = 0;
+      _nlabels = 0;
+      _nloops = 0;
+      _nesting = 0;
+      _nlit = 0;
+    }
+    int newLabel() {
+      if (_nlabels >= MAX_LABELS) return c.failN("too many branches in function", c._retPos);
+      c._labelAt[_nlabels] = -1;
+      return _nlabels++;
+    }
+    bool emitInsn(InsnKind k, uint32_t op, int32_t val, uint8_t size) {
+      if (_ninsn >= MAX_INSNS) return fail("function too large", c._retPos);
+      Insn& in = _insns[_ninsn++];
+      in.op = op;
+      in.kind = k;
+      in.size = size;
+      in.val = val;
+      return true;
+    }
+    bool placeLabel(int label) {
+      if (label < 0) return false;
+      c._labelAt[label] = (int16_t)_ninsn;
+      return emitInsn(IK_LABEL, 0, label, 0);
+    }
+
+    bool genDepth(int n) {
+      // tree depth: left-leaning chains (a+b+c+...) nest without parentheses
+      if (++_nesting > 2 * MAX_DEPTH) return fail("expression nested too deeply", _nodes[n].pos);
+      return true;
+    }
+    bool genLoop(int lBreak, int lCont) {
+      if (_nloops >= MAX_DEPTH) return fail("loops nested too deeply", c._retPos);
+      _breakLabel[_nloops] = lBreak;
+      _contLabel[_nloops] = lCont;
+      _nloops++;
+      return lBreak >= 0 && lCont >= 0;
+    }
+
+    int nextLive(int i) const {
+      for (i++; i < _ninsn; i++)
+        if (_insns[i].kind != IK_DEAD) return i;
+      return -1;
+    }
+    // First real instruction at or after i (skips labels).
+    int nextReal(int i) const {
+      for (; i < _ninsn; i++)
+        if (_insns[i].kind != IK_DEAD && _insns[i].kind != IK_LABEL) return i;
+      return -1;
+    }
+    static bool isLabelRef(const Insn& in) {
+      return in.kind == IK_B || in.kind == IK_BCC || in.kind == IK_CBZ;
+    }
+
+    // Unreferenced labels stop blocking patterns.
+    void dropDeadLabels(bool& changed) {
+      uint16_t uses[MAX_LABELS];
+      memset(uses, 0, sizeof(uses));
+      for (int i = 0; i < _ninsn; i++)
+        if (isLabelRef(_insns[i])) uses[_insns[i].val]++;
+      uses[_retLabel]++;
+      for (int i = 0; i < _ninsn; i++) {
+        Insn& a = _insns[i];
+        if (a.kind == IK_LABEL && uses[a.val] == 0) {
+          a.kind = IK_DEAD;
+          changed = true;
+        }
+      }
+    }
+
+    // Branch clean-ups common to all targets: unreachable code, jump
+    // threading, branches to the next instruction, Bcc over B. Returns true
+    // when instruction i was removed or rewritten.
+    bool tidyBranch(int i, bool& changed) {
+      Insn& a = _insns[i];
+      if (isBarrier(a)) {
+        for (int j = i + 1; j < _ninsn && _insns[j].kind != IK_LABEL; j++) {
+          if (_insns[j].kind != IK_DEAD) {
+            _insns[j].kind = IK_DEAD;
+            changed = true;
+          }
+        }
+      }
+      if (!isLabelRef(a)) return false;
+      // Jump threading: target is itself an unconditional branch
+      int t = nextReal(c._labelAt[a.val]);
+      if (t >= 0 && _insns[t].kind == IK_B && _insns[t].val != a.val) {
+        a.val = _insns[t].val;
+        changed = true;
+      }
+      // Branch to the label that immediately follows
+      for (int j = i + 1; j < _ninsn; j++) {
+        if (_insns[j].kind == IK_DEAD) continue;
+        if (_insns[j].kind != IK_LABEL) break;
+        if (_insns[j].val == a.val) {
+          a.kind = IK_DEAD;
+          changed = true;
+          return true;
+        }
+      }
+      // Bcc L1; B L2; L1: -> B!cc L2
+      int j = nextLive(i);
+      if (a.kind != IK_B && j >= 0 && _insns[j].kind == IK_B) {
+        int k = nextLive(j);
+        if (k >= 0 && _insns[k].kind == IK_LABEL && _insns[k].val == a.val) {
+          invertBranch(a);
+          a.val = _insns[j].val;
+          _insns[j].kind = IK_DEAD;
+          changed = true;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    int findOrAddLiteral(int32_t v) {
+      for (int i = 0; i < _nlit; i++)
+        if (c._literals[i] == v) return i;
+      if (_nlit >= MAX_LITERALS) return -1;
+      c._literals[_nlit++] = v;
+      return _nlit - 1;
+    }
+
+    // Little-endian output of 'bytes' bytes at _outSz.
+    bool put(uint32_t v, int bytes) {
+      if (c._outSz + (size_t)bytes > c._outCap) return fail("output buffer too small", c._retPos);
+      for (int i = 0; i < bytes; i++) c._out[c._outSz++] = (uint8_t)(v >> (8 * i));
+      return true;
+    }
+    bool callFix(uint32_t at, int f) {
+      if (_ncalls >= MAX_CALLS) return fail("too many calls", c._retPos);
+      c._calls[_ncalls].off = at;
+      c._calls[_ncalls].func = (int16_t)f;
+      _ncalls++;
+      return true;
+    }
+  };
+
+  // ---------------- Thumb (Cortex-M0+ / Cortex-M33) ----------------
+  // Thumb-1 for the M0+; Thumb-2 mode keeps the same register plan and adds
+  // MOVW and modified immediates (pool words only for full 32-bit values),
+  // SDIV/MLS, UBFX, ITE for comparison values, CBZ/CBNZ and 32-bit branches.
+  class ThumbBackend : public Backend {
+  public:
+    explicit ThumbBackend(MCCompiler& comp)
+      : Backend(comp) {}
+
+    void setThumb2(bool on) {
+      _t2 = on;
+    }
+
+    void reset() override {
+      Backend::reset();
+      _divFunc = -1;
+    }
+
+    bool emitFunction(int f, int body) override {
+      allocateHomes();
+      if (!startFunctionOutput(f)) return false;
+      size_t mark = c._outSz;
+      Stats st = c._stats;
+      int ncalls = _ncalls;
+      _inlineConsts = false;
+      for (;;) {
+        _poolOverflow = false;
+        if (!genFunction(body)) return false;
+        if (layoutFunction(f)) return true;
+        if (!_poolOverflow || _inlineConsts) return false;
+        // Literal pool out of LDR reach (> 1 KB of code): rebuild without one.
+        c._outSz = mark;
+        c._stats = st;
+        _ncalls = ncalls;
+        _inlineConsts = true;
+      }
+    }
+
+    bool finishProgram(int mainF) override {
+      if (_divFunc >= 0 && !emitDivHelper()) return false;
+      if (_haveStub) {
+        uint32_t lit = _funcs[mainF].off - 10u + 1u;  // relative to PC at 'add r0,pc', Thumb bit set
+        static const uint16_t stub[6] = { 0xB082, 0x9000, 0x4801, 0x4478, 0x9001, 0xBD01 };
+        for (int i = 0; i < 6; i++) {
+          c._out[i * 2] = (uint8_t)stub[i];
+          c._out[i * 2 + 1] = (uint8_t)(stub[i] >> 8);
+        }
+        for (int i = 0; i < 4; i++) c._out[12 + i] = (uint8_t)(lit >> (8 * i));
+      }
+      for (int i = 0; i < _ncalls; i++) {
+        int32_t disp = (int32_t)_funcs[c._calls[i].func].off - (int32_t)(c._calls[i].off + 4);
+        putWide(c._calls[i].off, encBranch32(disp, 0xD000));
+      }
+      return true;
+    }
+
+  protected:
+    bool isBarrier(const Insn& in) const override {
+      return in.kind == IK_B || (in.kind == IK_HW && (in.op & 0xFF00) == 0xBD00);
+    }
+    void invertBranch(Insn& in) const override {
+      in.op ^= (in.kind == IK_CBZ) ? 0x800u : 1u;  // CBZ <-> CBNZ, cond ^ 1
+    }
+
+  private:
+    bool _t2 = false;
+    int _divFunc = -1;
+    int _pushDepth = 0;  // words pushed below the frame (SP-relative slots)
+    int _nslots = 0;
+    uint8_t _savedMask = 0;  // r4-r7 used by the current function
+    bool _inlineConsts = false;  // no literal pool: MOVW/MOVT, or MOVS/LSLS/ADDS on Thumb-1
+    bool _poolOverflow = false;
+
+    enum Cond : uint8_t { C_EQ = 0,
+                          C_NE = 1,
+                          C_HS = 2,
+                          C_LO = 3,
+                          C_GE = 10,
+                          C_LT = 11,
+                          C_GT = 12,
+                          C_LE = 13 };
+
+    bool emit(uint16_t hw) {
+      return emitInsn(IK_HW, hw, 0, 2);
+    }
+    bool emit32(uint32_t op) {
+      return emitInsn(IK_HW32, op, 0, 4);
+    }
+    bool emitLdrLit(uint8_t rt, int32_t value) {
+      return emitInsn(IK_LDRLIT, (uint16_t)(0x4800 | (rt << 8)), value, 2);
+    }
+    bool emitB(int label) {
+      return label >= 0 && emitInsn(IK_B, 0, label, 2);
+    }
+    bool emitBcc(uint8_t cond, int label) {
+      return label >= 0 && emitInsn(IK_BCC, cond, label, 2);
+    }
+    bool emitCall(int f) {
+      return emitInsn(IK_BL, 0, f, 4);
+    }
+    // Thumb-2 branch on rn == 0 / != 0. CBZ only reaches forward, so labels
+    // already placed (loop tops) keep CMP + Bcc.
+    bool emitZeroBranch(uint8_t rn, bool nonZero, int label) {
+      if (label < 0) return false;
+      if (!_t2 || c._labelAt[label] >= 0) return emit(encCmpImm(rn, 0)) && emitBcc(nonZero ? C_NE : C_EQ, label);
+      return emitInsn(IK_CBZ, (uint16_t)((nonZero ? 0xB900 : 0xB100) | rn), label, 2);
+    }
+
+    // Thumb-1 encodings used by the generator
+    static uint16_t encPush(uint8_t r) {
+      return (uint16_t)(0xB400 | (1u << r));
+    }
+    static uint16_t encPop(uint8_t r) {
+      return (uint16_t)(0xBC00 | (1u << r));
+    }
+    static uint16_t encMovsImm(uint8_t rd, uint8_t imm) {
+      return (uint16_t)(0x2000 | (rd << 8) | imm);
+    }
+    static uint16_t encCmpImm(uint8_t rn, uint8_t imm) {
+      return (uint16_t)(0x2800 | (rn << 8) | imm);
+    }
+    static uint16_t encAddsImm(uint8_t rdn, uint8_t imm) {
+      return (uint16_t)(0x3000 | (rdn << 8) | imm);
+    }
+    static uint16_t encSubsImm(uint8_t rdn, uint8_t imm) {
+      return (uint16_t)(0x3800 | (rdn << 8) | imm);
+    }
+    static uint16_t encAddsImm3(uint8_t rd, uint8_t rn, uint8_t imm) {
+      return (uint16_t)(0x1C00 | (imm << 6) | (rn << 3) | rd);
+    }
+    static uint16_t encSubsImm3(uint8_t rd, uint8_t rn, uint8_t imm) {
+      return (uint16_t)(0x1E00 | (imm << 6) | (rn << 3) | rd);
+    }
+    static uint16_t encLslsImm(uint8_t rd, uint8_t rm, uint8_t sh) {
+      return (uint16_t)(0x0000 | ((sh & 31) << 6) | (rm << 3) | rd);
+    }
+    static uint16_t encLsrsImm(uint8_t rd, uint8_t rm, uint8_t sh) {  // sh 1..32
+      return (uint16_t)(0x0800 | ((sh & 31) << 6) | (rm << 3) | rd);
+    }
+    static uint16_t encAsrsImm(uint8_t rd, uint8_t rm, uint8_t sh) {  // sh 1..32
+      return (uint16_t)(0x1000 | ((sh & 31) << 6) | (rm << 3) | rd);
+    }
+    static uint16_t encMovsReg(uint8_t rd, uint8_t rm) {
+      return encLslsImm(rd, rm, 0);
+    }
+    static uint16_t encAddsReg(uint8_t rd, uint8_t rn, uint8_t rm) {
+      return (uint16_t)(0x1800 | (rm << 6) | (rn << 3) | rd);
+    }
+    static uint16_t encSubsReg(uint8_t rd, uint8_t rn, uint8_t rm) {
+      return (uint16_t)(0x1A00 | (rm << 6) | (rn << 3) | rd);
+    }
+    // Two-operand data processing: Rdn = Rdn OP Rm (0x4000 | op<<6)
+    enum DpOp : uint8_t { DP_AND = 0,
+                          DP_EOR = 1,
+                          DP_LSL = 2,
+                          DP_LSR = 3,
+                          DP_ASR = 4,
+                          DP_ADC = 5,
+                          DP_SBC = 6,
+                          DP_TST = 8,
+                          DP_NEG = 9,
+                          DP_CMP = 10,
+                          DP_ORR = 12,
+                          DP_MUL = 13,
+                          DP_BIC = 14,
+                          DP_MVN = 15 };
+    static uint16_t encDp(DpOp op, uint8_t rdn, uint8_t rm) {
+      return (uint16_t)(0x4000 | (op << 6) | (rm << 3) | rdn);
+    }
+    static uint16_t encLdrSp(uint8_t rt, uint8_t words) {
+      return (uint16_t)(0x9800 | (rt << 8) | words);
+    }
+    static uint16_t encStrSp(uint8_t rt, uint8_t words) {
+      return (uint16_t)(0x9000 | (rt << 8) | words);
+    }
+    static uint16_t encStrImm(uint8_t rt, uint8_t rn, uint8_t off) {  // off: multiple of 4, <= 124
+      return (uint16_t)(0x6000 | ((off >> 2) << 6) | (rn << 3) | rt);
+    }
+    static uint16_t encLdrImm(uint8_t rt, uint8_t rn, uint8_t off) {
+      return (uint16_t)(0x6800 | ((off >> 2) << 6) | (rn << 3) | rt);
+    }
+
+    // Thumb-2 32-bit encodings (first halfword in the low 16 bits)
+    static uint32_t t2(uint16_t h1, uint16_t h2) {
+      return h1 | ((uint32_t)h2 << 16);
+    }
+    // i:imm3:imm8 split of a 12-bit field; h1 carries op and Rn
+    static uint32_t encImm12(uint16_t h1, uint8_t rn, uint8_t rd, uint32_t imm12) {
+      return t2((uint16_t)(h1 | ((imm12 >> 11) << 10) | rn), (uint16_t)((((imm12 >> 8) & 7) << 12) | (rd << 8) | (imm12 & 0xFF)));
+    }
+    // Modified immediate (imm12) that expands to v, or -1.
+    static int modImm(uint32_t v) {
+      uint32_t b = v & 0xFF, h = (v >> 8) & 0xFF;
+      if (v == b) return (int)b;
+      if (v == (b | b << 16)) return (int)(0x100 | b);
+      if (v == (h << 8 | h << 24)) return (int)(0x200 | h);
+      if (v == (b | b << 8 | b << 16 | b << 24)) return (int)(0x300 | b);
+      for (int rot = 8; rot < 32; rot++) {
+        uint32_t x = (v << rot) | (v >> (32 - rot));  // v == x ROR rot, x = 1bcdefgh
+        if (x >= 0x80 && x <= 0xFF) return (rot << 7) | (int)(x & 0x7F);
+      }
+      return -1;
+    }
+    // Data processing with a modified immediate: 0xF000 AND, 0xF020 BIC,
+    // 0xF040 ORR (Rn=15: MOV), 0xF060 ORN (Rn=15: MVN), 0xF080 EOR,
+    // 0xF100 ADD, 0xF1A0 SUB, 0xF1B0 CMP (Rd=15), 0xF110 CMN (Rd=15)
+    enum T2Op : uint16_t { T2_AND = 0xF000,
+                           T2_BIC = 0xF020,
+                           T2_ORR = 0xF040,
+                           T2_ORN = 0xF060,
+                           T2_EOR = 0xF080,
+                           T2_ADD = 0xF100,
+                           T2_SUB = 0xF1A0,
+                           T2_CMN = 0xF110,
+                           T2_CMP = 0xF1B0 };
+    bool emitT2Imm(T2Op op, uint8_t rd, uint8_t rn, int imm12) {
+      return emit32(encImm12(op, rn, rd, (uint32_t)imm12));
+    }
+    static uint32_t encAddw(uint8_t rd, uint8_t rn, uint32_t imm12) {  // also SUBW with 0xF2A0
+      return encImm12(0xF200, rn, rd, imm12);
+    }
+    static uint32_t encSubw(uint8_t rd, uint8_t rn, uint32_t imm12) {
+      return encImm12(0xF2A0, rn, rd, imm12);
+    }
+    static uint32_t encMovw(uint8_t rd, uint32_t imm16) {
+      return encImm12(0xF240, (uint8_t)(imm16 >> 12), rd, imm16 & 0xFFF);
+    }
+    static uint32_t encMovt(uint8_t rd, uint32_t imm16) {
+      return encImm12(0xF2C0, (uint8_t)(imm16 >> 12), rd, imm16 & 0xFFF);
+    }
+    static uint32_t encSdiv(uint8_t rd, uint8_t rn, uint8_t rm) {
+      return t2((uint16_t)(0xFB90 | rn), (uint16_t)(0xF0F0 | (rd << 8) | rm));
+    }
+    static uint32_t encMls(uint8_t rd, uint8_t rn, uint8_t rm, uint8_t ra) {  // rd = ra - rn * rm
+      return t2((uint16_t)(0xFB00 | rn), (uint16_t)((ra << 12) | (rd << 8) | 0x10 | rm));
+    }
+    static uint32_t encUbfx(uint8_t rd, uint8_t rn, uint8_t lsb, uint8_t width) {
+      return t2((uint16_t)(0xF3C0 | rn), (uint16_t)(((lsb >> 2) << 12) | (rd << 8) | ((lsb & 3) << 6) | (width - 1)));
+    }
+    // BL (h2 = 0xD000) / B.W (h2 = 0x9000), displacement from the instruction + 4
+    static uint32_t encBranch32(int32_t disp, uint16_t h2) {
+      uint32_t s = disp < 0 ? 1u : 0u;
+      uint32_t u = (uint32_t)disp;
+      uint32_t j1 = ((~(u >> 23)) ^ s) & 1u, j2 = ((~(u >> 22)) ^ s) & 1u;
+      return t2((uint16_t)(0xF000 | (s << 10) | ((u >> 12) & 0x3FF)), (uint16_t)(h2 | (j1 << 13) | (j2 << 11) | ((u >> 1) & 0x7FF)));
+    }
+    // Bcc.W (+-1 MB)
+    static uint32_t encBccW(uint8_t cond, int32_t disp) {
+      uint32_t u = (uint32_t)disp;
+      uint32_t s = (u >> 20) & 1u, j2 = (u >> 19) & 1u, j1 = (u >> 18) & 1u;
+      return t2((uint16_t)(0xF000 | (s << 10) | (cond << 6) | ((u >> 12) & 0x3F)), (uint16_t)(0x8000 | (j1 << 13) | (j2 << 11) | ((u >> 1) & 0x7FF)));
+    }
+
+    bool push(uint8_t r) {
+      _pushDepth++;
+      return emit(encPush(r));
+    }
+    bool pop(uint8_t r) {
+      _pushDepth--;
+      return emit(encPop(r));
+    }
+    bool mov(uint8_t rd, uint8_t rm) {
+      return rd == rm || emit(encMovsReg(rd, rm));
+    }
+
+    bool loadImm(uint8_t rd, int32_t v) {
+      uint32_t u = (uint32_t)v;
+      if (u <= 255) return emit(encMovsImm(rd, (uint8_t)u));
+      if (_t2) {
+        if (c._opt.strengthReduce) {
+          int m = modImm(u);
+          if (m >= 0) return emitT2Imm(T2_ORR, rd, 15, m);  // MOV.W
+          m = modImm(~u);
+          if (m >= 0) return emitT2Imm(T2_ORN, rd, 15, m);  // MVN.W
+        }
+        if (u <= 0xFFFF) return emit32(encMovw(rd, u));
+      }
+      if (c._opt.strengthReduce) {
+        // -imm8: MOVS + NEGS (2 cycles, same as LDR literal, saves the pool word)
+        if ((0u - u) <= 255) return emit(encMovsImm(rd, (uint8_t)(0u - u))) && emit(encDp(DP_NEG, rd, rd));
+        // ~imm8: MOVS + MVNS
+        if (~u <= 255) return emit(encMovsImm(rd, (uint8_t)~u)) && emit(encDp(DP_MVN, rd, rd));
+        // imm8 << k: MOVS + LSLS
+        for (uint8_t sh = 1; sh < 32; sh++) {
+          if ((u & ((1u << sh) - 1u)) != 0) break;
+          if ((u >> sh) <= 255) return emit(encMovsImm(rd, (uint8_t)(u >> sh))) && emit(encLslsImm(rd, rd, sh));
+        }
+      }
+      if (_inlineConsts) {
+        // MOVW + MOVT costs 8 bytes at every use; the pool word is shared
+        if (_t2) return emit32(encMovw(rd, u & 0xFFFF)) && emit32(encMovt(rd, u >> 16));
+        // byte by byte: MOVS b3; (LSLS #8; ADDS bN)...
+        int top = 3;
+        while (((u >> (8 * top)) & 0xFF) == 0) top--;
+        if (!emit(encMovsImm(rd, (uint8_t)(u >> (8 * top))))) return false;
+        for (int i = top - 1; i >= 0; i--) {
+          if (!emit(encLslsImm(rd, rd, 8))) return false;
+          uint8_t b = (uint8_t)(u >> (8 * i));
+          if (b && !emit(encAddsImm(rd, b))) return false;
+        }
+        return true;
+      }
+      return emitLdrLit(rd, v);
+    }
+
+    // SP-relative word offset of a stack-homed variable at the current push depth.
+    bool slotWords(int var, uint8_t& words) {
+      int w = _vars[var].slot + _pushDepth;
+      if (w > 255) return fail("stack frame too large", c._retPos);
+      words = (uint8_t)w;
+      return true;
+    }
+
+    // Register holding the node's value without emitting code (register variables).
+    bool regOf(int n, uint8_t& r) const {
+      if (n < 0 || _nodes[n].k != N_VAR || _vars[_nodes[n].v].reg < 0) return false;
+      r = (uint8_t)_vars[_nodes[n].v].reg;
+      return true;
+    }
+    bool loadLeaf(int n, uint8_t rd) {
+      const Node& nd = _nodes[n];
+      if (nd.k == N_NUM) return loadImm(rd, nd.v);
+      uint8_t r;
+      if (regOf(n, r)) return mov(rd, r);
+      uint8_t w;
+      return slotWords(nd.v, w) && emit(encLdrSp(rd, w));
+    }
+    bool storeVar(int var, uint8_t rs) {
+      if (_vars[var].reg >= 0) return mov((uint8_t)_vars[var].reg, rs);
+      uint8_t w;
+      return slotWords(var, w) && emit(encStrSp(rs, w));
+    }
+    // Left operand: register variables are used in place, anything else goes to r0.
+    bool operandA(int a, uint8_t& rn) {
+      if (regOf(a, rn)) return true;
+      rn = 0;
+      return genExpr(a);
+    }
+    // Leaf right operand: register variables in place, anything else into r1.
+    bool operandB(int b, uint8_t& rm) {
+      if (regOf(b, rm)) return true;
+      rm = 1;
+      return loadLeaf(b, 1);
+    }
+
+    // Evaluate expression n into r0.
+    bool genExpr(int n) {
+      if (!genDepth(n)) return false;
+      bool ok = genExprInner(n);
+      _nesting--;
+      return ok;
+    }
+
+    bool genExprInner(int n) {
+      const Node& nd = _nodes[n];
+      switch (nd.k) {
+        case N_NUM:
+        case N_VAR:
+          return loadLeaf(n, 0);
+        case N_ASSIGN:
+          return genExpr(nd.a) && storeVar(nd.v, 0);
+        case N_PREINC:
+        case N_POSTINC:
+          {
+            bool post = (nd.k == N_POSTINC);
+            uint16_t step = nd.b > 0 ? encAddsImm3(0, 0, 1) : encSubsImm3(0, 0, 1);
+            int8_t r = _vars[nd.v].reg;
+            if (r >= 0) {
+              uint16_t s = nd.b > 0 ? encAddsImm((uint8_t)r, 1) : encSubsImm((uint8_t)r, 1);
+              if (post) return mov(0, (uint8_t)r) && emit(s);
+              return emit(s) && mov(0, (uint8_t)r);
+            }
+            uint8_t w;
+            if (!slotWords(nd.v, w) || !emit(encLdrSp(0, w))) return false;
+            if (!post) return emit(step) && emit(encStrSp(0, w));
+            // r1 = r0 +/- 1; store r1, keep the old value in r0
+            return emit((uint16_t)((step & ~7u) | 1u)) && emit(encStrSp(1, w));
+          }
+        case N_CALL:
+          return genCall(nd);
+        case N_INTRIN:
+          return genIntrinsic(nd);
+        case N_COND:
+          {
+            int lElse = newLabel(), lEnd = newLabel();
+            return genBranch(nd.a, lElse, false) && genExpr(nd.b) && emitB(lEnd) && placeLabel(lElse) && genExpr(nd.v) && placeLabel(lEnd);
+          }
+        case N_NEG:
+        case N_BNOT:
+          {
+            uint8_t r;
+            if (!operandA(nd.a, r)) return false;
+            return emit(encDp(nd.k == N_NEG ? DP_NEG : DP_MVN, 0, r));
+          }
+        case N_LNOT:
+          {
+            // r0 = (x == 0): NEGS r1,x sets C only for x == 0; ADCS r0,r1 -> C
+            uint8_t r;
+            if (!operandA(nd.a, r)) return false;
+            return mov(0, r) && emit(encDp(DP_NEG, 1, 0)) && emit(encDp(DP_ADC, 0, 1));
+          }
+        case N_LT:
+        case N_LE:
+        case N_GT:
+        case N_GE:
+          if (_t2) {
+            // CMP; ITE cc; MOVcc r0,#1; MOV r0,#0 (no flag writes inside IT)
+            uint8_t cond;
+            if (!genCompare(nd.a, nd.b, nd.k, cond)) return false;
+            uint16_t ite = (uint16_t)(0xBF04 | (cond << 4) | ((~cond & 1) << 3));
+            return emitInsn(IK_IT, t2(ite, encMovsImm(0, 1)), encMovsImm(0, 0), 6);
+          }
+          return genMaterialize(n);
+        case N_LAND:
+        case N_LOR:
+          return genMaterialize(n);
+        default:
+          return genBinary(nd);
+      }
+    }
+
+    // Boolean value through branches: r0 = cond ? 1 : 0
+    bool genMaterialize(int n) {
+      int lTrue = newLabel(), lEnd = newLabel();
+      return genBranch(n, lTrue, true) && emit(encMovsImm(0, 0)) && emitB(lEnd) && placeLabel(lTrue) && emit(encMovsImm(0, 1)) && placeLabel(lEnd);
+    }
+
+    // r0 = (r0 == 0) / (r0 != 0) without branches
+    bool genZeroTest(bool eq) {
+      if (eq) return emit(encDp(DP_NEG, 1, 0)) && emit(encDp(DP_ADC, 0, 1));
+      // SUBS r1,r0,#1 sets C unless r0 == 0; SBCS r0,r1 -> r0 - (r0-1) - !C = C
+      return emit(encSubsImm3(1, 0, 1)) && emit(encDp(DP_SBC, 0, 1));
+    }
+
+    bool genBinary(const Node& nd) {
+      NodeKind k = nd.k;
+      int a = nd.a, b = nd.b;
+      if (isCommutative(k) && isLeaf(a) && !isLeaf(b)) {
+        int t = a;
+        a = b;
+        b = t;
+      }
+      if (c._opt.strengthReduce && isNum(b)) {
+        bool handled = false;
+        if (!genBinaryImm(k, a, _nodes[b].v, handled)) return false;
+        if (handled) return true;
+      }
+      uint8_t rn, rm;
+      if (isLeaf(b)) {
+        if (!operandA(a, rn) || !operandB(b, rm)) return false;
+        return emitOp(k, rn, rm);
+      }
+      if (isLeaf(a)) {
+        if (!genExpr(b)) return false;
+        if (k == N_SUB || k == N_EQ || k == N_NE || (_t2 && (k == N_DIV || k == N_MOD))) {
+          // 3-register forms take any operand order
+          if (!regOf(a, rn)) {
+            rn = 1;
+            if (!loadLeaf(a, 1)) return false;
+          }
+          return emitOp(k, rn, 0);
+        }
+        if (!mov(1, 0) || !operandA(a, rn)) return false;
+        return emitOp(k, rn, 1);
+      }
+      // General case: evaluate right, park it on the stack, evaluate left.
+      if (!genExpr(b) || !push(0) || !genExpr(a) || !pop(1)) return false;
+      return emitOp(k, 0, 1);
+    }
+
+    // r0 = rn OP rm. rm is never r0 unless rn != r0 and OP is SUB/EQ/NE
+    // (Thumb-2: also DIV/MOD).
+    bool emitOp(NodeKind k, uint8_t rn, uint8_t rm) {
+      switch (k) {
+        case N_ADD: return emit(encAddsReg(0, rn, rm));
+        case N_SUB: return emit(encSubsReg(0, rn, rm));
+        case N_EQ:
+        case N_NE: return emit(encSubsReg(0, rn, rm)) && genZeroTest(k == N_EQ);
+        case N_MUL:
+        case N_AND:
+        case N_OR:
+        case N_XOR:
+          {
+            DpOp op = (k == N_MUL) ? DP_MUL : (k == N_AND) ? DP_AND : (k == N_OR) ? DP_ORR : DP_EOR;
+            if (rn == 0) return emit(encDp(op, 0, rm));
+            if (rm == 0) return emit(encDp(op, 0, rn));
+            return mov(0, rn) && emit(encDp(op, 0, rm));
+          }
+        case N_SHL:
+        case N_SHR:
+          return mov(0, rn) && emit(encDp(k == N_SHL ? DP_LSL : DP_ASR, 0, rm));
+        case N_DIV:
+        case N_MOD:
+          {
+            if (_t2) {
+              // SDIV gives 0 for d == 0 (no trap by default), so MLS leaves n
+              if (k == N_DIV) return emit32(encSdiv(0, rn, rm));
+              return emit32(encSdiv(2, rn, rm)) && emit32(encMls(0, 2, rm, rn));
+            }
+            // helper: r0 = n / d, r1 = n % d
+            if (!mov(0, rn) || !mov(1, rm) || !useDivHelper()) return false;
+            if (!emitCall(_divFunc)) return false;
+            return k == N_DIV || mov(0, 1);
+          }
+        default:
+          return fail("unsupported operator", c._retPos);
+      }
+    }
+
+    // Constant right operand (strength reduction). Sets handled=false to fall
+    // back to the generic register form.
+    bool genBinaryImm(NodeKind k, int a, int32_t cv, bool& handled) {
+      handled = true;
+      uint8_t rn;
+      uint32_t u = (uint32_t)cv;
+      switch (k) {
+        case N_ADD:
+        case N_SUB:
+          {
+            bool sub = (k == N_SUB);
+            if (cv < 0 && cv > -4096) {
+              cv = -cv;
+              sub = !sub;
+            }
+            if (cv >= 0 && cv <= 255) {
+              if (!operandA(a, rn)) return false;
+              if (cv <= 7) return emit(sub ? encSubsImm3(0, rn, (uint8_t)cv) : encAddsImm3(0, rn, (uint8_t)cv));
+              return mov(0, rn) && emit(sub ? encSubsImm(0, (uint8_t)cv) : encAddsImm(0, (uint8_t)cv));
+            }
+            if (!_t2) break;
+            if (cv >= 0 && cv <= 4095) {
+              if (!operandA(a, rn)) return false;
+              return emit32(sub ? encSubw(0, rn, (uint32_t)cv) : encAddw(0, rn, (uint32_t)cv));
+            }
+            if (sub) u = 0u - u;
+            int m = modImm(u);
+            if (m < 0) break;
+            return operandA(a, rn) && emitT2Imm(T2_ADD, 0, rn, m);
+          }
+        case N_SHL:
+        case N_SHR:
+          u &= 0xFF;  // register shifts use the bottom byte
+          if (!operandA(a, rn)) return false;
+          if (u == 0) return mov(0, rn);
+          if (k == N_SHL) return u >= 32 ? emit(encMovsImm(0, 0)) : emit(encLslsImm(0, rn, (uint8_t)u));
+          return emit(encAsrsImm(0, rn, u >= 32 ? 32 : (uint8_t)u));
+        case N_AND:
+          {
+            if (u == 0xFF || u == 0xFFFF) {
+              if (!operandA(a, rn)) return false;
+              return emit((uint16_t)((u == 0xFF ? 0xB2C0 : 0xB280) | (rn << 3)));  // UXTB/UXTH r0,rn
+            }
+            int lo = log2Exact(u + 1);  // 2^k - 1: keep low k bits
+            if (lo > 0 && lo < 32 && (_t2 || u > 255)) {
+              if (!operandA(a, rn)) return false;
+              if (_t2) return emit32(encUbfx(0, rn, 0, (uint8_t)lo));
+              return emit(encLslsImm(0, rn, (uint8_t)(32 - lo))) && emit(encLsrsImm(0, 0, (uint8_t)(32 - lo)));
+            }
+            int hi = log2Exact(~u + 1);  // -(2^k): clear low k bits
+            if (hi > 0 && hi < 32) {
+              if (!operandA(a, rn)) return false;
+              return emit(encLsrsImm(0, rn, (uint8_t)hi)) && emit(encLslsImm(0, 0, (uint8_t)hi));
+            }
+            if (!_t2) break;
+            int m = modImm(u);
+            if (m >= 0) return operandA(a, rn) && emitT2Imm(T2_AND, 0, rn, m);
+            m = modImm(~u);
+            if (m >= 0) return operandA(a, rn) && emitT2Imm(T2_BIC, 0, rn, m);
+            break;
+          }
+        case N_OR:
+        case N_XOR:
+          {
+            int m = _t2 ? modImm(u) : -1;
+            if (m < 0) break;
+            return operandA(a, rn) && emitT2Imm(k == N_OR ? T2_ORR : T2_EOR, 0, rn, m);
+          }
+        case N_DIV:
+        case N_MOD:
+          {
+            // signed x / 2^k == (x + (x < 0 ? 2^k - 1 : 0)) >> k
+            int sh = (cv > 1) ? log2Exact(u) : -1;
+            if (sh < 1) break;
+            if (!operandA(a, rn)) return false;
+            if (!emit(encAsrsImm(1, rn, 31)) || !emit(encLsrsImm(1, 1, (uint8_t)(32 - sh)))) return false;
+            if (k == N_DIV) return emit(encAddsReg(0, rn, 1)) && emit(encAsrsImm(0, 0, (uint8_t)sh));
+            // x % 2^k == x - ((x + bias) & -2^k)
+            return emit(encAddsReg(1, 1, rn)) && emit(encLsrsImm(1, 1, (uint8_t)sh)) && emit(encLslsImm(1, 1, (uint8_t)sh)) && emit(encSubsReg(0, rn, 1));
+          }
+        case N_EQ:
+        case N_NE:
+          {
+            if (cv < 0 || cv > 255) break;
+            if (!operandA(a, rn)) return false;
+            if (cv == 0) {
+              if (!mov(0, rn)) return false;
+            } else if (cv <= 7) {
+              if (!emit(encSubsImm3(0, rn, (uint8_t)cv))) return false;
+            } else if (!mov(0, rn) || !emit(encSubsImm(0, (uint8_t)cv))) {
+              return false;
+            }
+            return genZeroTest(k == N_EQ);
+          }
+        default:
+          break;
+      }
+      handled = false;
+      return true;
+    }
+
+    bool useDivHelper() {
+      if (_divFunc >= 0) return true;
+      _divFunc = c.addFunc(nullptr, 0, c._retPos);
+      return _divFunc >= 0;
+    }
+
+    // AAPCS call: args 0-3 in r0-r3, the rest pushed (arg4 at the lowest address).
+    bool genCall(const Node& nd) {
+      int args[MAX_PARAMS];
+      int argc = 0;
+      for (int a = nd.a; a >= 0 && argc < MAX_PARAMS; a = _nodes[a].next) args[argc++] = a;
+      int stackArgs = argc > 4 ? argc - 4 : 0;
+      for (int i = argc - 1; i >= 4; i--) {
+        if (!genExpr(args[i]) || !push(0)) return false;
+      }
+      // Complex register args are parked on the stack (highest index first) so
+      // a single POP can distribute them; leaves are loaded after arg0.
+      uint8_t popMask = 0;
+      int regArgs = argc < 4 ? argc : 4;
+      for (int i = regArgs - 1; i >= 1; i--) {
+        if (isLeaf(args[i])) continue;
+        if (!genExpr(args[i]) || !push(0)) return false;
+        popMask |= (uint8_t)(1u << i);
+      }
+      if (regArgs > 0 && !genExpr(args[0])) return false;
+      if (popMask) {
+        int n = 0;
+        for (uint8_t m = popMask; m; m &= (uint8_t)(m - 1)) n++;
+        _pushDepth -= n;
+        if (!emit((uint16_t)(0xBC00 | popMask))) return false;
+      }
+      for (int i = 1; i < regArgs; i++) {
+        if (isLeaf(args[i]) && !loadLeaf(args[i], (uint8_t)i)) return false;
+      }
+      if (!emitCall(nd.v)) return false;
+      if (stackArgs) {
+        _pushDepth -= stackArgs;
+        if (!emit((uint16_t)(0xB000 | stackArgs))) return false;  // ADD SP,#4*n
+      }
+      return true;
+    }
+
+    // SIO store: [sio + off] = value (r1 holds the base).
+    bool genSioStore(int arg, uint8_t off) {
+      uint8_t rv;
+      if (!operandA(arg, rv) || !loadImm(1, (int32_t)c.regs().sioBase)) return false;
+      return emit(encStrImm(rv, 1, off));
+    }
+
+    bool genIntrinsic(const Node& nd) {
+      const ChipRegs& cr = c.regs();
+      int a0 = nd.a;
+      int a1 = (a0 >= 0) ? _nodes[a0].next : -1;
+      switch (nd.v) {
+        case IN_GPIO_SET: return genSioStore(a0, cr.gpioSet);
+        case IN_GPIO_CLR: return genSioStore(a0, cr.gpioClr);
+        case IN_GPIO_XOR: return genSioStore(a0, cr.gpioXor);
+        case IN_GPIO_OUT: return genSioStore(a0, cr.gpioOut);
+        case IN_GPIO_OE_SET: return genSioStore(a0, cr.oeSet);
+        case IN_GPIO_OE_CLR: return genSioStore(a0, cr.oeClr);
+        case IN_GPIO_IN:
+          return loadImm(0, (int32_t)cr.sioBase) && emit(encLdrImm(0, 0, cr.gpioIn));
+        case IN_TIME_US:
+          return loadImm(0, (int32_t)cr.timerawl) && emit(encLdrImm(0, 0, 0));
+        case IN_GPIO_INIT:
+          {
+            // CTRL[pin] = 5 (FUNCSEL_SIO)
+            uint8_t rp;
+            if (!operandA(a0, rp)) return false;
+            if (!emit(encLslsImm(1, rp, 3)) || !loadImm(2, (int32_t)cr.ioBank0Ctrl0) || !emit(encAddsReg(1, 1, 2))) return false;
+            if (!emit(encMovsImm(2, 5)) || !emit(encStrImm(2, 1, 0))) return false;
+            if (!cr.padIsoClr0) return true;
+            // PADS[pin].ISO (bit 8) cleared through the atomic-clear alias
+            if (!emit(encLslsImm(1, rp, 2)) || !loadImm(2, (int32_t)cr.padIsoClr0) || !emit(encAddsReg(1, 1, 2))) return false;
+            return emit(encMovsImm(2, 1)) && emit(encLslsImm(2, 2, 8)) && emit(encStrImm(2, 1, 0));
+          }
+        case IN_BUSY_WAIT:
+          {
+            // SUBS (1) + taken BGT (2): 3 cycles per round, at least one round
+            int lLoop = newLabel();
+            uint8_t r;
+            if (!operandA(a0, r) || !mov(0, r) || !placeLabel(lLoop)) return false;
+            return emit(encSubsImm(0, 3)) && emitBcc(C_GT, lLoop);
+          }
+        case IN_MMIO_READ:
+          if (isNum(a0) && ((uint32_t)_nodes[a0].v & 3u) == 0) {
+            // constant address: fold the low bits into the LDR offset
+            uint32_t addr = (uint32_t)_nodes[a0].v;
+            uint8_t off = (uint8_t)(addr & 0x7C);
+            return loadImm(0, (int32_t)(addr - off)) && emit(encLdrImm(0, 0, off));
+          }
+          return genExpr(a0) && emit(encLdrImm(0, 0, 0));
+        case IN_MMIO_WRITE:
+          if (isLeaf(a0)) {
+            uint8_t rv;
+            if (!operandA(a1, rv) || !loadLeaf(a0, 1)) return false;
+            return emit(encStrImm(rv, 1, 0));
+          }
+          if (!genExpr(a1) || !push(0) || !genExpr(a0) || !pop(1)) return false;
+          return emit(encStrImm(1, 0, 0));
+        default:
+          return fail("unsupported intrinsic", nd.pos);
+      }
+    }
+
+    // Flags for "a <op> b" (CMP); returns the condition that means true.
+    bool genCompare(int a, int b, NodeKind k, uint8_t& cond) {
+      static const uint8_t conds[] = { C_EQ, C_NE, C_LT, C_LE, C_GT, C_GE };
+      cond = conds[k - N_EQ];
+      uint8_t rn, rm;
+      if (isNum(b)) {
+        uint32_t u = (uint32_t)_nodes[b].v;
+        if (u <= 255) {
+          if (!operandA(a, rn)) return false;
+          return emit(encCmpImm(rn, (uint8_t)u));
+        }
+        int m = _t2 ? modImm(u) : -1;
+        if (m >= 0) return operandA(a, rn) && emitT2Imm(T2_CMP, 15, rn, m);
+        m = _t2 ? modImm(0u - u) : -1;
+        if (m >= 0) return operandA(a, rn) && emitT2Imm(T2_CMN, 15, rn, m);
+      }
+      if (isLeaf(b)) {
+        if (!operandA(a, rn) || !operandB(b, rm)) return false;
+        return emit(encDp(DP_CMP, rn, rm));
+      }
+      if (isLeaf(a)) {
+        if (!genExpr(b)) return false;
+        if (!regOf(a, rn)) {
+          rn = 1;
+          if (!loadLeaf(a, 1)) return false;
+        }
+        return emit(encDp(DP_CMP, rn, 0));
+      }
+      if (!genExpr(b) || !push(0) || !genExpr(a) || !pop(1)) return false;
+      return emit(encDp(DP_CMP, 0, 1));
+    }
+
+    // Jump to 'label' when (n != 0) == jumpIf, otherwise fall through.
+    bool genBranch(int n, int label, bool jumpIf) {
+      if (!genDepth(n)) return false;
+      bool ok = genBranchInner(n, label, jumpIf);
+      _nesting--;
+      return ok;
+    }
+
+    bool genBranchInner(int n, int label, bool jumpIf) {
+      const Node& nd = _nodes[n];
+      switch (nd.k) {
+        case N_NUM:
+          if ((nd.v != 0) == jumpIf) return emitB(label);
+          return true;
+        case N_LNOT:
+          return genBranch(nd.a, label, !jumpIf);
+        case N_LAND:
+        case N_LOR:
+          {
+            bool isAnd = (nd.k == N_LAND);
+            if (isAnd != jumpIf) {
+              // && jumping on false / || jumping on true: either side decides
+              return genBranch(nd.a, label, jumpIf) && genBranch(nd.b, label, jumpIf);
+            }
+            int skip = newLabel();
+            return genBranch(nd.a, skip, !jumpIf) && genBranch(nd.b, label, jumpIf) && placeLabel(skip);
+          }
+        case N_EQ:
+        case N_NE:
+        case N_LT:
+        case N_LE:
+        case N_GT:
+        case N_GE:
+          {
+            if (_t2 && (nd.k == N_EQ || nd.k == N_NE) && isNum(nd.b, 0)) {
+              uint8_t r;
+              return operandA(nd.a, r) && emitZeroBranch(r, (nd.k == N_NE) == jumpIf, label);
+            }
+            uint8_t cond;
+            if (!genCompare(nd.a, nd.b, nd.k, cond)) return false;
+            return emitBcc(jumpIf ? cond : (uint8_t)(cond ^ 1), label);
+          }
+        default:
+          {
+            uint8_t r;
+            return operandA(n, r) && emitZeroBranch(r, jumpIf, label);
+          }
+      }
+    }
+
+    // Assignment whose value is not needed: write straight into a register home.
+    bool genAssignStmt(const Node& nd) {
+      int8_t rv = _vars[nd.v].reg;
+      if (rv < 0) return genExpr(nd.a) && storeVar(nd.v, 0);
+      uint8_t rd = (uint8_t)rv;
+      int e = nd.a;
+      const Node& en = _nodes[e];
+      uint8_t ra, rb;
+      if (isLeaf(e)) return loadLeaf(e, rd);
+      if ((en.k == N_ADD || en.k == N_SUB) && regOf(en.a, ra)) {
+        if (isNum(en.b)) {
+          int32_t cv = _nodes[en.b].v;
+          bool sub = (en.k == N_SUB);
+          if (cv < 0 && cv > -256) {
+            cv = -cv;
+            sub = !sub;
+          }
+          if (cv >= 0 && cv <= 7) return emit(sub ? encSubsImm3(rd, ra, (uint8_t)cv) : encAddsImm3(rd, ra, (uint8_t)cv));
+          if (cv >= 0 && cv <= 255 && ra == rd) return emit(sub ? encSubsImm(rd, (uint8_t)cv) : encAddsImm(rd, (uint8_t)cv));
+        } else if (regOf(en.b, rb)) {
+          return emit(en.k == N_SUB ? encSubsReg(rd, ra, rb) : encAddsReg(rd, ra, rb));
+        }
+      }
+      if ((en.k == N_AND || en.k == N_OR || en.k == N_XOR || en.k == N_MUL) && regOf(en.a, ra) && regOf(en.b, rb) && (ra == rd || rb == rd)) {
+        DpOp op = (en.k == N_MUL) ? DP_MUL : (en.k == N_AND) ? DP_AND : (en.k == N_OR) ? DP_ORR : DP_EOR;
+        return emit(encDp(op, rd, ra == rd ? rb : ra));
+      }
+      if ((en.k == N_SHL || en.k == N_SHR) && regOf(en.a, ra) && isNum(en.b) && (uint32_t)_nodes[en.b].v - 1u < 31u) {
+        uint8_t sh = (uint8_t)_nodes[en.b].v;
+        return emit(en.k == N_SHL ? encLslsImm(rd, ra, sh) : encAsrsImm(rd, ra, sh));
+      }
+      return genExpr(e) && mov(rd, 0);
+    }
+
+    // Expression evaluated for side effects only.
+    bool genDiscard(int e) {
+      const Node& en = _nodes[e];
+      if (en.k == N_ASSIGN) return genAssignStmt(en);
+      if (en.k == N_PREINC || en.k == N_POSTINC) {
+        int8_t r = _vars[en.v].reg;
+        if (r >= 0) return emit(en.b > 0 ? encAddsImm((uint8_t)r, 1) : encSubsImm((uint8_t)r, 1));
+        return genExpr(e);
+      }
+      if (!c.hasSideEffects(e)) return true;
+      if (en.k == N_COND) {
+        int lElse = newLabel(), lEnd = newLabel();
+        return genBranch(en.a, lElse, false) && genDiscard(en.b) && emitB(lEnd) && placeLabel(lElse) && genDiscard(en.v) && placeLabel(lEnd);
+      }
+      return genExpr(e);
+    }
+
+    bool genStmt(int s) {
+      if (!genDepth(s)) return false;
+      bool ok = genStmtInner(s);
+      _nesting--;
+      return ok;
+    }
+
+    bool genStmtInner(int s) {
+      const Node& nd = _nodes[s];
+      switch (nd.k) {
+        case N_NOP:
+          return true;
+        case N_BLOCK:
+          for (int ch = nd.a; ch >= 0; ch = _nodes[ch].next) {
+            if (!genStmt(ch)) return false;
+          }
+          return true;
+        case N_EXPR:
+          return genDiscard(nd.a);
+        case N_RETURN:
+          if (nd.a >= 0) {
+            if (!genExpr(nd.a)) return false;
+          } else if (!emit(encMovsImm(0, 0))) {
+            return false;
+          }
+          return emitB(_retLabel);
+        case N_BREAK:
+          return emitB(_breakLabel[_nloops - 1]);
+        case N_CONTINUE:
+          return emitB(_contLabel[_nloops - 1]);
+        case N_IF:
+          {
+            int lElse = newLabel();
+            if (!genBranch(nd.a, lElse, false) || !genStmt(nd.b)) return false;
+            if (nd.v < 0) return placeLabel(lElse);
+            int lEnd = newLabel();
+            return emitB(lEnd) && placeLabel(lElse) && genStmt(nd.v) && placeLabel(lEnd);
+          }
+        case N_WHILE:
+        case N_FOR:
+          {
+            // rotated loop: jump to the test, body, step, test -> body
+            int cond = nd.a;
+            int lTop = newLabel(), lCond = newLabel(), lBreak = newLabel();
+            int lCont = (nd.k == N_FOR && nd.v >= 0) ? newLabel() : lCond;
+            if (!genLoop(lBreak, lCont)) return false;
+            bool forever = (cond < 0) || (isNum(cond) && _nodes[cond].v != 0);
+            if (cond >= 0 && isNum(cond) && _nodes[cond].v == 0) {
+              _nloops--;
+              return true;  // never runs
+            }
+            if (!forever && !emitB(lCond)) return false;
+            if (!placeLabel(lTop) || !genStmt(nd.b)) return false;
+            if (lCont != lCond && (!placeLabel(lCont) || !genStmt(nd.v))) return false;
+            if (!placeLabel(lCond)) return false;
+            if (forever ? !emitB(lTop) : !genBranch(cond, lTop, true)) return false;
+            _nloops--;
+            return placeLabel(lBreak);
+          }
+        case N_DO:
+          {
+            int lTop = newLabel(), lCont = newLabel(), lBreak = newLabel();
+            if (!genLoop(lBreak, lCont)) return false;
+            if (!placeLabel(lTop) || !genStmt(nd.a) || !placeLabel(lCont) || !genBranch(nd.b, lTop, true)) return false;
+            _nloops--;
+            return placeLabel(lBreak);
+          }
+        default:
+          return fail("unsupported statement", nd.pos);
+      }
+    }
+
+    // ---- Functions ----
+
+    // Give the four heaviest variables r4-r7, the rest SP slots.
+    void allocateHomes() {
+      _nslots = 0;
+      _savedMask = 0;
+      for (int r = 4; r <= 7; r++) {
+        int best = -1;
+        for (int i = 0; i < c._nvars; i++) {
+          if (_vars[i].reg >= 0 || _vars[i].weight == 0) continue;
+          if (best < 0 || _vars[i].weight > _vars[best].weight) best = i;
+        }
+        if (best < 0) break;
+        _vars[best].reg = (int8_t)r;
+        _savedMask |= (uint8_t)(1u << r);
+      }
+      for (int i = 0; i < c._nvars; i++) {
+        if (_vars[i].reg < 0 && _vars[i].weight > 0) _vars[i].slot = (int16_t)_nslots++;
+      }
+    }
+
+    bool genFunction(int body) {
+      beginFunction();
+      _pushDepth = 0;
+      _retLabel = newLabel();
+
+      // prologue
+      if (!emit((uint16_t)(0xB500 | _savedMask))) return false;
+      if (_nslots > 127) return fail("too many stack variables", c._retPos);
+      if (_nslots && !emit((uint16_t)(0xB080 | _nslots))) return false;  // SUB SP
+      int saved = 1;
+      for (uint8_t m = _savedMask; m; m &= (uint8_t)(m - 1)) saved++;
+      for (int i = 0; i < c._nparams && i < 4; i++) {
+        if (_vars[i].weight && !storeVar(i, (uint8_t)i)) return false;
+      }
+      for (int i = 4; i < c._nparams; i++) {
+        if (!_vars[i].weight) continue;
+        int w = _nslots + saved + (i - 4);
+        int8_t r = _vars[i].reg;
+        if (!emit(encLdrSp(r >= 0 ? (uint8_t)r : 0, (uint8_t)w))) return false;
+        if (r < 0 && !storeVar(i, 0)) return false;
+      }
+
+      if (!genStmt(body)) return false;
+      // falling off the end returns 0
+      if (_ninsn == 0 || _insns[_ninsn - 1].kind != IK_B || _insns[_ninsn - 1].val != _retLabel) {
+        if (!emit(encMovsImm(0, 0))) return false;
+      }
+      if (!placeLabel(_retLabel)) return false;
+      if (_nslots && !emit((uint16_t)(0xB000 | _nslots))) return false;  // ADD SP
+      if (!emit((uint16_t)(0xBD00 | _savedMask))) return false;
+
+      if (c._opt.peephole) peephole();
+      return true;
+    }
+
+    // Entry stub when main is not the first function: tail-jump to main with
+    // r0-r3 and lr intact (PC-relative, so the blob stays position independent).
+    //   sub sp,#8; str r0,[sp]; ldr r0,=main-(.+6); add r0,pc; str r0,[sp,#4]; pop {r0,pc}
+    static const uint32_t STUB_SIZE = 16;
+
+    bool startFunctionOutput(int f) {
+      if (c._stats.functions == 0 && !c.isMain(f)) {
+        if (c._outCap < STUB_SIZE) return fail("output buffer too small", c._retPos);
+        memset(c._out, 0, STUB_SIZE);
+        c._outSz = STUB_SIZE;
+        _haveStub = true;
+        c._stats.codeBytes += 12;
+        c._stats.poolBytes += 4;
+        c._stats.insns += 6;
+        c._stats.cycles += 1 + 2 + 2 + 1 + 2 + 5;
+      }
+      c._stats.functions++;
+      return true;
+    }
+
+    // Shift-subtract signed divide: r0 = r0 / r1, r1 = r0 % r1 (C truncation).
+    bool emitDivHelper() {
+      beginFunction();
+      int lNonZero = newLabel(), lLoop = newLabel(), lSkip = newLabel();
+      bool ok = emit(0xB510)                                                                                     // push {r4,lr}
+                && emit(encCmpImm(1, 0)) && emitBcc(C_NE, lNonZero) && mov(1, 0) && emit(encMovsImm(0, 0)) && emit(0xBD10)  // d == 0
+                && placeLabel(lNonZero) && emit(encAsrsImm(2, 0, 31))                                                    // r2 = sign(n)
+                && emit(encAsrsImm(3, 1, 31))                                                                            // r3 = sign(d)
+                && emit(encDp(DP_EOR, 0, 2)) && emit(encSubsReg(0, 0, 2))                                                // r0 = |n|
+                && emit(encDp(DP_EOR, 1, 3)) && emit(encSubsReg(1, 1, 3))                                                // r1 = |d|
+                && emit(encDp(DP_EOR, 3, 2))                                                                             // r3 = sign(q)
+                && emit(0xB40C)                                                                                          // push {r2,r3}
+                && emit(encMovsImm(2, 0)) && emit(encMovsImm(3, 0)) && emit(encMovsImm(4, 32)) && placeLabel(lLoop)      // q, rem, count
+                && emit(encLslsImm(0, 0, 1)) && emit(encDp(DP_ADC, 3, 3))                                                // rem = rem<<1 | top bit of n
+                && emit(encLslsImm(2, 2, 1)) && emit(encDp(DP_CMP, 3, 1)) && emitBcc(C_LO, lSkip) && emit(encSubsReg(3, 3, 1)) && emit(encAddsImm(2, 1)) && placeLabel(lSkip) && emit(encSubsImm(4, 1)) && emitBcc(C_NE, lLoop) && mov(0, 2) && mov(1, 3) && emit(0xBC0C)  // pop {r2,r3}
+                && emit(encDp(DP_EOR, 0, 3)) && emit(encSubsReg(0, 0, 3))                                                // apply sign(q)
+                && emit(encDp(DP_EOR, 1, 2)) && emit(encSubsReg(1, 1, 2))                                                // rem takes sign(n)
+                && emit(0xBD10);                                                                                         // pop {r4,pc}
+      if (!ok) return false;
+      _funcs[_divFunc].defined = true;
+      c._stats.functions++;
+      return layoutFunction(_divFunc);
+    }
+
+    // ---- Peephole ----
+
+    static bool isSingleReg(uint32_t hw, uint16_t op, uint8_t& r) {
+      uint32_t m = hw & 0xFF;
+      if ((hw & 0xFF00) != op || m == 0 || (m & (m - 1)) != 0) return false;
+      r = (uint8_t)log2Exact(m);
+      return true;
+    }
+    // Instruction fully overwrites rd without reading anything (MOVS #imm, LDR literal/SP).
+    static bool isPureLoad(const Insn& in, uint8_t& rd) {
+      if (in.kind == IK_LDRLIT || (in.kind == IK_HW && ((in.op & 0xF800) == 0x2000 || (in.op & 0xF800) == 0x9800))) {
+        rd = (uint8_t)((in.op >> 8) & 7);
+        return true;
+      }
+      return false;
+    }
+    // Last write of the instruction is to r0 and it sets Z from that value.
+    static bool setsZOfR0(const Insn& in) {
+      if (in.kind != IK_HW) return false;
+      uint32_t hw = in.op;
+      if (hw < 0x2000) return (hw & 7) == 0;                                                  // shifts, ADDS/SUBS reg/imm3
+      if ((hw & 0xF000) == 0x2000 || (hw & 0xF000) == 0x3000) return ((hw >> 8) & 7) == 0 && (hw & 0xF800) != 0x2800;  // MOVS/ADDS/SUBS imm8
+      if ((hw & 0xFC00) == 0x4000) {
+        uint8_t op = (hw >> 6) & 15;
+        return (hw & 7) == 0 && op != DP_TST && op != DP_CMP && op != 11;
+      }
+      return false;
+    }
+
+    void peephole() {
+      bool changed = true;
+      int rounds = 0;
+      while (changed && rounds++ < 32) {
+        changed = false;
+        dropDeadLabels(changed);
+        for (int i = 0; i < _ninsn; i++) {
+          Insn& a = _insns[i];
+          if (a.kind == IK_DEAD || a.kind == IK_LABEL) continue;
+          // Single-instruction no-ops: MOVS rX,rX / ADDS rX,#0 / SUBS rX,#0
+          if (a.kind == IK_HW && (((a.op & 0xFFC0) == 0x0000 && ((a.op >> 3) & 7) == (a.op & 7)) || (a.op & 0xF0FF) == 0x3000)) {
+            a.kind = IK_DEAD;
+            changed = true;
+            continue;
+          }
+          if (tidyBranch(i, changed)) continue;
+          int j = nextLive(i);
+          if (j < 0) break;
+          Insn& b = _insns[j];
+          uint8_t ra, rb;
+          if (a.kind == IK_HW && b.kind == IK_HW && isSingleReg(a.op, 0xB400, ra) && isSingleReg(b.op, 0xBC00, rb)) {
+            // PUSH{rX};POP{rX} -> nothing, PUSH{rX};POP{rY} -> MOVS rY,rX
+            if (ra == rb) b.kind = IK_DEAD;
+            else b.op = encMovsReg(rb, ra);
+            a.kind = IK_DEAD;
+            changed = true;
+            continue;
+          }
+          if (isPureLoad(a, ra) && isPureLoad(b, rb) && ra == rb) {
+            a.kind = IK_DEAD;  // first load is dead
+            changed = true;
+            continue;
+          }
+          if (a.kind == IK_HW && b.kind == IK_HW && (a.op & 0xF800) == 0x9000 && (b.op & 0xF800) == 0x9800 && (a.op & 0x7FF) == (b.op & 0x7FF)) {
+            b.kind = IK_DEAD;  // STR rX,[sp,#o]; LDR rX,[sp,#o]
+            changed = true;
+            continue;
+          }
+          if (a.kind == IK_HW && b.kind == IK_HW && (a.op & 0xFFC0) == 0x4240 && a.op == b.op && ((a.op >> 3) & 7) == (a.op & 7)) {
+            a.kind = b.kind = IK_DEAD;  // NEGS rX,rX twice
+            changed = true;
+            continue;
+          }
+          if (a.kind == IK_HW && b.kind == IK_HW && (a.op & 0xFFC0) == 0x0000 && (b.op & 0xFFC0) == 0x0000 && ((a.op >> 3) & 7) == (b.op & 7) && (a.op & 7) == ((b.op >> 3) & 7)) {
+            b.kind = IK_DEAD;  // MOVS rY,rX ; MOVS rX,rY
+            changed = true;
+            continue;
+          }
+          if (setsZOfR0(a) && b.kind == IK_HW && b.op == encCmpImm(0, 0)) {
+            // CMP r0,#0 after an op that already set Z from r0, when only EQ/NE is tested
+            int k = nextLive(j);
+            if (k >= 0 && _insns[k].kind == IK_BCC && _insns[k].op <= C_NE) {
+              b.kind = IK_DEAD;
+              changed = true;
+              continue;
+            }
+          }
+        }
+      }
+    }
+
+    // ---- Layout + literal pool ----
+
+    static uint8_t cyclesOf(const Insn& in) {
+      switch (in.kind) {
+        case IK_LDRLIT: return 2;
+        case IK_B: return in.size == 2 ? 2 : 3;
+        case IK_BCC: return 1;
+        case IK_CBZ: return in.size == 2 ? 1 : 2;
+        case IK_BL: return 3;
+        case IK_IT: return 3;
+        case IK_HW32: return (in.op & 0xFFF0) == 0xFB90 ? 12 : 1;  // SDIV: worst case
+        default: break;
+      }
+      uint32_t hw = in.op;
+      if ((hw & 0xFE00) == 0xB400 || (hw & 0xFE00) == 0xBC00) {
+        uint8_t n = 0;
+        for (uint32_t m = hw & 0x1FF; m; m &= m - 1) n++;
+        return (uint8_t)(1 + n + (((hw & 0xFF00) == 0xBD00) ? 2 : 0));  // POP {..,pc} refills the pipeline
+      }
+      if ((hw & 0xF000) == 0x9000 || (hw & 0xF000) == 0x6000) return 2;  // LDR/STR [sp] / [rn,#imm]
+      return 1;
+    }
+
+    bool put16(uint16_t hw) {
+      return put(hw, 2);
+    }
+    bool put32(uint32_t op) {  // two halfwords, first one in the low 16 bits
+      return put(op, 4);
+    }
+    void putWide(size_t off, uint32_t op) {
+      for (int i = 0; i < 4; i++) c._out[off + i] = (uint8_t)(op >> (8 * i));
+    }
+
+    static bool fitsB(int32_t d) {
+      return d >= -2048 && d <= 2046;
+    }
+    static bool fitsBcc(int32_t d) {
+      return d >= -256 && d <= 254;
+    }
+
+    // Relax branches, then emit the function and its literal pool at _outSz.
+    bool layoutFunction(int f) {
+      uint32_t base = (uint32_t)c._outSz;
+      _funcs[f].off = base;
+      uint32_t* labelOff = c._labelOff;
+      bool grown = true;
+      while (grown) {
+        grown = false;
+        uint32_t off = base;
+        for (int i = 0; i < _ninsn; i++) {
+          if (_insns[i].kind == IK_LABEL) labelOff[_insns[i].val] = off;
+          if (_insns[i].kind != IK_DEAD) off += _insns[i].size;
+        }
+        off = base;
+        for (int i = 0; i < _ninsn; i++) {
+          Insn& in = _insns[i];
+          if (in.kind == IK_DEAD) continue;
+          if (in.kind == IK_B || in.kind == IK_BCC || in.kind == IK_CBZ) {
+            // B/Bcc/BL at 'off' see PC = off + 4; the long Bcc forms branch from off + 2
+            int32_t d = (int32_t)labelOff[in.val] - (int32_t)(off + 4);
+            uint8_t need;
+            if (in.kind == IK_B) need = fitsB(d) ? 2 : 4;
+            else if (in.kind == IK_CBZ) need = (d >= 0 && d <= 126) ? 2 : (fitsBcc(d - 2) ? 4 : 6);  // CMP + Bcc / Bcc.W
+            else if (_t2) need = fitsBcc(d) ? 2 : 4;
+            else need = fitsBcc(d) ? 2 : fitsB(d - 2) ? 4 : 6;
+            if (need > in.size) {
+              in.size = need;
+              grown = true;
+            }
+          }
+          off += in.size;
+        }
+      }
 
-      size_t litAddr = poolBase + (size_t)litIdx * 4;
-      if (litAddr < pcAligned) return fail("literal pool placed before reference (unexpected)", instrAddr);
-      size_t byteDiff = litAddr - pcAligned;
-      if ((byteDiff % 4) != 0) return fail("literal pool misalignment", instrAddr);
-      size_t imm8 = byteDiff / 4;
-      if (imm8 > 255) return fail("literal too far (imm8 overflow)", instrAddr);
+      for (int i = 0; i < _ninsn; i++) {
+        Insn& in = _insns[i];
+        if (in.kind == IK_DEAD || in.kind == IK_LABEL) continue;
+        uint32_t at = (uint32_t)c._outSz;
+        c._stats.insns++;
+        c._stats.cycles += cyclesOf(in);
+        switch (in.kind) {
+          case IK_HW:
+            if (!put16((uint16_t)in.op)) return false;
+            break;
+          case IK_HW32:
+            if (!put32(in.op)) return false;
+            break;
+          case IK_IT:
+            if (!put32(in.op) || !put16((uint16_t)in.val)) return false;
+            break;
+          case IK_LDRLIT:
+            if (findOrAddLiteral(in.val) < 0) return fail("literal pool full", c._retPos);
+            if (!put16((uint16_t)in.op)) return false;
+            break;
+          case IK_B:
+            {
+              int32_t d = (int32_t)labelOff[in.val] - (int32_t)(at + 4);
+              if (in.size == 2) {
+                if (!put16((uint16_t)(0xE000 | ((d >> 1) & 0x7FF)))) return false;
+              } else if (!put32(encBranch32(d, _t2 ? 0x9000 : 0xD000))) {  // B.W / BL
+                return false;
+              }
+              break;
+            }
+          case IK_BCC:
+          case IK_CBZ:
+            {
+              uint8_t cond = (uint8_t)in.op;
+              if (in.kind == IK_CBZ) {
+                int32_t d = (int32_t)labelOff[in.val] - (int32_t)(at + 4);
+                if (in.size == 2) {
+                  if (!put16((uint16_t)(in.op | ((d >> 6) & 1) << 9 | ((d >> 1) & 31) << 3))) return false;
+                  break;
+                }
+                // CMP rn,#0 then the Bcc forms below, one halfword later
+                if (!put16(encCmpImm((uint8_t)(in.op & 7), 0))) return false;
+                cond = (in.op & 0x800) ? C_NE : C_EQ;
+                at += 2;
+              }
+              uint8_t size = (in.kind == IK_CBZ) ? (uint8_t)(in.size - 2) : in.size;
+              int32_t d = (int32_t)labelOff[in.val] - (int32_t)(at + 4);
+              if (size == 2) {
+                if (!put16((uint16_t)(0xD000 | (cond << 8) | ((d >> 1) & 0xFF)))) return false;
+              } else if (_t2) {
+                if (!put32(encBccW(cond, d))) return false;
+              } else if (size == 4) {
+                // B!cc over a B
+                d -= 2;
+                if (!put16((uint16_t)(0xD000 | ((cond ^ 1) << 8) | 0)) || !put16((uint16_t)(0xE000 | ((d >> 1) & 0x7FF)))) return false;
+              } else {
+                // B!cc over a BL (LR was saved by the prologue)
+                if (!put16((uint16_t)(0xD000 | ((cond ^ 1) << 8) | 1)) || !put32(encBranch32(d - 2, 0xD000))) return false;
+              }
+              break;
+            }
+          case IK_BL:
+            if (!callFix(at, in.val) || !put32(0)) return false;
+            break;
+          default:
+            break;
+        }
+      }
+      c._stats.codeBytes += c._outSz - base;
+      if (_nlit == 0) return true;  // no pool
+
+      // Align to 4 for the literal pool storage
+      size_t codeEnd = c._outSz;
+      while ((c._outSz & 0x3) != 0) {
+        if (!put16(0xBF00)) return false;  // NOP
+      }
+      size_t poolBase = c._outSz;
+      for (int i = 0; i < _nlit; i++) {
+        if (!put((uint32_t)c._literals[i], 4)) return false;
+      }
+      c._stats.poolBytes += c._outSz - codeEnd;
+
+      // Fix up all LDR literal imm8 fields: PC for Thumb is instr address + 4, aligned down
+      uint32_t off = base;
+      for (int i = 0; i < _ninsn; i++) {
+        const Insn& in = _insns[i];
+        if (in.kind == IK_DEAD) continue;
+        if (in.kind == IK_LDRLIT) {
+          int litIdx = findOrAddLiteral(in.val);
+          size_t pcAligned = (off + 4) & ~((size_t)3);
+          size_t imm8 = (poolBase + (size_t)litIdx * 4 - pcAligned) / 4;
+          if (imm8 > 255) {
+            _poolOverflow = true;
+            return false;
+          }
+          c._out[off] = (uint8_t)imm8;
+        }
+        off += in.size;
+      }
+      return true;
+    }
+  };
 
-      // LDR literal T1 encoding at instrOffset:
-      // opcode 01001 Rt imm8 => base halfword = 0x4800 | (Rt<<8) | imm8
-      // Here Rt==r0, so we need to set low 8 bits to imm8.
-      uint16_t hw = (uint16_t)(_out[instrAddr] | (_out[instrAddr + 1] << 8));
-      hw = (uint16_t)((hw & 0xFF00) | (uint16_t)imm8);
-      _out[instrAddr] = (uint8_t)(hw & 0xFF);
-      _out[instrAddr + 1] = (uint8_t)(hw >> 8);
+  // ---------------- Xtensa LX7 (ESP32-S3) ----------------
+  // Windowed ABI: every function starts with ENTRY and returns with RETW,
+  // calls are CALL8 (args in a10-a15, result back in a10; the callee sees
+  // them as a2-a7 / returns in a2). a2-a7 survive calls and hold the six
+  // heaviest variables; a8-a15 are expression temporaries, spilled to the
+  // frame around calls.
+  class XtensaBackend : public Backend {
+  public:
+    explicit XtensaBackend(MCCompiler& comp)
+      : Backend(comp) {}
+
+    bool emitFunction(int f, int body) override {
+      allocateHomes();
+      if (!genFunction(body)) return false;
+      c._stats.functions++;
+      return layoutFunction(f);
     }
 
-    return true;
+    bool finishProgram(int mainF) override {
+      if (_haveStub) {
+        uint32_t j = encJ((int32_t)_funcs[mainF].off - 4);
+        for (int i = 0; i < 3; i++) c._out[i] = (uint8_t)(j >> (8 * i));
+      }
+      for (int i = 0; i < _ncalls; i++) {
+        uint32_t at = c._calls[i].off;
+        int32_t disp = (int32_t)_funcs[c._calls[i].func].off - (int32_t)((at & ~3u) + 4);
+        if (disp < -(1 << 19) || disp >= (1 << 19)) return fail("call out of range", c._retPos);
+        uint32_t op = 0x25u | (((uint32_t)disp >> 2) & 0x3FFFF) << 6;  // CALL8
+        for (int k = 0; k < 3; k++) c._out[at + k] = (uint8_t)(op >> (8 * k));
+      }
+      return true;
+    }
+
+  protected:
+    bool isBarrier(const Insn& in) const override {
+      return in.kind == IK_B || (in.kind == IK_HW && in.op == OP_RETW);
+    }
+    void invertBranch(Insn& in) const override {
+      in.op ^= ((in.op & 0xF) == 7) ? 0x8000u : 0x40u;  // BEQ<->BNE.., BEQZ<->BNEZ.., BEQI<->BNEI..
+    }
+
+  private:
+    static const uint8_t SP = 1;
+    static const uint8_t RV = 2;     // return value (a2 of this window)
+    static const uint8_t ARG0 = 10;  // first outgoing argument / call result
+    static const uint8_t TEMP0 = 8;  // a8-a15: temporaries
+    static const int AREA_SIZE = 64;  // per call level: a8-a15 spill + 8 parked args
+    static const uint32_t OP_RETW = 0x000090;
+    static const uint32_t OP_MEMW = 0x0020C0;
+
+    // ESP32-S3 registers used by the intrinsics (GPIO 0-31)
+    static const uint32_t GPIO_BASE = 0x60004000u;
+    static const uint8_t GPIO_OUT = 0x04, GPIO_W1TS = 0x08, GPIO_W1TC = 0x0C;
+    static const uint8_t GPIO_EN_W1TS = 0x24, GPIO_EN_W1TC = 0x28, GPIO_IN = 0x3C;
+    static const uint32_t GPIO_FUNC0_OUT_SEL = 0x60004554u;  // 4 bytes per pin, 0x100 = GPIO_OUT
+    static const uint32_t IO_MUX_GPIO0 = 0x60009004u;        // 4 bytes per pin
+    static const uint32_t IO_MUX_GPIO_CFG = 0x1A00;          // MCU_SEL 1 (GPIO), FUN_DRV 2, FUN_IE
+    static const uint32_t SYSTIMER_BASE = 0x60023000u;       // unit 0, 16 MHz
+    static const uint8_t SYST_OP = 0x04, SYST_HI = 0x40, SYST_LO = 0x44;
+    static const uint32_t CCOUNT = 0xEA;
+
+    uint8_t _tempMask = 0;  // a8-a15 in use
+    int _nslots = 0;
+    int _outArea = 0;    // bytes at [sp]: stack arguments of the widest call
+    int _callLevel = 0;  // calls being evaluated (argument nesting)
+    int _maxLevel = 0;
+    int _frameSize = 0;
+    int _frameFix[MAX_PARAMS];  // loads of incoming stack arguments (offset += frame size)
+    int _nframeFix = 0;
+
+    // ---- Encodings ----
+    static uint32_t rrr(uint32_t op, uint8_t r, uint8_t s, uint8_t t) {
+      return op | (uint32_t)r << 12 | (uint32_t)s << 8 | (uint32_t)t << 4;
+    }
+    // op0 = 2 loads/stores/immediates: imm8 in [23:16]
+    static uint32_t rri8(uint32_t op, uint8_t s, uint8_t t, uint32_t imm8) {
+      return op | (imm8 & 0xFF) << 16 | (uint32_t)s << 8 | (uint32_t)t << 4;
+    }
+    enum RrrOp : uint32_t { X_AND = 0x100000,
+                            X_OR = 0x200000,
+                            X_XOR = 0x300000,
+                            X_ADD = 0x800000,
+                            X_SUB = 0xC00000,
+                            X_MULL = 0x820000,
+                            X_MOVEQZ = 0x830000,
+                            X_MOVNEZ = 0x930000,
+                            X_QUOS = 0xD20000,
+                            X_REMS = 0xF20000 };
+    // Branches with a zero offset; the layout fills in the immediate.
+    enum BranchOp : uint32_t { BR_BEQ = 0x1007,
+                               BR_BNE = 0x9007,
+                               BR_BLT = 0x2007,
+                               BR_BGE = 0xA007,
+                               BR_BLTU = 0x3007,
+                               BR_BGEU = 0xB007,
+                               BR_BEQZ = 0x16,
+                               BR_BNEZ = 0x56,
+                               BR_BLTZ = 0x96,
+                               BR_BGEZ = 0xD6,
+                               BR_BEQI = 0x26,
+                               BR_BNEI = 0x66,
+                               BR_BLTI = 0xA6,
+                               BR_BGEI = 0xE6 };
+    static uint32_t encJ(int32_t disp) {  // from the instruction + 4
+      return 0x06u | ((uint32_t)disp & 0x3FFFF) << 6;
+    }
+    // BEQZ-style branches (BRI12) carry 12 offset bits, all others 8.
+    static uint32_t withOffset(uint32_t op, int32_t d) {
+      if ((op & 0xF) == 6 && (op & 0x30) == 0x10) return op | ((uint32_t)d & 0xFFF) << 12;
+      return op | ((uint32_t)d & 0xFF) << 16;
+    }
+    static bool fitsBranch(uint32_t op, int32_t d) {
+      if ((op & 0xF) == 6 && (op & 0x30) == 0x10) return d >= -2048 && d <= 2047;
+      return d >= -128 && d <= 127;
+    }
+    // B4CONST index of v (BEQI/BNEI/BLTI/BGEI operand), or -1
+    static int b4const(int32_t v) {
+      static const int16_t tab[16] = { -1, 1, 2, 3, 4, 5, 6, 7, 8, 10, 12, 16, 32, 64, 128, 256 };
+      for (int i = 0; i < 16; i++)
+        if (tab[i] == v) return i;
+      return -1;
+    }
+
+    bool emit(uint32_t op) {
+      return emitInsn(IK_HW, op, 0, 3);
+    }
+    bool emitB(int label) {
+      return label >= 0 && emitInsn(IK_B, 0, label, 3);
+    }
+    bool emitBranch(uint32_t op, int label) {
+      return label >= 0 && emitInsn(IK_BCC, op, label, 3);
+    }
+    bool mov(uint8_t rd, uint8_t rs) {
+      return rd == rs || emit(rrr(X_OR, rd, rs, rs));
+    }
+    bool op3(RrrOp op, uint8_t rd, uint8_t rs, uint8_t rt) {
+      return emit(rrr(op, rd, rs, rt));
+    }
+    bool movi(uint8_t rd, int32_t v) {  // -2048..2047
+      return emit(0x00A002u | ((uint32_t)v & 0xFF) << 16 | (((uint32_t)v >> 8) & 0xF) << 8 | (uint32_t)rd << 4);
+    }
+    bool addi(uint8_t rd, uint8_t rs, int32_t v) {  // -128..127
+      return emit(rri8(0x00C002, rs, rd, (uint32_t)v));
+    }
+    bool addmi(uint8_t rd, uint8_t rs, int32_t v) {  // v * 256
+      return emit(rri8(0x00D002, rs, rd, (uint32_t)v));
+    }
+    bool slli(uint8_t rd, uint8_t rs, int sa) {  // 1..31
+      uint32_t x = 32u - (uint32_t)sa;
+      return emit(0x010000u | (x >> 4) << 20 | (uint32_t)rd << 12 | (uint32_t)rs << 8 | (x & 15) << 4);
+    }
+    bool srai(uint8_t rd, uint8_t rt, int sa) {  // 0..31
+      return emit(0x210000u | ((uint32_t)sa >> 4) << 20 | (uint32_t)rd << 12 | ((uint32_t)sa & 15) << 8 | (uint32_t)rt << 4);
+    }
+    bool srli(uint8_t rd, uint8_t rt, int sa) {  // 0..15
+      return emit(0x410000u | (uint32_t)rd << 12 | (uint32_t)sa << 8 | (uint32_t)rt << 4);
+    }
+    bool extui(uint8_t rd, uint8_t rt, int sh, int bits) {  // bits 1..16
+      return emit(0x040000u | (uint32_t)(bits - 1) << 20 | ((uint32_t)sh >> 4) << 16 | (uint32_t)rd << 12 | ((uint32_t)sh & 15) << 8 | (uint32_t)rt << 4);
+    }
+    bool l32i(uint8_t rt, uint8_t rs, int off) {
+      if (off < 0 || off > 1020) return fail("stack frame too large", c._retPos);
+      return emit(rri8(0x002002, rs, rt, (uint32_t)off >> 2));
+    }
+    bool s32i(uint8_t rt, uint8_t rs, int off) {
+      if (off < 0 || off > 1020) return fail("stack frame too large", c._retPos);
+      return emit(rri8(0x006002, rs, rt, (uint32_t)off >> 2));
+    }
+
+    // ---- Registers ----
+    int allocTemp() {
+      for (int i = 0; i < 8; i++) {
+        if (!(_tempMask & (1u << i))) {
+          _tempMask |= (uint8_t)(1u << i);
+          return TEMP0 + i;
+        }
+      }
+      return c.failN("expression too complex", c._retPos);
+    }
+    bool temp(uint8_t& r) {
+      int t = allocTemp();
+      r = (uint8_t)t;
+      return t >= 0;
+    }
+    // Free a temporary (homes and 'keep' stay).
+    void release(uint8_t r, int keep = -1) {
+      if (r >= TEMP0 && r != keep) _tempMask &= (uint8_t)~(1u << (r - TEMP0));
+    }
+
+    bool regOf(int n, uint8_t& r) const {
+      if (n < 0 || _nodes[n].k != N_VAR || _vars[_nodes[n].v].reg < 0) return false;
+      r = (uint8_t)_vars[_nodes[n].v].reg;
+      return true;
+    }
+    int slotOff(int var) const {
+      return _outArea + 4 * _vars[var].slot;
+    }
+    // Spill area of a call level: a8-a15 at +0, stack arguments at +32.
+    int areaOff(int level) const {
+      return _outArea + 4 * _nslots + AREA_SIZE * level;
+    }
+
+    bool loadImm(uint8_t rd, int32_t v) {
+      if (v >= -2048 && v <= 2047) return movi(rd, v);
+      if (c._opt.strengthReduce) {
+        // imm12 << k: MOVI + SLLI, no pool entry
+        uint32_t u = (uint32_t)v;
+        for (int sh = 1; sh < 32 && !(u & (1u << (sh - 1))); sh++) {
+          int32_t x = v >> sh;
+          if (x >= -2048 && x <= 2047) return movi(rd, x) && slli(rd, rd, sh);
+        }
+      }
+      return emitInsn(IK_LDRLIT, 0x000001u | (uint32_t)rd << 4, v, 3);  // L32R
+    }
+    bool loadLeaf(int n, uint8_t rd) {
+      const Node& nd = _nodes[n];
+      if (nd.k == N_NUM) return loadImm(rd, nd.v);
+      uint8_t r;
+      if (regOf(n, r)) return mov(rd, r);
+      return l32i(rd, SP, slotOff(nd.v));
+    }
+    bool storeVar(int var, uint8_t rs) {
+      if (_vars[var].reg >= 0) return mov((uint8_t)_vars[var].reg, rs);
+      return s32i(rs, SP, slotOff(var));
+    }
+
+    // Registers needed to evaluate n (Sethi-Ullman); calls count high so
+    // they run before other operands occupy temporaries.
+    int need(int n) const {
+      const Node& nd = _nodes[n];
+      switch (nd.k) {
+        case N_NUM: return 1;
+        case N_VAR: return _vars[nd.v].reg >= 0 ? 0 : 1;
+        case N_CALL: return 8;
+        case N_INTRIN:
+        case N_ASSIGN:
+        case N_PREINC:
+        case N_POSTINC:
+        case N_COND: return 2;
+        case N_NEG:
+        case N_BNOT:
+        case N_LNOT: return need(nd.a) > 1 ? need(nd.a) : 1;
+        default:
+          {
+            int la = need(nd.a), lb = need(nd.b);
+            if (la == lb) return la + 1;
+            return la > lb ? la : lb;
+          }
+      }
+    }
+
+    // Register holding n: a variable's home (no code) or a new temporary.
+    bool genVal(int n, uint8_t& r) {
+      if (regOf(n, r)) return true;
+      return temp(r) && genTo(n, r);
+    }
+    // Operand of a one-operand form writing rd: built in rd itself when rd
+    // is a temporary (saves a register per nesting level).
+    bool genUnary(int n, uint8_t rd, uint8_t& r) {
+      if (regOf(n, r)) return true;
+      if (rd < TEMP0) return temp(r) && genTo(n, r);
+      r = rd;
+      return genTo(n, rd);
+    }
+    // Both operands in registers, the heavier one first. The first one may
+    // be built in rd when rd is a temporary (homes are written last).
+    bool genOperands(int a, int b, int rd, uint8_t& ra, uint8_t& rb) {
+      bool swap = need(b) > need(a);
+      int first = swap ? b : a, second = swap ? a : b;
+      uint8_t r1, r2;
+      if (rd >= TEMP0 && !regOf(first, r1)) {
+        r1 = (uint8_t)rd;
+        if (!genTo(first, r1)) return false;
+      } else if (!genVal(first, r1)) {
+        return false;
+      }
+      if (!genVal(second, r2)) return false;
+      ra = swap ? r2 : r1;
+      rb = swap ? r1 : r2;
+      return true;
+    }
+
+    // Evaluate expression n into rd.
+    bool genTo(int n, uint8_t rd) {
+      if (!genDepth(n)) return false;
+      bool ok = genToInner(n, rd);
+      _nesting--;
+      return ok;
+    }
+
+    bool genToInner(int n, uint8_t rd) {
+      const Node& nd = _nodes[n];
+      switch (nd.k) {
+        case N_NUM:
+        case N_VAR:
+          return loadLeaf(n, rd);
+        case N_ASSIGN:
+          {
+            int8_t h = _vars[nd.v].reg;
+            if (h >= 0) return genTo(nd.a, (uint8_t)h) && mov(rd, (uint8_t)h);
+            return genTo(nd.a, rd) && storeVar(nd.v, rd);
+          }
+        case N_PREINC:
+        case N_POSTINC:
+          {
+            int8_t h = _vars[nd.v].reg;
+            int d = nd.b > 0 ? 1 : -1;
+            if (h >= 0) {
+              if (nd.k == N_POSTINC) return mov(rd, (uint8_t)h) && addi((uint8_t)h, (uint8_t)h, d);
+              return addi((uint8_t)h, (uint8_t)h, d) && mov(rd, (uint8_t)h);
+            }
+            if (!l32i(rd, SP, slotOff(nd.v))) return false;
+            if (nd.k == N_PREINC) return addi(rd, rd, d) && s32i(rd, SP, slotOff(nd.v));
+            uint8_t t;
+            if (!temp(t) || !addi(t, rd, d) || !s32i(t, SP, slotOff(nd.v))) return false;
+            release(t);
+            return true;
+          }
+        case N_CALL:
+          return genCall(nd, rd);
+        case N_INTRIN:
+          return genIntrinsic(nd, rd);
+        case N_COND:
+          {
+            int lElse = newLabel(), lEnd = newLabel();
+            return genBranch(nd.a, lElse, false) && genTo(nd.b, rd) && emitB(lEnd) && placeLabel(lElse) && genTo(nd.v, rd) && placeLabel(lEnd);
+          }
+        case N_NEG:
+          {
+            uint8_t r;
+            if (!genUnary(nd.a, rd, r) || !emit(0x600000u | (uint32_t)rd << 12 | (uint32_t)r << 4)) return false;  // NEG
+            release(r, rd);
+            return true;
+          }
+        case N_BNOT:
+          {
+            uint8_t r, t;
+            if (!genUnary(nd.a, rd, r) || !temp(t) || !movi(t, -1) || !op3(X_XOR, rd, r, t)) return false;
+            release(t);
+            release(r, rd);
+            return true;
+          }
+        case N_LNOT:
+          {
+            // w = 1; w = 0 if r != 0
+            uint8_t r, w, z;
+            if (!genUnary(nd.a, rd, r)) return false;
+            w = rd;
+            if (rd == r && !temp(w)) return false;
+            if (!temp(z) || !movi(w, 1) || !movi(z, 0) || !op3(X_MOVNEZ, w, z, r) || !mov(rd, w)) return false;
+            release(z);
+            release(w, rd);
+            release(r, rd);
+            return true;
+          }
+        case N_EQ:
+        case N_NE:
+          return genEqNe(nd, rd);
+        case N_LT:
+        case N_LE:
+        case N_GT:
+        case N_GE:
+        case N_LAND:
+        case N_LOR:
+          return genMaterialize(n, rd);
+        default:
+          return genBinary(nd, rd);
+      }
+    }
+
+    // Boolean value through branches: rd = cond ? 1 : 0
+    bool genMaterialize(int n, uint8_t rd) {
+      uint8_t w = rd;
+      if (rd < TEMP0 && !temp(w)) return false;  // a home may be an operand
+      int lEnd = newLabel();
+      if (!movi(w, 1) || !genBranch(n, lEnd, true) || !movi(w, 0) || !placeLabel(lEnd) || !mov(rd, w)) return false;
+      release(w, rd);
+      return true;
+    }
+
+    // == / != as values without branches: t = a - b; rd = t ? (==: 0, !=: 1) : ...
+    bool genEqNe(const Node& nd, uint8_t rd) {
+      int a = nd.a, b = nd.b;
+      if (isNum(a) && !isNum(b)) {
+        a = nd.b;
+        b = nd.a;
+      }
+      uint8_t ra, rb, t, z, w = rd;
+      int32_t cv = isNum(b) ? _nodes[b].v : 0;
+      if (c._opt.strengthReduce && isNum(b) && cv >= -127 && cv <= 128) {
+        if (!genUnary(a, rd, ra)) return false;
+        if (cv == 0) {
+          t = ra;
+        } else if (!temp(t) || !addi(t, ra, -cv)) {
+          return false;
+        }
+      } else {
+        if (!genOperands(a, b, -1, ra, rb) || !temp(t) || !op3(X_SUB, t, ra, rb)) return false;
+        release(rb);
+      }
+      if (rd == t && !temp(w)) return false;
+      if (!temp(z) || !movi(w, 1) || !movi(z, 0)) return false;
+      if (!op3(nd.k == N_EQ ? X_MOVNEZ : X_MOVEQZ, w, z, t) || !mov(rd, w)) return false;
+      release(z);
+      release(w, rd);
+      release(t, rd);
+      release(ra, rd);
+      return true;
+    }
+
+    bool genBinary(const Node& nd, uint8_t rd) {
+      NodeKind k = nd.k;
+      int a = nd.a, b = nd.b;
+      if (isCommutative(k) && isNum(a) && !isNum(b)) {
+        a = nd.b;
+        b = nd.a;
+      }
+      if (c._opt.strengthReduce && isNum(b)) {
+        bool handled = false;
+        if (!genBinaryImm(k, a, _nodes[b].v, rd, handled)) return false;
+        if (handled) return true;
+      }
+      uint8_t ra, rb;
+      if (!genOperands(a, b, rd, ra, rb)) return false;
+      if (!emitOp(k, rd, ra, rb, isNum(b) && _nodes[b].v != 0)) return false;
+      release(ra, rd);
+      release(rb, rd);
+      return true;
+    }
+
+    // rd = ra OP rb. Multi-instruction forms read both operands before the
+    // last write, so rd may be either of them.
+    bool emitOp(NodeKind k, uint8_t rd, uint8_t ra, uint8_t rb, bool nonZero) {
+      uint8_t t, z;
+      switch (k) {
+        case N_ADD: return op3(X_ADD, rd, ra, rb);
+        case N_SUB: return op3(X_SUB, rd, ra, rb);
+        case N_MUL: return op3(X_MULL, rd, ra, rb);
+        case N_AND: return op3(X_AND, rd, ra, rb);
+        case N_OR: return op3(X_OR, rd, ra, rb);
+        case N_XOR: return op3(X_XOR, rd, ra, rb);
+        case N_SHL:
+        case N_SHR:
+          {
+            // amounts 32-255 (bits 5-7 of the low byte) give 0 / the sign
+            if (!temp(t) || !temp(z) || !extui(t, rb, 5, 3)) return false;
+            if (k == N_SHL) {
+              if (!movi(z, 0) || !emit(0x401000u | (uint32_t)rb << 8) || !emit(0xA10000u | (uint32_t)rd << 12 | (uint32_t)ra << 8)) return false;  // SSL; SLL
+            } else if (!srai(z, ra, 31) || !emit(0x400000u | (uint32_t)rb << 8) || !emit(0xB10000u | (uint32_t)rd << 12 | (uint32_t)ra << 4)) {  // SSR; SRA
+              return false;
+            }
+            if (!op3(X_MOVNEZ, rd, z, t)) return false;
+            release(z);
+            release(t);
+            return true;
+          }
+        case N_DIV:
+        case N_MOD:
+          {
+            RrrOp op = (k == N_DIV) ? X_QUOS : X_REMS;
+            if (nonZero) return op3(op, rd, ra, rb);
+            // QUOS/REMS trap on zero: / gives 0, % gives the dividend
+            int lZero = newLabel();
+            if (!temp(t)) return false;
+            if (!(k == N_DIV ? movi(t, 0) : mov(t, ra))) return false;
+            if (!emitBranch(BR_BEQZ | (uint32_t)rb << 8, lZero) || !op3(op, t, ra, rb) || !placeLabel(lZero) || !mov(rd, t)) return false;
+            release(t);
+            return true;
+          }
+        default:
+          return fail("unsupported operator", c._retPos);
+      }
+    }
+
+    // Constant right operand (strength reduction). Sets handled=false to fall
+    // back to the generic register form.
+    bool genBinaryImm(NodeKind k, int a, int32_t cv, uint8_t rd, bool& handled) {
+      handled = true;
+      uint8_t ra, t;
+      uint32_t u = (uint32_t)cv;
+      switch (k) {
+        case N_ADD:
+        case N_SUB:
+          {
+            int32_t v = (k == N_SUB) ? (int32_t)(0u - u) : cv;
+            int32_t lo = (int32_t)(int8_t)(v & 0xFF), hi = (int32_t)((uint32_t)v - (uint32_t)lo) >> 8;
+            if (hi < -128 || hi > 127) break;
+            if (!genUnary(a, rd, ra)) return false;
+            if (hi == 0) {
+              if (!addi(rd, ra, lo)) return false;
+            } else if (!addmi(rd, ra, hi) || (lo && !addi(rd, rd, lo))) {
+              return false;
+            }
+            release(ra, rd);
+            return true;
+          }
+        case N_SHL:
+        case N_SHR:
+          u &= 0xFF;  // shifts use the bottom byte, like the register form
+          if (!genUnary(a, rd, ra)) return false;
+          if (u == 0) {
+            if (!mov(rd, ra)) return false;
+          } else if (k == N_SHL) {
+            if (!(u >= 32 ? movi(rd, 0) : slli(rd, ra, (int)u))) return false;
+          } else if (!srai(rd, ra, u >= 32 ? 31 : (int)u)) {
+            return false;
+          }
+          release(ra, rd);
+          return true;
+        case N_AND:
+          {
+            int lo = log2Exact(u + 1);  // 2^k - 1: keep low k bits
+            if (lo <= 0 || lo > 16) break;
+            if (!genUnary(a, rd, ra) || !extui(rd, ra, 0, lo)) return false;
+            release(ra, rd);
+            return true;
+          }
+        case N_DIV:
+        case N_MOD:
+          {
+            // signed x / 2^k == (x + (x < 0 ? 2^k - 1 : 0)) >> k
+            int sh = (cv > 1) ? log2Exact(u) : -1;
+            if (sh < 1) break;
+            if (!genUnary(a, rd, ra) || !temp(t) || !srai(t, ra, 31)) return false;
+            if (!(sh <= 16 ? extui(t, t, 0, sh) : srli(t, t, 32 - sh)) || !op3(X_ADD, t, t, ra)) return false;
+            if (k == N_DIV) {
+              if (!srai(rd, t, sh)) return false;
+            } else if (!srai(t, t, sh) || !slli(t, t, sh) || !op3(X_SUB, rd, ra, t)) {  // x - ((x + bias) & -2^k)
+              return false;
+            }
+            release(t);
+            release(ra, rd);
+            return true;
+          }
+        default:
+          break;
+      }
+      handled = false;
+      return true;
+    }
+
+    // Windowed CALL8. Temporaries live across the call go to this level's
+    // spill area. Arguments 0-5 are built straight in a10-a15 while enough
+    // temporaries stay free; the others (and 6, 7) are evaluated first and
+    // parked in the area, then loaded last (6 and 7 to [sp], which nested
+    // calls reuse).
+    bool genCall(const Node& nd, uint8_t rd) {
+      int args[MAX_PARAMS];
+      int argc = 0;
+      for (int a = nd.a; a >= 0 && argc < MAX_PARAMS; a = _nodes[a].next) args[argc++] = a;
+      int area = areaOff(_callLevel);
+      if (++_callLevel > _maxLevel) _maxLevel = _callLevel;
+      uint8_t saved = _tempMask;
+      uint8_t live = (uint8_t)(saved & ~(rd >= TEMP0 ? 1u << (rd - TEMP0) : 0u));
+      for (int i = 0; i < 8; i++) {
+        if ((live & (1u << i)) && !s32i((uint8_t)(TEMP0 + i), SP, area + 4 * i)) return false;
+      }
+      _tempMask = 0;
+      bool parked[MAX_PARAMS];
+      int direct = 0;
+      for (int i = 0; i < argc; i++) {
+        // an operator holds up to ~4 temporaries beyond its operands' need
+        parked[i] = !isLeaf(args[i]) && (i >= 6 || need(args[i]) + 4 > 8 - direct);
+        if (!parked[i] && !isLeaf(args[i])) direct++;
+      }
+      uint8_t r;
+      for (int i = 0; i < argc; i++) {
+        if (!parked[i]) continue;
+        if (!genVal(args[i], r) || !s32i(r, SP, area + 32 + 4 * i)) return false;
+        release(r);
+      }
+      int regArgs = argc < 6 ? argc : 6;
+      for (int i = 0; i < regArgs; i++) {
+        if (isLeaf(args[i]) || parked[i]) continue;
+        _tempMask |= (uint8_t)(1u << (ARG0 - TEMP0 + i));
+        if (!genTo(args[i], (uint8_t)(ARG0 + i))) return false;
+      }
+      for (int i = 6; i < argc; i++) {
+        if (isLeaf(args[i])) {
+          if (!genVal(args[i], r)) return false;
+        } else if (!temp(r) || !l32i(r, SP, area + 32 + 4 * i)) {
+          return false;
+        }
+        if (!s32i(r, SP, 4 * (i - 6))) return false;
+        release(r);
+      }
+      for (int i = 0; i < regArgs; i++) {
+        if (parked[i] && !l32i((uint8_t)(ARG0 + i), SP, area + 32 + 4 * i)) return false;
+        if (isLeaf(args[i]) && !loadLeaf(args[i], (uint8_t)(ARG0 + i))) return false;
+      }
+      if (!emitInsn(IK_BL, 0, nd.v, 3)) return false;
+      _tempMask = saved;
+      _callLevel--;
+      if (!mov(rd, ARG0)) return false;
+      for (int i = 0; i < 8; i++) {
+        if ((live & (1u << i)) && !l32i((uint8_t)(TEMP0 + i), SP, area + 4 * i)) return false;
+      }
+      return true;
+    }
+
+    // Base + offset for a constant address (L32I/S32I reach 0..1020).
+    bool constBase(uint32_t addr, uint8_t& rb, int& off) {
+      off = (int)(addr & 0x3FC);
+      return temp(rb) && loadImm(rb, (int32_t)(addr - (uint32_t)off));
+    }
+    // [GPIO_BASE + off] = value
+    bool genGpioStore(int arg, uint8_t off) {
+      uint8_t rv, rb;
+      if (!genVal(arg, rv) || !temp(rb) || !loadImm(rb, (int32_t)GPIO_BASE)) return false;
+      if (!emit(OP_MEMW) || !s32i(rv, rb, off)) return false;
+      release(rb);
+      release(rv);
+      return true;
+    }
+
+    bool genIntrinsic(const Node& nd, uint8_t rd) {
+      int a0 = nd.a;
+      int a1 = (a0 >= 0) ? _nodes[a0].next : -1;
+      uint8_t r, t, b;
+      int off;
+      switch (nd.v) {
+        case IN_GPIO_SET: return genGpioStore(a0, GPIO_W1TS);
+        case IN_GPIO_CLR: return genGpioStore(a0, GPIO_W1TC);
+        case IN_GPIO_OUT: return genGpioStore(a0, GPIO_OUT);
+        case IN_GPIO_OE_SET: return genGpioStore(a0, GPIO_EN_W1TS);
+        case IN_GPIO_OE_CLR: return genGpioStore(a0, GPIO_EN_W1TC);
+        case IN_GPIO_XOR:
+          {
+            // no XOR alias on the S3: read-modify-write GPIO_OUT
+            if (!genVal(a0, r) || !temp(b) || !temp(t) || !loadImm(b, (int32_t)GPIO_BASE)) return false;
+            if (!emit(OP_MEMW) || !l32i(t, b, GPIO_OUT) || !op3(X_XOR, t, t, r) || !emit(OP_MEMW) || !s32i(t, b, GPIO_OUT)) return false;
+            release(t);
+            release(b);
+            release(r);
+            return true;
+          }
+        case IN_GPIO_IN:
+          if (!temp(b) || !loadImm(b, (int32_t)GPIO_BASE) || !emit(OP_MEMW) || !l32i(rd, b, GPIO_IN)) return false;
+          release(b, rd);
+          return true;
+        case IN_GPIO_INIT:
+          {
+            // IO_MUX[pin] = GPIO function + input enable; FUNCn_OUT_SEL = simple GPIO output
+            uint8_t v;
+            if (!genVal(a0, r) || !temp(t) || !temp(b) || !temp(v) || !slli(t, r, 2)) return false;
+            if (!loadImm(b, (int32_t)IO_MUX_GPIO0) || !op3(X_ADD, b, b, t) || !loadImm(v, (int32_t)IO_MUX_GPIO_CFG)) return false;
+            if (!emit(OP_MEMW) || !s32i(v, b, 0)) return false;
+            if (!loadImm(b, (int32_t)GPIO_FUNC0_OUT_SEL) || !op3(X_ADD, b, b, t) || !movi(v, 0x100)) return false;
+            if (!emit(OP_MEMW) || !s32i(v, b, 0)) return false;
+            release(v);
+            release(b);
+            release(t);
+            release(r);
+            return true;
+          }
+        case IN_TIME_US:
+          {
+            // latch unit 0, wait for VALUE_VALID, then the 52-bit 16 MHz count / 16
+            int lWait = newLabel();
+            if (!temp(b) || !temp(t) || !loadImm(b, (int32_t)SYSTIMER_BASE) || !loadImm(t, 1 << 30)) return false;
+            if (!emit(OP_MEMW) || !s32i(t, b, SYST_OP) || !placeLabel(lWait)) return false;
+            if (!emit(OP_MEMW) || !l32i(t, b, SYST_OP) || !emitBranch(0x6007u | 13u << 4 | (uint32_t)t << 8 | 1u << 12, lWait)) return false;  // BBCI t,29
+            if (!emit(OP_MEMW) || !l32i(t, b, SYST_HI) || !emit(OP_MEMW) || !l32i(b, b, SYST_LO)) return false;
+            if (!slli(t, t, 28) || !srli(b, b, 4) || !op3(X_OR, rd, t, b)) return false;
+            release(t, rd);
+            release(b, rd);
+            return true;
+          }
+        case IN_BUSY_WAIT:
+          {
+            // spin until CCOUNT has advanced by n
+            int lLoop = newLabel();
+            if (!genVal(a0, r) || !temp(t) || !temp(b)) return false;
+            if (!emit(0x030000u | CCOUNT << 8 | (uint32_t)t << 4) || !placeLabel(lLoop)) return false;
+            if (!emit(0x030000u | CCOUNT << 8 | (uint32_t)b << 4) || !op3(X_SUB, b, b, t) || !emitBranch(BR_BLTU | (uint32_t)b << 8 | (uint32_t)r << 4, lLoop)) return false;
+            release(b);
+            release(t);
+            release(r);
+            return true;
+          }
+        case IN_MMIO_READ:
+          if (isNum(a0) && ((uint32_t)_nodes[a0].v & 3u) == 0) {
+            if (!constBase((uint32_t)_nodes[a0].v, b, off) || !emit(OP_MEMW) || !l32i(rd, b, off)) return false;
+            release(b, rd);
+            return true;
+          }
+          if (!genVal(a0, r) || !emit(OP_MEMW) || !l32i(rd, r, 0)) return false;
+          release(r, rd);
+          return true;
+        case IN_MMIO_WRITE:
+          {
+            uint8_t rv;
+            if (!genVal(a1, rv)) return false;
+            off = 0;
+            if (isNum(a0) && ((uint32_t)_nodes[a0].v & 3u) == 0) {
+              if (!constBase((uint32_t)_nodes[a0].v, b, off)) return false;
+            } else if (!genVal(a0, b)) {
+              return false;
+            }
+            if (!emit(OP_MEMW) || !s32i(rv, b, off)) return false;
+            release(b);
+            release(rv);
+            return true;
+          }
+        default:
+          return fail("unsupported intrinsic", nd.pos);
+      }
+    }
+
+    // Jump to 'label' when (n != 0) == jumpIf, otherwise fall through.
+    bool genBranch(int n, int label, bool jumpIf) {
+      if (!genDepth(n)) return false;
+      bool ok = genBranchInner(n, label, jumpIf);
+      _nesting--;
+      return ok;
+    }
+
+    bool genBranchInner(int n, int label, bool jumpIf) {
+      const Node& nd = _nodes[n];
+      uint8_t ra, rb;
+      uint32_t op;
+      switch (nd.k) {
+        case N_NUM:
+          if ((nd.v != 0) == jumpIf) return emitB(label);
+          return true;
+        case N_LNOT:
+          return genBranch(nd.a, label, !jumpIf);
+        case N_LAND:
+        case N_LOR:
+          {
+            bool isAnd = (nd.k == N_LAND);
+            if (isAnd != jumpIf) return genBranch(nd.a, label, jumpIf) && genBranch(nd.b, label, jumpIf);
+            int skip = newLabel();
+            return genBranch(nd.a, skip, !jumpIf) && genBranch(nd.b, label, jumpIf) && placeLabel(skip);
+          }
+        case N_EQ:
+        case N_NE:
+        case N_LT:
+        case N_LE:
+        case N_GT:
+        case N_GE:
+          {
+            NodeKind k = nd.k;
+            int a = nd.a, b = nd.b;
+            if (isNum(a) && !isNum(b)) {
+              a = nd.b;
+              b = nd.a;
+              k = swapCompare(k);
+            }
+            if (isNum(b)) {
+              // against a constant: BEQZ.. for 0, BEQI.. for B4CONST values
+              NodeKind kk = k;
+              int32_t cv = _nodes[b].v;
+              if ((kk == N_GT || kk == N_LE) && cv != INT32_MAX) {
+                kk = (kk == N_GT) ? N_GE : N_LT;  // x > c == x >= c+1
+                cv++;
+              }
+              int idx = b4const(cv);
+              if (cv == 0 || idx >= 0) {
+                static const uint32_t zops[4] = { BR_BEQZ, BR_BNEZ, BR_BLTZ, BR_BGEZ };
+                static const uint32_t iops[4] = { BR_BEQI, BR_BNEI, BR_BLTI, BR_BGEI };
+                int sel = kk == N_EQ ? 0 : kk == N_NE ? 1 : kk == N_LT ? 2 : 3;
+                if (!genVal(a, ra)) return false;
+                release(ra);
+                op = (cv == 0 ? zops[sel] : iops[sel] | (uint32_t)idx << 12) | (uint32_t)ra << 8;
+                return emitBranch(jumpIf ? op : op ^ 0x40, label);
+              }
+            }
+            if (!genOperands(a, b, -1, ra, rb)) return false;
+            switch (k) {
+              case N_EQ: op = BR_BEQ | (uint32_t)ra << 8 | (uint32_t)rb << 4; break;
+              case N_NE: op = BR_BNE | (uint32_t)ra << 8 | (uint32_t)rb << 4; break;
+              case N_LT: op = BR_BLT | (uint32_t)ra << 8 | (uint32_t)rb << 4; break;
+              case N_GE: op = BR_BGE | (uint32_t)ra << 8 | (uint32_t)rb << 4; break;
+              case N_GT: op = BR_BLT | (uint32_t)rb << 8 | (uint32_t)ra << 4; break;  // b < a
+              default: op = BR_BGE | (uint32_t)rb << 8 | (uint32_t)ra << 4; break;   // b >= a
+            }
+            release(ra);
+            release(rb);
+            if (!jumpIf) op ^= 0x8000;
+            return emitBranch(op, label);
+          }
+        case N_AND:
+          {
+            // x & 2^k: bit test
+            int bit = isNum(nd.b) ? log2Exact((uint32_t)_nodes[nd.b].v) : -1;
+            if (bit < 0 || !c._opt.strengthReduce) break;
+            if (!genVal(nd.a, ra)) return false;
+            release(ra);
+            op = 0x6007u | (uint32_t)(bit >> 4) << 12 | (uint32_t)ra << 8 | (uint32_t)(bit & 15) << 4;  // BBCI
+            return emitBranch(jumpIf ? op ^ 0x8000 : op, label);                                        // BBSI
+          }
+        default:
+          break;
+      }
+      if (!genVal(n, ra)) return false;
+      release(ra);
+      return emitBranch((jumpIf ? BR_BNEZ : BR_BEQZ) | (uint32_t)ra << 8, label);
+    }
+
+    // Expression evaluated for side effects only.
+    bool genDiscard(int e) {
+      const Node& en = _nodes[e];
+      uint8_t t;
+      if (en.k == N_ASSIGN) {
+        int8_t h = _vars[en.v].reg;
+        if (h >= 0) return genTo(en.a, (uint8_t)h);
+        if (!genVal(en.a, t) || !storeVar(en.v, t)) return false;
+        release(t);
+        return true;
+      }
+      if (en.k == N_PREINC || en.k == N_POSTINC) {
+        int8_t h = _vars[en.v].reg;
+        int d = en.b > 0 ? 1 : -1;
+        if (h >= 0) return addi((uint8_t)h, (uint8_t)h, d);
+        if (!temp(t) || !l32i(t, SP, slotOff(en.v)) || !addi(t, t, d) || !s32i(t, SP, slotOff(en.v))) return false;
+        release(t);
+        return true;
+      }
+      if (!c.hasSideEffects(e)) return true;
+      if (en.k == N_COND) {
+        int lElse = newLabel(), lEnd = newLabel();
+        return genBranch(en.a, lElse, false) && genDiscard(en.b) && emitB(lEnd) && placeLabel(lElse) && genDiscard(en.v) && placeLabel(lEnd);
+      }
+      if (en.k == N_CALL) return genCall(en, ARG0);  // result stays in a10
+      if (!temp(t) || !genTo(e, t)) return false;
+      release(t);
+      return true;
+    }
+
+    bool genStmt(int s) {
+      if (!genDepth(s)) return false;
+      bool ok = genStmtInner(s);
+      _nesting--;
+      return ok;
+    }
+
+    bool genStmtInner(int s) {
+      const Node& nd = _nodes[s];
+      switch (nd.k) {
+        case N_NOP:
+          return true;
+        case N_BLOCK:
+          for (int ch = nd.a; ch >= 0; ch = _nodes[ch].next) {
+            if (!genStmt(ch)) return false;
+          }
+          return true;
+        case N_EXPR:
+          return genDiscard(nd.a);
+        case N_RETURN:
+          if (nd.a >= 0) {
+            if (!genTo(nd.a, RV)) return false;
+          } else if (!movi(RV, 0)) {
+            return false;
+          }
+          return emitB(_retLabel);
+        case N_BREAK:
+          return emitB(_breakLabel[_nloops - 1]);
+        case N_CONTINUE:
+          return emitB(_contLabel[_nloops - 1]);
+        case N_IF:
+          {
+            int lElse = newLabel();
+            if (!genBranch(nd.a, lElse, false) || !genStmt(nd.b)) return false;
+            if (nd.v < 0) return placeLabel(lElse);
+            int lEnd = newLabel();
+            return emitB(lEnd) && placeLabel(lElse) && genStmt(nd.v) && placeLabel(lEnd);
+          }
+        case N_WHILE:
+        case N_FOR:
+          {
+            // rotated loop: jump to the test, body, step, test -> body
+            int cond = nd.a;
+            int lTop = newLabel(), lCond = newLabel(), lBreak = newLabel();
+            int lCont = (nd.k == N_FOR && nd.v >= 0) ? newLabel() : lCond;
+            if (!genLoop(lBreak, lCont)) return false;
+            bool forever = (cond < 0) || (isNum(cond) && _nodes[cond].v != 0);
+            if (cond >= 0 && isNum(cond) && _nodes[cond].v == 0) {
+              _nloops--;
+              return true;  // never runs
+            }
+            if (!forever && !emitB(lCond)) return false;
+            if (!placeLabel(lTop) || !genStmt(nd.b)) return false;
+            if (lCont != lCond && (!placeLabel(lCont) || !genStmt(nd.v))) return false;
+            if (!placeLabel(lCond)) return false;
+            if (forever ? !emitB(lTop) : !genBranch(cond, lTop, true)) return false;
+            _nloops--;
+            return placeLabel(lBreak);
+          }
+        case N_DO:
+          {
+            int lTop = newLabel(), lCont = newLabel(), lBreak = newLabel();
+            if (!genLoop(lBreak, lCont)) return false;
+            if (!placeLabel(lTop) || !genStmt(nd.a) || !placeLabel(lCont) || !genBranch(nd.b, lTop, true)) return false;
+            _nloops--;
+            return placeLabel(lBreak);
+          }
+        default:
+          return fail("unsupported statement", nd.pos);
+      }
+    }
+
+    // ---- Functions ----
+
+    // The six heaviest variables get a2-a7 (parameters keep the register they
+    // arrive in), the rest frame slots above the outgoing arguments.
+    void allocateHomes() {
+      const int PICKED = 0;  // chosen, register not assigned yet
+      _nslots = 0;
+      for (int n = 0; n < 6; n++) {
+        int best = -1;
+        for (int i = 0; i < c._nvars; i++) {
+          if (_vars[i].reg >= 0 || _vars[i].weight == 0) continue;
+          if (best < 0 || _vars[i].weight > _vars[best].weight) best = i;
+        }
+        if (best < 0) break;
+        _vars[best].reg = PICKED;
+      }
+      uint8_t used = 0;
+      for (int i = 0; i < c._nparams && i < 6; i++) {
+        if (_vars[i].reg == PICKED) {
+          _vars[i].reg = (int8_t)(2 + i);
+          used |= (uint8_t)(1u << (2 + i));
+        }
+      }
+      for (int i = 0; i < c._nvars; i++) {
+        if (_vars[i].reg != PICKED) continue;
+        int r = 2;
+        while (used & (1u << r)) r++;
+        _vars[i].reg = (int8_t)r;
+        used |= (uint8_t)(1u << r);
+      }
+      for (int i = 0; i < c._nvars; i++) {
+        if (_vars[i].reg < 0 && _vars[i].weight > 0) _vars[i].slot = (int16_t)_nslots++;
+      }
+      // widest call decides the outgoing stack argument area
+      _outArea = 0;
+      for (int n = 0; n < c._nnodes; n++) {
+        if (_nodes[n].k != N_CALL) continue;
+        int argc = 0;
+        for (int a = _nodes[n].a; a >= 0; a = _nodes[a].next) argc++;
+        if (argc > 6 && 4 * (argc - 6) > _outArea) _outArea = 4 * (argc - 6);
+      }
+    }
+
+    bool genFunction(int body) {
+      beginFunction();
+      _tempMask = 0;
+      _callLevel = 0;
+      _maxLevel = 0;
+      _nframeFix = 0;
+      _retLabel = newLabel();
+
+      // prologue: ENTRY (frame size patched below), spill parameters without
+      // a register first, then fetch stack arguments 6 and 7
+      if (!emit(0)) return false;
+      for (int i = 0; i < c._nparams && i < 6; i++) {
+        if (_vars[i].weight && _vars[i].reg < 0 && !storeVar(i, (uint8_t)(2 + i))) return false;
+      }
+      for (int i = 6; i < c._nparams; i++) {
+        if (!_vars[i].weight) continue;
+        int8_t r = _vars[i].reg;
+        _frameFix[_nframeFix++] = _ninsn;
+        if (!l32i(r >= 0 ? (uint8_t)r : TEMP0, SP, 4 * (i - 6))) return false;
+        if (r < 0 && !storeVar(i, TEMP0)) return false;
+      }
+
+      if (!genStmt(body)) return false;
+      // falling off the end returns 0
+      if (_ninsn == 0 || _insns[_ninsn - 1].kind != IK_B || _insns[_ninsn - 1].val != _retLabel) {
+        if (!movi(RV, 0)) return false;
+      }
+      if (!placeLabel(_retLabel) || !emit(OP_RETW)) return false;
+
+      if (c._opt.peephole) peephole();
+
+      // frame: [out args][slots][call levels][32: register save areas], 16-aligned
+      _frameSize = (areaOff(_maxLevel) + 32 + 15) & ~15;
+      _insns[0].op = 0x000036u | (uint32_t)SP << 8 | (uint32_t)(_frameSize >> 3) << 12;  // ENTRY a1,FS
+      for (int i = 0; i < _nframeFix; i++) {
+        Insn& in = _insns[_frameFix[i]];
+        uint32_t off = ((in.op >> 16) << 2) + (uint32_t)_frameSize;
+        if (off > 1020) return fail("stack frame too large", c._retPos);
+        in.op = (in.op & 0xFFFF) | (off >> 2) << 16;
+      }
+      return true;
+    }
+
+    // ---- Peephole ----
+
+    // MOV ar, as (OR ar, as, as): destination, or -1 for anything else
+    static int movDest(const Insn& in, uint8_t& src) {
+      uint32_t s = (in.op >> 8) & 15, t = (in.op >> 4) & 15;
+      if (in.kind != IK_HW || (in.op & 0xFF000F) != X_OR || s != t) return -1;
+      src = (uint8_t)s;
+      return (int)((in.op >> 12) & 15);
+    }
+    static bool isMovSelf(const Insn& in) {
+      uint8_t s;
+      return movDest(in, s) == s;
+    }
+
+    void peephole() {
+      bool changed = true;
+      int rounds = 0;
+      while (changed && rounds++ < 32) {
+        changed = false;
+        dropDeadLabels(changed);
+        for (int i = 0; i < _ninsn; i++) {
+          Insn& a = _insns[i];
+          if (a.kind == IK_DEAD || a.kind == IK_LABEL) continue;
+          if (isMovSelf(a)) {
+            a.kind = IK_DEAD;
+            changed = true;
+            continue;
+          }
+          if (tidyBranch(i, changed)) continue;
+          // J to RETW -> RETW
+          if (a.kind == IK_B) {
+            int t = nextReal(c._labelAt[a.val]);
+            if (t >= 0 && _insns[t].kind == IK_HW && _insns[t].op == OP_RETW) {
+              a.kind = IK_HW;
+              a.op = OP_RETW;
+              changed = true;
+              continue;
+            }
+          }
+          int j = nextLive(i);
+          if (j < 0) break;
+          Insn& b = _insns[j];
+          // MOV rY,rX ; MOV rX,rY
+          uint8_t sa, sb;
+          int da = movDest(a, sa), db = movDest(b, sb);
+          if (da >= 0 && db == sa && sb == da) {
+            b.kind = IK_DEAD;
+            changed = true;
+            continue;
+          }
+        }
+      }
+    }
+
+    // ---- Layout ----
+
+    static uint8_t cyclesOf(const Insn& in) {
+      switch (in.kind) {
+        case IK_LDRLIT: return 2;
+        case IK_B: return 2;
+        case IK_BCC: return in.size == 3 ? 1 : 2;
+        case IK_BL: return 3;
+        default: break;
+      }
+      uint32_t op = in.op;
+      if (op == OP_RETW) return 3;
+      if ((op & 0xF00F) == 0x2002) return 2;                                      // L32I
+      if ((op & 0xFF000F) == X_QUOS || (op & 0xFF000F) == X_REMS) return 12;    // divider, worst case
+      return 1;
+    }
+
+    // [pad to 4][literal pool][code]; L32R only reaches backwards.
+    bool layoutFunction(int f) {
+      for (int i = 0; i < _ninsn; i++) {
+        if (_insns[i].kind == IK_LDRLIT && findOrAddLiteral(_insns[i].val) < 0) return fail("literal pool full", c._retPos);
+      }
+      if (c._stats.functions == 1 && (!c.isMain(f) || _nlit > 0)) {
+        // entry stub: J main (patched in finishProgram), offset 0 stays the entry point
+        if (!put(0, 4)) return false;
+        _haveStub = true;
+        c._stats.codeBytes += 3;
+        c._stats.poolBytes += 1;
+        c._stats.insns++;
+        c._stats.cycles += 2;
+      }
+      size_t start = c._outSz;
+      while (c._outSz & 3) {
+        if (!put(0, 1)) return false;
+      }
+      size_t poolBase = c._outSz;
+      for (int i = 0; i < _nlit; i++) {
+        if (!put((uint32_t)c._literals[i], 4)) return false;
+      }
+      c._stats.poolBytes += c._outSz - start;
+      uint32_t base = (uint32_t)c._outSz;
+      _funcs[f].off = base;
+
+      uint32_t* labelOff = c._labelOff;
+      bool grown = true;
+      while (grown) {
+        grown = false;
+        uint32_t off = base;
+        for (int i = 0; i < _ninsn; i++) {
+          if (_insns[i].kind == IK_LABEL) labelOff[_insns[i].val] = off;
+          if (_insns[i].kind != IK_DEAD) off += _insns[i].size;
+        }
+        off = base;
+        for (int i = 0; i < _ninsn; i++) {
+          Insn& in = _insns[i];
+          if (in.kind == IK_DEAD) continue;
+          if (in.kind == IK_BCC && in.size == 3 && !fitsBranch(in.op, (int32_t)labelOff[in.val] - (int32_t)(off + 4))) {
+            in.size = 6;  // inverted branch over a J
+            grown = true;
+          }
+          off += in.size;
+        }
+      }
+
+      for (int i = 0; i < _ninsn; i++) {
+        Insn& in = _insns[i];
+        if (in.kind == IK_DEAD || in.kind == IK_LABEL) continue;
+        uint32_t at = (uint32_t)c._outSz;
+        c._stats.insns++;
+        c._stats.cycles += cyclesOf(in);
+        switch (in.kind) {
+          case IK_HW:
+            if (!put(in.op, 3)) return false;
+            break;
+          case IK_LDRLIT:
+            {
+              int32_t d = (int32_t)(poolBase + 4u * (uint32_t)findOrAddLiteral(in.val)) - (int32_t)((at + 3) & ~3u);
+              if (d < -262144) return fail("literal pool out of range", c._retPos);
+              if (!put(in.op | ((uint32_t)(d >> 2) & 0xFFFF) << 8, 3)) return false;
+              break;
+            }
+          case IK_BCC:
+            if (in.size == 3) {
+              if (!put(withOffset(in.op, (int32_t)labelOff[in.val] - (int32_t)(at + 4)), 3)) return false;
+              break;
+            }
+            // inverted branch over a J
+            invertBranch(in);
+            if (!put(withOffset(in.op, 2), 3)) return false;
+            invertBranch(in);
+            at += 3;
+            // fall through
+          case IK_B:
+            {
+              int32_t d = (int32_t)labelOff[in.val] - (int32_t)(at + 4);
+              if (d < -131072 || d > 131071) return fail("branch out of range", c._retPos);
+              if (!put(encJ(d), 3)) return false;
+              break;
+            }
+          case IK_BL:
+            if (!callFix(at, in.val) || !put(0, 3)) return false;
+            break;
+          default:
+            break;
+        }
+      }
+      c._stats.codeBytes += c._outSz - base;
+      return true;
+    }
+  };
+
+  // Shared by the back ends (one compile at a time)
+  Insn _insns[MAX_INSNS];
+  int16_t _labelAt[MAX_LABELS];  // insn index of each label
+  uint32_t _labelOff[MAX_LABELS];
+  int32_t _literals[MAX_LITERALS];
+  CallFix _calls[MAX_CALLS];
+
+  ThumbBackend _thumb{ *this };
+  XtensaBackend _xtensa{ *this };
+
+  Backend& backend() {
+    if (_target == TARGET_XTENSA) return _xtensa;
+    return _thumb;
   }
 };
 
-#endif  // MCCOMPILER_H_
\ No newline at end of file
+#endif  // MCCOMPILER_H_